@@ -62,6 +62,11 @@ enum McciBootloaderError_e
 	McciBootloaderError_FlashVerifyFailed,	///< flash verify failed after programming
 	McciBootloaderError_FlashNotFound,	///< flash didn't reply properly to SFDP
 	McciBootloaderError_FlashNotSupported,	///< flash SFDP contents are prior to JESD216B, or otherwise not suitable.
+	McciBootloaderError_PackageNotValid,	///< update package contents were not valid while unpacking
+	McciBootloaderError_BlockHashMismatch,	///< a block read from storage didn't match its hash
+	McciBootloaderError_ImageNotValid,	///< image sent over the serial port can't be put in flash
+	McciBootloaderError_SignatureNotValid,	///< image sent over the serial port failed its hash or signature check
+	McciBootloaderError_HostTimeout,	///< host stopped sending (or started over) during serial recovery
 	};
 // typedef uint32_t McciBootloaderError_t; -- in mcci_bootloader_types.h.
 
@@ -75,8 +80,29 @@ enum McciBootloaderState_e
 	McciBootloaderState_ErasingApp,
 	McciBootloaderState_WritingApp,
 	McciBootloaderState_CheckingApp,
+	McciBootloaderState_WaitingForHost,	///< serial recovery: waiting for the host to start
+	McciBootloaderState_ReceivingApp,	///< serial recovery: receiving and writing the app
 	};
 
+/*
+|| A state can also carry the progress through a long phase. The phase
+|| is in the low byte. The next byte is zero if there's no progress to
+|| report, and one more than the percent complete otherwise.
+*/
+#define	MCCI_BOOTLOADER_STATE_PHASE		UINT32_C(0x000000FF)	///< the McciBootloaderState_e
+#define	MCCI_BOOTLOADER_STATE_PROGRESS		UINT32_C(0x0000FF00)	///< 0, or 1 + percent complete
+
+/// \brief make a state with progress
+#define	MCCI_BOOTLOADER_STATE_SET_PROGRESS(a_phase, a_percent)		\
+	(((a_phase) & MCCI_BOOTLOADER_STATE_PHASE) | (((uint32_t)(a_percent) + 1) << 8))
+
+/// \brief get the percent complete from a state, or -1 if it has none
+static inline
+int McciBootloader_getStatePercent(McciBootloaderState_t state)
+	{
+	return (int)((state & MCCI_BOOTLOADER_STATE_PROGRESS) >> 8) - 1;
+	}
+
 /****************************************************************************\
 |
 |	Parameters from link script
@@ -89,12 +115,16 @@ extern const void *gk_McciBootloader_ImageSize;
 
 extern const void *gk_McciBootloader_AppBase;
 extern const void *gk_McciBootloader_AppTop;
+extern const void *gk_McciBootloader_AppBank2Base;
 extern const void *gk_McciBootloader_MfgBase;
 extern const void *gk_McciBootloader_MfgTop;
 
 extern void *g_McciBootloader_SocRamBase;
 extern void *g_McciBootloader_SocRamTop;
 
+extern const void *gk_McciBootloader_RamCodeImageBase;
+extern void *g_McciBootloader_RamCodeBase;
+extern void *g_McciBootloader_RamCodeTop;
 extern const void *gk_McciBootloader_DataImageBase;
 extern void *g_McciBootloader_DataBase;
 extern void *g_McciBootloader_DataTop;
@@ -102,6 +132,64 @@ extern void *g_McciBootloader_BssBase;
 extern void *g_McciBootloader_BssTop;
 extern void *g_McciBootloader_StackTop;
 
+/// \brief the value used to paint unused stack
+#define	MCCI_BOOTLOADER_STACK_PAINT	UINT32_C(0xC5A5C5A5)
+
+/// \brief the least scratch that McciBootloader_checkSignature() will use
+///	as a stack; with less, it uses the caller's stack.
+#define	MCCI_BOOTLOADER_SCRATCH_STACK_MIN	2048u
+
+/****************************************************************************\
+|
+|	Block buffer geometry; set per board in the Makefile.
+|
+\****************************************************************************/
+
+/// \brief the size of an image block. Images are read, checked against
+///	block hash tables, and unpacked from delta packages a block at a
+///	time, and flash is erased in whole blocks. It must be a power of
+///	two, and a multiple of the SHA-512 block and the flash page (128).
+#ifndef MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE
+# define MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE	4096u
+#endif
+
+/// \brief the number of blocks in g_McciBootloader_imageBlock. Images
+///	are read from storage this many blocks at a time.
+#ifndef MCCI_BOOTLOADER_IMAGE_BLOCK_COUNT
+# define MCCI_BOOTLOADER_IMAGE_BLOCK_COUNT	1u
+#endif
+
+/// \brief the last block of an image is only erased and programmed up to
+///	a multiple of this: the flash page, which is also the SHA-512 block.
+#define	MCCI_BOOTLOADER_IMAGE_ROUND_SIZE	128u
+
+/// \brief the unit of programming: an STM32L0 half page. The first one
+///	of an app holds its stack pointer, so an app isn't valid until its
+///	first half page is programmed; it's programmed last.
+#define	MCCI_BOOTLOADER_PROGRAM_SIZE	64u
+
+MCCIADK_C_ASSERT(MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE >= MCCI_BOOTLOADER_IMAGE_ROUND_SIZE);
+MCCIADK_C_ASSERT((MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE & (MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE - 1)) == 0);
+MCCIADK_C_ASSERT(MCCI_BOOTLOADER_IMAGE_BLOCK_COUNT >= 1u);
+// the headers and signature blocks are read into the buffer whole.
+MCCIADK_C_ASSERT(MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE * MCCI_BOOTLOADER_IMAGE_BLOCK_COUNT >= 512u);
+
+/****************************************************************************\
+|
+|	App banks; set per board in the Makefile.
+|
+\****************************************************************************/
+
+/// \brief the number of app banks. With 1, the app has the whole app
+///	region. With 2, the region is split at gk_McciBootloader_AppBank2Base,
+///	each part holds an app linked to run there, and the platform's
+///	app bank selector says which to run; see McciBootloader_bootAppBank().
+#ifndef MCCI_BOOTLOADER_APP_BANKS
+# define MCCI_BOOTLOADER_APP_BANKS	1u
+#endif
+
+MCCIADK_C_ASSERT(MCCI_BOOTLOADER_APP_BANKS == 1u || MCCI_BOOTLOADER_APP_BANKS == 2u);
+
 /****************************************************************************\
 |
 |	Various utilities
@@ -171,7 +259,117 @@ McciBootloader_programAndCheckFlash(
 	const McciBootloader_AppInfo_t *pAppInfo
 	);
 
-extern uint8_t g_McciBootloader_imageBlock[4096];
+bool
+McciBootloader_checkPackageHeader(
+	const McciBootloader_PackageHeader_t *pHeader,
+	McciBootloader_AppInfo_t *pAppInfo
+	);
+
+McciBootloaderError_t
+McciBootloader_programDelta(
+	McciBootloaderStorageAddress_t address,
+	const McciBootloader_PackageHeader_t *pHeader
+	);
+
+McciBootloaderError_t
+McciBootloader_programCompressed(
+	McciBootloaderStorageAddress_t address,
+	const McciBootloader_PackageHeader_t *pHeader
+	);
+
+McciBootloaderError_t
+McciBootloader_checkPackageResult(
+	const McciBootloader_PackageHeader_t *pHeader
+	);
+
+bool
+McciBootloader_getBlockHashTable(
+	McciBootloaderStorageAddress_t address,
+	const McciBootloader_AppInfo_t *pAppInfo,
+	McciBootloader_BlockHashHeader_t *pHeader
+	);
+
+bool
+McciBootloader_checkBlockHashTable(
+	const void *pTable,
+	size_t nTable,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	void *pScratch,
+	size_t nScratch
+	);
+
+bool
+McciBootloader_checkDirectory(
+	McciBootloaderStorageAddress_t address,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	mcci_tweetnacl_sha512_t *pRoot
+	);
+
+bool
+McciBootloader_readDirectory(
+	McciBootloaderStorageAddress_t address,
+	size_t *pnDirectory
+	);
+
+bool
+McciBootloader_selectStorageImage(
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	McciBootloaderStorageAddress_t *pAddress,
+	McciBootloader_AppInfo_t *pAppInfo
+	);
+
+void
+McciBootloader_bootAppBank(
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	);
+
+void
+McciBootloader_serialRecovery(
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	McciBootloaderError_t reason
+	);
+
+bool
+McciBootloader_checkSignature(
+	const mcci_tweetnacl_sign_signature_t *pSignature,
+	const mcci_tweetnacl_sha512_t *pHash,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	void *pScratch,
+	size_t nScratch
+	);
+
+void
+McciBootloader_paintStack(
+	void *pBase,
+	void *pTop
+	);
+
+size_t
+McciBootloader_getStackUsed(
+	const void *pBase,
+	const void *pTop
+	);
+
+void
+McciBootloader_indicateState(
+	McciBootloaderState_t state
+	);
+
+void
+McciBootloader_indicateProgress(
+	uint32_t nDone,
+	uint32_t nTotal
+	);
+
+bool
+McciBootloader_checkStorageBlock(
+	McciBootloaderStorageAddress_t address,
+	const McciBootloader_AppInfo_t *pAppInfo,
+	uint32_t iBlock,
+	const uint8_t *pBlock
+	);
+
+extern uint8_t g_McciBootloader_imageBlock[MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE * MCCI_BOOTLOADER_IMAGE_BLOCK_COUNT];
 
 MCCI_BOOTLOADER_END_DECLS
 #endif /* _MCCI_BOOTLOADER_H_ */
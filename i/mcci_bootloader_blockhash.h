@@ -0,0 +1,87 @@
+/*
+
+Module:	mcci_bootloader_blockhash.h
+
+Function:
+	McciBootloader_BlockHashHeader_t and related definitions
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mcci_bootloader_blockhash_h_
+#define _mcci_bootloader_blockhash_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include "mcci_bootloader_appinfo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************\
+|
+|	Data Structures
+|
+\****************************************************************************/
+
+///
+/// \brief Block hash table header
+///
+/// \details
+///	An image in storage may be followed (immediately after its
+///	signature block) by a table of block hashes: this header, then
+///	\c nBlocks SHA-512 hashes, one for each block of the image
+///	(imagesize + authsize bytes; the last block may be short), then
+///	a McciBootloader_SignatureBlock_t. The hash in that signature
+///	block (the root) covers the header, the block hashes, and the
+///	public key, just as the hash of an image covers the image and the
+///	public key.
+///
+///	The table is only used when checking and copying images from
+///	storage; it's never programmed into flash. Once the root has been
+///	checked, each block can be checked by itself, as it's read, so a
+///	bad block is found without reading the rest of the image.
+///
+///	The block size must be MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE, and the
+///	table must fit in g_McciBootloader_imageBlock.
+///
+struct McciBootloader_BlockHashHeader_s
+	{
+	uint32_t	magic;			///< the format identifier.
+	uint16_t	size;			///< size of this structure, in bytes
+	uint8_t		log2BlockSize;		///< log2 of the block size
+	uint8_t		reserved;		///< zero
+	uint32_t	imageSize;		///< imagesize + authsize of the image
+	uint32_t	nBlocks;		///< number of block hashes
+	};
+
+#define	MCCI_BOOTLOADER_BLOCK_HASH_MAGIC	(('M' << 0) | ('B' << 8) | ('H' << 16) | ('0' << 24))
+
+/// \brief return the size of a block hash table, including the signature block
+static inline size_t
+McciBootloader_blockHashTableSize(
+	const McciBootloader_BlockHashHeader_t *pHeader
+	)
+	{
+	return pHeader->size +
+	       pHeader->nBlocks * sizeof(mcci_tweetnacl_sha512_t) +
+	       sizeof(McciBootloader_SignatureBlock_t);
+	}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _mcci_bootloader_blockhash_h_ */
@@ -0,0 +1,95 @@
+/*
+
+Module:	mcci_bootloader_directory.h
+
+Function:
+	McciBootloader_DirectoryHeader_t and related definitions
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#ifndef _mcci_bootloader_directory_h_
+#define _mcci_bootloader_directory_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include "mcci_bootloader_appinfo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************\
+|
+|	Data Structures
+|
+\****************************************************************************/
+
+///
+/// \brief Slot directory header
+///
+/// \details
+///	The storage may have a slot directory, at the address given by
+///	McciBootloaderPlatform_getDirectoryStorageAddress(): this header,
+///	then \c nSlots entries, then a McciBootloader_SignatureBlock_t.
+///	The hash in the signature block covers the header, the entries
+///	and the public key, as for an image.
+///
+///	Each entry names a slot in storage that holds an image or an
+///	update package, and records what was in it when the directory
+///	was written: the AppInfo of the image it gives, and the hash
+///	from its signature block. When the bootloader has to recover
+///	the app, it uses the directory to try the newest slot first,
+///	and only reads and checks the images it tries. A slot whose
+///	hash no longer matches its entry has been rewritten since, and
+///	is skipped.
+///
+///	The whole directory must fit in g_McciBootloader_imageBlock.
+///
+struct McciBootloader_DirectoryHeader_s
+	{
+	uint32_t	magic;			///< the format identifier.
+	uint16_t	size;			///< size of this structure, in bytes
+	uint16_t	nSlots;			///< number of entries
+	};
+
+#define	MCCI_BOOTLOADER_DIRECTORY_MAGIC	(('M' << 0) | ('S' << 8) | ('D' << 16) | ('0' << 24))
+
+///
+/// \brief Slot directory entry
+///
+struct McciBootloader_DirectoryEntry_s
+	{
+	uint32_t			address;	///< storage address of the slot
+	uint32_t			nSigned;	///< offset of the slot's signature block
+	McciBootloader_AppInfo_t	appInfo;	///< app info of the image in (or made by) the slot
+	mcci_tweetnacl_sha512_t		hash;		///< the hash from the slot's signature block
+	};
+
+/// \brief return the size of a slot directory, including the signature block
+static inline size_t
+McciBootloader_directorySize(
+	const McciBootloader_DirectoryHeader_t *pHeader
+	)
+	{
+	return pHeader->size +
+	       pHeader->nSlots * sizeof(McciBootloader_DirectoryEntry_t) +
+	       sizeof(McciBootloader_SignatureBlock_t);
+	}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _mcci_bootloader_directory_h_ */
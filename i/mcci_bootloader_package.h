@@ -0,0 +1,176 @@
+/*
+
+Module:	mcci_bootloader_package.h
+
+Function:
+	McciBootloader_PackageHeader_t and related definitions
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mcci_bootloader_package_h_
+#define _mcci_bootloader_package_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include "mcci_bootloader_appinfo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************\
+|
+|	Data Structures
+|
+\****************************************************************************/
+
+///
+/// \brief Update package header
+///
+/// \details
+///	A storage region normally holds a complete image, exactly as it
+///	will appear in flash. It may instead hold a package: this header,
+///	followed by \c payloadSize bytes of payload, followed by a
+///	McciBootloader_SignatureBlock_t. The hash in the signature block
+///	covers the header, the payload, and the public key, just as the
+///	hash of an image covers the image and the public key.
+///
+///	A package is recognized by its magic number, which can't be
+///	mistaken for the initial stack pointer of an image.
+///
+///	The image that results from unpacking a package is described by
+///	\c appInfo; its hash (as found in its own signature block) must
+///	be \c targetHash.
+///
+struct McciBootloader_PackageHeader_s
+	{
+	uint32_t	magic;			///< the format identifier.
+	uint16_t	size;			///< size of this structure, in bytes
+	uint8_t		type;			///< the package type; see McciBootloader_PackageType_e
+	uint8_t		log2WindowSize;		///< log2 of the window size used to make the package
+	uint32_t	payloadSize;		///< size of the payload, in bytes
+	uint32_t	baseSize;		///< delta: imagesize + authsize of the base image
+	mcci_tweetnacl_sha512_t baseHash;	///< delta: the hash of the base image
+	mcci_tweetnacl_sha512_t targetHash;	///< the hash of the resulting image
+	McciBootloader_AppInfo_t appInfo;	///< the AppInfo of the resulting image
+	};
+
+#define	MCCI_BOOTLOADER_PACKAGE_MAGIC	(('M' << 0) | ('P' << 8) | ('K' << 16) | ('0' << 24))
+
+///
+/// \brief package types
+///
+enum McciBootloader_PackageType_e
+	{
+	McciBootloader_PackageType_Delta = 1,	///< copy/add instructions against the app in flash
+	McciBootloader_PackageType_Compressed = 2, ///< the image, LZ-compressed
+	};
+
+///
+/// \brief Delta package instructions
+///
+/// \details
+///	The payload of a delta package is a stream of instructions that
+///	produce the new image, in order, from the image currently in the
+///	application flash (the base). Each instruction begins with an
+///	unsigned LEB128 value \c v; the low two bits are the opcode,
+///	and \c (v >> 2) + 1 is the number of bytes produced.
+///
+///	- COPY is followed by a signed (zig-zag) LEB128 offset, relative
+///	  to the end of the previous COPY source (initially zero), giving
+///	  the offset in the base of the bytes to copy.
+///	- ADD is followed by the bytes.
+///	- RUN is followed by one byte, to be repeated.
+///
+///	The new image is built one window at a time in RAM, and then
+///	programmed in place of the base. So a COPY that produces bytes
+///	for a given window may only use base bytes at or after the
+///	start of that window.
+///
+enum McciBootloader_DeltaOp_e
+	{
+	McciBootloader_DeltaOp_Copy = 0,	///< copy bytes from the base
+	McciBootloader_DeltaOp_Add = 1,		///< add literal bytes
+	McciBootloader_DeltaOp_Run = 2,		///< repeat a byte
+	};
+
+///
+/// \brief Compressed package format
+///
+/// \details
+///	The payload of a compressed package is the image (including its
+///	signature block), compressed as a single LZ4 block: a sequence
+///	of tokens, each of which has a literal count in the upper four
+///	bits and a match length (less 4) in the lower four. A count of
+///	15 is extended by the following bytes, each added to the count,
+///	up to and including the first byte that is not 255. The literal
+///	bytes follow, then a two-byte little-endian distance back into
+///	the output, then any match-length extension bytes. The last
+///	token has literals only.
+///
+///	Distances are at most (1 << log2WindowSize). The bootloader keeps
+///	no window in RAM; it reads earlier output back from flash, so the
+///	only RAM it needs is a half-page program buffer.
+///
+#define	MCCI_BOOTLOADER_LZ_MIN_MATCH	4
+
+/// \brief buffered reader for package payloads in storage
+struct McciBootloader_StorageStream_s
+	{
+	McciBootloaderStorageAddress_t	address;	///< next storage address to read
+	McciBootloaderStorageAddress_t	addressEnd;	///< end of the stream
+	McciBootloaderError_t		error;		///< set on failure
+	uint8_t				*pBuffer;	///< the buffer
+	uint32_t			nBuffer;	///< size of the buffer
+	uint32_t			iBuffer;	///< index of next byte in buffer
+	uint32_t			nValid;		///< number of bytes in buffer
+	};
+
+/****************************************************************************\
+|
+|	APIs
+|
+\****************************************************************************/
+
+void
+McciBootloader_storageStreamInit(
+	McciBootloader_StorageStream_t *pStream,
+	McciBootloaderStorageAddress_t address,
+	uint32_t nBytes,
+	uint8_t *pBuffer,
+	uint32_t nBuffer
+	);
+
+bool
+McciBootloader_storageStreamRead(
+	McciBootloader_StorageStream_t *pStream,
+	uint8_t *pBuffer,
+	uint32_t nBuffer
+	);
+
+/// \brief return true if every byte of the stream has been read
+static inline bool
+McciBootloader_storageStreamIsEmpty(
+	const McciBootloader_StorageStream_t *pStream
+	)
+	{
+	return pStream->iBuffer == pStream->nValid && pStream->address == pStream->addressEnd;
+	}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _mcci_bootloader_package_h_ */
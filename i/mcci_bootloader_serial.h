@@ -0,0 +1,118 @@
+/*
+
+Module:	mcci_bootloader_serial.h
+
+Function:
+	McciBootloader_SerialFrameHeader_t and related definitions, for
+	serial recovery.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#ifndef _mcci_bootloader_serial_h_
+#define _mcci_bootloader_serial_h_	/* prevent multiple includes */
+
+#pragma once
+
+#ifndef _MCCI_BOOTLOADER_TYPES_H_
+# include "mcci_bootloader_types.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************\
+|
+|	Data Structures
+|
+\****************************************************************************/
+
+///
+/// \brief Serial recovery frame header
+///
+/// \details
+///	In serial recovery (see McciBootloader_serialRecovery()), the host
+///	sends a signed app image to the bootloader over the serial port.
+///	Everything is sent in frames: this header, then \c length bytes
+///	of payload, then a CRC-32 (as used by zlib and Ethernet, sent
+///	least significant byte first) of everything after the sync byte.
+///	Multi-byte fields are little-endian. Bytes that don't start a
+///	frame with a good CRC are skipped.
+///
+///	The host starts a session with a Hello frame, giving the number
+///	of bytes to be sent (imagesize + authsize) in \c offset. The
+///	bootloader answers with Ready, giving the window: the number of
+///	Data frames the host may send ahead of the acknowledgements.
+///
+///	The host then sends the image in Data frames, in order, each
+///	with MCCI_BOOTLOADER_SERIAL_DATA_MAX bytes (but the last), and
+///	its position in \c offset. The bootloader writes each frame to
+///	flash as it arrives, and answers with Ack, giving the offset of
+///	the next byte it needs. If a frame is lost or damaged, the
+///	frames after it are dropped, and the bootloader answers the
+///	first of them with Nak, giving the offset to go back to.
+///
+///	When all the bytes are in, the bootloader checks the hash and
+///	signature, as for an image in storage, and sends Result, with
+///	the McciBootloaderError_t in \c offset. The app is launched
+///	after a good Result; after a bad one, the bootloader waits for
+///	another Hello.
+///
+struct McciBootloader_SerialFrameHeader_s
+	{
+	uint8_t		sync;			///< MCCI_BOOTLOADER_SERIAL_SYNC
+	uint8_t		type;			///< the McciBootloader_SerialFrameType_e
+	uint16_t	length;			///< number of payload bytes
+	uint32_t	offset;			///< position in the image, or as given by \c type
+	};
+
+#define	MCCI_BOOTLOADER_SERIAL_SYNC	UINT8_C(0xA5)
+
+/// \brief the payload of a Data frame, but the last
+#define	MCCI_BOOTLOADER_SERIAL_DATA_MAX	256u
+
+/// \brief the size of the CRC that follows the payload
+#define	MCCI_BOOTLOADER_SERIAL_CRC_SIZE	4u
+
+/// \brief the size of the largest frame
+#define	MCCI_BOOTLOADER_SERIAL_FRAME_MAX	\
+	(sizeof(McciBootloader_SerialFrameHeader_t) + MCCI_BOOTLOADER_SERIAL_DATA_MAX + MCCI_BOOTLOADER_SERIAL_CRC_SIZE)
+
+/// \brief the frame types
+enum McciBootloader_SerialFrameType_e
+	{
+	McciBootloader_SerialFrameType_Hello = 1,	///< host: start a session; \c offset is the image size
+	McciBootloader_SerialFrameType_Ready,		///< bootloader: session started; payload is McciBootloader_SerialReady_t
+	McciBootloader_SerialFrameType_Data,		///< host: image bytes, starting at \c offset
+	McciBootloader_SerialFrameType_Ack,		///< bootloader: the bytes before \c offset are in flash
+	McciBootloader_SerialFrameType_Nak,		///< bootloader: a frame was lost; send again from \c offset
+	McciBootloader_SerialFrameType_Result,		///< bootloader: session over; \c offset is the McciBootloaderError_t
+	};
+
+///
+/// \brief Serial recovery Ready payload
+///
+struct McciBootloader_SerialReady_s
+	{
+	uint16_t	window;			///< Data frames the host may send ahead
+	uint16_t	dataMax;		///< MCCI_BOOTLOADER_SERIAL_DATA_MAX
+	uint32_t	reason;			///< why the bootloader is in recovery: the McciBootloaderError_t, or OK if asked
+	};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _mcci_bootloader_serial_h_ */
@@ -108,5 +108,40 @@ typedef struct McciBootloader_AppInfo_s McciBootloader_AppInfo_t;
 ///
 typedef struct McciBootloader_SignatureBlock_s McciBootloader_SignatureBlock_t;
 
+///
+/// \brief The header of an update package in storage
+///
+typedef struct McciBootloader_PackageHeader_s McciBootloader_PackageHeader_t;
+
+///
+/// \brief A buffered reader for data in storage
+///
+typedef struct McciBootloader_StorageStream_s McciBootloader_StorageStream_t;
+
+///
+/// \brief The header of a table of block hashes for an image in storage
+///
+typedef struct McciBootloader_BlockHashHeader_s McciBootloader_BlockHashHeader_t;
+
+///
+/// \brief The header of the slot directory in storage
+///
+typedef struct McciBootloader_DirectoryHeader_s McciBootloader_DirectoryHeader_t;
+
+///
+/// \brief One slot in the slot directory
+///
+typedef struct McciBootloader_DirectoryEntry_s McciBootloader_DirectoryEntry_t;
+
+///
+/// \brief The header of a frame of the serial recovery protocol
+///
+typedef struct McciBootloader_SerialFrameHeader_s McciBootloader_SerialFrameHeader_t;
+
+///
+/// \brief The payload of the serial recovery Ready frame
+///
+typedef struct McciBootloader_SerialReady_s McciBootloader_SerialReady_t;
+
 MCCI_BOOTLOADER_END_DECLS
 #endif /* _MCCI_BOOTLOADER_TYPES_H_ */
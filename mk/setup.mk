@@ -137,6 +137,12 @@ CFLAGS	+=	-nostdlib
 CFLAGS  +=	${CFLAGS_BUILDTYPE_${T_BUILDTYPE}}
 CFLAGS 	+=	${CFLAGS_PROGRAM} ${CFLAGS_USER}
 
+# LTO=1 compiles for link-time optimization; CFLAGS are also passed to
+# the link, and the libraries must be made with the plugin-aware ar.
+ifeq (${LTO},1)
+CFLAGS	+=	-flto
+endif
+
 INCLUDES_GLOBAL += ${MCCIBOOTLOADER_ROOT}i
 
 CPPFLAGS +=	${CPPFLAGS_PROGRAM} ${CPPFLAGS_USER}
@@ -156,7 +162,11 @@ LDADD	?=					\
 	-lgcc					\
 ### end LDADD ###
 
+ifeq (${LTO},1)
+AR	:=	$(CROSS_COMPILE)gcc-ar
+else
 AR	:=	$(CROSS_COMPILE)ar
+endif
 
 ##############################################################################
 #
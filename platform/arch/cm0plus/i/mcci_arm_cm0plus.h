@@ -175,7 +175,7 @@ extern "C" {
 #define	MCCI_CM0PLUS_SCB_ICSR_PENDSVSET		(UINT32_C(1) << 28)	///<
 #define	MCCI_CM0PLUS_SCB_ICSR_PENDSVCLR		(UINT32_C(1) << 27)	///<
 #define	MCCI_CM0PLUS_SCB_ICSR_PENDSTSET		(UINT32_C(1) << 26)	///<
-#define	MCCI_CM0PLUS_SCB_ICSR_PENDSTCLR		(UINT32_C(1) << 26)	///<
+#define	MCCI_CM0PLUS_SCB_ICSR_PENDSTCLR		(UINT32_C(1) << 25)	///<
 #define	MCCI_CM0PLUS_SCB_ICSR_RSV24		(UINT32_C(1) << 24)	///<
 #define	MCCI_CM0PLUS_SCB_ICSR_ISRPREEMPT	(UINT32_C(1) << 23)	///<
 #define	MCCI_CM0PLUS_SCB_ICSR_ISRPENDING	(UINT32_C(1) << 22)	///<
@@ -453,6 +453,23 @@ void McciArm_DataSynchBarrier(
 	__asm volatile ("dsb 0xF" ::: "memory");
 	}
 
+///
+/// \brief sleep until an interrupt is pending
+///
+/// \details
+///	The CPU stops until an enabled interrupt becomes pending. This
+///	happens even if PRIMASK is set; in that case the interrupt is not
+///	taken, and execution continues after the WFI.
+///
+__attribute__((__always_inline__)) static inline
+void
+McciArm_waitForInterrupt(
+	void
+	)
+	{
+	__asm volatile ("wfi" ::: "memory");
+	}
+
 #else
 # error "Compiler not supported"
 #endif
@@ -26,11 +26,44 @@ Author:
 
 #include "mcci_arm_cm0plus.h"
 #include "mcci_bootloader_cm0plus_appimage.h"
+#include "mcci_bootloader_platform_types.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/****************************************************************************\
+|
+|	Stack usage
+|
+\****************************************************************************/
+
+/// \brief the magic number of a McciBootloader_CortexStackRecord_t
+#define	MCCI_BOOTLOADER_STACK_RECORD_MAGIC	UINT32_C(0x4B435453)	/* 'STCK' */
+
+///
+/// \brief the stack usage left for the app by the boot
+///
+/// \details \c check is the complement of the XOR of the other words,
+///	so that a record that the app has written over can be detected.
+///
+typedef struct McciBootloader_CortexStackRecord_s
+	{
+	uint32_t magic;		///< MCCI_BOOTLOADER_STACK_RECORD_MAGIC
+	McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_t usage;	///< the usage
+	uint32_t check;		///< the check word
+	} McciBootloader_CortexStackRecord_t;
+
+void
+McciBootloaderPlatform_saveStackUsage(
+	void
+	);
+
+McciBootloaderPlatform_ARMv6M_SvcError_t
+McciBootloaderPlatform_getStackUsage(
+	McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_t *pUsage
+	);
+
 /****************************************************************************\
 |
 |	Globals
@@ -63,6 +96,28 @@ extern const McciBootloader_SignatureBlock_t
 gk_McciBootloader_SignatureBlock
 __attribute__((__section__(".McciBootloader_Signature")));
 
+///
+/// \brief the most scratch stack used during this boot
+///
+/// \see McciBootloaderPlatform_callOnStack()
+///
+extern McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_t
+g_McciBootloader_StackUsage;
+
+///
+/// \brief the stack usage record left for the app
+///
+/// \details
+///	The record is put in section \c .McciBootloader_NoInit, which is
+///	neither loaded nor zeroed -- be sure to research the link script
+///	when making changes here.
+///
+/// \see mccibootloader.ld
+///
+extern McciBootloader_CortexStackRecord_t
+g_McciBootloader_StackRecord
+__attribute__((__section__(".McciBootloader_NoInit")));
+
 /****************************************************************************\
 |
 |	End of file
@@ -0,0 +1,131 @@
+/*
+
+Module:	mccibootloaderplatform_callonstack.c
+
+Function:
+	McciBootloaderPlatform_callOnStack()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader_platform.h"
+
+#include "mcci_bootloader.h"
+#include "mcci_bootloader_cm0plus.h"
+#include <stdint.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+static void
+callOnStack_switch(
+	McciBootloaderPlatform_StackFn_t *pFn,
+	void *pArg,
+	void *pStackTop
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_t
+g_McciBootloader_StackUsage;
+
+/*
+
+Name:	McciBootloaderPlatform_callOnStack()
+
+Function:
+	Call a function on a stack lent by the caller.
+
+Definition:
+	void McciBootloaderPlatform_callOnStack(
+		McciBootloaderPlatform_StackFn_t *pFn,
+		void *pArg,
+		void *pStack,
+		size_t nStack
+		);
+
+Description:
+	The nStack bytes at pStack are painted, and then (*pFn)(pArg) is
+	called with the stack pointer at the (8-byte aligned) top of the
+	area. On return, the caller's stack pointer is restored, and the
+	most scratch stack used so far is recorded in
+	g_McciBootloader_StackUsage for the stack usage report.
+
+	Interrupts stay enabled; handlers run on the lent stack, so it
+	must have room for them as well.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloaderPlatform_callOnStack(
+	McciBootloaderPlatform_StackFn_t *pFn,
+	void *pArg,
+	void *pStack,
+	size_t nStack
+	)
+	{
+	uint8_t * const pTop = (uint8_t *)((uintptr_t)((uint8_t *)pStack + nStack) & ~(uintptr_t)7);
+
+	McciBootloader_paintStack(pStack, pTop);
+	callOnStack_switch(pFn, pArg, pTop);
+
+	size_t const nUsed = McciBootloader_getStackUsed(pStack, pTop);
+
+	if (nUsed > g_McciBootloader_StackUsage.nScratchUsed)
+		{
+		g_McciBootloader_StackUsage.nScratch = McciBootloader_codeSize(pStack, pTop);
+		g_McciBootloader_StackUsage.nScratchUsed = nUsed;
+		}
+	}
+
+/* switch to pStackTop, call pFn(pArg), and switch back */
+__attribute__((__naked__))
+static void
+callOnStack_switch(
+	McciBootloaderPlatform_StackFn_t *pFn,
+	void *pArg,
+	void *pStackTop
+	)
+	{
+	__asm volatile (
+		"push	{r4, lr}\n"
+		"mov	r4, sp\n"	// r4 is callee-saved: it keeps our sp
+		"mov	sp, r2\n"
+		"mov	r2, r0\n"
+		"mov	r0, r1\n"
+		"blx	r2\n"
+		"mov	sp, r4\n"
+		"pop	{r4, pc}\n"
+		);
+	}
+
+/**** end of mccibootloaderplatform_callonstack.c ****/
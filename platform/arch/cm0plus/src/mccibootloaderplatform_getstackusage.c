@@ -0,0 +1,149 @@
+/*
+
+Module:	mccibootloaderplatform_getstackusage.c
+
+Function:
+	McciBootloaderPlatform_saveStackUsage() and
+	McciBootloaderPlatform_getStackUsage()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader_platform.h"
+
+#include "mcci_bootloader.h"
+#include "mcci_bootloader_cm0plus.h"
+#include <stdint.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+static uint32_t
+stackUsage_check(
+	const McciBootloader_CortexStackRecord_t *pRecord
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+McciBootloader_CortexStackRecord_t
+g_McciBootloader_StackRecord;
+
+/*
+
+Name:	McciBootloaderPlatform_saveStackUsage()
+
+Function:
+	Record how much stack the boot used, for the application.
+
+Definition:
+	void McciBootloaderPlatform_saveStackUsage(
+		void
+		);
+
+Description:
+	McciBootloaderPlatform_entry() paints the stack, from the end of
+	.bss up; here, just before launching the app, we see how far it
+	was used, and save that and the scratch stack usage (from
+	McciBootloaderPlatform_callOnStack()) in g_McciBootloader_StackRecord.
+	That's in .McciBootloader_NoInit, at the bottom of the working
+	RAM, where it survives until the app writes over it.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloaderPlatform_saveStackUsage(
+	void
+	)
+	{
+	McciBootloader_CortexStackRecord_t * const pRecord = &g_McciBootloader_StackRecord;
+
+	pRecord->usage = g_McciBootloader_StackUsage;
+	pRecord->usage.nStack = McciBootloader_codeSize(&g_McciBootloader_BssTop, &g_McciBootloader_StackTop);
+	pRecord->usage.nStackUsed = McciBootloader_getStackUsed(&g_McciBootloader_BssTop, &g_McciBootloader_StackTop);
+	pRecord->magic = MCCI_BOOTLOADER_STACK_RECORD_MAGIC;
+	pRecord->check = stackUsage_check(pRecord);
+	}
+
+/*
+
+Name:	McciBootloaderPlatform_getStackUsage()
+
+Function:
+	Return the stack usage recorded by the last boot.
+
+Definition:
+	McciBootloaderPlatform_ARMv6M_SvcError_t
+	McciBootloaderPlatform_getStackUsage(
+		McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_t *pUsage
+		);
+
+Description:
+	This is called on behalf of the app by the SVC handler, so it
+	uses only the record; the rest of the bootloader's RAM belongs to
+	the app.
+
+Returns:
+	McciBootloaderPlatform_SvcError_OK, with *pUsage set, if the
+	record is intact; McciBootloaderPlatform_SvcError_NotAvailable if
+	it's been overwritten.
+
+*/
+
+McciBootloaderPlatform_ARMv6M_SvcError_t
+McciBootloaderPlatform_getStackUsage(
+	McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_t *pUsage
+	)
+	{
+	const McciBootloader_CortexStackRecord_t * const pRecord = &g_McciBootloader_StackRecord;
+
+	if (pRecord->magic != MCCI_BOOTLOADER_STACK_RECORD_MAGIC ||
+	    pRecord->check != stackUsage_check(pRecord))
+		return McciBootloaderPlatform_SvcError_NotAvailable;
+
+	*pUsage = pRecord->usage;
+	return McciBootloaderPlatform_SvcError_OK;
+	}
+
+/* the check word of a record */
+static uint32_t
+stackUsage_check(
+	const McciBootloader_CortexStackRecord_t *pRecord
+	)
+	{
+	return ~(pRecord->magic ^
+		 pRecord->usage.nStack ^
+		 pRecord->usage.nStackUsed ^
+		 pRecord->usage.nScratch ^
+		 pRecord->usage.nScratchUsed);
+	}
+
+/**** end of mccibootloaderplatform_getstackusage.c ****/
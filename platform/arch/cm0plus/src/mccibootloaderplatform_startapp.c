@@ -23,6 +23,7 @@ Author:
 
 #include "mcci_bootloader_bits.h"
 #include "mcci_arm_cm0plus.h"
+#include "mcci_bootloader_cm0plus.h"
 #include <stdint.h>
 
 /****************************************************************************\
@@ -93,6 +94,9 @@ McciBootloaderPlatform_startApp(
 	const uint32_t stack = pAppVectors->stack;
 	const uint32_t pc = pAppVectors->entry;
 
+	// leave the stack usage for the app
+	McciBootloaderPlatform_saveStackUsage();
+
 	// Oddly, interrupts are enabled on launch, so we have to
 	// deal with that below.
 	McciArm_disableInterrupts();
@@ -46,6 +46,8 @@ gk_McciBootloaderPlatformInterface =
 	.pDelayMs = McciBootloaderBoard_CatenaAbz_delayMs,
 	.pGetUpdate = McciBootloaderBoard_CatenaAbz_getUpdate,
 	.pSetUpdate = McciBootloaderBoard_CatenaAbz_setUpdate,
+	.pGetAppBank = McciBootloaderBoard_CatenaAbz_getAppBank,
+	.pSetAppBank = McciBootloaderBoard_CatenaAbz_setAppBank,
 	.pSystemFlashErase = McciBootloader_Stm32L0_systemFlashErase,
 	.pSystemFlashWrite = McciBootloader_Stm32L0_systemFlashWrite,
 	.Storage =
@@ -54,12 +56,20 @@ gk_McciBootloaderPlatformInterface =
 		.pRead = McciBootloaderFlash_Mx25v8035f_storageRead,
 		.pGetPrimaryAddress = McciBootloaderBoard_CatenaAbz_getPrimaryStorageAddress,
 		.pGetFallbackAddress = McciBootloaderBoard_CatenaAbz_getFallbackStorageAddress,
+		.pGetDirectoryAddress = McciBootloaderBoard_CatenaAbz_getDirectoryStorageAddress,
 		},
 	.Spi =
 		{
 		.pInit = McciBootloaderBoard_CatenaAbz_spiInit,
 		.pTransfer = McciBootloaderBoard_CatenaAbz_spiTransfer,
 		},
+	.Serial =
+		{
+		.pInit = McciBootloaderBoard_CatenaAbz_serialInit,
+		.pRead = McciBootloaderBoard_CatenaAbz_serialRead,
+		.pWrite = McciBootloaderBoard_CatenaAbz_serialWrite,
+		.pGetRecoveryRequest = McciBootloaderBoard_CatenaAbz_getRecoveryRequest,
+		},
 	.Annunciator =
 		{
 		.pInit = McciBootloaderBoard_CatenaAbz_annunciatorInit,
@@ -75,4 +85,21 @@ gk_McciBootloaderPlatformInterface =
 
 
 
+/****************************************************************************\
+|
+|	Static binding (see mcci_bootloader_board_catena_abz_binding.h)
+|
+\****************************************************************************/
+
+#ifdef MCCI_BOOTLOADER_PLATFORM_BINDING
+/* the core library is shared, so it calls storage init by a common name */
+void
+McciBootloaderBoard_storageInit(
+	void
+	)
+	{
+	McciBootloaderBoard_Catena46xx_storageInit();
+	}
+#endif
+
 /**** end of mccibootloaderboard_catenaabz_platforminterface.c ****/
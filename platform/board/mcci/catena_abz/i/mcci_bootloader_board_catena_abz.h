@@ -29,8 +29,8 @@ Author:
 # include "mcci_bootloader_types.h"
 #endif
 
-#ifndef _mcci_bootloader_platform_h_
-# include "mcci_bootloader_platform.h"
+#ifndef _mcci_bootloader_platform_types_h_
+# include "mcci_bootloader_platform_types.h"
 #endif
 
 #ifndef _mcci_bootloader_stm32l0_h_
@@ -71,6 +71,17 @@ MCCI_BOOTLOADER_BEGIN_DECLS
 #define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_STORAGE_UPDATE_BASE	\
 		(UINT32_C(256) * 1024)
 
+///
+/// \brief base address of the slot directory
+///
+/// \details The directory (see McciBootloader_DirectoryHeader_t) takes
+///	the last 4k sector below the fallback image, so it can be erased
+///	and rewritten by itself. If the first 256k is write-protected,
+///	the directory must be written before protection is set.
+///
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_STORAGE_DIRECTORY_BASE	\
+		(UINT32_C(60) * 1024)
+
 /****************************************************************************\
 |
 |	API functions.
@@ -96,6 +107,12 @@ McciBootloaderBoard_CatenaAbz_getUpdate;
 McciBootloaderPlatform_SetUpdateFlagFn_t
 McciBootloaderBoard_CatenaAbz_setUpdate;
 
+McciBootloaderPlatform_GetAppBankFn_t
+McciBootloaderBoard_CatenaAbz_getAppBank;
+
+McciBootloaderPlatform_SetAppBankFn_t
+McciBootloaderBoard_CatenaAbz_setAppBank;
+
 McciBootloaderPlatform_StorageReadFn_t
 McciBootloaderBoard_CatenaAbz_storageRead;
 
@@ -105,20 +122,36 @@ McciBootloaderBoard_CatenaAbz_getPrimaryStorageAddress;
 McciBootloaderPlatform_GetFallbackStorageAddressFn_t
 McciBootloaderBoard_CatenaAbz_getFallbackStorageAddress;
 
+McciBootloaderPlatform_GetDirectoryStorageAddressFn_t
+McciBootloaderBoard_CatenaAbz_getDirectoryStorageAddress;
+
 McciBootloaderPlatform_SpiInitFn_t
 McciBootloaderBoard_CatenaAbz_spiInit;
 
 McciBootloaderPlatform_SpiTransferFn_t
 McciBootloaderBoard_CatenaAbz_spiTransfer;
 
+McciBootloaderPlatform_SerialInitFn_t
+McciBootloaderBoard_CatenaAbz_serialInit;
+
+McciBootloaderPlatform_SerialReadFn_t
+McciBootloaderBoard_CatenaAbz_serialRead;
+
+McciBootloaderPlatform_SerialWriteFn_t
+McciBootloaderBoard_CatenaAbz_serialWrite;
+
+McciBootloaderPlatform_GetRecoveryRequestFn_t
+McciBootloaderBoard_CatenaAbz_getRecoveryRequest;
+
 McciBootloaderPlatform_AnnunciatorInitFn_t
 McciBootloaderBoard_CatenaAbz_annunciatorInit;
 
 McciBootloaderPlatform_AnnunciatorIndicateStateFn_t
 McciBootloaderBoard_CatenaAbz_annunciatorIndicateState;
 
+void McciBootloaderBoard_CatenaAbz_annunciatorStop(void);
 void McciBootloaderBoard_CatenaAbz_clearLed(void);
-void McciBootloaderBoard_CatenaAbz_handleSysTick(void);
+void McciBootloaderBoard_CatenaAbz_handleLptim1(void);
 void McciBootloaderBoard_CatenaAbz_setLed(void);
 
 McciBootloaderBoard_CatenaAbz_Eeprom_t *
@@ -126,4 +159,12 @@ McciBootloaderBoard_CatenaAbz_getEepromPointer(void);
 
 MCCI_BOOTLOADER_END_DECLS
 
+/*
+|| The platform header comes last: with a static binding, it includes
+|| this header to define its wrappers, which need the declarations above.
+*/
+#ifndef _mcci_bootloader_platform_h_
+# include "mcci_bootloader_platform.h"
+#endif
+
 #endif /* _mcci_bootloader_board_catena_abz_h_ */
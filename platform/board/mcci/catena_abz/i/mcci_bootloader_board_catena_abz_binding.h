@@ -0,0 +1,89 @@
+/*
+
+Module:	mcci_bootloader_board_catena_abz_binding.h
+
+Function:
+	Static platform binding for MCCI Catenas based on the Murata
+	type-ABZ module with the STM32L0.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#ifndef _mcci_bootloader_board_catena_abz_binding_h_
+#define _mcci_bootloader_board_catena_abz_binding_h_	/* prevent multiple includes */
+
+#pragma once
+
+/*
+|| This file is included by mcci_bootloader_platform.h when the build
+|| sets MCCI_BOOTLOADER_PLATFORM_BINDING to its name. It names the
+|| function that provides each entry of McciBootloaderPlatform_Interface_t,
+|| so the wrappers call them directly. It must agree with the
+|| gk_McciBootloaderPlatformInterface tables in the board libraries.
+*/
+
+#ifndef _mcci_bootloader_board_catena_abz_h_
+# include "mcci_bootloader_board_catena_abz.h"
+#endif
+
+#ifndef _mcci_bootloader_flash_mx25v8035f_h_
+# include "mcci_bootloader_flash_mx25v8035f.h"
+#endif
+
+MCCI_BOOTLOADER_BEGIN_DECLS
+
+/****************************************************************************\
+|
+|	The board-specific entries. The core library is shared by all the
+|	ABZ boards, so each board library provides these under a common
+|	name.
+|
+\****************************************************************************/
+
+McciBootloaderPlatform_StorageInitFn_t
+McciBootloaderBoard_storageInit;
+
+/****************************************************************************\
+|
+|	The binding
+|
+\****************************************************************************/
+
+#define	McciBootloaderPlatformBinding_systemInit		McciBootloaderBoard_CatenaAbz_systemInit
+#define	McciBootloaderPlatformBinding_prepareForLaunch		McciBootloaderBoard_CatenaAbz_prepareForLaunch
+#define	McciBootloaderPlatformBinding_fail			McciBootloaderBoard_CatenaAbz_fail
+#define	McciBootloaderPlatformBinding_delayMs			McciBootloaderBoard_CatenaAbz_delayMs
+#define	McciBootloaderPlatformBinding_getUpdateFlag		McciBootloaderBoard_CatenaAbz_getUpdate
+#define	McciBootloaderPlatformBinding_setUpdateFlag		McciBootloaderBoard_CatenaAbz_setUpdate
+#define	McciBootloaderPlatformBinding_getAppBank		McciBootloaderBoard_CatenaAbz_getAppBank
+#define	McciBootloaderPlatformBinding_setAppBank		McciBootloaderBoard_CatenaAbz_setAppBank
+#define	McciBootloaderPlatformBinding_systemFlashErase		McciBootloader_Stm32L0_systemFlashErase
+#define	McciBootloaderPlatformBinding_systemFlashWrite		McciBootloader_Stm32L0_systemFlashWrite
+#define	McciBootloaderPlatformBinding_storageInit		McciBootloaderBoard_storageInit
+#define	McciBootloaderPlatformBinding_storageRead		McciBootloaderFlash_Mx25v8035f_storageRead
+#define	McciBootloaderPlatformBinding_getPrimaryStorageAddress	McciBootloaderBoard_CatenaAbz_getPrimaryStorageAddress
+#define	McciBootloaderPlatformBinding_getFallbackStorageAddress	McciBootloaderBoard_CatenaAbz_getFallbackStorageAddress
+#define	McciBootloaderPlatformBinding_getDirectoryStorageAddress	McciBootloaderBoard_CatenaAbz_getDirectoryStorageAddress
+#define	McciBootloaderPlatformBinding_spiInit			McciBootloaderBoard_CatenaAbz_spiInit
+#define	McciBootloaderPlatformBinding_spiTransfer		McciBootloaderBoard_CatenaAbz_spiTransfer
+#define	McciBootloaderPlatformBinding_serialInit		McciBootloaderBoard_CatenaAbz_serialInit
+#define	McciBootloaderPlatformBinding_serialRead		McciBootloaderBoard_CatenaAbz_serialRead
+#define	McciBootloaderPlatformBinding_serialWrite		McciBootloaderBoard_CatenaAbz_serialWrite
+#define	McciBootloaderPlatformBinding_getRecoveryRequest	McciBootloaderBoard_CatenaAbz_getRecoveryRequest
+#define	McciBootloaderPlatformBinding_annunciatorInit		McciBootloaderBoard_CatenaAbz_annunciatorInit
+#define	McciBootloaderPlatformBinding_annunciatorIndicateState	McciBootloaderBoard_CatenaAbz_annunciatorIndicateState
+
+MCCI_BOOTLOADER_END_DECLS
+
+#endif /* _mcci_bootloader_board_catena_abz_binding_h_ */
@@ -40,10 +40,12 @@ McciBootloaderBoard_CatenaAbz_Eeprom_t;
 /// \brief layout of Catena EEPROM image
 ///
 /// We place an image of this at the end of the data EEPROM second for
-/// the SoC.
+/// the SoC. Apps find the update request at the top of EEPROM, so new
+/// cells go in front of it.
 ///
 struct McciBootloaderBoard_CatenaAbz_Eeprom_s
 	{
+	uint32_t	AppBank;	///< the app bank selector.
 	uint32_t	fUpdateRequest;	///< the update request.
 	};
 
@@ -54,7 +56,7 @@ struct McciBootloaderBoard_CatenaAbz_Eeprom_s
 
 // make sure the structure is the right size
 MCCI_BOOTLOADER_EEPROM_STATIC_ASSERT(
-	sizeof(McciBootloaderBoard_CatenaAbz_Eeprom_t) == 4
+	sizeof(McciBootloaderBoard_CatenaAbz_Eeprom_t) == 8
 	);
 
 /// \brief mark the beginning of a bootloader EEPROM section
@@ -66,6 +68,10 @@ MCCI_BOOTLOADER_EEPROM_STATIC_ASSERT(
 /// \brief the distinguished "update request" value
 #define	MCCI_BOOTLOADER_CATENA_ABZ_EEPROM_UPDATE_REQUEST	UINT32_C(0xFFFFFFFF)
 
+/// \brief the app bank selector value for the second bank; any other
+///	value selects the first.
+#define	MCCI_BOOTLOADER_CATENA_ABZ_EEPROM_APP_BANK_2	(('2' << 24) | ('K' << 16) | ('N' << 8) | 'B')
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,6 +22,8 @@ Author:
 #include "mcci_bootloader_board_catena_abz.h"
 
 #include "mcci_bootloader.h"
+#include "mcci_stm32l0xx.h"
+#include "mcci_arm_cm0plus.h"
 
 /****************************************************************************\
 |
@@ -29,29 +31,39 @@ Author:
 |
 \****************************************************************************/
 
+/// LPTIM1 counts the LSE (32768 Hz), divided by 128.
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_ANNUNCIATOR_HZ	(UINT32_C(32768) / 128)
+
+/// the LED is on PB2, which is LPTIM1_OUT as alternate function 2.
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_PIN	2
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_AF		2
+
 typedef struct CatenaAbz_Annuciator_s CatenaAbz_Annuciator_t;
 
 typedef enum
 	{
-	stNoChange = -1, ///< internal: don't change state.
 	stInitial,	///< not initialized
-	stIdle,		///< not displaying
-	stLedOn,	///< light is on
-	stBitGap,	///< displaying bit gap
-	stByteGap,	///< displaying byte gap
+	stIdle,		///< not displaying; timer stopped
+	stBits,		///< displaying the bits of the state
+	stProgress,	///< displaying the progress bar
 	} AnnunciatorBitState_t;
 
 struct CatenaAbz_Annuciator_s
 	{
-	uint32_t		tick;
-	uint32_t		display;
-	uint32_t		value;
-	uint32_t		bittime;
-	uint32_t		timer;
-	McciBootloaderState_t	bootState;
+	uint32_t		display;	///< the bits to display, left-justified, with a stop bit
+	uint32_t		value;		///< the bits left to display
+	uint32_t		bittime;	///< timer counts per bit time
+	int32_t			progress;	///< percent complete, or -1
+	McciBootloaderState_t	bootState;	///< the state being displayed
 	AnnunciatorBitState_t	bitState;
 	};
 
+static void
+annunciatorStart(void);
+
+static void
+annunciatorNextPeriod(void);
+
 /****************************************************************************\
 |
 |	Read-only data.
@@ -67,26 +79,116 @@ struct CatenaAbz_Annuciator_s
 \****************************************************************************/
 
 static CatenaAbz_Annuciator_t annunciator;
+
+/*
+
+Name:	McciBootloaderBoard_CatenaAbz_annunciatorInit()
+
+Function:
+	Set up the LED annunciator.
+
+Definition:
+	McciBootloaderPlatform_AnnunciatorInitFn_t
+		McciBootloaderBoard_CatenaAbz_annunciatorInit;
+
+	void McciBootloaderBoard_CatenaAbz_annunciatorInit(
+		void
+		);
+
+Description:
+	The LED pattern is generated by LPTIM1 in PWM mode, driving the
+	LED directly. Each bit of the pattern is one period of the timer:
+	the LED is off for the gap, and then on for the bit. The timer
+	interrupts once per period, at the end, so that we can program
+	the next bit; otherwise the CPU isn't disturbed.
+
+	LPTIM1 is clocked from the LSE, which systemInit has started. We
+	then enable interrupts.
+
+Returns:
+	No explicit result.
+
+*/
 
 void
 McciBootloaderBoard_CatenaAbz_annunciatorInit(
 	void
 	)
 	{
+	// clock LPTIM1 from the LSE, and enable it.
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_RCC_CCIPR,
+		MCCI_STM32L0_REG_RCC_CCIPR_LPTIM1SEL,
+		MCCI_STM32L0_REG_RCC_CCIPR_LPTIM1SEL_LSE
+		);
+	McciArm_putRegOr(
+		MCCI_STM32L0_REG_RCC_APB1ENR,
+		MCCI_STM32L0_REG_RCC_APB1ENR_LPTIM1EN
+		);
+
+	annunciator.bittime = MCCI_BOOTLOADER_BOARD_CATENA_ABZ_ANNUNCIATOR_HZ / 10; // 100 ms per bit.
+	annunciator.bitState = stIdle;
+
+	McciArm_putReg(MCCI_CM0PLUS_NVIC_ISER, UINT32_C(1) << MCCI_STM32L0_IRQ_LPTIM1);
+
 	/// enable interrupts
 	McciArm_setPRIMASK(0);
-	annunciator.bittime = 100; // 100 ms per bit.
-	annunciator.bitState = stIdle;
+
+	// the state may have been set before we were initialized.
+	if (annunciator.display != 0)
+		annunciatorStart();
 	}
 
+/*
+
+Name:	McciBootloaderBoard_CatenaAbz_annunciatorIndicateState()
+
+Function:
+	Set the state to be shown by the LED annunciator.
+
+Definition:
+	McciBootloaderPlatform_AnnunciatorIndicateStateFn_t
+		McciBootloaderBoard_CatenaAbz_annunciatorIndicateState;
+
+	void McciBootloaderBoard_CatenaAbz_annunciatorIndicateState(
+		McciBootloaderState_t state
+		);
+
+Description:
+	The phase of the state is shown as a sequence of bits: short
+	flashes for zeros, long flashes for ones. If the state carries
+	progress, the sequence is followed by a bar, a flash whose
+	length grows from one to eleven bit times as the phase goes from
+	0% to 100%. A new phase is shown from the start of the next
+	sequence; new progress, at the next bar. So progress costs no
+	interrupts beyond those of the bits.
+
+	A state of zero stops the display.
+
+Returns:
+	No explicit result.
+
+*/
+
 void
 McciBootloaderBoard_CatenaAbz_annunciatorIndicateState(
 	McciBootloaderState_t state
 	)
 	{
-	if (state != 0)
+	McciBootloaderState_t const phase = state & MCCI_BOOTLOADER_STATE_PHASE;
+
+	annunciator.progress = McciBootloader_getStatePercent(state);
+	if (annunciator.progress > 100)
+		annunciator.progress = 100;
+
+	if (phase == annunciator.bootState && annunciator.display != 0)
+		return;
+
+	annunciator.bootState = phase;
+
+	if (phase != 0)
 		{
-		uint32_t display = ((uint32_t)state << 1) | 1;
+		uint32_t display = ((uint32_t)phase << 1) | 1;
 		unsigned nBits;
 		// always put at least 2 bits
 		for (nBits = 31; nBits > 2; --nBits)
@@ -104,84 +206,213 @@ McciBootloaderBoard_CatenaAbz_annunciatorIndicateState(
 		}
 	else
 		annunciator.display = 0;
+
+	if (annunciator.bitState == stIdle && annunciator.display != 0)
+		annunciatorStart();
 	}
 
-static bool
-nextBit(void)
+/*
+
+Name:	McciBootloaderBoard_CatenaAbz_handleLptim1()
+
+Function:
+	Handle the LPTIM1 interrupt: program the next bit of the pattern.
+
+Definition:
+	void McciBootloaderBoard_CatenaAbz_handleLptim1(
+		void
+		);
+
+Description:
+	This is the LPTIM1 interrupt handler. It may also be polled with
+	interrupts disabled (as McciBootloaderBoard_CatenaAbz_fail()
+	does); it does nothing unless a period has ended.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloaderBoard_CatenaAbz_handleLptim1(
+	void
+	)
 	{
-	bool fNextBit = !!(annunciator.value & UINT32_C(0x80000000));
-	annunciator.value <<= 1;
-	if (annunciator.value == 0)
-		return false;
-
-	McciBootloaderBoard_CatenaAbz_setLed();
-	annunciator.timer = annunciator.tick + annunciator.bittime * (1 + 2 * fNextBit);
-	return true;
+	if (! (McciArm_getReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_ISR) & MCCI_STM32L0_LPTIM_ISR_ARRM))
+		return;
+
+	McciArm_putReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_ICR, MCCI_STM32L0_LPTIM_ISR_ARRM);
+
+	// if we're polling, don't leave the interrupt pending.
+	McciArm_putReg(MCCI_CM0PLUS_NVIC_ICPR, UINT32_C(1) << MCCI_STM32L0_IRQ_LPTIM1);
+
+	annunciatorNextPeriod();
 	}
 
+/*
+
+Name:	McciBootloaderBoard_CatenaAbz_annunciatorStop()
+
+Function:
+	Stop the LED annunciator, and return its resources to the reset state.
+
+Definition:
+	void McciBootloaderBoard_CatenaAbz_annunciatorStop(
+		void
+		);
+
+Description:
+	This is called before launching the app. LPTIM1 and the GPIOs
+	are reset by McciBootloader_Stm32L0_prepareForLaunch(); we take
+	care of the rest.
+
+Returns:
+	No explicit result.
+
+*/
+
 void
-McciBootloaderBoard_CatenaAbz_handleSysTick(
+McciBootloaderBoard_CatenaAbz_annunciatorStop(
 	void
 	)
 	{
-	const uint32_t now = annunciator.tick + 1;
-	annunciator.tick = now;
-	AnnunciatorBitState_t nextState = stNoChange;
+	McciArm_putReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_CR, 0);
+	McciArm_putReg(MCCI_CM0PLUS_NVIC_ICER, UINT32_C(1) << MCCI_STM32L0_IRQ_LPTIM1);
+	McciArm_putReg(MCCI_CM0PLUS_NVIC_ICPR, UINT32_C(1) << MCCI_STM32L0_IRQ_LPTIM1);
+	McciArm_putRegClear(
+		MCCI_STM32L0_REG_RCC_CCIPR,
+		MCCI_STM32L0_REG_RCC_CCIPR_LPTIM1SEL
+		);
+	annunciator.bitState = stInitial;
+	}
+
+/* start the timer, with the first bit */
+static void
+annunciatorStart(void)
+	{
+	uint32_t const psw = McciArm_disableInterrupts();
 
-	switch (annunciator.bitState)
+	if (annunciator.bitState != stIdle)
 		{
-	default:
-	case stInitial:
-		nextState = stInitial;
-		annunciator.bitState = stInitial;
+		McciArm_setPRIMASK(psw);
 		return;
+		}
 
-	case stIdle:
-		if (annunciator.display != 0)
-			{
-			annunciator.value = annunciator.display;
-			nextBit();
-			nextState = stLedOn;
-			}
-		break;
+	// give the LED to LPTIM1
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_GPIOB + MCCI_STM32L0_GPIO_AFRx_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_PIN),
+		MCCI_STM32L0_GPIO_AFSEL_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_PIN),
+		MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_AFSEL_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_PIN),
+			MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_AF
+			)
+		);
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_GPIOB + MCCI_STM32L0_GPIO_MODER,
+		MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_PIN),
+		MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_PIN),
+			MCCI_STM32L0_GPIO_MODE_AF
+			)
+		);
 
-	case stLedOn:
-		if ((int32_t)(now - annunciator.timer) >= 0)
-			{
-			McciBootloaderBoard_CatenaAbz_clearLed();
-			annunciator.timer = now + annunciator.bittime;
-			nextState = stBitGap;
-			}
-		break;
+	// PWM mode, output high after CMP, ARR and CMP take effect at once.
+	// CFGR and IER can only be written while the timer is disabled.
+	McciArm_putReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_CFGR, MCCI_STM32L0_LPTIM_CFGR_PRESC_128);
+	McciArm_putReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_IER, MCCI_STM32L0_LPTIM_ISR_ARRM);
+	McciArm_putReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_CR, MCCI_STM32L0_LPTIM_CR_ENABLE);
+
+	// start from the top of the pattern (as if we'd just shown the bar)
+	annunciator.value = 0;
+	annunciator.bitState = stProgress;
+	annunciatorNextPeriod();
+
+	// ARR must be loaded before we start.
+	while (! (McciArm_getReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_ISR) & MCCI_STM32L0_LPTIM_ISR_ARROK))
+		/* loop */;
+
+	McciArm_putReg(
+		MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_ICR,
+		MCCI_STM32L0_LPTIM_ISR_ARROK | MCCI_STM32L0_LPTIM_ISR_CMPOK
+		);
+	McciArm_putReg(
+		MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_CR,
+		MCCI_STM32L0_LPTIM_CR_ENABLE | MCCI_STM32L0_LPTIM_CR_CNTSTRT
+		);
+
+	McciArm_setPRIMASK(psw);
+	}
+
+/* get the next bit to display; false if there are no more */
+static bool
+nextBit(bool *pfBit)
+	{
+	uint32_t const value = annunciator.value;
+
+	annunciator.value = value << 1;
+	*pfBit = !!(value & UINT32_C(0x80000000));
+	return annunciator.value != 0;
+	}
+
+/*
+|| Program the period that's just starting: off for the gap, then on.
+|| The timer output is low until the counter passes CMP, and high until
+|| it reaches ARR.
+*/
+static void
+annunciatorSetPeriod(
+	uint32_t gap,
+	uint32_t on
+	)
+	{
+	McciArm_putReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_ARR, gap + on - 1);
+	McciArm_putReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_CMP, gap - 1);
+	}
+
+/* set up the next period, or stop if there's nothing to display */
+static void
+annunciatorNextPeriod(void)
+	{
+	uint32_t const bittime = annunciator.bittime;
+	uint32_t gap = bittime;
+	bool fBit;
 
-	case stBitGap:
-		if ((int32_t)(now - annunciator.timer) >= 0)
+	if (! nextBit(&fBit))
+		{
+		// at the end of the bits, show the progress, if any.
+		if (annunciator.bitState == stBits && annunciator.progress >= 0)
 			{
-			if (nextBit())
-				nextState = stLedOn;
-			else
-				{
-				nextState = stByteGap;
-				annunciator.timer = now + 2 * annunciator.bittime;
-				}
+			annunciator.bitState = stProgress;
+			annunciatorSetPeriod(
+				3 * bittime,
+				bittime + bittime * (uint32_t)annunciator.progress / 10
+				);
+			return;
 			}
 
-	case stByteGap:
-		if ((int32_t)(now - annunciator.timer) >= 0)
+		// then start over, after a byte gap.
+		annunciator.value = annunciator.display;
+		if (! nextBit(&fBit))
 			{
-			annunciator.value = annunciator.display;
-			if (nextBit())
-				nextState = stLedOn;
-			else
-				{
-				nextState = stIdle;
-				}
+			McciArm_putReg(MCCI_STM32L0_REG_LPTIM1 + MCCI_STM32L0_LPTIM_CR, 0);
+			McciBootloaderBoard_CatenaAbz_clearLed();
+			McciArm_putRegMasked(
+				MCCI_STM32L0_REG_GPIOB + MCCI_STM32L0_GPIO_MODER,
+				MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_PIN),
+				MCCI_BOOTLOADER_FIELD_SET_VALUE(
+					MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_LED_PIN),
+					MCCI_STM32L0_GPIO_MODE_OUT
+					)
+				);
+			annunciator.bitState = stIdle;
+			return;
 			}
-		break;
+
+		gap = 3 * bittime;
 		}
 
-	if (nextState != stNoChange)
-		annunciator.bitState = nextState;
+	annunciator.bitState = stBits;
+	annunciatorSetPeriod(gap, bittime * (1 + 2 * fBit));
 	}
 
 /**** end of mccibootloaderboard_catenaabz_annunciator.c ****/
@@ -29,6 +29,11 @@ Author:
 |
 \****************************************************************************/
 
+static void
+putEepromCell(
+	uint32_t *pCell,
+	uint32_t dwValue
+	);
 
 /****************************************************************************\
 |
@@ -68,12 +73,43 @@ McciBootloaderBoard_CatenaAbz_getUpdate(void)
 void
 McciBootloaderBoard_CatenaAbz_setUpdate(bool fRequest)
 	{
-	const McciBootloaderBoard_CatenaAbz_Eeprom_t * const pEeprom = McciBootloaderBoard_CatenaAbz_getEepromPointer();
+	McciBootloaderBoard_CatenaAbz_Eeprom_t * const pEeprom = McciBootloaderBoard_CatenaAbz_getEepromPointer();
 	uint32_t dwValue = fRequest ? MCCI_BOOTLOADER_CATENA_ABZ_EEPROM_UPDATE_REQUEST
 				  : 0;
 
+	putEepromCell(&pEeprom->fUpdateRequest, dwValue);
+	}
+
+uint32_t
+McciBootloaderBoard_CatenaAbz_getAppBank(void)
+	{
+	const McciBootloaderBoard_CatenaAbz_Eeprom_t * const pEeprom = McciBootloaderBoard_CatenaAbz_getEepromPointer();
+
+	if (pEeprom->AppBank == MCCI_BOOTLOADER_CATENA_ABZ_EEPROM_APP_BANK_2)
+		return 1;
+	else
+		return 0;
+	}
+
+void
+McciBootloaderBoard_CatenaAbz_setAppBank(uint32_t iBank)
+	{
+	McciBootloaderBoard_CatenaAbz_Eeprom_t * const pEeprom = McciBootloaderBoard_CatenaAbz_getEepromPointer();
+	uint32_t dwValue = iBank == 1 ? MCCI_BOOTLOADER_CATENA_ABZ_EEPROM_APP_BANK_2
+				      : 0;
+
+	putEepromCell(&pEeprom->AppBank, dwValue);
+	}
+
+/* write one 32-bit EEPROM cell, unless it already has the value */
+static void
+putEepromCell(
+	uint32_t *pCell,
+	uint32_t dwValue
+	)
+	{
 	// if it's already set to the right value, just return.
-	if (pEeprom->fUpdateRequest == dwValue)
+	if (*pCell == dwValue)
 		return;
 
 	// spin waiting for an operation
@@ -86,7 +122,7 @@ McciBootloaderBoard_CatenaAbz_setUpdate(bool fRequest)
 
 	// the EEPROM should erase first, if needed.
 	// write data
-	McciArm_putReg((uint32_t)&pEeprom->fUpdateRequest, dwValue);
+	McciArm_putReg((uint32_t)pCell, dwValue);
 
 	// wait for operation to complete
 	while (McciArm_getReg(MCCI_STM32L0_REG_FLASH_SR) & MCCI_STM32L0_REG_FLASH_SR_BSY)
@@ -72,6 +72,7 @@ McciBootloaderBoard_CatenaAbz_prepareForLaunch(
 	void
 	)
 	{
+	McciBootloaderBoard_CatenaAbz_annunciatorStop();
 	McciBootloader_Stm32L0_prepareForLaunch();
 	}
 
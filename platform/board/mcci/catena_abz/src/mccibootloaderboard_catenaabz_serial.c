@@ -0,0 +1,400 @@
+/*
+
+Module:	mccibootloaderboard_catenaabz_serial.c
+
+Function:
+	Serial recovery driver for Catena boards based on Murata ABZ and
+	STM32L0.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader_board_catena_abz.h"
+
+#include "mcci_bootloader.h"
+#include "mcci_stm32l0xx.h"
+#include "mcci_arm_cm0plus.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+#ifndef MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_BAUD
+/// \brief the baud rate for serial recovery; set by the Makefile
+# define MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_BAUD	921600u
+#endif
+
+/// \brief USART2 is clocked from APB1, at the full 32 MHz
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_CLOCK	UINT32_C(32000000)
+
+/// \brief USART2_TX is on PA2, and USART2_RX on PA3, as alternate function 4
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_TX_PIN	2
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN	3
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_AF	4
+
+/// \brief the DMA1 channel for USART2_RX (SPI2 has 4 and 5)
+#define	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_DMA_RX	6
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/// \brief the receive ring, lent by the core, and our place in it
+static uint8_t *s_pSerialRing;
+static size_t s_nSerialRing;
+static size_t s_iSerialRead;
+
+/*
+
+Name:	McciBootloaderBoard_CatenaAbz_serialInit()
+
+Function:
+	Initialize USART2 for serial recovery.
+
+Definition:
+	McciBootloaderPlatform_SerialInitFn_t
+		McciBootloaderBoard_CatenaAbz_serialInit;
+
+	size_t McciBootloaderBoard_CatenaAbz_serialInit(
+		uint8_t *pBuffer,
+		size_t nBuffer
+		);
+
+Description:
+	USART2 is set up on PA2 (TX) and PA3 (RX), at
+	MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_BAUD, 8 bits, no parity,
+	one stop bit.
+
+	Reception is by DMA, into the lent buffer as a circular ring, so
+	the host can keep sending while we program flash. Overrun
+	detection is off: a lost byte shows up as a bad frame, and the
+	protocol sends it again.
+
+	The USART and DMA are reset by prepareForLaunch(), so there's
+	nothing to undo before launching the app.
+
+Returns:
+	The size of the ring; the host may send that far ahead.
+
+*/
+
+size_t
+McciBootloaderBoard_CatenaAbz_serialInit(
+	uint8_t *pBuffer,
+	size_t nBuffer
+	)
+	{
+	const uint32_t dma = MCCI_STM32L0_REG_DMA1;
+	const uint32_t rx = MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_DMA_RX;
+	const uint32_t usart = MCCI_STM32L0_REG_USART2;
+
+	// CNDTR is 16 bits
+	if (nBuffer > UINT16_MAX)
+		nBuffer = UINT16_MAX;
+
+	s_pSerialRing = pBuffer;
+	s_nSerialRing = nBuffer;
+	s_iSerialRead = 0;
+
+	// enable GPIO port A, and give PA2 and PA3 to USART2
+	McciArm_putRegOr(
+		MCCI_STM32L0_REG_RCC_IOPENR,
+		MCCI_STM32L0_REG_RCC_IOPENR_IOPAEN
+		);
+
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_GPIOA + MCCI_STM32L0_GPIO_AFRx_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_TX_PIN),
+		(MCCI_STM32L0_GPIO_AFSEL_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_TX_PIN) |
+		 MCCI_STM32L0_GPIO_AFSEL_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN)),
+		(MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_AFSEL_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_TX_PIN),
+			MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_AF
+			) |
+		 MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_AFSEL_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN),
+			MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_AF
+			))
+		);
+
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_GPIOA + MCCI_STM32L0_GPIO_PUPDR,
+		MCCI_STM32L0_GPIO_PUPD_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN),
+		MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_PUPD_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN),
+			MCCI_STM32L0_GPIO_PUPD_PULLUP
+			)
+		);
+
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_GPIOA + MCCI_STM32L0_GPIO_MODER,
+		(MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_TX_PIN) |
+		 MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN)),
+		(MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_TX_PIN),
+			MCCI_STM32L0_GPIO_MODE_AF
+			) |
+		 MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN),
+			MCCI_STM32L0_GPIO_MODE_AF
+			))
+		);
+
+	// enable USART2 at APB1, and reset it
+	McciArm_putRegOr(
+		MCCI_STM32L0_REG_RCC_APB1ENR,
+		MCCI_STM32L0_REG_RCC_APB1ENR_USART2EN
+		);
+	McciArm_putRegOr(
+		MCCI_STM32L0_REG_RCC_APB1RSTR,
+		MCCI_STM32L0_REG_RCC_APB1RSTR_USART2RST
+		);
+	McciArm_putRegClear(
+		MCCI_STM32L0_REG_RCC_APB1RSTR,
+		MCCI_STM32L0_REG_RCC_APB1RSTR_USART2RST
+		);
+
+	// enable DMA1, and route USART2_RX to our channel
+	McciArm_putRegOr(
+		MCCI_STM32L0_REG_RCC_AHBENR,
+		MCCI_STM32L0_REG_RCC_AHBENR_DMAEN
+		);
+
+	McciArm_putRegMasked(
+		dma + MCCI_STM32L0_DMA_CSELR,
+		MCCI_STM32L0_DMA_CSELR_CS(rx),
+		MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_DMA_CSELR_CS(rx),
+			MCCI_STM32L0_DMA_CSELR_CS_USART2
+			)
+		);
+
+	// receive: USART2_RDR to the ring, round and round
+	McciArm_putReg(dma + MCCI_STM32L0_DMA_CPAR(rx), usart + MCCI_STM32L0_USART_RDR);
+	McciArm_putReg(dma + MCCI_STM32L0_DMA_CMAR(rx), (uint32_t)pBuffer);
+	McciArm_putReg(dma + MCCI_STM32L0_DMA_CNDTR(rx), (uint32_t)nBuffer);
+	McciArm_putReg(
+		dma + MCCI_STM32L0_DMA_CCR(rx),
+		MCCI_STM32L0_DMA_CCR_MINC |
+		MCCI_STM32L0_DMA_CCR_CIRC |
+		MCCI_STM32L0_DMA_CCR_EN
+		);
+
+	// since we reset above, we only need the non-default settings
+	McciArm_putReg(
+		usart + MCCI_STM32L0_USART_BRR,
+		(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_CLOCK + MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_BAUD / 2) /
+			MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_BAUD
+		);
+	McciArm_putReg(
+		usart + MCCI_STM32L0_USART_CR3,
+		MCCI_STM32L0_USART_CR3_OVRDIS |
+		MCCI_STM32L0_USART_CR3_DMAR
+		);
+	McciArm_putReg(
+		usart + MCCI_STM32L0_USART_CR1,
+		MCCI_STM32L0_USART_CR1_TE |
+		MCCI_STM32L0_USART_CR1_RE |
+		MCCI_STM32L0_USART_CR1_UE
+		);
+
+	return nBuffer;
+	}
+
+/*
+
+Name:	McciBootloaderBoard_CatenaAbz_serialRead()
+
+Function:
+	Read received bytes from the ring.
+
+Definition:
+	McciBootloaderPlatform_SerialReadFn_t
+		McciBootloaderBoard_CatenaAbz_serialRead;
+
+	size_t McciBootloaderBoard_CatenaAbz_serialRead(
+		uint8_t *pBuffer,
+		size_t nBuffer,
+		uint32_t timeoutMs
+		);
+
+Description:
+	The DMA's remaining count tells us how far it has written. If
+	nothing is waiting, we check again each ms (sleeping between, if
+	the bootloader is built to sleep) until timeoutMs have passed.
+
+Returns:
+	The number of bytes read; zero if none arrived in time. The port
+	is never closed.
+
+*/
+
+size_t
+McciBootloaderBoard_CatenaAbz_serialRead(
+	uint8_t *pBuffer,
+	size_t nBuffer,
+	uint32_t timeoutMs
+	)
+	{
+	const uint32_t rx = MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_DMA_RX;
+	size_t nRead = 0;
+
+	for (;;)
+		{
+		size_t iWrite = s_nSerialRing -
+			McciArm_getReg(MCCI_STM32L0_REG_DMA1 + MCCI_STM32L0_DMA_CNDTR(rx));
+
+		// the count might be caught at zero, before it's reloaded
+		if (iWrite == s_nSerialRing)
+			iWrite = 0;
+
+		while (nRead < nBuffer && s_iSerialRead != iWrite)
+			{
+			pBuffer[nRead++] = s_pSerialRing[s_iSerialRead];
+			if (++s_iSerialRead == s_nSerialRing)
+				s_iSerialRead = 0;
+			}
+
+		if (nRead != 0 || timeoutMs == 0)
+			return nRead;
+
+		McciBootloaderBoard_CatenaAbz_delayMs(1);
+		--timeoutMs;
+		}
+	}
+
+/*
+
+Name:	McciBootloaderBoard_CatenaAbz_serialWrite()
+
+Function:
+	Send bytes on USART2.
+
+Definition:
+	McciBootloaderPlatform_SerialWriteFn_t
+		McciBootloaderBoard_CatenaAbz_serialWrite;
+
+	void McciBootloaderBoard_CatenaAbz_serialWrite(
+		const uint8_t *pBuffer,
+		size_t nBuffer
+		);
+
+Description:
+	The bootloader only sends short frames, so we poll. We return
+	once the last bit is on the wire, so that the app can be
+	launched (and the USART reset) right after a frame.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloaderBoard_CatenaAbz_serialWrite(
+	const uint8_t *pBuffer,
+	size_t nBuffer
+	)
+	{
+	const uint32_t usart = MCCI_STM32L0_REG_USART2;
+
+	for (; nBuffer > 0; --nBuffer)
+		{
+		while (! (McciArm_getReg(usart + MCCI_STM32L0_USART_ISR) & MCCI_STM32L0_USART_ISR_TXE))
+			;
+
+		McciArm_putReg(usart + MCCI_STM32L0_USART_TDR, *pBuffer++);
+		}
+
+	while (! (McciArm_getReg(usart + MCCI_STM32L0_USART_ISR) & MCCI_STM32L0_USART_ISR_TC))
+		;
+	}
+
+/*
+
+Name:	McciBootloaderBoard_CatenaAbz_getRecoveryRequest()
+
+Function:
+	See whether the host is asking for serial recovery.
+
+Definition:
+	McciBootloaderPlatform_GetRecoveryRequestFn_t
+		McciBootloaderBoard_CatenaAbz_getRecoveryRequest;
+
+	bool McciBootloaderBoard_CatenaAbz_getRecoveryRequest(
+		void
+		);
+
+Description:
+	The host asks by holding a break (a low level) on our RX pin,
+	PA3, through reset (see `mccibootloader_image --send-break`).
+	The pin is pulled up, so it reads high if nothing is connected,
+	or if the host's line is idle. We sample it twice, a ms apart,
+	so that an ordinary character isn't taken for a break.
+
+Returns:
+	true if the host is holding a break.
+
+*/
+
+bool
+McciBootloaderBoard_CatenaAbz_getRecoveryRequest(
+	void
+	)
+	{
+	uint32_t const rxBit = UINT32_C(1) << MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN;
+
+	McciArm_putRegOr(
+		MCCI_STM32L0_REG_RCC_IOPENR,
+		MCCI_STM32L0_REG_RCC_IOPENR_IOPAEN
+		);
+
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_GPIOA + MCCI_STM32L0_GPIO_PUPDR,
+		MCCI_STM32L0_GPIO_PUPD_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN),
+		MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_PUPD_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN),
+			MCCI_STM32L0_GPIO_PUPD_PULLUP
+			)
+		);
+
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_GPIOA + MCCI_STM32L0_GPIO_MODER,
+		MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN),
+		MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_GPIO_MODE_P(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SERIAL_RX_PIN),
+			MCCI_STM32L0_GPIO_MODE_IN
+			)
+		);
+
+	// let the pull-up charge the pin, then sample it twice
+	McciBootloaderBoard_CatenaAbz_delayMs(1);
+	if (McciArm_getReg(MCCI_STM32L0_REG_GPIOA + MCCI_STM32L0_GPIO_IDR) & rxBit)
+		return false;
+
+	McciBootloaderBoard_CatenaAbz_delayMs(1);
+	return ! (McciArm_getReg(MCCI_STM32L0_REG_GPIOA + MCCI_STM32L0_GPIO_IDR) & rxBit);
+	}
+
+/**** end of mccibootloaderboard_catenaabz_serial.c ****/
@@ -31,7 +31,22 @@ Author:
 |
 \****************************************************************************/
 
+#if MCCI_BOOTLOADER_STM32L0_WAIT == MCCI_BOOTLOADER_STM32L0_WAIT_SLEEP
+/// \brief transfers at least this long use DMA, so we can sleep
+# define MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_MIN	UINT32_C(16)
 
+/// \brief the DMA1 channel for SPI2_RX
+# define MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_RX	4
+/// \brief the DMA1 channel for SPI2_TX
+# define MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_TX	5
+
+static void
+spiTransferDma(
+	uint8_t *pRx,
+	const uint8_t *pTx,
+	size_t nBytes
+	);
+#endif
 
 /****************************************************************************\
 |
@@ -39,7 +54,10 @@ Author:
 |
 \****************************************************************************/
 
-
+#ifdef MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_MIN
+/// \brief what we send by DMA when there's no tx buffer
+static const uint8_t kSpiZero = 0;
+#endif
 
 /****************************************************************************\
 |
@@ -165,6 +183,28 @@ McciBootloaderBoard_CatenaAbz_spiInit(void)
 	//	MCCI_STM32L0_REG_SPI2 + MCCI_STM32L0_SPI_I2SCFGR,
 	//	MCCI_STM32L0_SPI_I2SCFGR_I2SMOD
 	//	);
+
+#ifdef MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_MIN
+	// enable DMA1, and route SPI2 to its channels
+	McciArm_putRegOr(
+		MCCI_STM32L0_REG_RCC_AHBENR,
+		MCCI_STM32L0_REG_RCC_AHBENR_DMAEN
+		);
+
+	McciArm_putRegMasked(
+		MCCI_STM32L0_REG_DMA1 + MCCI_STM32L0_DMA_CSELR,
+		(MCCI_STM32L0_DMA_CSELR_CS(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_RX) |
+		 MCCI_STM32L0_DMA_CSELR_CS(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_TX)),
+		(MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_DMA_CSELR_CS(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_RX),
+			MCCI_STM32L0_DMA_CSELR_CS_SPI2
+			) |
+		 MCCI_BOOTLOADER_FIELD_SET_VALUE(
+			MCCI_STM32L0_DMA_CSELR_CS(MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_TX),
+			MCCI_STM32L0_DMA_CSELR_CS_SPI2
+			))
+		);
+#endif
 	}
 
 /*
@@ -195,6 +235,12 @@ Description:
 	The API defines pRx and pTx as optional; if NULL, bytes are discarded
 	or zeroes inserted, respectively.
 
+	When the bootloader is built to sleep while waiting (see
+	MCCI_BOOTLOADER_STM32L0_WAIT), long transfers are done by DMA,
+	and we sleep until the last byte has been received. Short ones
+	(commands and addresses) are polled, as setting up the DMA would
+	take longer than the transfer.
+
 Returns:
 	No explicit result.
 
@@ -218,6 +264,15 @@ McciBootloaderBoard_CatenaAbz_spiTransfer(
 		MCCI_STM32L0_REG_SPI2 + MCCI_STM32L0_SPI_CR1,
 		MCCI_STM32L0_SPI_CR1_SPE
 		);
+
+#ifdef MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_MIN
+	if (nBytes >= MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_MIN)
+		{
+		spiTransferDma(pRx, pTx, nBytes);
+		nBytes = 0;
+		}
+#endif
+
 	txdata = 0;
 	for (; nBytes > 0; --nBytes)
 		{
@@ -246,4 +301,83 @@ McciBootloaderBoard_CatenaAbz_spiTransfer(
 		}
 	}
 
+#ifdef MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_MIN
+/* transfer by DMA, sleeping until the last byte is received */
+static void
+spiTransferDma(
+	uint8_t *pRx,
+	const uint8_t *pTx,
+	size_t nBytes
+	)
+	{
+	const uint32_t dma = MCCI_STM32L0_REG_DMA1;
+	const uint32_t rx = MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_RX;
+	const uint32_t tx = MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_TX;
+	uint8_t rxDiscard;
+
+	while (nBytes > 0)
+		{
+		// CNDTR is 16 bits
+		const uint32_t nChunk = nBytes > UINT16_MAX ? UINT16_MAX : (uint32_t)nBytes;
+
+		// receive: SPI2_DR to pRx (or to rxDiscard)
+		McciArm_putReg(dma + MCCI_STM32L0_DMA_CPAR(rx), MCCI_STM32L0_REG_SPI2 + MCCI_STM32L0_SPI_DR);
+		McciArm_putReg(dma + MCCI_STM32L0_DMA_CMAR(rx), pRx ? (uint32_t)pRx : (uint32_t)&rxDiscard);
+		McciArm_putReg(dma + MCCI_STM32L0_DMA_CNDTR(rx), nChunk);
+		McciArm_putReg(
+			dma + MCCI_STM32L0_DMA_CCR(rx),
+			(pRx ? MCCI_STM32L0_DMA_CCR_MINC : 0) |
+			MCCI_STM32L0_DMA_CCR_TCIE |
+			MCCI_STM32L0_DMA_CCR_EN
+			);
+
+		// transmit: pTx (or zeroes) to SPI2_DR
+		McciArm_putReg(dma + MCCI_STM32L0_DMA_CPAR(tx), MCCI_STM32L0_REG_SPI2 + MCCI_STM32L0_SPI_DR);
+		McciArm_putReg(dma + MCCI_STM32L0_DMA_CMAR(tx), pTx ? (uint32_t)pTx : (uint32_t)&kSpiZero);
+		McciArm_putReg(dma + MCCI_STM32L0_DMA_CNDTR(tx), nChunk);
+		McciArm_putReg(
+			dma + MCCI_STM32L0_DMA_CCR(tx),
+			(pTx ? MCCI_STM32L0_DMA_CCR_MINC : 0) |
+			MCCI_STM32L0_DMA_CCR_DIR |
+			MCCI_STM32L0_DMA_CCR_EN
+			);
+
+		// start: rx first, so no byte is missed
+		McciArm_putRegOr(
+			MCCI_STM32L0_REG_SPI2 + MCCI_STM32L0_SPI_CR2,
+			MCCI_STM32L0_SPI_CR2_RXDMAEN
+			);
+		McciArm_putRegOr(
+			MCCI_STM32L0_REG_SPI2 + MCCI_STM32L0_SPI_CR2,
+			MCCI_STM32L0_SPI_CR2_TXDMAEN
+			);
+
+		McciBootloader_Stm32L0_waitForRegister(
+			dma + MCCI_STM32L0_DMA_ISR,
+			MCCI_STM32L0_DMA_ISR_TCIF(rx),
+			MCCI_STM32L0_DMA_ISR_TCIF(rx),
+			UINT32_C(1) << MCCI_STM32L0_IRQ_DMA1_CH4_7
+			);
+
+		// stop, and clean up
+		McciArm_putRegClear(
+			MCCI_STM32L0_REG_SPI2 + MCCI_STM32L0_SPI_CR2,
+			MCCI_STM32L0_SPI_CR2_RXDMAEN | MCCI_STM32L0_SPI_CR2_TXDMAEN
+			);
+		McciArm_putReg(dma + MCCI_STM32L0_DMA_CCR(rx), 0);
+		McciArm_putReg(dma + MCCI_STM32L0_DMA_CCR(tx), 0);
+		McciArm_putReg(
+			dma + MCCI_STM32L0_DMA_IFCR,
+			MCCI_STM32L0_DMA_ISR_GIF(rx) | MCCI_STM32L0_DMA_ISR_GIF(tx)
+			);
+
+		nBytes -= nChunk;
+		if (pRx)
+			pRx += nChunk;
+		if (pTx)
+			pTx += nChunk;
+		}
+	}
+#endif /* MCCI_BOOTLOADER_BOARD_CATENA_ABZ_SPI_DMA_MIN */
+
 /**** end of mccibootloaderboard_catenaabz_spi.c ****/
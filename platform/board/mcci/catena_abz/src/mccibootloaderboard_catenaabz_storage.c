@@ -59,4 +59,12 @@ McciBootloaderBoard_CatenaAbz_getFallbackStorageAddress(
 	return MCCI_BOOTLOADER_BOARD_CATENA_ABZ_STORAGE_FALLBACK_BASE;
 	}
 
+McciBootloaderStorageAddress_t
+McciBootloaderBoard_CatenaAbz_getDirectoryStorageAddress(
+	void
+	)
+	{
+	return MCCI_BOOTLOADER_BOARD_CATENA_ABZ_STORAGE_DIRECTORY_BASE;
+	}
+
 /**** end of mccibootloaderboard_catenaabz_storage.c ****/
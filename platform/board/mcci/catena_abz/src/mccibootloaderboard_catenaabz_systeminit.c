@@ -145,17 +145,19 @@ void
 McciBootloaderBoard_CatenaAbz_delayMs(uint32_t ms)
 	{
 	for (++ms; ms > 0; --ms)
-		{
-		while ((McciArm_getReg(MCCI_CM0PLUS_SYSTICK_CSR) & MCCI_CM0PLUS_SYSTICK_CSR_COUNTFLAG) == 0)
-			;
-		}
+		delayTick();
 	}
 
+/* wait for the next SysTick; the tick itself wakes us if we sleep */
 static void
 delayTick(void)
 	{
-	while ((McciArm_getReg(MCCI_CM0PLUS_SYSTICK_CSR) & MCCI_CM0PLUS_SYSTICK_CSR_COUNTFLAG) == 0)
-		;
+	McciBootloader_Stm32L0_waitForRegister(
+		MCCI_CM0PLUS_SYSTICK_CSR,
+		MCCI_CM0PLUS_SYSTICK_CSR_COUNTFLAG,
+		MCCI_CM0PLUS_SYSTICK_CSR_COUNTFLAG,
+		0
+		);
 	}
 
 void
@@ -177,7 +179,7 @@ McciBootloaderBoard_CatenaAbz_fail(
 		for (; timeToReboot > 0; --timeToReboot)
 			{
 			delayTick();
-			McciBootloaderBoard_CatenaAbz_handleSysTick();
+			McciBootloaderBoard_CatenaAbz_handleLptim1();
 			}
 
 		McciArm_DataSynchBarrier();
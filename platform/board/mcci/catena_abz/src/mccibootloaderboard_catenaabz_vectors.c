@@ -63,7 +63,7 @@ gk_McciBootloader_CortexVectors =
 		[12] = /* reserved */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[13] = /* reserved */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[14] = /* PendSV */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
-		[15] = /* SysTick */		(uint32_t) McciBootloaderBoard_CatenaAbz_handleSysTick,
+		[15] = /* SysTick */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[16] = /* ExtInt(0) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[17] = /* ExtInt(1) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[18] = /* ExtInt(2) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
@@ -77,7 +77,7 @@ gk_McciBootloader_CortexVectors =
 		[26] = /* ExtInt(10) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[27] = /* ExtInt(11) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[28] = /* ExtInt(12) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
-		[29] = /* ExtInt(13) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
+		[29] = /* LPTIM1 */		(uint32_t) McciBootloaderBoard_CatenaAbz_handleLptim1,
 		[30] = /* ExtInt(14) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[31] = /* ExtInt(15) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
 		[32] = /* ExtInt(16) */		(uint32_t) McciBootloaderBoard_CatenaAbz_NotHandled,
@@ -224,6 +224,30 @@ McciBootloaderBoard_CatenaAbz_SvcHandler(
 		}
 		break;
 
+	case McciBootloaderPlatform_ARMv6M_SvcRq_CheckBlockHashTable:
+		{
+		if (arg1 == 0 || (arg1 & 3) != 0)
+			err = McciBootloaderPlatform_SvcError_InvalidParameter;
+		else if (! McciBootloader_checkBlockHashTable(
+				(const void *)arg1,
+				arg2,
+				&gk_McciBootloader_SignatureBlock.publicKey,
+				/* our RAM is the app's now: no scratch */ NULL,
+				0
+				))
+			err = McciBootloaderPlatform_SvcError_VerifyFailure;
+		}
+		break;
+
+	case McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage:
+		{
+		if (arg1 == 0 || (arg1 & 3) != 0)
+			err = McciBootloaderPlatform_SvcError_InvalidParameter;
+		else
+			err = McciBootloaderPlatform_getStackUsage((void *)arg1);
+		}
+		break;
+
 	default:
 		err = McciBootloaderPlatform_SvcError_Unclaimed;
 		break;
@@ -37,6 +37,7 @@ struct McciBootloaderPlatform_StorageInterface_s
 	McciBootloaderPlatform_StorageReadFn_t		*pRead;				///< Read from storage.
 	McciBootloaderPlatform_GetPrimaryStorageAddressFn_t *pGetPrimaryAddress;		///< Get address of primary firmware region
 	McciBootloaderPlatform_GetFallbackStorageAddressFn_t *pGetFallbackAddress;	///< Get address of fall-back firmware region.
+	McciBootloaderPlatform_GetDirectoryStorageAddressFn_t *pGetDirectoryAddress;	///< Get address of the slot directory.
 	};
 
 struct McciBootloaderPlatform_SpiInterface_s
@@ -45,6 +46,14 @@ struct McciBootloaderPlatform_SpiInterface_s
 	McciBootloaderPlatform_SpiTransferFn_t		*pTransfer;	///< do a SPI write/read.
 	};
 
+struct McciBootloaderPlatform_SerialInterface_s
+	{
+	McciBootloaderPlatform_SerialInitFn_t		*pInit;			///< Initialize the serial port for recovery
+	McciBootloaderPlatform_SerialReadFn_t		*pRead;			///< Read from the serial port
+	McciBootloaderPlatform_SerialWriteFn_t		*pWrite;		///< Write to the serial port
+	McciBootloaderPlatform_GetRecoveryRequestFn_t	*pGetRecoveryRequest;	///< Find out whether serial recovery was requested
+	};
+
 struct McciBootloaderPlatform_AnnunciatorInterface_s
 	{
 	McciBootloaderPlatform_AnnunciatorInitFn_t	*pInit;			///< initialize the annunciator system
@@ -60,38 +69,71 @@ struct McciBootloaderPlatform_Interface_s
 	McciBootloaderPlatform_DelayMsFn_t		*pDelayMs;		///< Delay execution some number of milliseconds
 	McciBootloaderPlatform_GetUpdateFlagFn_t	*pGetUpdate;		///< Find out whether firmware update was requested
 	McciBootloaderPlatform_SetUpdateFlagFn_t	*pSetUpdate;		///< Set value of firmware-update flag
+	McciBootloaderPlatform_GetAppBankFn_t		*pGetAppBank;		///< Find out which app bank is selected
+	McciBootloaderPlatform_SetAppBankFn_t		*pSetAppBank;		///< Select an app bank
 	McciBootloaderPlatform_SystemFlashEraseFn_t	*pSystemFlashErase;	///< Erase flash
 	McciBootloaderPlatform_SystemFlashWriteFn_t	*pSystemFlashWrite;	///< Write block to flash
 	McciBootloaderPlatform_StorageInterface_t	Storage;
 	McciBootloaderPlatform_SpiInterface_t		Spi;
+	McciBootloaderPlatform_SerialInterface_t	Serial;
 	McciBootloaderPlatform_AnnunciatorInterface_t	Annunciator;
 	};
 
 extern const McciBootloaderPlatform_Interface_t
 gk_McciBootloaderPlatformInterface;
 
+/*
+|| By default, the wrappers below call the platform through
+|| gk_McciBootloaderPlatformInterface, so one build of the core serves
+|| any board. If the build defines MCCI_BOOTLOADER_PLATFORM_BINDING as
+|| the (quoted) name of a header, that header defines
+|| McciBootloaderPlatformBinding_{name} as the function that provides
+|| McciBootloaderPlatform_{name}(), and the wrappers call it directly.
+|| Calls can then be inlined with -flto, and the table is discarded.
+*/
+#ifdef MCCI_BOOTLOADER_PLATFORM_BINDING
+# include MCCI_BOOTLOADER_PLATFORM_BINDING
+# define MCCI_BOOTLOADER_PLATFORM_CALL(a_member, a_name)	\
+	McciBootloaderPlatformBinding_##a_name
+#else
+# define MCCI_BOOTLOADER_PLATFORM_CALL(a_member, a_name)	\
+	(*gk_McciBootloaderPlatformInterface.a_member)
+#endif
+
 static inline void
 McciBootloaderPlatform_systemInit(void)
 	{
-	(*gk_McciBootloaderPlatformInterface.pSystemInit)();
+	MCCI_BOOTLOADER_PLATFORM_CALL(pSystemInit, systemInit)();
 	}
 
 static inline void
 McciBootloaderPlatform_prepareForLaunch(void)
 	{
-	(*gk_McciBootloaderPlatformInterface.pPrepareForLaunch)();
+	MCCI_BOOTLOADER_PLATFORM_CALL(pPrepareForLaunch, prepareForLaunch)();
 	}
 
 static inline bool
 McciBootloaderPlatform_getUpdateFlag(void)
 	{
-	return (*gk_McciBootloaderPlatformInterface.pGetUpdate)();
+	return MCCI_BOOTLOADER_PLATFORM_CALL(pGetUpdate, getUpdateFlag)();
 	}
 
 static inline void
 McciBootloaderPlatform_setUpdateFlag(bool fUpdate)
 	{
-	(*gk_McciBootloaderPlatformInterface.pSetUpdate)(fUpdate);
+	MCCI_BOOTLOADER_PLATFORM_CALL(pSetUpdate, setUpdateFlag)(fUpdate);
+	}
+
+static inline uint32_t
+McciBootloaderPlatform_getAppBank(void)
+	{
+	return MCCI_BOOTLOADER_PLATFORM_CALL(pGetAppBank, getAppBank)();
+	}
+
+static inline void
+McciBootloaderPlatform_setAppBank(uint32_t iBank)
+	{
+	MCCI_BOOTLOADER_PLATFORM_CALL(pSetAppBank, setAppBank)(iBank);
 	}
 
 static inline bool
@@ -100,7 +142,7 @@ McciBootloaderPlatform_systemFlashErase(
 	size_t targetSize
 	)
 	{
-	return (*gk_McciBootloaderPlatformInterface.pSystemFlashErase)(
+	return MCCI_BOOTLOADER_PLATFORM_CALL(pSystemFlashErase, systemFlashErase)(
 		targetAddress,
 		targetSize
 		);
@@ -113,7 +155,7 @@ McciBootloaderPlatform_systemFlashWrite(
 	size_t nBytes
 	)
 	{
-	return (*gk_McciBootloaderPlatformInterface.pSystemFlashWrite)(
+	return MCCI_BOOTLOADER_PLATFORM_CALL(pSystemFlashWrite, systemFlashWrite)(
 		pDestination,
 		pSource,
 		nBytes
@@ -131,13 +173,13 @@ McciBootloaderPlatform_delayMs(
 	uint32_t ms
 	)
 	{
-	(*gk_McciBootloaderPlatformInterface.pDelayMs)(ms);
+	MCCI_BOOTLOADER_PLATFORM_CALL(pDelayMs, delayMs)(ms);
 	}
 
 static inline void
 McciBootloaderPlatform_storageInit(void)
 	{
-	(*gk_McciBootloaderPlatformInterface.Storage.pInit)();
+	MCCI_BOOTLOADER_PLATFORM_CALL(Storage.pInit, storageInit)();
 	}
 
 static inline bool
@@ -147,7 +189,7 @@ McciBootloaderPlatform_storageRead(
 	size_t nBuffer
 	)
 	{
-	return (*gk_McciBootloaderPlatformInterface.Storage.pRead)(
+	return MCCI_BOOTLOADER_PLATFORM_CALL(Storage.pRead, storageRead)(
 		hAddress,
 		pBuffer,
 		nBuffer
@@ -157,19 +199,25 @@ McciBootloaderPlatform_storageRead(
 static inline McciBootloaderStorageAddress_t
 McciBootloaderPlatform_getPrimaryStorageAddress(void)
 	{
-	return (*gk_McciBootloaderPlatformInterface.Storage.pGetPrimaryAddress)();
+	return MCCI_BOOTLOADER_PLATFORM_CALL(Storage.pGetPrimaryAddress, getPrimaryStorageAddress)();
 	}
 
 static inline McciBootloaderStorageAddress_t
 McciBootloaderPlatform_getFallbackStorageAddress(void)
 	{
-	return (*gk_McciBootloaderPlatformInterface.Storage.pGetFallbackAddress)();
+	return MCCI_BOOTLOADER_PLATFORM_CALL(Storage.pGetFallbackAddress, getFallbackStorageAddress)();
+	}
+
+static inline McciBootloaderStorageAddress_t
+McciBootloaderPlatform_getDirectoryStorageAddress(void)
+	{
+	return MCCI_BOOTLOADER_PLATFORM_CALL(Storage.pGetDirectoryAddress, getDirectoryStorageAddress)();
 	}
 
 static inline void
 McciBootloaderPlatform_spiInit(void)
 	{
-	(*gk_McciBootloaderPlatformInterface.Spi.pInit)();
+	MCCI_BOOTLOADER_PLATFORM_CALL(Spi.pInit, spiInit)();
 	}
 
 static inline void
@@ -180,15 +228,51 @@ McciBootloaderPlatform_spiTransfer(
 	bool fContinue
 	)
 	{
-	(*gk_McciBootloaderPlatformInterface.Spi.pTransfer)(
+	MCCI_BOOTLOADER_PLATFORM_CALL(Spi.pTransfer, spiTransfer)(
 		pRx, pTx, nBytes, fContinue
 		);
 	}
 
+static inline size_t
+McciBootloaderPlatform_serialInit(
+	uint8_t *pBuffer,
+	size_t nBuffer
+	)
+	{
+	return MCCI_BOOTLOADER_PLATFORM_CALL(Serial.pInit, serialInit)(pBuffer, nBuffer);
+	}
+
+static inline size_t
+McciBootloaderPlatform_serialRead(
+	uint8_t *pBuffer,
+	size_t nBuffer,
+	uint32_t timeoutMs
+	)
+	{
+	return MCCI_BOOTLOADER_PLATFORM_CALL(Serial.pRead, serialRead)(
+		pBuffer, nBuffer, timeoutMs
+		);
+	}
+
+static inline void
+McciBootloaderPlatform_serialWrite(
+	const uint8_t *pBuffer,
+	size_t nBuffer
+	)
+	{
+	MCCI_BOOTLOADER_PLATFORM_CALL(Serial.pWrite, serialWrite)(pBuffer, nBuffer);
+	}
+
+static inline bool
+McciBootloaderPlatform_getRecoveryRequest(void)
+	{
+	return MCCI_BOOTLOADER_PLATFORM_CALL(Serial.pGetRecoveryRequest, getRecoveryRequest)();
+	}
+
 static inline void
 McciBootloaderPlatform_annunciatorInit(void)
 	{
-	(*gk_McciBootloaderPlatformInterface.Annunciator.pInit)();
+	MCCI_BOOTLOADER_PLATFORM_CALL(Annunciator.pInit, annunciatorInit)();
 	}
 
 static inline void
@@ -196,7 +280,7 @@ McciBootloaderPlatform_annunciatorIndicateState(
 	McciBootloaderState_t state
 	)
 	{
-	(*gk_McciBootloaderPlatformInterface.Annunciator.pIndicateState)(state);
+	MCCI_BOOTLOADER_PLATFORM_CALL(Annunciator.pIndicateState, annunciatorIndicateState)(state);
 	}
 
 void
@@ -227,6 +311,14 @@ McciBootloaderPlatform_getSignatureBlock(
 	const McciBootloader_AppInfo_t *
 	);
 
+void
+McciBootloaderPlatform_callOnStack(
+	McciBootloaderPlatform_StackFn_t *pFn,
+	void *pArg,
+	void *pStack,
+	size_t nStack
+	);
+
 MCCI_BOOTLOADER_END_DECLS
 
 #endif /* _mcci_bootloader_platform_h_ */
@@ -116,6 +116,35 @@ typedef void
 	bool state
 	);
 
+///
+/// \brief Get the app bank selector
+///
+/// When the bootloader is built with two app banks
+/// (MCCI_BOOTLOADER_APP_BANKS), the platform keeps a note of which of
+/// them holds the app to run, in storage that survives reset.
+///
+/// \returns the index of the selected bank: 0 for the bank at
+///	gk_McciBootloader_AppBase, 1 for the bank at
+///	gk_McciBootloader_AppBank2Base. A note that is missing or not
+///	recognized selects bank 0.
+///
+typedef uint32_t
+(McciBootloaderPlatform_GetAppBankFn_t)(
+	void
+	);
+
+///
+/// \brief Set the app bank selector
+///
+/// \param [in] iBank the index of the bank to select (0 or 1).
+///
+/// \see McciBootloaderPlatform_GetAppBankFn_t
+///
+typedef void
+(McciBootloaderPlatform_SetAppBankFn_t)(
+	uint32_t iBank
+	);
+
 ///
 /// \brief Erase a region of internal flash
 ///
@@ -207,6 +236,16 @@ typedef McciBootloaderStorageAddress_t
 	void
 	);
 
+///
+/// \brief get the address of the slot directory in the storage
+///
+/// \see McciBootloader_DirectoryHeader_t
+///
+typedef McciBootloaderStorageAddress_t
+(McciBootloaderPlatform_GetDirectoryStorageAddressFn_t)(
+	void
+	);
+
 ///
 /// \brief initialize the SPI driver for storage use
 ///
@@ -250,6 +289,79 @@ typedef void
 	bool fContinue
 	);
 
+///
+/// \brief initialize the serial port for recovery
+///
+/// \param [in] pBuffer	RAM lent to the driver, for receiving.
+/// \param [in] nBuffer	size of the buffer, in bytes.
+///
+/// \details The bootloader calls this when it enters serial recovery (see
+///	McciBootloader_serialRecovery()). The buffer stays lent until the
+///	app is launched. A driver that receives by DMA can use it as its
+///	ring, so that the host can keep sending while flash is written.
+///
+/// \returns the number of bytes the host may send ahead of the
+///	bootloader's reads without loss, or zero if the platform has no
+///	serial port for recovery.
+///
+typedef size_t
+(McciBootloaderPlatform_SerialInitFn_t)(
+	uint8_t *pBuffer,
+	size_t nBuffer
+	);
+
+///
+/// \brief read bytes from the serial port
+///
+/// \param [out] pBuffer	the buffer to be filled.
+/// \param [in] nBuffer	the most bytes to read.
+/// \param [in] timeoutMs	how long to wait for the first byte.
+///
+/// \details Bytes that have already arrived are returned without waiting.
+///	Otherwise, we wait up to \p timeoutMs ms for one to arrive.
+///
+/// \returns the number of bytes read: zero if none arrived in time, or
+///	MCCI_BOOTLOADER_SERIAL_CLOSED if the port has gone away for good
+///	(so that recovery should stop).
+///
+typedef size_t
+(McciBootloaderPlatform_SerialReadFn_t)(
+	uint8_t *pBuffer,
+	size_t nBuffer,
+	uint32_t timeoutMs
+	);
+
+/// \brief the result of McciBootloaderPlatform_SerialReadFn_t if the port has gone
+#define	MCCI_BOOTLOADER_SERIAL_CLOSED	SIZE_MAX
+
+///
+/// \brief write bytes to the serial port
+///
+/// \param [in] pBuffer	the bytes to be sent.
+/// \param [in] nBuffer	the number of bytes.
+///
+/// \details Returns once the bytes have been sent, or queued to be sent.
+///
+typedef void
+(McciBootloaderPlatform_SerialWriteFn_t)(
+	const uint8_t *pBuffer,
+	size_t nBuffer
+	);
+
+///
+/// \brief find out if serial recovery was requested at reset
+///
+/// \details Each platform has its own way (a strap, a button, a break on
+///	the serial port) to ask for serial recovery even if the app is good.
+///
+/// \returns \c true if the bootloader should enter serial recovery
+///	before checking the app.
+///
+typedef bool
+(McciBootloaderPlatform_GetRecoveryRequestFn_t)(
+	void
+	);
+
 ///
 /// \brief Initialize the annuciator system
 ///
@@ -275,6 +387,18 @@ typedef void
 	McciBootloaderState_t state
 	);
 
+///
+/// \brief function to be run on another stack
+///
+/// \param [in] pArg	the argument given to McciBootloaderPlatform_callOnStack()
+///
+/// \see McciBootloaderPlatform_callOnStack()
+///
+typedef void
+(McciBootloaderPlatform_StackFn_t)(
+	void *pArg
+	);
+
 /// \brief storage interface structure
 typedef struct McciBootloaderPlatform_StorageInterface_s
 McciBootloaderPlatform_StorageInterface_t;
@@ -283,6 +407,10 @@ McciBootloaderPlatform_StorageInterface_t;
 typedef struct McciBootloaderPlatform_SpiInterface_s
 McciBootloaderPlatform_SpiInterface_t;
 
+/// \brief serial recovery interface structure
+typedef struct McciBootloaderPlatform_SerialInterface_s
+McciBootloaderPlatform_SerialInterface_t;
+
 /// \brief annunciator interface structure
 typedef struct McciBootloaderPlatform_AnnunciatorInterface_s
 McciBootloaderPlatform_AnnunciatorInterface_t;
@@ -298,6 +426,8 @@ typedef enum McciBootloaderPlatform_ARMv6M_SvcError_e
 	/// successful processing
 	McciBootloaderPlatform_SvcError_OK = 0,
 
+	/// error: the information isn't available
+	McciBootloaderPlatform_SvcError_NotAvailable = UINT32_C(-4),
 	/// error: verify failure
 	McciBootloaderPlatform_SvcError_VerifyFailure = UINT32_C(-3),
 	/// error: invalid parameter to SVC
@@ -329,6 +459,16 @@ typedef enum McciBootloaderPlatform_ARMv6M_SvcRq_e
 	/// Call \c mcci_tweetnacl_verify64(). \c arg1 and \c arg2 are the pointers;
 	/// result is set to verifyFailure for failure.
 	McciBootloaderPlatform_ARMv6M_SvcRq_Verify64  /* = UINT32_C(0x01000004) */,
+
+	/// Call \c McciBootloader_checkBlockHashTable() with the bootloader's
+	/// public key. \c arg1 points to the table, and \c arg2 is its size
+	/// in bytes; result is set to verifyFailure for failure.
+	McciBootloaderPlatform_ARMv6M_SvcRq_CheckBlockHashTable  /* = UINT32_C(0x01000005) */,
+
+	/// Get the most stack used by the last boot. \c arg1 points to a
+	/// McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_t; result is
+	/// set to notAvailable if the app has overwritten the record.
+	McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage  /* = UINT32_C(0x01000006) */,
 	} McciBootloaderPlatform_ARMv6M_SvcRq_t;
 
 MCCIADK_C_ASSERT(sizeof(McciBootloaderPlatform_ARMv6M_SvcRq_t) == sizeof(uint32_t));
@@ -350,6 +490,15 @@ typedef struct McciBootloaderPlatform_ARMv6M_SvcRq_HashFinish_Arg_s
 	size_t nOverall;
 	} McciBootloaderPlatform_ARMv6M_SvcRq_HashFinish_Arg_t;
 
+/// \brief argument to \ref McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage
+typedef struct McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_s
+	{
+	uint32_t nStack;	///< bytes of stack (working RAM after .bss)
+	uint32_t nStackUsed;	///< most bytes of stack used
+	uint32_t nScratch;	///< bytes of scratch stack lent to the verifier
+	uint32_t nScratchUsed;	///< most bytes of scratch stack used
+	} McciBootloaderPlatform_ARMv6M_SvcRq_GetStackUsage_Arg_t;
+
 ///
 /// \brief SVC function interface
 ///
@@ -42,6 +42,23 @@ Author:
 
 MCCI_BOOTLOADER_BEGIN_DECLS
 
+/****************************************************************************\
+|
+|	Waiting for the hardware
+|
+\****************************************************************************/
+
+/// \brief spin while waiting for the hardware: lowest latency.
+#define	MCCI_BOOTLOADER_STM32L0_WAIT_SPIN	0
+/// \brief sleep (WFI) while waiting for the hardware: lowest energy.
+#define	MCCI_BOOTLOADER_STM32L0_WAIT_SLEEP	1
+
+/// \brief how to wait for flash programming, SPI transfers and delays;
+///	set by the board build (see `BOOTLOADER_WAIT_ABZ` in the Makefile).
+#ifndef MCCI_BOOTLOADER_STM32L0_WAIT
+# define MCCI_BOOTLOADER_STM32L0_WAIT	MCCI_BOOTLOADER_STM32L0_WAIT_SLEEP
+#endif
+
 /****************************************************************************\
 |
 |	API functions
@@ -67,5 +84,13 @@ McciBootloader_Stm32L0_systemFlashErase;
 McciBootloaderPlatform_SystemFlashWriteFn_t
 McciBootloader_Stm32L0_systemFlashWrite;
 
+void
+McciBootloader_Stm32L0_waitForRegister(
+	uint32_t reg,
+	uint32_t mask,
+	uint32_t value,
+	uint32_t irqMask
+	);
+
 MCCI_BOOTLOADER_END_DECLS
 #endif /* _mcci_bootloader_stm32l0_h_ */
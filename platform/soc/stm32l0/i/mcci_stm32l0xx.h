@@ -958,14 +958,14 @@ extern "C" {
 /// \name GPIO_AFRx bits
 ///	@{
 /// \brief get reg offset for GPIO_AFRx
-#define	MCCI_STM32L0_GPIO_AFRx_P(p)	(MCCI_STM32L0_GPIO_AFRL + ((p) / UINT32_C(8)))	//< f
+#define	MCCI_STM32L0_GPIO_AFRx_P(p)	(MCCI_STM32L0_GPIO_AFRL + UINT32_C(4) * ((p) / UINT32_C(8)))	//< f
 
 /// \brief get AFRx mask for port bit \p p.
 ///
 /// Normal use:
 ///	MCCI_BOOTLOADER_FIELD_SET_VALUE(MCCI_STM32L0_GPIO_AFSEL_P(bitnum), 0..7)
 ///
-#define	MCCI_STM32L0_GPIO_AFSEL_P(p)	(UINT32_C(0xF) << ((p) & 0x7u)
+#define	MCCI_STM32L0_GPIO_AFSEL_P(p)	(UINT32_C(0xF) << (4 * ((p) & 0x7u)))
 ///	@}
 
 /****************************************************************************\
@@ -1070,6 +1070,196 @@ extern "C" {
 ///	@}
 
 
+/****************************************************************************\
+|
+|	USART Registers
+|
+\****************************************************************************/
+
+/// \name USART offsets
+///	@{
+#define	MCCI_STM32L0_USART_CR1		UINT32_C(0x00)	///< offset to USART control register 1
+#define	MCCI_STM32L0_USART_CR2		UINT32_C(0x04)	///< offset to USART control register 2
+#define	MCCI_STM32L0_USART_CR3		UINT32_C(0x08)	///< offset to USART control register 3
+#define	MCCI_STM32L0_USART_BRR		UINT32_C(0x0C)	///< offset to USART baud rate register
+#define	MCCI_STM32L0_USART_GTPR		UINT32_C(0x10)	///< offset to USART guard time and prescaler register
+#define	MCCI_STM32L0_USART_RTOR		UINT32_C(0x14)	///< offset to USART receiver timeout register
+#define	MCCI_STM32L0_USART_RQR		UINT32_C(0x18)	///< offset to USART request register
+#define	MCCI_STM32L0_USART_ISR		UINT32_C(0x1C)	///< offset to USART interrupt and status register
+#define	MCCI_STM32L0_USART_ICR		UINT32_C(0x20)	///< offset to USART interrupt flag clear register
+#define	MCCI_STM32L0_USART_RDR		UINT32_C(0x24)	///< offset to USART receive data register
+#define	MCCI_STM32L0_USART_TDR		UINT32_C(0x28)	///< offset to USART transmit data register
+///	@}
+
+/// \name USART_CR1 bits
+///	@{
+#define	MCCI_STM32L0_USART_CR1_OVER8	(UINT32_C(1) << 15)	///< oversample by 8 (not 16)
+#define	MCCI_STM32L0_USART_CR1_TE	(UINT32_C(1) << 3)	///< transmitter enable
+#define	MCCI_STM32L0_USART_CR1_RE	(UINT32_C(1) << 2)	///< receiver enable
+#define	MCCI_STM32L0_USART_CR1_UE	(UINT32_C(1) << 0)	///< USART enable
+///	@}
+
+/// \name USART_CR3 bits
+///	@{
+#define	MCCI_STM32L0_USART_CR3_DDRE	(UINT32_C(1) << 13)	///< disable DMA on reception error
+#define	MCCI_STM32L0_USART_CR3_OVRDIS	(UINT32_C(1) << 12)	///< overrun disable
+#define	MCCI_STM32L0_USART_CR3_DMAT	(UINT32_C(1) << 7)	///< DMA enable transmitter
+#define	MCCI_STM32L0_USART_CR3_DMAR	(UINT32_C(1) << 6)	///< DMA enable receiver
+#define	MCCI_STM32L0_USART_CR3_EIE	(UINT32_C(1) << 0)	///< error interrupt enable
+///	@}
+
+/// \name USART_ISR bits
+///	@{
+#define	MCCI_STM32L0_USART_ISR_REACK	(UINT32_C(1) << 22)	///< receive enable acknowledge
+#define	MCCI_STM32L0_USART_ISR_TEACK	(UINT32_C(1) << 21)	///< transmit enable acknowledge
+#define	MCCI_STM32L0_USART_ISR_BUSY	(UINT32_C(1) << 16)	///< receiving a character
+#define	MCCI_STM32L0_USART_ISR_TXE	(UINT32_C(1) << 7)	///< transmit data register empty
+#define	MCCI_STM32L0_USART_ISR_TC	(UINT32_C(1) << 6)	///< transmission complete
+#define	MCCI_STM32L0_USART_ISR_RXNE	(UINT32_C(1) << 5)	///< read data register not empty
+#define	MCCI_STM32L0_USART_ISR_IDLE	(UINT32_C(1) << 4)	///< idle line detected
+#define	MCCI_STM32L0_USART_ISR_ORE	(UINT32_C(1) << 3)	///< overrun error
+#define	MCCI_STM32L0_USART_ISR_NF	(UINT32_C(1) << 2)	///< noise detected
+#define	MCCI_STM32L0_USART_ISR_FE	(UINT32_C(1) << 1)	///< framing error
+#define	MCCI_STM32L0_USART_ISR_PE	(UINT32_C(1) << 0)	///< parity error
+///	@}
+
+/// \name USART_ICR bits
+///	@{
+#define	MCCI_STM32L0_USART_ICR_TCCF	(UINT32_C(1) << 6)	///< transmission complete clear flag
+#define	MCCI_STM32L0_USART_ICR_IDLECF	(UINT32_C(1) << 4)	///< idle line detected clear flag
+#define	MCCI_STM32L0_USART_ICR_ORECF	(UINT32_C(1) << 3)	///< overrun error clear flag
+#define	MCCI_STM32L0_USART_ICR_NCF	(UINT32_C(1) << 2)	///< noise detected clear flag
+#define	MCCI_STM32L0_USART_ICR_FECF	(UINT32_C(1) << 1)	///< framing error clear flag
+#define	MCCI_STM32L0_USART_ICR_PECF	(UINT32_C(1) << 0)	///< parity error clear flag
+///	@}
+
+
+/****************************************************************************\
+|
+|	DMA Registers
+|
+\****************************************************************************/
+
+/// \name DMA offsets
+///	@{
+#define	MCCI_STM32L0_DMA_ISR		UINT32_C(0x00)	///< offset to DMA interrupt status register
+#define	MCCI_STM32L0_DMA_IFCR		UINT32_C(0x04)	///< offset to DMA interrupt flag clear register
+#define	MCCI_STM32L0_DMA_CSELR		UINT32_C(0xA8)	///< offset to DMA channel selection register
+
+/// \brief offset to DMA_CCRx for channel \p c (1..7)
+#define	MCCI_STM32L0_DMA_CCR(c)		(UINT32_C(0x08) + UINT32_C(20) * ((c) - 1))
+/// \brief offset to DMA_CNDTRx for channel \p c (1..7)
+#define	MCCI_STM32L0_DMA_CNDTR(c)	(UINT32_C(0x0C) + UINT32_C(20) * ((c) - 1))
+/// \brief offset to DMA_CPARx for channel \p c (1..7)
+#define	MCCI_STM32L0_DMA_CPAR(c)	(UINT32_C(0x10) + UINT32_C(20) * ((c) - 1))
+/// \brief offset to DMA_CMARx for channel \p c (1..7)
+#define	MCCI_STM32L0_DMA_CMAR(c)	(UINT32_C(0x14) + UINT32_C(20) * ((c) - 1))
+///	@}
+
+/// \name DMA_ISR and DMA_IFCR bits, for channel \p c (1..7)
+///	@{
+#define	MCCI_STM32L0_DMA_ISR_GIF(c)	(UINT32_C(1) << (4 * ((c) - 1) + 0))	///< global interrupt flag
+#define	MCCI_STM32L0_DMA_ISR_TCIF(c)	(UINT32_C(1) << (4 * ((c) - 1) + 1))	///< transfer complete
+#define	MCCI_STM32L0_DMA_ISR_HTIF(c)	(UINT32_C(1) << (4 * ((c) - 1) + 2))	///< half transfer
+#define	MCCI_STM32L0_DMA_ISR_TEIF(c)	(UINT32_C(1) << (4 * ((c) - 1) + 3))	///< transfer error
+///	@}
+
+/// \name DMA_CCRx bits
+///	@{
+#define	MCCI_STM32L0_DMA_CCR_RSV15	UINT32_C(0xFFFF8000)	///< reserved
+#define	MCCI_STM32L0_DMA_CCR_MEM2MEM	(UINT32_C(1) << 14)	///< memory-to-memory mode
+#define	MCCI_STM32L0_DMA_CCR_PL		(UINT32_C(3) << 12)	///< priority level
+#define	MCCI_STM32L0_DMA_CCR_MSIZE	(UINT32_C(3) << 10)	///< memory size (0: 8 bits, 1: 16 bits, 2: 32 bits)
+#define	MCCI_STM32L0_DMA_CCR_PSIZE	(UINT32_C(3) << 8)	///< peripheral size (0: 8 bits, 1: 16 bits, 2: 32 bits)
+#define	MCCI_STM32L0_DMA_CCR_MINC	(UINT32_C(1) << 7)	///< memory increment mode
+#define	MCCI_STM32L0_DMA_CCR_PINC	(UINT32_C(1) << 6)	///< peripheral increment mode
+#define	MCCI_STM32L0_DMA_CCR_CIRC	(UINT32_C(1) << 5)	///< circular mode
+#define	MCCI_STM32L0_DMA_CCR_DIR	(UINT32_C(1) << 4)	///< read from memory (not from peripheral)
+#define	MCCI_STM32L0_DMA_CCR_TEIE	(UINT32_C(1) << 3)	///< transfer error interrupt enable
+#define	MCCI_STM32L0_DMA_CCR_HTIE	(UINT32_C(1) << 2)	///< half transfer interrupt enable
+#define	MCCI_STM32L0_DMA_CCR_TCIE	(UINT32_C(1) << 1)	///< transfer complete interrupt enable
+#define	MCCI_STM32L0_DMA_CCR_EN		(UINT32_C(1) << 0)	///< channel enable
+///	@}
+
+/// \name DMA_CSELR fields
+///	@{
+/// \brief the request selection field for channel \p c (1..7)
+#define	MCCI_STM32L0_DMA_CSELR_CS(c)	(UINT32_C(0xF) << (4 * ((c) - 1)))
+#define	MCCI_STM32L0_DMA_CSELR_CS_SPI2	UINT32_C(2)	///< SPI2_RX on channel 4 or 6, SPI2_TX on 5 or 7
+#define	MCCI_STM32L0_DMA_CSELR_CS_USART2	UINT32_C(4)	///< USART2_RX on channel 5 or 6, USART2_TX on 4 or 7
+///	@}
+
+/****************************************************************************\
+|
+|	LPTIM Registers
+|
+\****************************************************************************/
+
+/// \name LPTIM offsets
+///	@{
+#define	MCCI_STM32L0_LPTIM_ISR		UINT32_C(0x00)	///< offset to LPTIM interrupt and status register
+#define	MCCI_STM32L0_LPTIM_ICR		UINT32_C(0x04)	///< offset to LPTIM interrupt clear register
+#define	MCCI_STM32L0_LPTIM_IER		UINT32_C(0x08)	///< offset to LPTIM interrupt enable register
+#define	MCCI_STM32L0_LPTIM_CFGR		UINT32_C(0x0C)	///< offset to LPTIM configuration register
+#define	MCCI_STM32L0_LPTIM_CR		UINT32_C(0x10)	///< offset to LPTIM control register
+#define	MCCI_STM32L0_LPTIM_CMP		UINT32_C(0x14)	///< offset to LPTIM compare register
+#define	MCCI_STM32L0_LPTIM_ARR		UINT32_C(0x18)	///< offset to LPTIM autoreload register
+#define	MCCI_STM32L0_LPTIM_CNT		UINT32_C(0x1C)	///< offset to LPTIM counter register
+///	@}
+
+/// \name LPTIM_ISR, LPTIM_ICR and LPTIM_IER bits
+///	@{
+#define	MCCI_STM32L0_LPTIM_ISR_DOWN	(UINT32_C(1) << 6)	///< counter direction changed to down
+#define	MCCI_STM32L0_LPTIM_ISR_UP	(UINT32_C(1) << 5)	///< counter direction changed to up
+#define	MCCI_STM32L0_LPTIM_ISR_ARROK	(UINT32_C(1) << 4)	///< write to LPTIM_ARR has completed
+#define	MCCI_STM32L0_LPTIM_ISR_CMPOK	(UINT32_C(1) << 3)	///< write to LPTIM_CMP has completed
+#define	MCCI_STM32L0_LPTIM_ISR_EXTTRIG	(UINT32_C(1) << 2)	///< external trigger edge
+#define	MCCI_STM32L0_LPTIM_ISR_ARRM	(UINT32_C(1) << 1)	///< counter matched LPTIM_ARR
+#define	MCCI_STM32L0_LPTIM_ISR_CMPM	(UINT32_C(1) << 0)	///< counter matched LPTIM_CMP
+///	@}
+
+/// \name LPTIM_CFGR bits
+///	@{
+#define	MCCI_STM32L0_LPTIM_CFGR_RSV25	UINT32_C(0xFE000000)	///< reserved
+#define	MCCI_STM32L0_LPTIM_CFGR_ENC	(UINT32_C(1) << 24)	///< encoder mode
+#define	MCCI_STM32L0_LPTIM_CFGR_COUNTMODE (UINT32_C(1) << 23)	///< count external (not internal) clock
+#define	MCCI_STM32L0_LPTIM_CFGR_PRELOAD	(UINT32_C(1) << 22)	///< update ARR and CMP at end of period (not at once)
+#define	MCCI_STM32L0_LPTIM_CFGR_WAVPOL	(UINT32_C(1) << 21)	///< invert the output
+#define	MCCI_STM32L0_LPTIM_CFGR_WAVE	(UINT32_C(1) << 20)	///< set-once (not PWM) mode
+#define	MCCI_STM32L0_LPTIM_CFGR_TIMOUT	(UINT32_C(1) << 19)	///< timeout mode
+#define	MCCI_STM32L0_LPTIM_CFGR_TRIGEN	(UINT32_C(3) << 17)	///< trigger enable and polarity
+#define	MCCI_STM32L0_LPTIM_CFGR_TRIGSEL	(UINT32_C(7) << 13)	///< trigger selector
+#define	MCCI_STM32L0_LPTIM_CFGR_PRESC	(UINT32_C(7) << 9)	///< prescaler: divide by 2^PRESC
+# define MCCI_STM32L0_LPTIM_CFGR_PRESC_1	MCCI_BOOTLOADER_FIELD_SET_VALUE(MCCI_STM32L0_LPTIM_CFGR_PRESC, 0)	///< /1
+# define MCCI_STM32L0_LPTIM_CFGR_PRESC_16	MCCI_BOOTLOADER_FIELD_SET_VALUE(MCCI_STM32L0_LPTIM_CFGR_PRESC, 4)	///< /16
+# define MCCI_STM32L0_LPTIM_CFGR_PRESC_128	MCCI_BOOTLOADER_FIELD_SET_VALUE(MCCI_STM32L0_LPTIM_CFGR_PRESC, 7)	///< /128
+#define	MCCI_STM32L0_LPTIM_CFGR_TRGFLT	(UINT32_C(3) << 6)	///< trigger filter
+#define	MCCI_STM32L0_LPTIM_CFGR_CKFLT	(UINT32_C(3) << 3)	///< clock filter
+#define	MCCI_STM32L0_LPTIM_CFGR_CKPOL	(UINT32_C(3) << 1)	///< clock polarity
+#define	MCCI_STM32L0_LPTIM_CFGR_CKSEL	(UINT32_C(1) << 0)	///< external (not internal) clock
+///	@}
+
+/// \name LPTIM_CR bits
+///	@{
+#define	MCCI_STM32L0_LPTIM_CR_CNTSTRT	(UINT32_C(1) << 2)	///< start in continuous mode
+#define	MCCI_STM32L0_LPTIM_CR_SNGSTRT	(UINT32_C(1) << 1)	///< start in single mode
+#define	MCCI_STM32L0_LPTIM_CR_ENABLE	(UINT32_C(1) << 0)	///< enable
+///	@}
+
+/****************************************************************************\
+|
+|	Interrupts
+|
+\****************************************************************************/
+
+/// \name NVIC interrupt numbers (Section 12.3, Table 56)
+///	@{
+#define	MCCI_STM32L0_IRQ_FLASH		UINT32_C(3)	///< flash and EEPROM
+#define	MCCI_STM32L0_IRQ_DMA1_CH4_7	UINT32_C(11)	///< DMA1 channels 4 to 7
+#define	MCCI_STM32L0_IRQ_LPTIM1		UINT32_C(13)	///< LPTIM1
+///	@}
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,6 +36,24 @@ McciBootloader_Stm32L0_programHalfPage(
 	const uint32_t *pData
 	);
 
+static void
+McciBootloader_Stm32L0_erasePage(
+	uint32_t flash_addr
+	);
+
+static void
+McciBootloader_Stm32L0_waitFlash(
+	void
+	);
+
+/// \brief the interrupts that end a wait for the flash
+#if MCCI_BOOTLOADER_STM32L0_WAIT == MCCI_BOOTLOADER_STM32L0_WAIT_SLEEP
+# define MCCI_BOOTLOADER_STM32L0_FLASH_PECR_WAIT	\
+	(MCCI_STM32L0_REG_FLASH_PECR_EOPIE | MCCI_STM32L0_REG_FLASH_PECR_ERRIE)
+#else
+# define MCCI_BOOTLOADER_STM32L0_FLASH_PECR_WAIT	0
+#endif
+
 /****************************************************************************\
 |
 |	Read-only data.
@@ -62,8 +80,7 @@ McciBootloader_Stm32L0_systemFlashErase(
 	nBytes = (nBytes + MCCI_STM32L0_FLASH_PAGE_SIZE - 1) & ~(MCCI_STM32L0_FLASH_PAGE_SIZE - 1);
 
 	// wait
-	while (McciArm_getReg(MCCI_STM32L0_REG_FLASH_SR) & MCCI_STM32L0_REG_FLASH_SR_BSY)
-		/* loop */;
+	McciBootloader_Stm32L0_waitFlash();
 
 	// unlock the PECR bit
 	McciArm_putReg(MCCI_STM32L0_REG_FLASH_PEKEYR, MCCI_STM32L0_REG_FLASH_PEKEYR_UNLOCK1);
@@ -82,30 +99,26 @@ McciBootloader_Stm32L0_systemFlashErase(
 
 	McciArm_putRegOr(
 		MCCI_STM32L0_REG_FLASH_PECR,
-		MCCI_STM32L0_REG_FLASH_PECR_ERASE | MCCI_STM32L0_REG_FLASH_PECR_PROG
+		MCCI_STM32L0_REG_FLASH_PECR_ERASE | MCCI_STM32L0_REG_FLASH_PECR_PROG |
+		MCCI_BOOTLOADER_STM32L0_FLASH_PECR_WAIT
 		);
 
 	for (; nPages > 0; p += MCCI_STM32L0_FLASH_PAGE_SIZE, --nPages)
 		{
-		// start the erase
-		McciArm_putReg(p, 0);
-
-		// wait for done
-		while (McciArm_getReg(MCCI_STM32L0_REG_FLASH_SR) & MCCI_STM32L0_REG_FLASH_SR_BSY)
-			/* loop */;
-
-		// reset EOP
-		if (McciArm_getReg(MCCI_STM32L0_REG_FLASH_SR) & MCCI_STM32L0_REG_FLASH_SR_EOP)
-			McciArm_putRegClear(
-				MCCI_STM32L0_REG_FLASH_SR,
-				MCCI_STM32L0_REG_FLASH_SR_EOP
-				);
+		// the flash can't be read during the erase, so the vector
+		// table isn't available.
+		const uint32_t psw = McciArm_disableInterrupts();
+
+		McciBootloader_Stm32L0_erasePage(p);
+
+		McciArm_setPRIMASK(psw);
 		}
 
 	// turn off PECR bits
 	McciArm_putRegClear(
 		MCCI_STM32L0_REG_FLASH_PECR,
-		MCCI_STM32L0_REG_FLASH_PECR_ERASE | MCCI_STM32L0_REG_FLASH_PECR_PROG
+		MCCI_STM32L0_REG_FLASH_PECR_ERASE | MCCI_STM32L0_REG_FLASH_PECR_PROG |
+		MCCI_BOOTLOADER_STM32L0_FLASH_PECR_WAIT
 		);
 
 	// lock
@@ -113,6 +126,46 @@ McciBootloader_Stm32L0_systemFlashErase(
 	return result;
 	}
 
+/*
+|| Erase one page, and wait for it to finish. This runs from RAM, so we
+|| can sleep while the flash is busy; when run from flash, the CPU
+|| stalls on the next instruction fetch for the whole erase.
+*/
+static void
+__attribute__((__section__(".RamFunc")))
+McciBootloader_Stm32L0_erasePage(
+	uint32_t flash_addr
+	)
+	{
+	// start the erase
+	McciArm_putReg(flash_addr, 0);
+
+	// wait for done
+	McciBootloader_Stm32L0_waitFlash();
+
+	// reset EOP
+	if (McciArm_getReg(MCCI_STM32L0_REG_FLASH_SR) & MCCI_STM32L0_REG_FLASH_SR_EOP)
+		McciArm_putRegClear(
+			MCCI_STM32L0_REG_FLASH_SR,
+			MCCI_STM32L0_REG_FLASH_SR_EOP
+			);
+	}
+
+/* wait for the flash to be idle; the end-of-operation interrupt wakes us */
+static void
+__attribute__((__section__(".RamFunc")))
+McciBootloader_Stm32L0_waitFlash(
+	void
+	)
+	{
+	McciBootloader_Stm32L0_waitForRegister(
+		MCCI_STM32L0_REG_FLASH_SR,
+		MCCI_STM32L0_REG_FLASH_SR_BSY,
+		0,
+		UINT32_C(1) << MCCI_STM32L0_IRQ_FLASH
+		);
+	}
+
 bool
 __attribute__((__section__(".RamFunc")))
 McciBootloader_Stm32L0_programHalfPage(
@@ -123,7 +176,8 @@ McciBootloader_Stm32L0_programHalfPage(
 	McciArm_putRegOr(
 		MCCI_STM32L0_REG_FLASH_PECR,
 		(MCCI_STM32L0_REG_FLASH_PECR_PROG |
-		 MCCI_STM32L0_REG_FLASH_PECR_FPRG)
+		 MCCI_STM32L0_REG_FLASH_PECR_FPRG |
+		 MCCI_BOOTLOADER_STM32L0_FLASH_PECR_WAIT)
 		);
 
 	unsigned i;
@@ -133,8 +187,7 @@ McciBootloader_Stm32L0_programHalfPage(
 		}
 
 	// wait for done
-	while (McciArm_getReg(MCCI_STM32L0_REG_FLASH_SR) & MCCI_STM32L0_REG_FLASH_SR_BSY)
-		/* loop */;
+	McciBootloader_Stm32L0_waitFlash();
 
 	// reset EOP
 	if (McciArm_getReg(MCCI_STM32L0_REG_FLASH_SR) & MCCI_STM32L0_REG_FLASH_SR_EOP)
@@ -147,7 +200,8 @@ McciBootloader_Stm32L0_programHalfPage(
 	McciArm_putRegClear(
 		MCCI_STM32L0_REG_FLASH_PECR,
 		(MCCI_STM32L0_REG_FLASH_PECR_PROG |
-		 MCCI_STM32L0_REG_FLASH_PECR_FPRG)
+		 MCCI_STM32L0_REG_FLASH_PECR_FPRG |
+		 MCCI_BOOTLOADER_STM32L0_FLASH_PECR_WAIT)
 		);
 
 	return true;
@@ -178,8 +232,7 @@ McciBootloader_Stm32L0_systemFlashWrite(
 	const size_t nHalfPage = MCCI_STM32L0_FLASH_HALF_PAGE_SIZE;
 
 	// wait
-	while (McciArm_getReg(MCCI_STM32L0_REG_FLASH_SR) & MCCI_STM32L0_REG_FLASH_SR_BSY)
-		/* loop */;
+	McciBootloader_Stm32L0_waitFlash();
 
 	// unlock
 	McciArm_putReg(MCCI_STM32L0_REG_FLASH_PEKEYR, MCCI_STM32L0_REG_FLASH_PEKEYR_UNLOCK1);
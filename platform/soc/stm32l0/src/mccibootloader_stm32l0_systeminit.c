@@ -63,7 +63,7 @@ Definition:
 Description:
 	Configure the STM32L0 core to run at 32 MHz, with the other
 	clocks configured in a suitable default way. Set up SYSTICK
-	to roll over every MS.  Enable HSI16 clock, PLL, LSE.
+	to roll over every MS, without interrupts.  Enable HSI16 clock, PLL, LSE.
 
 Returns:
 	No explicit result.
@@ -268,13 +268,14 @@ McciBootloader_Stm32L0_systemInit(void)
 		/* loop */;
 
 	// divisors for PCLK1, PCLK2 are initially 1 from above
-	// set up systick, as we may need it; set for 1 ms ticks
+	// set up systick, as we may need it; set for 1 ms ticks. It
+	// doesn't interrupt; McciBootloader_Stm32L0_waitForRegister()
+	// lets it wake us while we wait.
 	McciArm_putReg(MCCI_CM0PLUS_SYSTICK_RVR, (UINT32_C(32)*1000*1000)/1000 - 1);
 	McciArm_putReg(MCCI_CM0PLUS_SYSTICK_CVR, 0);
 	McciArm_putReg(
 		MCCI_CM0PLUS_SYSTICK_CSR,
 		(MCCI_CM0PLUS_SYSTICK_CSR_CLKSOURCE |
-		 MCCI_CM0PLUS_SYSTICK_CSR_TICKINT |
 		 MCCI_CM0PLUS_SYSTICK_CSR_ENABLE)
 		);
 
@@ -0,0 +1,161 @@
+/*
+
+Module:	mccibootloader_stm32l0_wait.c
+
+Function:
+	McciBootloader_Stm32L0_waitForRegister()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader_stm32l0.h"
+
+#include "mcci_stm32l0xx.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_Stm32L0_waitForRegister()
+
+Function:
+	Wait for a hardware register to reach a value, sleeping if possible.
+
+Definition:
+	void McciBootloader_Stm32L0_waitForRegister(
+		uint32_t reg,
+		uint32_t mask,
+		uint32_t value,
+		uint32_t irqMask
+		);
+
+Description:
+	We wait until (*reg & mask) == value. How we wait is set at
+	compile time by MCCI_BOOTLOADER_STM32L0_WAIT.
+
+	With MCCI_BOOTLOADER_STM32L0_WAIT_SPIN, we simply poll the register.
+
+	With MCCI_BOOTLOADER_STM32L0_WAIT_SLEEP, we disable interrupts,
+	enable the NVIC interrupts in irqMask (bit n for IRQ n), and
+	execute WFI until the register has the value. The caller must have
+	enabled the peripheral interrupt that signals the end of the
+	operation. Because PRIMASK is set, pending interrupts wake the CPU
+	but aren't taken; so this works even when the handler is
+	McciBootloaderBoard_CatenaAbz_NotHandled(), and even while the
+	flash is busy and can't supply a vector. On return, the interrupts
+	in irqMask are disabled and not pending, and PRIMASK is restored.
+
+	SysTick doesn't normally interrupt. While we wait, we let it wake
+	us every millisecond, so that delays can sleep, and so that the
+	wait is bounded if the end-of-operation interrupt is missed. We
+	clear it so that it doesn't keep us awake, and it's never taken.
+	Other enabled interrupts (such as the annunciator's) would also
+	keep us awake; we disable them until the wait is over, and then
+	they're taken as usual.
+
+	This runs from RAM, because it waits for flash operations.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+__attribute__((__section__(".RamFunc")))
+McciBootloader_Stm32L0_waitForRegister(
+	uint32_t reg,
+	uint32_t mask,
+	uint32_t value,
+	uint32_t irqMask
+	)
+	{
+#if MCCI_BOOTLOADER_STM32L0_WAIT == MCCI_BOOTLOADER_STM32L0_WAIT_SLEEP
+	uint32_t const psw = McciArm_disableInterrupts();
+	uint32_t deferred = 0;
+
+	if (irqMask != 0)
+		McciArm_putReg(MCCI_CM0PLUS_NVIC_ISER, irqMask);
+
+	// write, don't update: reading CSR would clear COUNTFLAG.
+	McciArm_putReg(
+		MCCI_CM0PLUS_SYSTICK_CSR,
+		(MCCI_CM0PLUS_SYSTICK_CSR_CLKSOURCE |
+		 MCCI_CM0PLUS_SYSTICK_CSR_TICKINT |
+		 MCCI_CM0PLUS_SYSTICK_CSR_ENABLE)
+		);
+
+	while ((McciArm_getReg(reg) & mask) != value)
+		{
+		McciArm_waitForInterrupt();
+
+		McciArm_putReg(MCCI_CM0PLUS_SCB_ICSR, MCCI_CM0PLUS_SCB_ICSR_PENDSTCLR);
+
+		uint32_t const pending =
+			McciArm_getReg(MCCI_CM0PLUS_NVIC_ISPR) &
+			McciArm_getReg(MCCI_CM0PLUS_NVIC_ISER) &
+			~irqMask;
+
+		if (pending != 0)
+			{
+			McciArm_putReg(MCCI_CM0PLUS_NVIC_ICER, pending);
+			deferred |= pending;
+			}
+		}
+
+	McciArm_putReg(
+		MCCI_CM0PLUS_SYSTICK_CSR,
+		(MCCI_CM0PLUS_SYSTICK_CSR_CLKSOURCE |
+		 MCCI_CM0PLUS_SYSTICK_CSR_ENABLE)
+		);
+	McciArm_putReg(MCCI_CM0PLUS_SCB_ICSR, MCCI_CM0PLUS_SCB_ICSR_PENDSTCLR);
+
+	if (irqMask != 0)
+		{
+		McciArm_putReg(MCCI_CM0PLUS_NVIC_ICER, irqMask);
+		McciArm_putReg(MCCI_CM0PLUS_NVIC_ICPR, irqMask);
+		}
+
+	if (deferred != 0)
+		McciArm_putReg(MCCI_CM0PLUS_NVIC_ISER, deferred);
+
+	McciArm_setPRIMASK(psw);
+#else
+	(void) irqMask;
+
+	while ((McciArm_getReg(reg) & mask) != value)
+		/* loop */;
+#endif
+	}
+
+/**** end of mccibootloader_stm32l0_wait.c ****/
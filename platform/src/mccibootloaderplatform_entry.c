@@ -30,6 +30,9 @@ Author:
 |
 \****************************************************************************/
 
+/// \brief how far below our frame to stop painting the stack; this
+///	leaves room for McciBootloader_paintStack()'s own frame.
+#define	STACK_PAINT_MARGIN	64u
 
 
 /****************************************************************************\
@@ -60,8 +63,10 @@ Definition:
 		);
 
 Description:
-	This routine initializes zero RAM, copies init data to RAM, and sets
-	up the hardware. Key hardware setup: clocks, potentially the debug UART,
+	This routine initializes zero RAM, copies init data and the code
+	that runs from RAM (the crypto kernels) to RAM, paints the free
+	stack (for McciBootloaderPlatform_saveStackUsage()), and sets up
+	the hardware. Key hardware setup: clocks, potentially the debug UART,
 	and brown-out detect.
 
 Returns:
@@ -79,15 +84,25 @@ McciBootloaderPlatform_entry(
 	void
 	)
 	{
+	const size_t nRamCode = McciBootloader_codeSize(&g_McciBootloader_RamCodeBase, &g_McciBootloader_RamCodeTop);
 	const size_t nData = McciBootloader_codeSize(&g_McciBootloader_DataBase, &g_McciBootloader_DataTop);
 	const size_t nBss = McciBootloader_codeSize(&g_McciBootloader_BssBase, &g_McciBootloader_BssTop);
 
+	/* copy the code that runs from RAM */
+	memcpy(&g_McciBootloader_RamCodeBase, &gk_McciBootloader_RamCodeImageBase, nRamCode);
+
 	/* copy the initialized data */
 	memcpy(&g_McciBootloader_DataBase, &gk_McciBootloader_DataImageBase, nData);
 
 	/* zero BSS */
 	memset(&g_McciBootloader_BssBase, 0, nBss);
 
+	/* paint the stack below us, so we can see how much is used */
+	McciBootloader_paintStack(
+		&g_McciBootloader_BssTop,
+		(uint8_t *)__builtin_frame_address(0) - STACK_PAINT_MARGIN
+		);
+
 	/* call the platform init function */
 	McciBootloaderPlatform_systemInit();
 	}
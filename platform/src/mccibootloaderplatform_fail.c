@@ -80,7 +80,7 @@ McciBootloaderPlatform_fail(
 	{
 	g_McciBootloader_failureCode = error;
 
-	(*gk_McciBootloaderPlatformInterface.pFail)(error);
+	MCCI_BOOTLOADER_PLATFORM_CALL(pFail, fail)(error);
 
 	MCCI_BOOTLOADER_NOT_REACHED();
 	}
@@ -0,0 +1,209 @@
+/*
+
+Module:	mccibootloader_bootappbank.c
+
+Function:
+	McciBootloader_bootAppBank()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_platform.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+static const uint8_t *
+getBankBase(
+	uint32_t iBank
+	);
+
+static size_t
+getBankSize(
+	uint32_t iBank
+	);
+
+static bool
+checkBankSigned(
+	uint32_t iBank,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	);
+
+static void
+MCCI_BOOTLOADER_NORETURN_PFX
+startBank(
+	uint32_t iBank
+	) MCCI_BOOTLOADER_NORETURN_SFX;
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_bootAppBank()
+
+Function:
+	Launch the app from the selected app bank, switching banks if
+	asked to, or if the selected bank isn't good.
+
+Definition:
+	void McciBootloader_bootAppBank(
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey
+		);
+
+Description:
+	Used when the bootloader is built with two app banks. Each bank
+	holds an app linked to run there. The app updates itself by
+	writing the new app (linked for the other bank) into the other
+	bank, and then setting the update flag; nothing is copied from
+	storage.
+
+	If the update flag is set, we consume it, and check the app in
+	the other bank: its hash, and its signature with our key. If it
+	passes, we select that bank and launch it. Otherwise, or if the
+	flag isn't set, we launch the app in the selected bank, if its
+	hash is good; it was checked in full when it was selected.
+
+	If the selected bank isn't good, but the other bank holds a good,
+	signed app, we go back to it: select it and launch it. As the
+	previous app stays in the other bank until it's overwritten,
+	setting the update flag again also rolls an update back.
+
+	The flag is cleared before the selector is changed, so a power
+	failure between the two leaves the previous app running, not
+	a pending request to switch back.
+
+Returns:
+	Only if neither bank holds a good app; the update flag is then
+	clear. Otherwise, launches the app, and doesn't return.
+
+*/
+
+void
+McciBootloader_bootAppBank(
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	)
+	{
+	uint32_t const iActive = McciBootloaderPlatform_getAppBank() & 1;
+	uint32_t const iOther = iActive ^ 1;
+
+	if (McciBootloaderPlatform_getUpdateFlag())
+		{
+		/* consume the request; don't check again until asked */
+		McciBootloaderPlatform_setUpdateFlag(false);
+
+		if (checkBankSigned(iOther, pPublicKey))
+			{
+			McciBootloaderPlatform_setAppBank(iOther);
+			startBank(iOther);
+			}
+		}
+
+	if (McciBootloader_checkCodeValid(getBankBase(iActive), getBankSize(iActive)))
+		startBank(iActive);
+
+	/* roll back to the other bank, if it's good */
+	if (checkBankSigned(iOther, pPublicKey))
+		{
+		McciBootloaderPlatform_setAppBank(iOther);
+		startBank(iOther);
+		}
+	}
+
+/* the base and size of each app bank */
+static const uint8_t *
+getBankBase(
+	uint32_t iBank
+	)
+	{
+	return iBank == 0 ? (const uint8_t *)&gk_McciBootloader_AppBase
+			  : (const uint8_t *)&gk_McciBootloader_AppBank2Base;
+	}
+
+static size_t
+getBankSize(
+	uint32_t iBank
+	)
+	{
+	return iBank == 0
+		? McciBootloader_codeSize(&gk_McciBootloader_AppBase, &gk_McciBootloader_AppBank2Base)
+		: McciBootloader_codeSize(&gk_McciBootloader_AppBank2Base, &gk_McciBootloader_AppTop)
+		;
+	}
+
+/*
+|| Check the app in a bank in full: its hash, and that it was signed with
+|| our key. The signature check uses the block buffer as its stack.
+*/
+static bool
+checkBankSigned(
+	uint32_t iBank,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	)
+	{
+	const uint8_t * const pBase = getBankBase(iBank);
+	size_t const nBank = getBankSize(iBank);
+
+	if (! McciBootloader_checkCodeValid(pBase, nBank))
+		return false;
+
+	const McciBootloader_SignatureBlock_t * const pSigBlock =
+		McciBootloaderPlatform_getSignatureBlock(
+			McciBootloaderPlatform_getAppInfo(pBase, nBank)
+			);
+
+	if (pSigBlock == NULL)
+		return false;
+
+	volatile mcci_tweetnacl_result_t result;
+
+	result = mcci_tweetnacl_verify_32(pPublicKey->bytes, pSigBlock->publicKey.bytes);
+
+	bool const fSignatureOk = McciBootloader_checkSignature(
+		&pSigBlock->signature,
+		&pSigBlock->hash,
+		pPublicKey,
+		g_McciBootloader_imageBlock,
+		sizeof(g_McciBootloader_imageBlock)
+		);
+
+	return mcci_tweetnacl_result_is_success(result) & fSignatureOk;
+	}
+
+static void
+startBank(
+	uint32_t iBank
+	)
+	{
+	McciBootloaderPlatform_startApp(getBankBase(iBank));
+	}
+
+/**** end of mccibootloader_bootappbank.c ****/
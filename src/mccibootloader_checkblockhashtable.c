@@ -0,0 +1,139 @@
+/*
+
+Module:	mccibootloader_checkblockhashtable.c
+
+Function:
+	McciBootloader_checkBlockHashTable()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_blockhash.h"
+
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_checkBlockHashTable()
+
+Function:
+	Check the signature of a block hash table in memory.
+
+Definition:
+	bool McciBootloader_checkBlockHashTable(
+		const void *pTable,
+		size_t nTable,
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+		void *pScratch,
+		size_t nScratch
+		);
+
+Description:
+	pTable points to a complete table (header, block hashes and
+	signature block) of nTable bytes. We check that the sizes are
+	consistent, compute the root hash, and check the signature on
+	it.
+
+	This is used by the bootloader for tables in storage, and by the
+	SVC handler on behalf of apps that want to check an image as it's
+	downloaded. The bootloader passes its block buffer as pScratch
+	(the table may be in it), and the signature check runs there
+	(see McciBootloader_checkSignature()); the SVC handler passes
+	NULL, and then all the working storage is on the stack.
+
+Returns:
+	true if the table is intact and was signed with the given key.
+
+*/
+
+bool
+McciBootloader_checkBlockHashTable(
+	const void *pTable,
+	size_t nTable,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	void *pScratch,
+	size_t nScratch
+	)
+	{
+	const McciBootloader_BlockHashHeader_t * const pHeader = pTable;
+
+	if (nTable < sizeof(*pHeader) + sizeof(McciBootloader_SignatureBlock_t))
+		return false;
+
+	if (pHeader->magic != MCCI_BOOTLOADER_BLOCK_HASH_MAGIC ||
+	    pHeader->size != sizeof(*pHeader))
+		return false;
+
+	if (pHeader->nBlocks > nTable / sizeof(mcci_tweetnacl_sha512_t) ||
+	    McciBootloader_blockHashTableSize(pHeader) != nTable)
+		return false;
+
+	size_t const nSigned = nTable - sizeof(McciBootloader_SignatureBlock_t);
+	const McciBootloader_SignatureBlock_t * const pSigBlock =
+		(const void *)((const uint8_t *)pTable + nSigned);
+
+	/* compute the root */
+	mcci_tweetnacl_sha512_t root;
+
+	mcci_tweetnacl_hash_sha512(
+		&root,
+		pTable,
+		nSigned + sizeof(mcci_tweetnacl_sign_publickey_t)
+		);
+
+	/*
+	|| check the parts of the signature block we have to hand first,
+	|| as the signature check may overwrite the table.
+	*/
+	volatile mcci_tweetnacl_result_t result;
+
+	result = mcci_tweetnacl_verify_64(root.bytes, pSigBlock->hash.bytes);
+	result |= mcci_tweetnacl_verify_32(pPublicKey->bytes, pSigBlock->publicKey.bytes);
+
+	bool const fSignatureOk = McciBootloader_checkSignature(
+		&pSigBlock->signature,
+		&root,
+		pPublicKey,
+		pScratch,
+		nScratch
+		);
+
+	return mcci_tweetnacl_result_is_success(result) & fSignatureOk;
+	}
+
+/**** end of mccibootloader_checkblockhashtable.c ****/
@@ -0,0 +1,185 @@
+/*
+
+Module:	mccibootloader_checkdirectory.c
+
+Function:
+	McciBootloader_checkDirectory() and McciBootloader_readDirectory()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_directory.h"
+#include "mcci_bootloader_platform.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_checkDirectory()
+
+Function:
+	Read the slot directory from storage and check its signature.
+
+Definition:
+	bool McciBootloader_checkDirectory(
+		McciBootloaderStorageAddress_t address,
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+		mcci_tweetnacl_sha512_t *pRoot // OUT
+		);
+
+Description:
+	We read the directory at the given storage address into the
+	block buffer, check that the sizes are consistent, compute its
+	hash, and check the signature on it. The signature check uses
+	the block buffer as scratch, so the entries are lost; the hash
+	is returned instead, so that McciBootloader_selectStorageImage()
+	can read them again and know that they haven't changed.
+
+Returns:
+	true if there's a directory and it was signed with the given key,
+	in which case *pRoot is set to its hash.
+
+*/
+
+bool
+McciBootloader_checkDirectory(
+	McciBootloaderStorageAddress_t address,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	mcci_tweetnacl_sha512_t *pRoot
+	)
+	{
+	size_t nDirectory;
+
+	if (! McciBootloader_readDirectory(address, &nDirectory))
+		return false;
+
+	size_t const nSigned = nDirectory - sizeof(McciBootloader_SignatureBlock_t);
+	const McciBootloader_SignatureBlock_t * const pSigBlock =
+		(const void *)(g_McciBootloader_imageBlock + nSigned);
+
+	mcci_tweetnacl_hash_sha512(
+		pRoot,
+		g_McciBootloader_imageBlock,
+		nSigned + sizeof(mcci_tweetnacl_sign_publickey_t)
+		);
+
+	/*
+	|| check the parts of the signature block we have to hand first,
+	|| as the signature check overwrites the directory.
+	*/
+	volatile mcci_tweetnacl_result_t result;
+
+	result = mcci_tweetnacl_verify_64(pRoot->bytes, pSigBlock->hash.bytes);
+	result |= mcci_tweetnacl_verify_32(pPublicKey->bytes, pSigBlock->publicKey.bytes);
+
+	bool const fSignatureOk = McciBootloader_checkSignature(
+		&pSigBlock->signature,
+		pRoot,
+		pPublicKey,
+		g_McciBootloader_imageBlock,
+		sizeof(g_McciBootloader_imageBlock)
+		);
+
+	return mcci_tweetnacl_result_is_success(result) & fSignatureOk;
+	}
+
+/*
+
+Name:	McciBootloader_readDirectory()
+
+Function:
+	Read the slot directory from storage into the block buffer.
+
+Definition:
+	bool McciBootloader_readDirectory(
+		McciBootloaderStorageAddress_t address,
+		size_t *pnDirectory // OUT
+		);
+
+Description:
+	We read the header of the directory at the given storage
+	address, check it, and read the whole directory (header,
+	entries and signature block) into g_McciBootloader_imageBlock.
+	The directory is not authenticated.
+
+Returns:
+	true if there's a directory that fits in the block buffer, in
+	which case *pnDirectory is set to its size in bytes.
+
+*/
+
+bool
+McciBootloader_readDirectory(
+	McciBootloaderStorageAddress_t address,
+	size_t *pnDirectory
+	)
+	{
+	const McciBootloader_DirectoryHeader_t * const pHeader =
+		(const void *)g_McciBootloader_imageBlock;
+
+	if (! McciBootloaderPlatform_storageRead(
+		address,
+		g_McciBootloader_imageBlock,
+		sizeof(*pHeader)
+		))
+		return false;
+
+	if (pHeader->magic != MCCI_BOOTLOADER_DIRECTORY_MAGIC ||
+	    pHeader->size != sizeof(*pHeader))
+		return false;
+
+	size_t const nDirectory = McciBootloader_directorySize(pHeader);
+
+	if (nDirectory > sizeof(g_McciBootloader_imageBlock))
+		return false;
+
+	if (! McciBootloaderPlatform_storageRead(
+		address,
+		g_McciBootloader_imageBlock,
+		nDirectory
+		))
+		return false;
+
+	/* the header might have changed under us */
+	if (McciBootloader_directorySize(pHeader) != nDirectory)
+		return false;
+
+	*pnDirectory = nDirectory;
+	return true;
+	}
+
+/**** end of mccibootloader_checkdirectory.c ****/
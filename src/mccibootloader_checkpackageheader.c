@@ -0,0 +1,167 @@
+/*
+
+Module:	mccibootloader_checkpackageheader.c
+
+Function:
+	McciBootloader_checkPackageHeader()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_package.h"
+#include "mcci_bootloader_platform.h"
+#include "mcci_tweetnacl_sign.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_checkPackageHeader()
+
+Function:
+	Validate the header of an update package in storage.
+
+Definition:
+	bool McciBootloader_checkPackageHeader(
+		const McciBootloader_PackageHeader_t *pHeader,
+		McciBootloader_AppInfo_t *pAppInfo // OUT
+		);
+
+Description:
+	Check that the header describes a package that we know how to
+	unpack, and that the image it will produce belongs in the
+	application flash.
+
+	A delta package can only be applied to the image it was made
+	from, so we also check that the application in flash is valid,
+	and that its hash matches the base hash in the header. A
+	compressed package stands alone, and has no base.
+
+	The signature of the package is checked separately, by
+	McciBootloader_checkStorageImage().
+
+Returns:
+	true for success, false for failure.
+
+	If true, pAppInfo is set to the AppInfo of the image that will
+	result from unpacking the package.
+
+*/
+
+bool
+McciBootloader_checkPackageHeader(
+	const McciBootloader_PackageHeader_t *pHeader,
+	McciBootloader_AppInfo_t *pAppInfo
+	)
+	{
+	if (pHeader->magic != MCCI_BOOTLOADER_PACKAGE_MAGIC)
+		return false;
+
+	if (pHeader->size != sizeof(*pHeader))
+		return false;
+
+	if (pHeader->type == McciBootloader_PackageType_Delta)
+		{
+		/* the package must have been made for our window size */
+		if (pHeader->log2WindowSize >= 32 ||
+		    (UINT32_C(1) << pHeader->log2WindowSize) != MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE)
+			return false;
+		}
+	else if (pHeader->type == McciBootloader_PackageType_Compressed)
+		{
+		/* distances are 16 bits, and there's no base */
+		if (pHeader->log2WindowSize > 16 || pHeader->baseSize != 0)
+			return false;
+		}
+	else
+		return false;
+
+	/* the result must be an app image */
+	const McciBootloader_AppInfo_t * const pNewAppInfo = &pHeader->appInfo;
+	size_t const appSize = McciBootloader_codeSize(&gk_McciBootloader_AppBase, &gk_McciBootloader_AppTop);
+
+	if (pNewAppInfo->magic != MCCI_BOOTLOADER_APP_INFO_MAGIC)
+		return false;
+
+	if (pNewAppInfo->size != sizeof(*pNewAppInfo))
+		return false;
+
+	if (pNewAppInfo->targetAddress != (uintptr_t) &gk_McciBootloader_AppBase)
+		return false;
+
+	if (pNewAppInfo->authsize != sizeof(McciBootloader_SignatureBlock_t))
+		return false;
+
+	if (pNewAppInfo->imagesize > appSize ||
+	    appSize - pNewAppInfo->imagesize < pNewAppInfo->authsize)
+		return false;
+
+	if (pHeader->type != McciBootloader_PackageType_Delta)
+		{
+		*pAppInfo = *pNewAppInfo;
+		return true;
+		}
+
+	/* the base must be the app that's in flash now, and it must be intact */
+	if (! McciBootloader_checkCodeValid(&gk_McciBootloader_AppBase, appSize))
+		return false;
+
+	const McciBootloader_AppInfo_t * const pBaseAppInfo =
+		McciBootloaderPlatform_getAppInfo(&gk_McciBootloader_AppBase, appSize);
+
+	if (pBaseAppInfo == NULL)
+		return false;
+
+	if (pBaseAppInfo->imagesize + pBaseAppInfo->authsize != pHeader->baseSize)
+		return false;
+
+	const McciBootloader_SignatureBlock_t * const pBaseSigBlock =
+		McciBootloaderPlatform_getSignatureBlock(pBaseAppInfo);
+
+	if (pBaseSigBlock == NULL)
+		return false;
+
+	if (! mcci_tweetnacl_result_is_success(
+		mcci_tweetnacl_verify_64(pBaseSigBlock->hash.bytes, pHeader->baseHash.bytes)
+		))
+		return false;
+
+	*pAppInfo = *pNewAppInfo;
+	return true;
+	}
+
+/**** end of mccibootloader_checkpackageheader.c ****/
@@ -0,0 +1,102 @@
+/*
+
+Module:	mccibootloader_checkpackageresult.c
+
+Function:
+	McciBootloader_checkPackageResult()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_package.h"
+#include "mcci_bootloader_platform.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_checkPackageResult()
+
+Function:
+	Check the image produced by unpacking a package.
+
+Definition:
+	McciBootloaderError_t McciBootloader_checkPackageResult(
+		const McciBootloader_PackageHeader_t *pHeader
+		);
+
+Description:
+	The image described by pHeader->appInfo has been programmed. We
+	check that it's valid, and that its hash is the one named by the
+	(signed) package header; the hash in the image alone proves only
+	that the image is intact, not that it came from the signer.
+
+Returns:
+	McciBootloaderError_OK if the image is the one the package
+	describes, McciBootloaderError_FlashVerifyFailed otherwise.
+
+*/
+
+McciBootloaderError_t
+McciBootloader_checkPackageResult(
+	const McciBootloader_PackageHeader_t *pHeader
+	)
+	{
+	const McciBootloader_AppInfo_t * const pAppInfo = &pHeader->appInfo;
+
+	if (! McciBootloader_checkCodeValid(
+		(const void *)(uintptr_t) pAppInfo->targetAddress,
+		pAppInfo->imagesize + pAppInfo->authsize
+		))
+		{
+		return McciBootloaderError_FlashVerifyFailed;
+		}
+
+	const McciBootloader_SignatureBlock_t * const pSigBlock =
+		McciBootloaderPlatform_getSignatureBlock(pAppInfo);
+
+	if (! mcci_tweetnacl_result_is_success(
+		mcci_tweetnacl_verify_64(pSigBlock->hash.bytes, pHeader->targetHash.bytes)
+		))
+		{
+		return McciBootloaderError_FlashVerifyFailed;
+		}
+
+	return McciBootloaderError_OK;
+	}
+
+/**** end of mccibootloader_checkpackageresult.c ****/
@@ -0,0 +1,187 @@
+/*
+
+Module:	mccibootloader_checksignature.c
+
+Function:
+	McciBootloader_checkSignature()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_platform.h"
+#include "mcci_tweetnacl_sign.h"
+#include <string.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+/// \brief what the signature check works on
+typedef struct CheckSignatureContext_s
+	{
+	/// the signed message: the signature, followed by the hash
+	uint8_t				signedMessage[sizeof(mcci_tweetnacl_sign_signature_t) + sizeof(mcci_tweetnacl_sha512_t)];
+	/// the opened message; crypto_sign_open needs as much room as the signed message
+	uint8_t				message[sizeof(mcci_tweetnacl_sign_signature_t) + sizeof(mcci_tweetnacl_sha512_t)];
+	mcci_tweetnacl_sign_publickey_t	publicKey;	///< the key
+	size_t				nActual;	///< size of the opened message
+	mcci_tweetnacl_result_t		result;		///< result of crypto_sign_open
+	} CheckSignatureContext_t;
+
+static McciBootloaderPlatform_StackFn_t checkSignature_open;
+
+static bool
+checkSignature_finish(
+	const CheckSignatureContext_t *pContext,
+	const mcci_tweetnacl_sha512_t *pHash
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_checkSignature()
+
+Function:
+	Check an ed25519 signature on a SHA-512 hash.
+
+Definition:
+	bool McciBootloader_checkSignature(
+		const mcci_tweetnacl_sign_signature_t *pSignature,
+		const mcci_tweetnacl_sha512_t *pHash,
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+		void *pScratch,
+		size_t nScratch
+		);
+
+Description:
+	The signature is checked with crypto_sign_open, whose temporaries
+	are the biggest user of stack in the bootloader. If pScratch
+	names at least MCCI_BOOTLOADER_SCRATCH_STACK_MIN bytes (beyond
+	what the check itself needs), the signed message is built at the
+	start of the scratch area, and the check runs with the rest as its
+	stack (see McciBootloaderPlatform_callOnStack()). During the boot,
+	the scratch is g_McciBootloader_imageBlock, which is free while
+	no I/O is in flight; so the stack need not be sized for the
+	verifier.
+
+	pSignature, pHash and pPublicKey may point into the scratch area;
+	they are copied before it's used. The contents of the scratch
+	area are lost.
+
+	If pScratch is NULL, or the scratch is too small, the check runs
+	on the caller's stack. This is the case when an application calls
+	the bootloader, as the bootloader's RAM then belongs to the app.
+
+Returns:
+	true if the signature on the hash was made with the key.
+
+*/
+
+bool
+McciBootloader_checkSignature(
+	const mcci_tweetnacl_sign_signature_t *pSignature,
+	const mcci_tweetnacl_sha512_t *pHash,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	void *pScratch,
+	size_t nScratch
+	)
+	{
+	/* copy the inputs first; they might be in the scratch area */
+	CheckSignatureContext_t context;
+	mcci_tweetnacl_sha512_t hash;
+
+	memcpy(context.signedMessage, pSignature->bytes, sizeof(pSignature->bytes));
+	memcpy(context.signedMessage + sizeof(pSignature->bytes), pHash->bytes, sizeof(pHash->bytes));
+	context.publicKey = *pPublicKey;
+	hash = *pHash;
+
+	if (pScratch == NULL ||
+	    nScratch < sizeof(context) + MCCI_BOOTLOADER_SCRATCH_STACK_MIN)
+		{
+		checkSignature_open(&context);
+		return checkSignature_finish(&context, &hash);
+		}
+
+	/* put the context at the start of the scratch, aligned */
+	uintptr_t const base = ((uintptr_t)pScratch + 7) & ~(uintptr_t)7;
+	CheckSignatureContext_t * const pContext = (void *)base;
+	uint8_t * const pStack = (uint8_t *)(pContext + 1);
+
+	*pContext = context;
+	McciBootloaderPlatform_callOnStack(
+		checkSignature_open,
+		pContext,
+		pStack,
+		(uint8_t *)pScratch + nScratch - pStack
+		);
+
+	return checkSignature_finish(pContext, &hash);
+	}
+
+/* run crypto_sign_open on a context */
+static void
+checkSignature_open(
+	void *pArg
+	)
+	{
+	CheckSignatureContext_t * const pContext = pArg;
+
+	pContext->result = mcci_tweetnacl_sign_open(
+		pContext->message,
+		&pContext->nActual,
+		pContext->signedMessage,
+		sizeof(pContext->signedMessage),
+		&pContext->publicKey
+		);
+	}
+
+/* constant-time checks of the result */
+static bool
+checkSignature_finish(
+	const CheckSignatureContext_t *pContext,
+	const mcci_tweetnacl_sha512_t *pHash
+	)
+	{
+	// result = non-zero for failure or zero for success.
+	volatile mcci_tweetnacl_result_t result;
+
+	result = pContext->result;
+
+	// make sure the size is right.
+	result |= pContext->nActual ^ sizeof(pHash->bytes);
+
+	// make sure the hashes match
+	result |= mcci_tweetnacl_verify_64(pHash->bytes, pContext->message);
+
+	return mcci_tweetnacl_result_is_success(result);
+	}
+
+/**** end of mccibootloader_checksignature.c ****/
@@ -0,0 +1,116 @@
+/*
+
+Module:	mccibootloader_checkstorageblock.c
+
+Function:
+	McciBootloader_checkStorageBlock()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_blockhash.h"
+#include "mcci_bootloader_platform.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_checkStorageBlock()
+
+Function:
+	Check one block of an image in storage against its block hash.
+
+Definition:
+	bool McciBootloader_checkStorageBlock(
+		McciBootloaderStorageAddress_t address,
+		const McciBootloader_AppInfo_t *pAppInfo,
+		uint32_t iBlock,
+		const uint8_t *pBlock
+		);
+
+Description:
+	The image at storage address \p address, described by pAppInfo,
+	has a block hash table whose header has been checked by
+	McciBootloader_getBlockHashTable(). pBlock points to a copy of
+	block \p iBlock of the image (the last block may be short; only
+	the bytes that are part of the image are hashed). We read the
+	block's hash from the table and compare.
+
+Returns:
+	true if the block matches its hash.
+
+*/
+
+bool
+McciBootloader_checkStorageBlock(
+	McciBootloaderStorageAddress_t address,
+	const McciBootloader_AppInfo_t *pAppInfo,
+	uint32_t iBlock,
+	const uint8_t *pBlock
+	)
+	{
+	uint32_t const imageSize = pAppInfo->imagesize + pAppInfo->authsize;
+	uint32_t const blockSize = MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE;
+	uint32_t const blockOffset = iBlock * blockSize;
+	mcci_tweetnacl_sha512_t expected;
+	mcci_tweetnacl_sha512_t actual;
+
+	if (blockOffset >= imageSize)
+		return false;
+
+	uint32_t nBlock = imageSize - blockOffset;
+
+	if (nBlock > blockSize)
+		nBlock = blockSize;
+
+	if (! McciBootloaderPlatform_storageRead(
+		address + imageSize +
+			sizeof(McciBootloader_BlockHashHeader_t) +
+			iBlock * sizeof(expected),
+		expected.bytes,
+		sizeof(expected.bytes)
+		))
+		return false;
+
+	mcci_tweetnacl_hash_sha512(&actual, pBlock, nBlock);
+
+	return mcci_tweetnacl_result_is_success(
+		mcci_tweetnacl_verify_64(actual.bytes, expected.bytes)
+		);
+	}
+
+/**** end of mccibootloader_checkstorageblock.c ****/
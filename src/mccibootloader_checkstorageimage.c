@@ -22,11 +22,12 @@ Author:
 #include "mcci_bootloader.h"
 
 #include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_blockhash.h"
+#include "mcci_bootloader_package.h"
 #include "mcci_bootloader_platform.h"
 #include "mcci_tweetnacl_hash.h"
 #include "mcci_tweetnacl_sign.h"
 
-#include <string.h>
 
 /****************************************************************************\
 |
@@ -34,6 +35,13 @@ Author:
 |
 \****************************************************************************/
 
+static bool
+checkStorageImageBlocks(
+	McciBootloaderStorageAddress_t address,
+	const McciBootloader_AppInfo_t *pAppInfo,
+	const McciBootloader_BlockHashHeader_t *pHeader,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	);
 
 
 /****************************************************************************\
@@ -50,7 +58,7 @@ Author:
 \****************************************************************************/
 
 uint8_t
-g_McciBootloader_imageBlock[4096];
+g_McciBootloader_imageBlock[MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE * MCCI_BOOTLOADER_IMAGE_BLOCK_COUNT];
 
 /*
 
@@ -71,14 +79,24 @@ Description:
 	scan through the image, calculating the SHA512, and finallly
 	check the signature on the hash.
 
+	If the image is followed by a block hash table, we check the
+	signature on the table instead, and then the hash of each block,
+	stopping at the first bad block.
+
+	The storage may instead hold an update package (see
+	McciBootloader_PackageHeader_t). In that case, the package
+	header is validated, and the hash and signature are checked
+	over the package rather than over an image.
+
 Returns:
 	true for success, false for failure.
 
-	If true, pIncomingAppInfo is set to the app info block read from the app.
+	If true, pIncomingAppInfo is set to the app info block read from the app
+	(or, for a package, the app info block of the image it will produce).
 
 Notes:
-	This is slow, so we try to update the LED state with a progress
-	indication.
+	This is slow, so we update the LED state with a progress
+	indication after each buffer (see McciBootloader_indicateProgress()).
 
 */
 
@@ -96,20 +114,48 @@ McciBootloader_checkStorageImage(
 		))
 		return false;
 
-	const McciBootloader_AppInfo_t * const pAppInfoIn =
-		McciBootloaderPlatform_getAppInfo(g_McciBootloader_imageBlock, sizeof(g_McciBootloader_imageBlock));
+	const McciBootloader_PackageHeader_t * const pPackageHeader =
+		(const void *)g_McciBootloader_imageBlock;
 
-	if (pAppInfoIn == NULL)
-		return false;
+	/* number of bytes ahead of the signature block */
+	uint32_t nSigned;
 
-	*pIncomingAppInfo = *pAppInfoIn;
+	if (pPackageHeader->magic == MCCI_BOOTLOADER_PACKAGE_MAGIC)
+		{
+		if (! McciBootloader_checkPackageHeader(pPackageHeader, pIncomingAppInfo))
+			return false;
 
-	uint32_t targetAddress = pIncomingAppInfo->targetAddress;
-	uint32_t targetSize = pIncomingAppInfo->imagesize + pIncomingAppInfo->authsize;
-	if (! McciBootloaderPlatform_checkImageValid(
-			g_McciBootloader_imageBlock, sizeof(g_McciBootloader_imageBlock), targetAddress, targetSize
-			))
-		return false;
+		if (pPackageHeader->payloadSize >
+		    UINT32_MAX - pPackageHeader->size - sizeof(McciBootloader_SignatureBlock_t))
+			return false;
+
+		nSigned = pPackageHeader->size + pPackageHeader->payloadSize;
+		}
+	else
+		{
+		const McciBootloader_AppInfo_t * const pAppInfoIn =
+			McciBootloaderPlatform_getAppInfo(g_McciBootloader_imageBlock, sizeof(g_McciBootloader_imageBlock));
+
+		if (pAppInfoIn == NULL)
+			return false;
+
+		*pIncomingAppInfo = *pAppInfoIn;
+
+		uint32_t targetAddress = pIncomingAppInfo->targetAddress;
+		uint32_t targetSize = pIncomingAppInfo->imagesize + pIncomingAppInfo->authsize;
+		if (! McciBootloaderPlatform_checkImageValid(
+				g_McciBootloader_imageBlock, sizeof(g_McciBootloader_imageBlock), targetAddress, targetSize
+				))
+			return false;
+
+		/* with a block hash table, we can check block by block */
+		McciBootloader_BlockHashHeader_t blockHashHeader;
+
+		if (McciBootloader_getBlockHashTable(address, pIncomingAppInfo, &blockHashHeader))
+			return checkStorageImageBlocks(address, pIncomingAppInfo, &blockHashHeader, pPublicKey);
+
+		nSigned = pIncomingAppInfo->imagesize;
+		}
 
 	mcci_tweetnacl_sha512_t imageHash;
 
@@ -119,7 +165,7 @@ McciBootloader_checkStorageImage(
 	McciBootloaderStorageAddress_t addressCurrent;
 	McciBootloaderStorageAddress_t const addressEnd = 
 		address +
-		pIncomingAppInfo->imagesize +
+		nSigned +
 		sizeof(mcci_tweetnacl_sign_publickey_t);
 
 	/* loop post condition: nThisTime is the result of the last hash */
@@ -160,6 +206,8 @@ McciBootloader_checkStorageImage(
 		uint32_t const nConsumed = nThisTime - nRemaining;
 		addressCurrent += nThisTime;
 		pRemaining = g_McciBootloader_imageBlock + nConsumed;
+
+		McciBootloader_indicateProgress(addressCurrent - address, addressEnd - address);
 		}
 
 	mcci_tweetnacl_hashblocks_sha512_finish(
@@ -171,62 +219,97 @@ McciBootloader_checkStorageImage(
 
 	// read the signature block
 	if (! McciBootloaderPlatform_storageRead(
-		address + pIncomingAppInfo->imagesize,
+		address + nSigned,
 		g_McciBootloader_imageBlock,
 		sizeof(McciBootloader_SignatureBlock_t)
 		))
 		return false;
 
-	const size_t nsig = sizeof(mcci_tweetnacl_sign_signature_t);
-	const size_t nsigned = sizeof(imageHash) + nsig;
-	size_t nActual;
-
 	// set up a pointer for convenience
 	const McciBootloader_SignatureBlock_t * const pSigBlock = (const void *)g_McciBootloader_imageBlock;
 
-	// append the imageHash
-	memcpy(
-		g_McciBootloader_imageBlock + sizeof(McciBootloader_SignatureBlock_t),
-		imageHash.bytes,
-		sizeof(imageHash.bytes)
+	// Make sure the key in the image matches ours. It should but still...
+	// This comes first, as the signature check reuses the block buffer.
+	bool const fKeyOk = mcci_tweetnacl_result_is_success(
+		mcci_tweetnacl_verify_32(
+			pPublicKey->bytes,
+			pSigBlock->publicKey.bytes
+			)
 		);
 
-	// the TweetNaCl crypto_sign_open requires that output buffer
-	// have an allocation size that's equal to nsigned. We can
-	// conveniently do this in the block buffer.
-	mcci_tweetnacl_sha512_t *pSignedHash =
-		(void *)((uint8_t *)pSigBlock->signature.bytes + nsigned);
-
-	// result = non-zero for failure or zero for success.
-	volatile mcci_tweetnacl_result_t result;
-
-	// check the signature, which will update signedHash.
-	result = mcci_tweetnacl_sign_open(
-			/* output */ pSignedHash->bytes,
-			&nActual,
-			pSigBlock->signature.bytes,
-			nsigned,
-			pPublicKey
-			);
+	// check the signature on the hash, using the block buffer as scratch.
+	bool const fSignatureOk = McciBootloader_checkSignature(
+		&pSigBlock->signature,
+		&imageHash,
+		pPublicKey,
+		g_McciBootloader_imageBlock,
+		sizeof(g_McciBootloader_imageBlock)
+		);
 
-	// constant time compares and checks.
-	// make sure the size is right.
-	result |= nActual ^ sizeof(pSignedHash->bytes);
+	// finally return the result.
+	return fKeyOk & fSignatureOk;
+	}
 
-	// make sure the hashes match
-	result |= mcci_tweetnacl_verify_64(
-			imageHash.bytes,
-			pSignedHash->bytes
-			);
+/* check an image that has a block hash table */
+static bool
+checkStorageImageBlocks(
+	McciBootloaderStorageAddress_t address,
+	const McciBootloader_AppInfo_t *pAppInfo,
+	const McciBootloader_BlockHashHeader_t *pHeader,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	)
+	{
+	uint32_t const imageSize = pAppInfo->imagesize + pAppInfo->authsize;
+	uint32_t const blockSize = MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE;
+	size_t const nTable = McciBootloader_blockHashTableSize(pHeader);
 
-	// Make sure the key in the image matches ours. It should but still...
-	result |= mcci_tweetnacl_verify_32(
-			pPublicKey->bytes,
-			pSigBlock->publicKey.bytes
-			);
+	/* read the table and check its signature */
+	if (! McciBootloaderPlatform_storageRead(
+		address + imageSize,
+		g_McciBootloader_imageBlock,
+		nTable
+		))
+		return false;
 
-	// finally return the result.
-	return mcci_tweetnacl_result_is_success(result);
+	if (! McciBootloader_checkBlockHashTable(
+		g_McciBootloader_imageBlock,
+		nTable,
+		pPublicKey,
+		g_McciBootloader_imageBlock,
+		sizeof(g_McciBootloader_imageBlock)
+		))
+		return false;
+
+	/*
+	|| then check the blocks, in order, stopping at the first bad one.
+	|| Read as many blocks as the buffer holds at a time.
+	*/
+	for (uint32_t iBlock = 0; iBlock < pHeader->nBlocks; )
+		{
+		uint32_t nThisTime = imageSize - iBlock * blockSize;
+
+		if (nThisTime > sizeof(g_McciBootloader_imageBlock))
+			nThisTime = sizeof(g_McciBootloader_imageBlock);
+
+		if (! McciBootloaderPlatform_storageRead(
+			address + iBlock * blockSize,
+			g_McciBootloader_imageBlock,
+			nThisTime
+			))
+			return false;
+
+		for (uint32_t offset = 0; offset < nThisTime; offset += blockSize, ++iBlock)
+			{
+			if (! McciBootloader_checkStorageBlock(
+				address, pAppInfo, iBlock, g_McciBootloader_imageBlock + offset
+				))
+				return false;
+			}
+
+		McciBootloader_indicateProgress(iBlock, pHeader->nBlocks);
+		}
+
+	return true;
 	}
 
 /**** end of mccibootloader_checkstorageimage.c ****/
@@ -0,0 +1,118 @@
+/*
+
+Module:	mccibootloader_getblockhashtable.c
+
+Function:
+	McciBootloader_getBlockHashTable()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_blockhash.h"
+#include "mcci_bootloader_platform.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_getBlockHashTable()
+
+Function:
+	Find the block hash table for an image in storage.
+
+Definition:
+	bool McciBootloader_getBlockHashTable(
+		McciBootloaderStorageAddress_t address,
+		const McciBootloader_AppInfo_t *pAppInfo,
+		McciBootloader_BlockHashHeader_t *pHeader // OUT
+		);
+
+Description:
+	The image at the given storage address is described by pAppInfo.
+	We read the header of the block hash table that follows the
+	image, if there is one, and check that it describes this image
+	and that the table will fit in the image block.
+
+	The table is not authenticated; use
+	McciBootloader_checkBlockHashTable() for that.
+
+Returns:
+	true if there's a table, in which case *pHeader is set to its
+	header; false otherwise.
+
+*/
+
+bool
+McciBootloader_getBlockHashTable(
+	McciBootloaderStorageAddress_t address,
+	const McciBootloader_AppInfo_t *pAppInfo,
+	McciBootloader_BlockHashHeader_t *pHeader
+	)
+	{
+	uint32_t const imageSize = pAppInfo->imagesize + pAppInfo->authsize;
+	uint32_t const blockSize = MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE;
+
+	if (! McciBootloaderPlatform_storageRead(
+		address + imageSize,
+		(uint8_t *)pHeader,
+		sizeof(*pHeader)
+		))
+		return false;
+
+	if (pHeader->magic != MCCI_BOOTLOADER_BLOCK_HASH_MAGIC)
+		return false;
+
+	if (pHeader->size != sizeof(*pHeader) || pHeader->reserved != 0)
+		return false;
+
+	/* blocks must be the size we read */
+	if (pHeader->log2BlockSize >= 32 ||
+	    (UINT32_C(1) << pHeader->log2BlockSize) != blockSize)
+		return false;
+
+	if (pHeader->imageSize != imageSize ||
+	    pHeader->nBlocks != (imageSize + blockSize - 1) / blockSize)
+		return false;
+
+	/* the whole table is checked in the image block */
+	if (McciBootloader_blockHashTableSize(pHeader) > sizeof(g_McciBootloader_imageBlock))
+		return false;
+
+	return true;
+	}
+
+/**** end of mccibootloader_getblockhashtable.c ****/
@@ -0,0 +1,136 @@
+/*
+
+Module:	mccibootloader_indicatestate.c
+
+Function:
+	McciBootloader_indicateState() and McciBootloader_indicateProgress()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_platform.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/// the state last passed to the annunciator
+static McciBootloaderState_t s_state;
+
+/*
+
+Name:	McciBootloader_indicateState()
+
+Function:
+	Tell the annunciator that we've started a new phase.
+
+Definition:
+	void McciBootloader_indicateState(
+		McciBootloaderState_t state
+		);
+
+Description:
+	The state (without progress) is remembered, so that
+	McciBootloader_indicateProgress() can add progress to it, and
+	is passed to the annunciator.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloader_indicateState(
+	McciBootloaderState_t state
+	)
+	{
+	s_state = state & MCCI_BOOTLOADER_STATE_PHASE;
+	McciBootloaderPlatform_annunciatorIndicateState(s_state);
+	}
+
+/*
+
+Name:	McciBootloader_indicateProgress()
+
+Function:
+	Tell the annunciator how far we are through the current phase.
+
+Definition:
+	void McciBootloader_indicateProgress(
+		uint32_t nDone,
+		uint32_t nTotal
+		);
+
+Description:
+	The percent complete is computed from nDone and nTotal, which
+	may be in any unit (typically bytes). The annunciator is only
+	called when the percentage changes, so this may be called for
+	every block. Nothing is reported before the first call to
+	McciBootloader_indicateState().
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloader_indicateProgress(
+	uint32_t nDone,
+	uint32_t nTotal
+	)
+	{
+	if (s_state == McciBootloaderState_Initial || nTotal == 0)
+		return;
+
+	if (nDone > nTotal)
+		nDone = nTotal;
+
+	/* scale down so that the multiply can't overflow */
+	while (nTotal > UINT32_MAX / 100)
+		{
+		nDone >>= 1;
+		nTotal >>= 1;
+		}
+
+	McciBootloaderState_t const state =
+		MCCI_BOOTLOADER_STATE_SET_PROGRESS(s_state, nDone * 100 / nTotal);
+
+	if (state != s_state)
+		{
+		s_state = state;
+		McciBootloaderPlatform_annunciatorIndicateState(state);
+		}
+	}
+
+/**** end of mccibootloader_indicatestate.c ****/
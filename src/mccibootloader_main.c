@@ -112,8 +112,8 @@ Implementation notes:
            SPI bus, etc.)  We also ask the driver to enable notifications
            as this is going to take a while.
         4. We read through the flash application image.
-           (Including hash and signature.) This involves reading 4k at a
-           time and doing the signature check.
+           (Including hash and signature.) This involves reading a buffer
+           at a time and doing the signature check.
         5. If the flash app image is not valid, and the application image
            is valid, we reset the update flag and launch the application.
         6. If the flash image is valid, we erase the flash, clear the update
@@ -122,7 +122,10 @@ Implementation notes:
         7. If the flash app image is not valid, and the application image is
            not valid, we repeat step 4 using the "safety app" image. If the
            "safety app" is valid, we repeat step 6 with the safety app. If
-           that fails, we fail with an indication (as at step 1).
+           that fails, we fail with an indication (as at step 1). If the
+           storage has a signed slot directory, we use it instead to
+           choose the newest good image, and usually only check that
+           one (see McciBootloader_selectStorageImage()).
 
         States we're trying to establish:
 
@@ -135,7 +138,27 @@ Implementation notes:
                                                           bring us up in some App NG state)
          (5)    OK      NG      -       OK      -       Load flash, clear flag & reevaluate
          (6)    OK      NG      -       NG      OK      Load fallback flash, clear flag & and reevaluate
-         (7)    OK      NG      -       NG      NG      Halt with indication
+         (7)    OK      NG      -       NG      NG      Wait for app on serial port;
+                                                         else halt with indication
+
+        In cases (5) and (6), if there's a slot directory, the newest
+        good slot it lists is loaded instead, whatever the state of the
+        flash and safe images.
+
+        If the bootloader is built with two app banks
+        (MCCI_BOOTLOADER_APP_BANKS), the app region is split in two, and
+        an update is written into the other bank by the app itself.
+        Before any of the above, McciBootloader_bootAppBank() launches
+        the selected bank, switching banks first if the update flag is
+        set and the other bank holds a good, signed app, or if the
+        selected bank is bad. Storage is only used if neither bank is
+        good; after loading, the banks are evaluated again.
+
+        If the platform has a serial port for recovery, in case (7) we
+        wait there for the host to send a signed app, instead of
+        halting (see McciBootloader_serialRecovery()). The platform can
+        also ask for this at reset, before any of the above, even if
+        the app is good.
 
 */
 
@@ -185,6 +208,21 @@ McciBootloader_main(void)
         const mcci_tweetnacl_sign_publickey_t * const pPublicKey =
                 &pBootloaderSigBlock->publicKey;
 
+        /* the annunciator is set up once, before the first state is shown */
+        bool fAnnunciatorReady = false;
+
+        /* if the platform asks for it, take an app over the serial port first */
+        if (McciBootloaderPlatform_getRecoveryRequest())
+                {
+                McciBootloaderPlatform_annunciatorInit();
+                fAnnunciatorReady = true;
+                McciBootloader_serialRecovery(pPublicKey, McciBootloaderError_OK);
+                }
+
+        /* with two app banks, updates are made in place: see if we can launch */
+        if (MCCI_BOOTLOADER_APP_BANKS > 1)
+                McciBootloader_bootAppBank(pPublicKey);
+
         /* next, we check the hash of the application */
         bool const appOk = McciBootloader_checkCodeValid(
                                 &gk_McciBootloader_AppBase,
@@ -203,17 +241,22 @@ McciBootloader_main(void)
 
         /* initialize the storage and annunciator drivers */
         McciBootloaderPlatform_storageInit();
-        McciBootloaderPlatform_annunciatorInit();
+        if (! fAnnunciatorReady)
+                McciBootloaderPlatform_annunciatorInit();
 
         /* start with the primary image */
         McciBootloaderStorageAddress_t const hPrimary = McciBootloaderPlatform_getPrimaryStorageAddress();
 
         /* check the app image */
         do      {
+                /* with no good app, recover it from the best image in storage, below */
+                if (! appOk)
+                        break;
+
                 /* because of power failures, don't clear the update-image flag just yet */
 
                 /* indicate that we're checking the storage */
-                McciBootloaderPlatform_annunciatorIndicateState(
+                McciBootloader_indicateState(
                         McciBootloaderState_CheckingPrimaryStorageHash
                         );
 
@@ -224,7 +267,7 @@ McciBootloader_main(void)
                                                 );
 
                 /* check for Case (3) */
-                if (appOk && !fImageOk)
+                if (! fImageOk)
                         {
                         /* case (3): "update" but update image failed tests */
                         /* consume the storage flag; don't check again until asked */
@@ -233,16 +276,7 @@ McciBootloader_main(void)
                         McciBootloaderPlatform_startApp(&gk_McciBootloader_AppBase);
                         }
 
-                /* check for case (4) */
-                if (appOk && fImageOk)
-                        /* go on */;
-                /* check for case (5) */
-                else if (! appOk && fImageOk)
-                        /* go on */;
-                else /* ! appOk && ! fImageOk */
-                        break;
-
-                /* case (4) or (5) */
+                /* case (4) */
                 McciBootloaderError_t programResult;
 
                 /* as soon as we've erased the app, we'll reset the storage flag inside the routine below */
@@ -252,7 +286,7 @@ McciBootloader_main(void)
                                         );
                 if (programResult == McciBootloaderError_OK)
                         {
-                        /* definitely (4) or (5): launch the application */
+                        /* definitely (4): launch the application */
                         McciBootloaderPlatform_setUpdateFlag(false);
                         McciBootloaderPlatform_startApp(&gk_McciBootloader_AppBase);
                         }
@@ -260,44 +294,30 @@ McciBootloader_main(void)
                         {
                         McciBootloaderPlatform_fail(programResult);
                         }
-
-                /* otherwise app is invalid so try the fallback image */
                 } while (0);
 
-        /* cases (6) through (9) */
+        /* cases (5) through (9) */
         do      {
-                McciBootloaderStorageAddress_t const hFallback = McciBootloaderPlatform_getFallbackStorageAddress();
                 McciBootloaderStorageAddress_t hStorage;
 
                 McciBootloaderError_t fImageOk;
 
                 fImageOk = McciBootloaderError_OK;
-                if (McciBootloader_checkStorageImage(
-                        hFallback,
-                        &g_McciBootloader_incomingAppInfo,
-                        pPublicKey
-                        )
-                    )
-                        {
-                        hStorage = hFallback;
-                        }
-                else if (McciBootloader_checkStorageImage(
-                        hPrimary,
-                        &g_McciBootloader_incomingAppInfo,
-                        pPublicKey
+
+                /* use the slot directory if there is one, else primary then fallback */
+                if (! McciBootloader_selectStorageImage(
+                        pPublicKey,
+                        &hStorage,
+                        &g_McciBootloader_incomingAppInfo
                         )
                     )
-                        {
-                        hStorage = hPrimary;
-                        }
-                else
                         {
                         fImageOk = McciBootloaderError_NoAppImage;
                         }
 
                 if (fImageOk == McciBootloaderError_OK)
                         {
-                        /* cases (6), (7), (8) */
+                        /* cases (5), (6), (7), (8) */
                         fImageOk = McciBootloader_programAndCheckFlash(
                                                 hStorage,
                                                 &g_McciBootloader_incomingAppInfo
@@ -305,9 +325,12 @@ McciBootloader_main(void)
 
                         if (fImageOk == McciBootloaderError_OK)
                                 {
-                                /* cases (6), (7), (8) */
+                                /* cases (5), (6), (7), (8) */
                                 /* consume the storage flag; don't check again until asked */
                                 McciBootloaderPlatform_setUpdateFlag(false);
+                                /* with two app banks, select the bank that was loaded */
+                                if (MCCI_BOOTLOADER_APP_BANKS > 1)
+                                        McciBootloader_bootAppBank(pPublicKey);
                                 McciBootloaderPlatform_startApp(&gk_McciBootloader_AppBase);
                                 }
                         }
@@ -315,6 +338,8 @@ McciBootloader_main(void)
                 /* case (9) */
                 /* consume the storage flag; don't check again until asked */
                 McciBootloaderPlatform_setUpdateFlag(false);
+                /* wait for an app over the serial port, if there is one */
+                McciBootloader_serialRecovery(pPublicKey, fImageOk);
                 McciBootloaderPlatform_fail(fImageOk);
                 } while (0);
         }
@@ -22,7 +22,11 @@ Author:
 #include "mcci_bootloader.h"
 
 #include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_blockhash.h"
+#include "mcci_bootloader_package.h"
 #include "mcci_bootloader_platform.h"
+
+#include <string.h>
 
 /****************************************************************************\
 |
@@ -66,8 +70,24 @@ Description:
 
 	1. Erase the current contents of internal flash
 	2. Read through the image one buffer at a time, programming
-	   the internal flash
-	3. Check the hash on the image
+	   the internal flash, except for the first half page
+	3. Read the first half page again, and program it
+	4. Check the hash on the image
+
+	The first half page holds the stack pointer, so until it's
+	programmed, the app isn't valid. If the power fails at any point
+	before that, the next boot finds no app, and starts over; it
+	never finds an app whose hash is programmed but whose signature
+	isn't. (The first half page isn't checked against the block
+	hash table when it's read again; the hash check at the end
+	covers it.)
+
+	If the image has a block hash table, each block is checked
+	against its hash before it's programmed, and we stop at the first
+	bad block.
+
+	If the storage holds an update package rather than an image,
+	the package is unpacked into flash instead.
 
 Returns:
 	McciBootloaderError_t_OK only if the image was programmed and
@@ -86,49 +106,131 @@ McciBootloader_programAndCheckFlash(
 	{
 	volatile const uint8_t * const targetAddress = (volatile const uint8_t *) pAppInfo->targetAddress;
 	size_t const overallSizeTight = pAppInfo->imagesize + pAppInfo->authsize;
-	const size_t blockSize = sizeof(g_McciBootloader_imageBlock);
-	size_t const overallSize = (overallSizeTight + blockSize - 1) & ~(blockSize - 1);
+	const size_t blockSize = MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE;
+	const size_t roundSize = MCCI_BOOTLOADER_IMAGE_ROUND_SIZE;
+	size_t const overallSize = (overallSizeTight + roundSize - 1) & ~(roundSize - 1);
+
+	/* packages are unpacked, not copied */
+	if (! McciBootloaderPlatform_storageRead(
+		storageAddress,
+		g_McciBootloader_imageBlock,
+		sizeof(McciBootloader_PackageHeader_t)
+		))
+		return McciBootloaderError_ReadFailed;
 
-	// erase in 4k chunks, to match program size.
+	if (((const McciBootloader_PackageHeader_t *)(const void *)g_McciBootloader_imageBlock)->magic ==
+	    MCCI_BOOTLOADER_PACKAGE_MAGIC)
+		{
+		/* the image block will be reused, so take a copy */
+		McciBootloader_PackageHeader_t header;
+
+		memcpy(&header, g_McciBootloader_imageBlock, sizeof(header));
+		McciBootloader_indicateState(McciBootloaderState_WritingApp);
+
+		if (header.type == McciBootloader_PackageType_Delta)
+			return McciBootloader_programDelta(storageAddress, &header);
+		else if (header.type == McciBootloader_PackageType_Compressed)
+			return McciBootloader_programCompressed(storageAddress, &header);
+		else
+			return McciBootloaderError_PackageNotValid;
+		}
+
+	// if there's a block hash table, check each block as it's read
+	McciBootloader_BlockHashHeader_t blockHashHeader;
+	bool const fBlockHashes =
+		McciBootloader_getBlockHashTable(storageAddress, pAppInfo, &blockHashHeader);
+
+	// erase up to the page that holds the last byte, to match program size.
+	McciBootloader_indicateState(McciBootloaderState_ErasingApp);
 	if (! McciBootloaderPlatform_systemFlashErase(
 		targetAddress, overallSize
 		))
 		return McciBootloaderError_EraseFailed;
 
-	// program in 4k chunks, up to the block that includes the
-	// last byte of the signature
+	// program a block at a time, up to the page that includes the
+	// last byte of the signature; read as many blocks as the buffer
+	// holds at a time.
 	McciBootloaderStorageAddress_t const addressEnd =
 		storageAddress + overallSize;
 
 	McciBootloaderStorageAddress_t addressCurrent;
 	volatile const uint8_t *targetCurrent;
 
+	McciBootloader_indicateState(McciBootloaderState_WritingApp);
+
 	for (addressCurrent = storageAddress, targetCurrent = targetAddress;
-	     addressCurrent < addressEnd;
-	     addressCurrent += blockSize, targetCurrent += blockSize)
+	     addressCurrent < addressEnd; )
 		{
-		/* read a block */
+		size_t nThisTime = addressEnd - addressCurrent;
+
+		if (nThisTime > sizeof(g_McciBootloader_imageBlock))
+			nThisTime = sizeof(g_McciBootloader_imageBlock);
+
+		/* read some blocks */
 		if (! McciBootloaderPlatform_storageRead(
 			addressCurrent,
 			g_McciBootloader_imageBlock,
-			blockSize
+			nThisTime
 			))
 			{
 			return McciBootloaderError_ReadFailed;
 			}
 
-		/* program this block */
-		if (! McciBootloaderPlatform_systemFlashWrite(
-			targetCurrent,
-			g_McciBootloader_imageBlock,
-			blockSize
-			))
+		for (const uint8_t *pBlock = g_McciBootloader_imageBlock;
+		     pBlock < g_McciBootloader_imageBlock + nThisTime;
+		     pBlock += blockSize, addressCurrent += blockSize, targetCurrent += blockSize)
 			{
-			return McciBootloaderError_FlashWriteFailed;
+			/* the last block may be short */
+			size_t nBlock = g_McciBootloader_imageBlock + nThisTime - pBlock;
+
+			if (nBlock > blockSize)
+				nBlock = blockSize;
+
+			/* stop at the first bad block */
+			if (fBlockHashes &&
+			    ! McciBootloader_checkStorageBlock(
+				storageAddress,
+				pAppInfo,
+				(addressCurrent - storageAddress) / blockSize,
+				pBlock
+				))
+				{
+				return McciBootloaderError_BlockHashMismatch;
+				}
+
+			/* program this block; the first half page waits until the end */
+			size_t const nSkip = targetCurrent == targetAddress ? MCCI_BOOTLOADER_PROGRAM_SIZE : 0;
+
+			if (! McciBootloaderPlatform_systemFlashWrite(
+				targetCurrent + nSkip,
+				pBlock + nSkip,
+				nBlock - nSkip
+				))
+				{
+				return McciBootloaderError_FlashWriteFailed;
+				}
 			}
+
+		McciBootloader_indicateProgress(addressCurrent - storageAddress, overallSize);
 		}
 
+	/* only now does the app become valid */
+	if (! McciBootloaderPlatform_storageRead(
+		storageAddress,
+		g_McciBootloader_imageBlock,
+		MCCI_BOOTLOADER_PROGRAM_SIZE
+		))
+		return McciBootloaderError_ReadFailed;
+
+	if (! McciBootloaderPlatform_systemFlashWrite(
+		targetAddress,
+		g_McciBootloader_imageBlock,
+		MCCI_BOOTLOADER_PROGRAM_SIZE
+		))
+		return McciBootloaderError_FlashWriteFailed;
+
 	/* finally, check the image */
+	McciBootloader_indicateState(McciBootloaderState_CheckingApp);
 	if (! McciBootloader_checkCodeValid(
 		(const void *)targetAddress, overallSizeTight
 		))
@@ -0,0 +1,293 @@
+/*
+
+Module:	mccibootloader_programcompressed.c
+
+Function:
+	McciBootloader_programCompressed()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_package.h"
+#include "mcci_bootloader_platform.h"
+
+#include <string.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+/// \brief the output side of the decompressor
+typedef struct McciBootloader_LzOutput_s
+	{
+	volatile const uint8_t	*pTarget;	///< where the image goes in flash
+	uint32_t		nWritten;	///< number of bytes flushed from buffer
+	uint32_t		nBuffer;	///< number of bytes in buffer
+	union	{
+		uint32_t	words[MCCI_BOOTLOADER_PROGRAM_SIZE / sizeof(uint32_t)];
+		uint8_t		bytes[MCCI_BOOTLOADER_PROGRAM_SIZE];
+		} buffer;			///< the next bytes to program
+	union	{
+		uint32_t	words[MCCI_BOOTLOADER_PROGRAM_SIZE / sizeof(uint32_t)];
+		uint8_t		bytes[MCCI_BOOTLOADER_PROGRAM_SIZE];
+		} first;			///< the first half page, programmed last
+	} McciBootloader_LzOutput_t;
+
+static bool
+lzOutput_flush(
+	McciBootloader_LzOutput_t *pOutput
+	);
+
+static bool
+lzStream_getCount(
+	McciBootloader_StorageStream_t *pStream,
+	uint32_t *pCount
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_programCompressed()
+
+Function:
+	Program internal flash from a compressed package.
+
+Definition:
+	McciBootloaderError_t McciBootloader_programCompressed(
+		McciBootloaderStorageAddress_t storageAddress,
+		const McciBootloader_PackageHeader_t *pHeader
+		);
+
+Description:
+	The package at storageAddress has already been checked by
+	McciBootloader_checkStorageImage(); pHeader points to a copy of
+	its header. We erase the space for the image, and then
+	decompress the payload half a page at a time, programming each
+	half page as it fills.
+
+	Matches refer to earlier output. That's already in flash, unless
+	it's in the half page we're building; so no window is kept in
+	RAM. The payload is read from storage through the image block.
+
+	The first half page is kept back, and programmed at the end, so
+	that the app isn't valid until all of it is in flash (see
+	McciBootloader_programAndCheckFlash()); matches that refer to it
+	are copied from RAM.
+
+	When all the output has been programmed, we check the hash of the
+	new image, and confirm that it's the image named by the package
+	header.
+
+Returns:
+	McciBootloaderError_t_OK only if the image was programmed and
+	the hash matches; otherwise a failure code.
+
+*/
+
+McciBootloaderError_t
+McciBootloader_programCompressed(
+	McciBootloaderStorageAddress_t storageAddress,
+	const McciBootloader_PackageHeader_t *pHeader
+	)
+	{
+	const McciBootloader_AppInfo_t * const pAppInfo = &pHeader->appInfo;
+	uint32_t const targetSize = pAppInfo->imagesize + pAppInfo->authsize;
+	uint32_t const windowSize = UINT32_C(1) << pHeader->log2WindowSize;
+	McciBootloader_StorageStream_t stream;
+	McciBootloader_LzOutput_t output;
+
+	output.pTarget = (volatile const uint8_t *)(uintptr_t) pAppInfo->targetAddress;
+	output.nWritten = 0;
+	output.nBuffer = 0;
+
+	McciBootloader_storageStreamInit(
+		&stream,
+		storageAddress + pHeader->size,
+		pHeader->payloadSize,
+		g_McciBootloader_imageBlock,
+		sizeof(g_McciBootloader_imageBlock)
+		);
+
+	if (! McciBootloaderPlatform_systemFlashErase(output.pTarget, targetSize))
+		return McciBootloaderError_EraseFailed;
+
+	for (;;)
+		{
+		uint8_t token;
+		uint32_t nLiteral;
+		uint32_t nMatch;
+
+		if (! McciBootloader_storageStreamRead(&stream, &token, 1))
+			return stream.error;
+
+		/* copy the literals */
+		nLiteral = token >> 4;
+		if (nLiteral == 15 && ! lzStream_getCount(&stream, &nLiteral))
+			return stream.error;
+
+		if (nLiteral > targetSize - (output.nWritten + output.nBuffer))
+			return McciBootloaderError_PackageNotValid;
+
+		while (nLiteral != 0)
+			{
+			uint32_t n = MCCI_BOOTLOADER_PROGRAM_SIZE - output.nBuffer;
+
+			if (n > nLiteral)
+				n = nLiteral;
+
+			if (! McciBootloader_storageStreamRead(
+				&stream, output.buffer.bytes + output.nBuffer, n
+				))
+				return stream.error;
+
+			output.nBuffer += n;
+			nLiteral -= n;
+
+			if (output.nBuffer == MCCI_BOOTLOADER_PROGRAM_SIZE &&
+			    ! lzOutput_flush(&output))
+				return McciBootloaderError_FlashWriteFailed;
+			}
+
+		/* the last sequence has no match */
+		if (output.nWritten + output.nBuffer == targetSize)
+			break;
+
+		/* copy the match */
+		uint8_t distanceBytes[2];
+
+		if (! McciBootloader_storageStreamRead(&stream, distanceBytes, sizeof(distanceBytes)))
+			return stream.error;
+
+		uint32_t const distance = distanceBytes[0] | ((uint32_t)distanceBytes[1] << 8);
+
+		nMatch = token & 0xF;
+		if (nMatch == 15 && ! lzStream_getCount(&stream, &nMatch))
+			return stream.error;
+
+		nMatch += MCCI_BOOTLOADER_LZ_MIN_MATCH;
+
+		if (distance == 0 || distance > windowSize ||
+		    distance > output.nWritten + output.nBuffer ||
+		    nMatch > targetSize - (output.nWritten + output.nBuffer))
+			return McciBootloaderError_PackageNotValid;
+
+		for (; nMatch != 0; --nMatch)
+			{
+			uint32_t const source = output.nWritten + output.nBuffer - distance;
+
+			/* earlier output is in flash, or in one of the buffers */
+			output.buffer.bytes[output.nBuffer++] =
+				source >= output.nWritten
+					? output.buffer.bytes[source - output.nWritten]
+				: source < MCCI_BOOTLOADER_PROGRAM_SIZE
+					? output.first.bytes[source]
+					: output.pTarget[source];
+
+			if (output.nBuffer == MCCI_BOOTLOADER_PROGRAM_SIZE &&
+			    ! lzOutput_flush(&output))
+				return McciBootloaderError_FlashWriteFailed;
+			}
+		}
+
+	/* program the final partial half page */
+	if (output.nBuffer != 0 && ! lzOutput_flush(&output))
+		return McciBootloaderError_FlashWriteFailed;
+
+	/* the payload must be used up exactly */
+	if (! McciBootloader_storageStreamIsEmpty(&stream))
+		return McciBootloaderError_PackageNotValid;
+
+	/* only now does the app become valid */
+	if (! McciBootloaderPlatform_systemFlashWrite(
+		output.pTarget,
+		output.first.words,
+		MCCI_BOOTLOADER_PROGRAM_SIZE
+		))
+		return McciBootloaderError_FlashWriteFailed;
+
+	/* finally, check the image, and make sure it's the one that was signed */
+	return McciBootloader_checkPackageResult(pHeader);
+	}
+
+/* program the buffer, padding with the erased value; keep the first one back */
+static bool
+lzOutput_flush(
+	McciBootloader_LzOutput_t *pOutput
+	)
+	{
+	memset(
+		pOutput->buffer.bytes + pOutput->nBuffer,
+		0,
+		MCCI_BOOTLOADER_PROGRAM_SIZE - pOutput->nBuffer
+		);
+
+	if (pOutput->nWritten == 0)
+		memcpy(pOutput->first.bytes, pOutput->buffer.bytes, MCCI_BOOTLOADER_PROGRAM_SIZE);
+	else if (! McciBootloaderPlatform_systemFlashWrite(
+		pOutput->pTarget + pOutput->nWritten,
+		pOutput->buffer.words,
+		MCCI_BOOTLOADER_PROGRAM_SIZE
+		))
+		return false;
+
+	pOutput->nWritten += pOutput->nBuffer;
+	pOutput->nBuffer = 0;
+	return true;
+	}
+
+/* add the extension bytes of a literal or match count */
+static bool
+lzStream_getCount(
+	McciBootloader_StorageStream_t *pStream,
+	uint32_t *pCount
+	)
+	{
+	uint8_t b;
+
+	do	{
+		if (! McciBootloader_storageStreamRead(pStream, &b, 1))
+			return false;
+
+		/* no count can exceed the app size, so this can't overflow */
+		if (*pCount > UINT32_C(0x1000000))
+			{
+			pStream->error = McciBootloaderError_PackageNotValid;
+			return false;
+			}
+
+		*pCount += b;
+		} while (b == 255);
+
+	return true;
+	}
+
+/**** end of mccibootloader_programcompressed.c ****/
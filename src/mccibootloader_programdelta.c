@@ -0,0 +1,308 @@
+/*
+
+Module:	mccibootloader_programdelta.c
+
+Function:
+	McciBootloader_programDelta()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_package.h"
+#include "mcci_bootloader_platform.h"
+
+#include <string.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+static bool
+deltaStream_getVarint(
+	McciBootloader_StorageStream_t *pStream,
+	uint32_t *pValue
+	);
+
+static bool
+programWindow(
+	volatile const uint8_t *pWindow,
+	uint32_t nBytes,
+	uint32_t *pFirst
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_programDelta()
+
+Function:
+	Program internal flash by applying a delta package to the app
+	in flash.
+
+Definition:
+	McciBootloaderError_t McciBootloader_programDelta(
+		McciBootloaderStorageAddress_t storageAddress,
+		const McciBootloader_PackageHeader_t *pHeader
+		);
+
+Description:
+	The package at storageAddress has already been checked by
+	McciBootloader_checkStorageImage(); pHeader points to a copy of
+	its header. We read the instruction stream from storage, building
+	the new image one window (one image block) at a time in
+	g_McciBootloader_imageBlock.
+	Each window is then erased and programmed in place. COPY
+	instructions read the base image directly from flash, so they may
+	only refer to windows that have not yet been programmed.
+
+	The first half page of the first window is kept back, and
+	programmed after all the windows, so that the app isn't valid
+	until all of it is in flash (see
+	McciBootloader_programAndCheckFlash()).
+
+	When all the windows have been programmed, we check the hash of
+	the new image, and confirm that it's the image named by the
+	(signed) package header.
+
+Returns:
+	McciBootloaderError_t_OK only if the image was programmed and
+	the hash matches; otherwise a failure code.
+
+Notes:
+	Once the first window is programmed, the base image is gone. If
+	we're interrupted, the app will not be valid at the next boot,
+	and the delta can't be applied again; so the bootloader will fall
+	back to the fallback image.
+
+*/
+
+McciBootloaderError_t
+McciBootloader_programDelta(
+	McciBootloaderStorageAddress_t storageAddress,
+	const McciBootloader_PackageHeader_t *pHeader
+	)
+	{
+	const McciBootloader_AppInfo_t * const pAppInfo = &pHeader->appInfo;
+	volatile const uint8_t * const targetAddress = (volatile const uint8_t *)(uintptr_t) pAppInfo->targetAddress;
+	uint32_t const targetSize = pAppInfo->imagesize + pAppInfo->authsize;
+	uint32_t const baseSize = pHeader->baseSize;
+	uint32_t const windowSize = MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE;
+	McciBootloader_StorageStream_t stream;
+	uint8_t streamBuffer[128];
+	uint32_t first[MCCI_BOOTLOADER_PROGRAM_SIZE / sizeof(uint32_t)];
+
+	/* the image block holds the window, so use a small buffer for the stream */
+	McciBootloader_storageStreamInit(
+		&stream,
+		storageAddress + pHeader->size,
+		pHeader->payloadSize,
+		streamBuffer,
+		sizeof(streamBuffer)
+		);
+
+	uint32_t windowBase = 0;
+	uint32_t nWindow = 0;
+	uint32_t sourceNext = 0;
+
+	while (windowBase + nWindow < targetSize)
+		{
+		uint32_t v;
+
+		if (! deltaStream_getVarint(&stream, &v))
+			return stream.error;
+
+		uint32_t const op = v & 3;
+		uint32_t nBytes = (v >> 2) + 1;
+		uint32_t source = 0;
+		uint8_t runByte = 0;
+
+		if (nBytes > targetSize - (windowBase + nWindow))
+			return McciBootloaderError_PackageNotValid;
+
+		if (op == McciBootloader_DeltaOp_Copy)
+			{
+			uint32_t offset;
+
+			if (! deltaStream_getVarint(&stream, &offset))
+				return stream.error;
+
+			/* undo the zig-zag encoding */
+			source = sourceNext + ((offset >> 1) ^ (0u - (offset & 1)));
+			if (source > baseSize || baseSize - source < nBytes)
+				return McciBootloaderError_PackageNotValid;
+
+			sourceNext = source + nBytes;
+			}
+		else if (op == McciBootloader_DeltaOp_Run)
+			{
+			if (! McciBootloader_storageStreamRead(&stream, &runByte, 1))
+				return stream.error;
+			}
+		else if (op != McciBootloader_DeltaOp_Add)
+			{
+			return McciBootloaderError_PackageNotValid;
+			}
+
+		while (nBytes != 0)
+			{
+			uint32_t n = windowSize - nWindow;
+			uint8_t * const pDest = g_McciBootloader_imageBlock + nWindow;
+
+			if (n > nBytes)
+				n = nBytes;
+
+			if (op == McciBootloader_DeltaOp_Copy)
+				{
+				/* windows before this one have been overwritten */
+				if (source < windowBase)
+					return McciBootloaderError_PackageNotValid;
+
+				memcpy(pDest, (const uint8_t *)targetAddress + source, n);
+				source += n;
+				}
+			else if (op == McciBootloader_DeltaOp_Run)
+				{
+				memset(pDest, runByte, n);
+				}
+			else
+				{
+				if (! McciBootloader_storageStreamRead(&stream, pDest, n))
+					return stream.error;
+				}
+
+			nWindow += n;
+			nBytes -= n;
+
+			if (nWindow == windowSize)
+				{
+				if (! programWindow(targetAddress + windowBase, windowSize, windowBase == 0 ? first : NULL))
+					return McciBootloaderError_FlashWriteFailed;
+
+				windowBase += windowSize;
+				nWindow = 0;
+				}
+			}
+		}
+
+	/* program the final partial window, up to the end of its last page */
+	if (nWindow != 0)
+		{
+		uint32_t const nRounded =
+			(nWindow + MCCI_BOOTLOADER_IMAGE_ROUND_SIZE - 1) &
+			~(MCCI_BOOTLOADER_IMAGE_ROUND_SIZE - 1);
+
+		memset(g_McciBootloader_imageBlock + nWindow, 0, nRounded - nWindow);
+		if (! programWindow(targetAddress + windowBase, nRounded, windowBase == 0 ? first : NULL))
+			return McciBootloaderError_FlashWriteFailed;
+		}
+
+	/* the instructions must use exactly the whole payload */
+	if (! McciBootloader_storageStreamIsEmpty(&stream))
+		return McciBootloaderError_PackageNotValid;
+
+	/* only now does the app become valid */
+	if (! McciBootloaderPlatform_systemFlashWrite(
+		targetAddress,
+		first,
+		MCCI_BOOTLOADER_PROGRAM_SIZE
+		))
+		return McciBootloaderError_FlashWriteFailed;
+
+	/* finally, check the image, and make sure it's the one that was signed */
+	return McciBootloader_checkPackageResult(pHeader);
+	}
+
+/*
+|| Erase (all or the start of) one window of flash and program it from the
+|| image block. If pFirst isn't NULL, the first half page is copied there
+|| instead of being programmed.
+*/
+static bool
+programWindow(
+	volatile const uint8_t *pWindow,
+	uint32_t nBytes,
+	uint32_t *pFirst
+	)
+	{
+	uint32_t nSkip = 0;
+
+	if (! McciBootloaderPlatform_systemFlashErase(
+		pWindow, nBytes
+		))
+		return false;
+
+	if (pFirst != NULL)
+		{
+		memcpy(pFirst, g_McciBootloader_imageBlock, MCCI_BOOTLOADER_PROGRAM_SIZE);
+		nSkip = MCCI_BOOTLOADER_PROGRAM_SIZE;
+		}
+
+	return McciBootloaderPlatform_systemFlashWrite(
+		pWindow + nSkip,
+		g_McciBootloader_imageBlock + nSkip,
+		nBytes - nSkip
+		);
+	}
+
+/* read an unsigned LEB128 value, which must fit in 32 bits */
+static bool
+deltaStream_getVarint(
+	McciBootloader_StorageStream_t *pStream,
+	uint32_t *pValue
+	)
+	{
+	uint32_t value = 0;
+	unsigned shift;
+
+	for (shift = 0; shift < 35; shift += 7)
+		{
+		uint8_t b;
+
+		if (! McciBootloader_storageStreamRead(pStream, &b, 1))
+			return false;
+
+		if (shift == 28 && (b & 0x70) != 0)
+			break;
+
+		value |= (uint32_t)(b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+			{
+			*pValue = value;
+			return true;
+			}
+		}
+
+	pStream->error = McciBootloaderError_PackageNotValid;
+	return false;
+	}
+
+/**** end of mccibootloader_programdelta.c ****/
@@ -0,0 +1,288 @@
+/*
+
+Module:	mccibootloader_selectstorageimage.c
+
+Function:
+	McciBootloader_selectStorageImage()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_directory.h"
+#include "mcci_bootloader_platform.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+/// \brief the slot index before the first one returned by getNextSlot()
+#define	SLOT_NONE	UINT32_MAX
+
+static bool
+getNextSlot(
+	McciBootloaderStorageAddress_t hDirectory,
+	const mcci_tweetnacl_sha512_t *pRoot,
+	McciBootloader_DirectoryEntry_t *pEntry,
+	uint32_t *piSlot
+	);
+
+static bool
+isBefore(
+	const McciBootloader_AppInfo_t *pA,
+	uint32_t iA,
+	const McciBootloader_AppInfo_t *pB,
+	uint32_t iB
+	);
+
+static bool
+checkSlotHash(
+	const McciBootloader_DirectoryEntry_t *pEntry
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_selectStorageImage()
+
+Function:
+	Find the best good image in storage, to recover the app.
+
+Definition:
+	bool McciBootloader_selectStorageImage(
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+		McciBootloaderStorageAddress_t *pAddress, // OUT
+		McciBootloader_AppInfo_t *pAppInfo // OUT
+		);
+
+Description:
+	If the storage has a good slot directory, we try its slots
+	newest first: highest version, then latest timestamp, then
+	first in the directory. A slot is skipped without reading it
+	if the hash in its signature block isn't the one in the
+	directory. Otherwise it's checked with
+	McciBootloader_checkStorageImage(), and must turn out to be the
+	version the directory says it is. Usually the first slot tried
+	is good, and it's the only image read.
+
+	If there's no directory, or none of its slots are good, we try
+	the primary image and then the fallback image, as before,
+	skipping either one that was already checked from the
+	directory.
+
+	The annunciator shows which of the primary and fallback regions
+	is being checked; any other slot shows as a fallback.
+
+Returns:
+	true if a good image was found, in which case *pAddress is set to
+	its storage address and *pAppInfo to its app info (see
+	McciBootloader_checkStorageImage()).
+
+*/
+
+bool
+McciBootloader_selectStorageImage(
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	McciBootloaderStorageAddress_t *pAddress,
+	McciBootloader_AppInfo_t *pAppInfo
+	)
+	{
+	McciBootloaderStorageAddress_t const hDirectory = McciBootloaderPlatform_getDirectoryStorageAddress();
+	McciBootloaderStorageAddress_t const hFallback = McciBootloaderPlatform_getFallbackStorageAddress();
+	McciBootloaderStorageAddress_t const hPrimary = McciBootloaderPlatform_getPrimaryStorageAddress();
+	bool fTriedFallback = false;
+	bool fTriedPrimary = false;
+	mcci_tweetnacl_sha512_t root;
+
+	if (McciBootloader_checkDirectory(hDirectory, pPublicKey, &root))
+		{
+		McciBootloader_DirectoryEntry_t entry;
+		uint32_t iSlot = SLOT_NONE;
+
+		while (getNextSlot(hDirectory, &root, &entry, &iSlot))
+			{
+			if (! checkSlotHash(&entry))
+				continue;
+
+			fTriedFallback |= entry.address == hFallback;
+			fTriedPrimary |= entry.address == hPrimary;
+
+			McciBootloader_indicateState(
+				entry.address == hPrimary
+					? McciBootloaderState_CheckingPrimaryStorageHash
+					: McciBootloaderState_CheckingFallbackStorageHash
+				);
+
+			if (McciBootloader_checkStorageImage(entry.address, pAppInfo, pPublicKey) &&
+			    pAppInfo->version == entry.appInfo.version &&
+			    pAppInfo->timestamp == entry.appInfo.timestamp)
+				{
+				*pAddress = entry.address;
+				return true;
+				}
+			}
+		}
+
+	/* no directory, or nothing in it was good: probe the usual places */
+	if (! fTriedPrimary)
+		{
+		McciBootloader_indicateState(McciBootloaderState_CheckingPrimaryStorageHash);
+
+		if (McciBootloader_checkStorageImage(hPrimary, pAppInfo, pPublicKey))
+			{
+			*pAddress = hPrimary;
+			return true;
+			}
+		}
+
+	if (! fTriedFallback)
+		{
+		McciBootloader_indicateState(McciBootloaderState_CheckingFallbackStorageHash);
+
+		if (McciBootloader_checkStorageImage(hFallback, pAppInfo, pPublicKey))
+			{
+			*pAddress = hFallback;
+			return true;
+			}
+		}
+
+	return false;
+	}
+
+/*
+|| Find the slot that comes next after *piSlot (described by *pEntry), or
+|| the first slot if *piSlot is SLOT_NONE. The directory has to be read
+|| again each time, as checking a slot overwrites the block buffer; its
+|| hash must still match the one whose signature was checked.
+*/
+static bool
+getNextSlot(
+	McciBootloaderStorageAddress_t hDirectory,
+	const mcci_tweetnacl_sha512_t *pRoot,
+	McciBootloader_DirectoryEntry_t *pEntry,
+	uint32_t *piSlot
+	)
+	{
+	size_t nDirectory;
+
+	if (! McciBootloader_readDirectory(hDirectory, &nDirectory))
+		return false;
+
+	mcci_tweetnacl_sha512_t hash;
+
+	mcci_tweetnacl_hash_sha512(
+		&hash,
+		g_McciBootloader_imageBlock,
+		nDirectory - sizeof(McciBootloader_SignatureBlock_t) + sizeof(mcci_tweetnacl_sign_publickey_t)
+		);
+
+	if (! mcci_tweetnacl_result_is_success(
+		mcci_tweetnacl_verify_64(hash.bytes, pRoot->bytes)
+		))
+		return false;
+
+	const McciBootloader_DirectoryHeader_t * const pHeader =
+		(const void *)g_McciBootloader_imageBlock;
+	const McciBootloader_DirectoryEntry_t * const pEntries =
+		(const void *)(g_McciBootloader_imageBlock + pHeader->size);
+	uint32_t const iPrevious = *piSlot;
+	const McciBootloader_DirectoryEntry_t *pBest = NULL;
+	uint32_t iBest = SLOT_NONE;
+
+	for (uint32_t iSlot = 0; iSlot < pHeader->nSlots; ++iSlot)
+		{
+		const McciBootloader_DirectoryEntry_t * const pThis = &pEntries[iSlot];
+
+		/* skip the slots that have been returned already */
+		if (iPrevious != SLOT_NONE &&
+		    ! isBefore(&pEntry->appInfo, iPrevious, &pThis->appInfo, iSlot))
+			continue;
+
+		if (pBest == NULL ||
+		    isBefore(&pThis->appInfo, iSlot, &pBest->appInfo, iBest))
+			{
+			pBest = pThis;
+			iBest = iSlot;
+			}
+		}
+
+	if (pBest == NULL)
+		return false;
+
+	*pEntry = *pBest;
+	*piSlot = iBest;
+	return true;
+	}
+
+/* true if slot iA (with app info pA) is to be tried before slot iB */
+static bool
+isBefore(
+	const McciBootloader_AppInfo_t *pA,
+	uint32_t iA,
+	const McciBootloader_AppInfo_t *pB,
+	uint32_t iB
+	)
+	{
+	if (pA->version != pB->version)
+		return pA->version > pB->version;
+
+	if (pA->timestamp != pB->timestamp)
+		return pA->timestamp > pB->timestamp;
+
+	return iA < iB;
+	}
+
+/* true if the slot still has the signature block hash in its entry */
+static bool
+checkSlotHash(
+	const McciBootloader_DirectoryEntry_t *pEntry
+	)
+	{
+	uint32_t const offset = pEntry->nSigned + sizeof(mcci_tweetnacl_sign_publickey_t);
+	mcci_tweetnacl_sha512_t hash;
+
+	if (pEntry->nSigned > UINT32_MAX - sizeof(McciBootloader_SignatureBlock_t) ||
+	    pEntry->address > UINT32_MAX - offset - sizeof(hash))
+		return false;
+
+	if (! McciBootloaderPlatform_storageRead(
+		pEntry->address + offset,
+		hash.bytes,
+		sizeof(hash.bytes)
+		))
+		return false;
+
+	return mcci_tweetnacl_result_is_success(
+		mcci_tweetnacl_verify_64(hash.bytes, pEntry->hash.bytes)
+		);
+	}
+
+/**** end of mccibootloader_selectstorageimage.c ****/
@@ -0,0 +1,519 @@
+/*
+
+Module:	mccibootloader_serialrecovery.c
+
+Function:
+	McciBootloader_serialRecovery()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_appinfo.h"
+#include "mcci_bootloader_platform.h"
+#include "mcci_bootloader_serial.h"
+#include "mcci_tweetnacl_hash.h"
+#include "mcci_tweetnacl_sign.h"
+
+#include <string.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+/// \brief the part of the image block lent to the serial driver, at the top
+#define	SERIAL_RING_SIZE	(sizeof(g_McciBootloader_imageBlock) / 4)
+
+/// \brief how long to wait for a Hello before checking again
+#define	SERIAL_HELLO_POLL_MS	1000u
+
+/// \brief how long the host may be silent during a session
+#define	SERIAL_SESSION_TIMEOUT_MS	2000u
+
+/// \brief the state of a session with the host
+typedef struct SerialSession_s
+	{
+	/// the frame being received; aligned for programming flash
+	uint32_t	frame[(MCCI_BOOTLOADER_SERIAL_FRAME_MAX + 3) / 4];
+	/// the first frame, which holds the vectors and app info; programmed last
+	uint32_t	first[MCCI_BOOTLOADER_SERIAL_DATA_MAX / 4];
+	size_t		nHave;		///< bytes of frame[] received so far
+	bool		fClosed;	///< the serial port has gone away
+	} SerialSession_t;
+
+static size_t
+receiveFrame(
+	SerialSession_t *pSession,
+	uint32_t timeoutMs
+	);
+
+static McciBootloaderError_t
+receiveImage(
+	SerialSession_t *pSession,
+	uint32_t nTotal,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	McciBootloader_AppInfo_t *pAppInfo
+	);
+
+static void
+sendFrame(
+	uint8_t type,
+	uint32_t offset,
+	const void *pPayload,
+	uint16_t nPayload
+	);
+
+static uint32_t
+crc32(
+	uint32_t crc,
+	const uint8_t *pBuffer,
+	size_t nBuffer
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+/* the CRC-32 (zlib, Ethernet) of each nibble */
+static const uint32_t sk_crc32Nibble[16] =
+	{
+	UINT32_C(0x00000000), UINT32_C(0x1DB71064), UINT32_C(0x3B6E20C8), UINT32_C(0x26D930AC),
+	UINT32_C(0x76DC4190), UINT32_C(0x6B6B51F4), UINT32_C(0x4DB26158), UINT32_C(0x5005713C),
+	UINT32_C(0xEDB88320), UINT32_C(0xF00F9344), UINT32_C(0xD6D6A3E8), UINT32_C(0xCB61B38C),
+	UINT32_C(0x9B64C2B0), UINT32_C(0x86D3D2D4), UINT32_C(0xA00AE278), UINT32_C(0xBDBDF21C),
+	};
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_serialRecovery()
+
+Function:
+	Receive a signed app image over the serial port, and launch it.
+
+Definition:
+	void McciBootloader_serialRecovery(
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+		McciBootloaderError_t reason
+		);
+
+Description:
+	Used when there's no good app to launch, or when the platform
+	reports that recovery was asked for at reset. We wait for the
+	host to start a session (see McciBootloader_SerialFrameHeader_t),
+	telling it \p reason, and then write the image to the app
+	region as it arrives, hashing it on the way.
+
+	The serial driver gets the top of the image block, so that
+	frames can keep arriving while flash is written; the rest is
+	scratch for the signature check.
+
+	The first frame holds the vectors and app info. It's checked
+	like the start of an image in storage, and the image must be
+	linked for the app region (or, with two app banks, for either
+	bank). Its pages are erased, so the old app is no longer valid,
+	but it's only programmed once the hash and signature of the
+	whole image have been checked. So a partial or badly signed
+	image is never launched, even after a reset.
+
+	If a session fails, we tell the host why, and wait for it to
+	try again.
+
+Returns:
+	Only if the platform has no serial port for recovery, or the
+	port goes away. Otherwise, launches the new app, and doesn't
+	return.
+
+*/
+
+void
+McciBootloader_serialRecovery(
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	McciBootloaderError_t reason
+	)
+	{
+	size_t nAhead = McciBootloaderPlatform_serialInit(
+		g_McciBootloader_imageBlock + sizeof(g_McciBootloader_imageBlock) - SERIAL_RING_SIZE,
+		SERIAL_RING_SIZE
+		);
+
+	if (nAhead == 0)
+		return;
+
+	McciBootloader_SerialReady_t ready;
+
+	/* the host may send as many whole frames ahead as the driver can hold */
+	nAhead /= MCCI_BOOTLOADER_SERIAL_FRAME_MAX;
+	if (nAhead == 0)
+		nAhead = 1;
+	else if (nAhead > UINT16_MAX)
+		nAhead = UINT16_MAX;
+
+	ready.window = (uint16_t)nAhead;
+	ready.dataMax = MCCI_BOOTLOADER_SERIAL_DATA_MAX;
+	ready.reason = (uint32_t)reason;
+
+	SerialSession_t session;
+
+	session.nHave = 0;
+	session.fClosed = false;
+
+	McciBootloader_indicateState(McciBootloaderState_WaitingForHost);
+
+	for (;;)
+		{
+		size_t const nFrame = receiveFrame(&session, SERIAL_HELLO_POLL_MS);
+
+		if (session.fClosed)
+			return;
+
+		const McciBootloader_SerialFrameHeader_t * const pHeader = (const void *)session.frame;
+
+		/* anything but a Hello is left over from an earlier session */
+		if (nFrame == 0 || pHeader->type != McciBootloader_SerialFrameType_Hello)
+			continue;
+
+		sendFrame(McciBootloader_SerialFrameType_Ready, pHeader->offset, &ready, sizeof(ready));
+
+		McciBootloader_AppInfo_t appInfo;
+		McciBootloaderError_t const result = receiveImage(
+			&session, pHeader->offset, pPublicKey, &appInfo
+			);
+
+		if (session.fClosed)
+			return;
+
+		sendFrame(McciBootloader_SerialFrameType_Result, (uint32_t)result, NULL, 0);
+
+		if (result == McciBootloaderError_OK)
+			{
+			/* consume the storage flag; the new app is what was asked for */
+			McciBootloaderPlatform_setUpdateFlag(false);
+
+			/* with two app banks, select the bank that was loaded */
+			if (MCCI_BOOTLOADER_APP_BANKS > 1)
+				McciBootloaderPlatform_setAppBank(
+					appInfo.targetAddress == (uintptr_t)&gk_McciBootloader_AppBank2Base
+					);
+
+			McciBootloaderPlatform_startApp((const void *)appInfo.targetAddress);
+			}
+
+		McciBootloader_indicateState(McciBootloaderState_WaitingForHost);
+		}
+	}
+
+/*
+|| Receive one good frame into pSession->frame, returning its size, or 0 if
+|| the host was silent for timeoutMs. We read only as much as the frame
+|| needs, so the next frame stays in the driver. Bytes that don't start
+|| a frame with a good CRC are dropped one at a time, to find the next sync.
+|| If that turns up a frame with bytes read past it, they're dropped too;
+|| the host sends them again, as for any lost frame.
+*/
+static size_t
+receiveFrame(
+	SerialSession_t *pSession,
+	uint32_t timeoutMs
+	)
+	{
+	uint8_t * const pFrame = (uint8_t *)pSession->frame;
+	const McciBootloader_SerialFrameHeader_t * const pHeader = (const void *)pFrame;
+
+	for (;;)
+		{
+		size_t nNeed = sizeof(*pHeader);
+
+		if (pSession->nHave >= sizeof(*pHeader))
+			{
+			if (pHeader->sync != MCCI_BOOTLOADER_SERIAL_SYNC ||
+			    pHeader->length > MCCI_BOOTLOADER_SERIAL_DATA_MAX)
+				nNeed = 0;
+			else
+				nNeed = sizeof(*pHeader) + pHeader->length + MCCI_BOOTLOADER_SERIAL_CRC_SIZE;
+			}
+
+		if (nNeed != 0 && pSession->nHave < nNeed)
+			{
+			size_t const nRead = McciBootloaderPlatform_serialRead(
+				pFrame + pSession->nHave,
+				nNeed - pSession->nHave,
+				timeoutMs
+				);
+
+			if (nRead == MCCI_BOOTLOADER_SERIAL_CLOSED)
+				{
+				pSession->fClosed = true;
+				return 0;
+				}
+
+			if (nRead == 0)
+				return 0;
+
+			pSession->nHave += nRead;
+
+			/* the sync byte must come first */
+			if (pFrame[0] != MCCI_BOOTLOADER_SERIAL_SYNC)
+				nNeed = 0;
+			else
+				continue;
+			}
+
+		if (nNeed != 0)
+			{
+			size_t const nCrc = nNeed - MCCI_BOOTLOADER_SERIAL_CRC_SIZE;
+			uint32_t crc;
+
+			memcpy(&crc, pFrame + nCrc, sizeof(crc));
+			if (crc == crc32(0, pFrame + 1, nCrc - 1))
+				{
+				pSession->nHave = 0;
+				return nNeed;
+				}
+			}
+
+		/* not a frame: drop the first byte, and look again */
+		pSession->nHave -= 1;
+		memmove(pFrame, pFrame + 1, pSession->nHave);
+		}
+	}
+
+/*
+|| Receive the nTotal bytes of an image into flash, as described for
+|| McciBootloader_serialRecovery(), and check it. On success, *pAppInfo is
+|| set to the image's app info.
+*/
+static McciBootloaderError_t
+receiveImage(
+	SerialSession_t *pSession,
+	uint32_t nTotal,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	McciBootloader_AppInfo_t *pAppInfo
+	)
+	{
+	const McciBootloader_SerialFrameHeader_t * const pHeader = (const void *)pSession->frame;
+	uint8_t * const pData = (uint8_t *)pSession->frame + sizeof(*pHeader);
+	size_t const roundSize = MCCI_BOOTLOADER_IMAGE_ROUND_SIZE;
+	mcci_tweetnacl_sha512_t imageHash;
+	uintptr_t targetAddress = 0;
+	size_t targetSize = 0;
+	uint32_t nHashed = 0;
+	size_t nFirst = 0;
+	uint32_t next = 0;
+	bool fNakSent = false;
+
+	if (nTotal == 0)
+		return McciBootloaderError_ImageNotValid;
+
+	mcci_tweetnacl_hashblocks_sha512_init(&imageHash);
+
+	while (next < nTotal)
+		{
+		size_t const nFrame = receiveFrame(pSession, SERIAL_SESSION_TIMEOUT_MS);
+
+		if (nFrame == 0)
+			return McciBootloaderError_HostTimeout;
+
+		/* a Hello means the host has started over */
+		if (pHeader->type == McciBootloader_SerialFrameType_Hello)
+			return McciBootloaderError_HostTimeout;
+		if (pHeader->type != McciBootloader_SerialFrameType_Data)
+			continue;
+
+		/* after a lost frame, ask for it once, and drop the rest until it comes */
+		if (pHeader->offset != next)
+			{
+			if (! fNakSent)
+				sendFrame(McciBootloader_SerialFrameType_Nak, next, NULL, 0);
+
+			fNakSent = true;
+			continue;
+			}
+
+		size_t const nData = pHeader->length;
+
+		if (nData == 0 || nData > nTotal - next ||
+		    (nData != MCCI_BOOTLOADER_SERIAL_DATA_MAX && nData != nTotal - next))
+			return McciBootloaderError_ImageNotValid;
+
+		if (next == 0)
+			{
+			/* the first frame must hold a good header for one of our app regions */
+			const McciBootloader_AppInfo_t *pAppInfoIn =
+				McciBootloaderPlatform_getAppInfo(pData, nData);
+
+			if (pAppInfoIn == NULL)
+				return McciBootloaderError_ImageNotValid;
+
+			targetAddress = pAppInfoIn->targetAddress;
+			if (targetAddress == (uintptr_t)&gk_McciBootloader_AppBase)
+				targetSize = McciBootloader_codeSize(
+					&gk_McciBootloader_AppBase,
+					MCCI_BOOTLOADER_APP_BANKS > 1 ? &gk_McciBootloader_AppBank2Base : &gk_McciBootloader_AppTop
+					);
+			else if (MCCI_BOOTLOADER_APP_BANKS > 1 &&
+				 targetAddress == (uintptr_t)&gk_McciBootloader_AppBank2Base)
+				targetSize = McciBootloader_codeSize(&gk_McciBootloader_AppBank2Base, &gk_McciBootloader_AppTop);
+			else
+				return McciBootloaderError_ImageNotValid;
+
+			pAppInfoIn = McciBootloaderPlatform_checkImageValid(pData, nData, targetAddress, targetSize);
+			if (pAppInfoIn == NULL ||
+			    pAppInfoIn->imagesize + pAppInfoIn->authsize != nTotal)
+				return McciBootloaderError_ImageNotValid;
+
+			*pAppInfo = *pAppInfoIn;
+			nHashed = pAppInfo->imagesize + sizeof(mcci_tweetnacl_sign_publickey_t);
+
+			memcpy(pSession->first, pData, nData);
+			nFirst = nData;
+
+			McciBootloader_indicateState(McciBootloaderState_ReceivingApp);
+			}
+
+		/* pad the last frame to whole pages */
+		size_t const nProgram = (nData + roundSize - 1) & ~(roundSize - 1);
+		volatile const uint8_t * const pTarget = (volatile const uint8_t *)(targetAddress + next);
+
+		memset(pData + nData, 0, nProgram - nData);
+
+		if (! McciBootloaderPlatform_systemFlashErase(pTarget, nProgram))
+			return McciBootloaderError_EraseFailed;
+
+		if (next != 0 &&
+		    ! McciBootloaderPlatform_systemFlashWrite(pTarget, pData, nProgram))
+			return McciBootloaderError_FlashWriteFailed;
+
+		/* hash up to, but not including, the hash */
+		if (next < nHashed)
+			{
+			if (nHashed - next > nData)
+				mcci_tweetnacl_hashblocks_sha512(&imageHash, pData, nData);
+			else
+				{
+				size_t const nLast = nHashed - next;
+				size_t const nRemaining = mcci_tweetnacl_hashblocks_sha512(&imageHash, pData, nLast);
+
+				mcci_tweetnacl_hashblocks_sha512_finish(
+					&imageHash, pData + nLast - nRemaining, nRemaining, nHashed
+					);
+				}
+			}
+
+		next += nData;
+		fNakSent = false;
+
+		McciBootloader_indicateProgress(next, nTotal);
+		sendFrame(McciBootloader_SerialFrameType_Ack, next, NULL, 0);
+		}
+
+	/* check the hash and signature, using the image block below the ring as scratch */
+	McciBootloader_indicateState(McciBootloaderState_CheckingApp);
+
+	const McciBootloader_SignatureBlock_t * const pSigBlock =
+		McciBootloaderPlatform_getSignatureBlock(pAppInfo);
+
+	volatile mcci_tweetnacl_result_t hashResult;
+	volatile mcci_tweetnacl_result_t keyResult;
+
+	hashResult = mcci_tweetnacl_verify_64(imageHash.bytes, pSigBlock->hash.bytes);
+	keyResult = mcci_tweetnacl_verify_32(pPublicKey->bytes, pSigBlock->publicKey.bytes);
+
+	bool const fSignatureOk = McciBootloader_checkSignature(
+		&pSigBlock->signature,
+		&imageHash,
+		pPublicKey,
+		g_McciBootloader_imageBlock,
+		sizeof(g_McciBootloader_imageBlock) - SERIAL_RING_SIZE
+		);
+
+	if (! (mcci_tweetnacl_result_is_success(hashResult) &
+	       mcci_tweetnacl_result_is_success(keyResult) &
+	       fSignatureOk))
+		return McciBootloaderError_SignatureNotValid;
+
+	/* only now does the app become valid */
+	if (! McciBootloaderPlatform_systemFlashWrite(
+		(volatile const void *)targetAddress,
+		pSession->first,
+		(nFirst + roundSize - 1) & ~(roundSize - 1)
+		))
+		return McciBootloaderError_FlashWriteFailed;
+
+	if (! McciBootloader_checkCodeValid((const void *)targetAddress, targetSize))
+		return McciBootloaderError_FlashVerifyFailed;
+
+	return McciBootloaderError_OK;
+	}
+
+/* send a frame to the host */
+static void
+sendFrame(
+	uint8_t type,
+	uint32_t offset,
+	const void *pPayload,
+	uint16_t nPayload
+	)
+	{
+	McciBootloader_SerialFrameHeader_t header;
+	uint32_t crc;
+
+	header.sync = MCCI_BOOTLOADER_SERIAL_SYNC;
+	header.type = type;
+	header.length = nPayload;
+	header.offset = offset;
+
+	crc = crc32(0, (const uint8_t *)&header + 1, sizeof(header) - 1);
+	crc = crc32(crc, pPayload, nPayload);
+
+	McciBootloaderPlatform_serialWrite((const uint8_t *)&header, sizeof(header));
+	if (nPayload != 0)
+		McciBootloaderPlatform_serialWrite(pPayload, nPayload);
+	McciBootloaderPlatform_serialWrite((const uint8_t *)&crc, sizeof(crc));
+	}
+
+/*
+|| Continue the CRC-32 crc (0 to start) over a buffer. We use a table of
+|| nibbles rather than bytes, to save flash.
+*/
+static uint32_t
+crc32(
+	uint32_t crc,
+	const uint8_t *pBuffer,
+	size_t nBuffer
+	)
+	{
+	crc = ~crc;
+
+	for (size_t i = 0; i < nBuffer; ++i)
+		{
+		crc ^= pBuffer[i];
+		crc = (crc >> 4) ^ sk_crc32Nibble[crc & 0xF];
+		crc = (crc >> 4) ^ sk_crc32Nibble[crc & 0xF];
+		}
+
+	return ~crc;
+	}
+
+/**** end of mccibootloader_serialrecovery.c ****/
@@ -0,0 +1,125 @@
+/*
+
+Module:	mccibootloader_stack.c
+
+Function:
+	McciBootloader_paintStack() and McciBootloader_getStackUsed()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_paintStack()
+
+Function:
+	Fill a stack area with MCCI_BOOTLOADER_STACK_PAINT.
+
+Definition:
+	void McciBootloader_paintStack(
+		void *pBase,
+		void *pTop
+		);
+
+Description:
+	The words from pBase (rounded up) to pTop (rounded down) are set
+	to MCCI_BOOTLOADER_STACK_PAINT, so that McciBootloader_getStackUsed()
+	can later find how far the stack grew. The caller must not be
+	using the area: when painting the stack that's in use, pTop must
+	be far enough below the stack pointer to leave room for this
+	function's frame.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloader_paintStack(
+	void *pBase,
+	void *pTop
+	)
+	{
+	uint32_t *p = (void *)(((uintptr_t)pBase + 3) & ~(uintptr_t)3);
+	uint32_t * const pEnd = (void *)((uintptr_t)pTop & ~(uintptr_t)3);
+
+	for (; p < pEnd; ++p)
+		*p = MCCI_BOOTLOADER_STACK_PAINT;
+	}
+
+/*
+
+Name:	McciBootloader_getStackUsed()
+
+Function:
+	Find how much of a painted stack area has been used.
+
+Definition:
+	size_t McciBootloader_getStackUsed(
+		const void *pBase,
+		const void *pTop
+		);
+
+Description:
+	The stack grows down from pTop. The area is scanned up from pBase
+	for the first word that isn't MCCI_BOOTLOADER_STACK_PAINT; everything
+	from there to pTop is counted as used. A word that happened to be
+	written with the paint value is counted as unused, so the result
+	may be low by a word or so.
+
+Returns:
+	The number of bytes used.
+
+*/
+
+size_t
+McciBootloader_getStackUsed(
+	const void *pBase,
+	const void *pTop
+	)
+	{
+	const uint32_t *p = (const void *)(((uintptr_t)pBase + 3) & ~(uintptr_t)3);
+	const uint32_t * const pEnd = (const void *)((uintptr_t)pTop & ~(uintptr_t)3);
+
+	while (p < pEnd && *p == MCCI_BOOTLOADER_STACK_PAINT)
+		++p;
+
+	return McciBootloader_codeSize(p, pTop);
+	}
+
+/**** end of mccibootloader_stack.c ****/
@@ -0,0 +1,170 @@
+/*
+
+Module:	mccibootloader_storagestream.c
+
+Function:
+	McciBootloader_storageStreamInit() and
+	McciBootloader_storageStreamRead()
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mcci_bootloader.h"
+
+#include "mcci_bootloader_package.h"
+#include "mcci_bootloader_platform.h"
+
+#include <string.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_storageStreamInit()
+
+Function:
+	Prepare to read a region of storage sequentially.
+
+Definition:
+	void McciBootloader_storageStreamInit(
+		McciBootloader_StorageStream_t *pStream,
+		McciBootloaderStorageAddress_t address,
+		uint32_t nBytes,
+		uint8_t *pBuffer,
+		uint32_t nBuffer
+		);
+
+Description:
+	The stream will return the nBytes bytes at the given storage
+	address, reading them nBuffer bytes at a time into pBuffer. A
+	bigger buffer means fewer storage transactions.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloader_storageStreamInit(
+	McciBootloader_StorageStream_t *pStream,
+	McciBootloaderStorageAddress_t address,
+	uint32_t nBytes,
+	uint8_t *pBuffer,
+	uint32_t nBuffer
+	)
+	{
+	pStream->address = address;
+	pStream->addressEnd = address + nBytes;
+	pStream->error = McciBootloaderError_OK;
+	pStream->pBuffer = pBuffer;
+	pStream->nBuffer = nBuffer;
+	pStream->iBuffer = 0;
+	pStream->nValid = 0;
+	}
+
+/*
+
+Name:	McciBootloader_storageStreamRead()
+
+Function:
+	Read the next bytes from a storage stream.
+
+Definition:
+	bool McciBootloader_storageStreamRead(
+		McciBootloader_StorageStream_t *pStream,
+		uint8_t *pBuffer,
+		uint32_t nBuffer
+		);
+
+Description:
+	The next nBuffer bytes of the stream are copied to pBuffer.
+
+Returns:
+	true for success. If there aren't enough bytes left in the
+	stream, or storage can't be read, the result is false, and
+	pStream->error is set to McciBootloaderError_PackageNotValid or
+	McciBootloaderError_ReadFailed, respectively.
+
+*/
+
+bool
+McciBootloader_storageStreamRead(
+	McciBootloader_StorageStream_t *pStream,
+	uint8_t *pBuffer,
+	uint32_t nBuffer
+	)
+	{
+	while (nBuffer != 0)
+		{
+		if (pStream->iBuffer == pStream->nValid)
+			{
+			uint32_t nRead = pStream->addressEnd - pStream->address;
+
+			if (nRead == 0)
+				{
+				pStream->error = McciBootloaderError_PackageNotValid;
+				return false;
+				}
+
+			if (nRead > pStream->nBuffer)
+				nRead = pStream->nBuffer;
+
+			if (! McciBootloaderPlatform_storageRead(
+				pStream->address, pStream->pBuffer, nRead
+				))
+				{
+				pStream->error = McciBootloaderError_ReadFailed;
+				return false;
+				}
+
+			pStream->address += nRead;
+			pStream->iBuffer = 0;
+			pStream->nValid = nRead;
+			}
+
+		uint32_t n = pStream->nValid - pStream->iBuffer;
+
+		if (n > nBuffer)
+			n = nBuffer;
+
+		memcpy(pBuffer, pStream->pBuffer + pStream->iBuffer, n);
+		pStream->iBuffer += n;
+		pBuffer += n;
+		nBuffer -= n;
+		}
+
+	return true;
+	}
+
+/**** end of mccibootloader_storagestream.c ****/
@@ -0,0 +1,157 @@
+/*
+
+Module:	mccibootloader_hostsim.h
+
+Function:
+	Host simulation of the bootloader platform.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mccibootloader_hostsim_h_
+#define _mccibootloader_hostsim_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include "mcci_bootloader.h"
+#include "mcci_bootloader_platform.h"
+
+#include <setjmp.h>
+
+MCCI_BOOTLOADER_BEGIN_DECLS
+
+/****************************************************************************\
+|
+|	The simulated memory map. This matches
+|	platform/board/mcci/catena_abz/mk/mccibootloader.ld, and the
+|	--defsym settings in the Makefile.
+|
+\****************************************************************************/
+
+#define	MCCI_BOOTLOADER_HOSTSIM_FLASH_BASE	UINT32_C(0x08000000)
+#define	MCCI_BOOTLOADER_HOSTSIM_FLASH_SIZE	(192u * 1024u)
+#define	MCCI_BOOTLOADER_HOSTSIM_BOOT_SIZE	(20u * 1024u)
+#define	MCCI_BOOTLOADER_HOSTSIM_APP_BASE	(MCCI_BOOTLOADER_HOSTSIM_FLASH_BASE + MCCI_BOOTLOADER_HOSTSIM_BOOT_SIZE)
+#define	MCCI_BOOTLOADER_HOSTSIM_APP_SIZE	(168u * 1024u)
+#define	MCCI_BOOTLOADER_HOSTSIM_APP_BANK2_BASE	(MCCI_BOOTLOADER_HOSTSIM_FLASH_BASE + MCCI_BOOTLOADER_HOSTSIM_FLASH_SIZE / 2)
+#define	MCCI_BOOTLOADER_HOSTSIM_PAGE_SIZE	128u
+#define	MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE	64u
+
+/// \brief the storage (SPI flash) size, and the regions within it
+#define	MCCI_BOOTLOADER_HOSTSIM_STORAGE_SIZE	(1024u * 1024u)
+#define	MCCI_BOOTLOADER_HOSTSIM_PRIMARY		(256u * 1024u)
+#define	MCCI_BOOTLOADER_HOSTSIM_FALLBACK	(64u * 1024u)
+#define	MCCI_BOOTLOADER_HOSTSIM_DIRECTORY	(60u * 1024u)
+
+/// \brief storage reads at least this long are done by DMA on the ABZ
+///	boards when they sleep while waiting; see
+///	mccibootloaderboard_catenaabz_spi.c.
+#define	MCCI_BOOTLOADER_HOSTSIM_SPI_DMA_MIN	16u
+
+/// \brief the size of each simulated stack. Host code needs far more
+///	stack than the device, so these are generous.
+#define	MCCI_BOOTLOADER_HOSTSIM_STACK_SIZE	(256u * 1024u)
+
+/****************************************************************************\
+|
+|	The simulation state
+|
+\****************************************************************************/
+
+/// \brief how a simulated boot ended
+enum McciBootloaderHostSim_Result_e
+	{
+	McciBootloaderHostSim_Result_Running = 0,	///< still running
+	McciBootloaderHostSim_Result_Launched,		///< the app was launched
+	McciBootloaderHostSim_Result_Failed,		///< McciBootloaderPlatform_fail() was called
+	McciBootloaderHostSim_Result_PowerLost,		///< the power was cut (see powerCutAfter)
+	};
+
+typedef uint32_t McciBootloaderHostSim_Result_t;
+
+/// \brief the operations after which the power can be cut
+enum McciBootloaderHostSim_PowerOp_e
+	{
+	McciBootloaderHostSim_PowerOp_None = 0,		///< none yet
+	McciBootloaderHostSim_PowerOp_Erase,		///< a flash page was erased
+	McciBootloaderHostSim_PowerOp_Program,		///< a flash half-page was programmed
+	McciBootloaderHostSim_PowerOp_Eeprom,		///< an EEPROM cell was written
+	};
+
+typedef uint32_t McciBootloaderHostSim_PowerOp_t;
+
+/// \brief everything the simulated platform knows
+typedef struct McciBootloaderHostSim_s
+	{
+	uint8_t				*pFlash;	///< the system flash, mapped at its real address
+	uint8_t				*pStorage;	///< the storage contents
+	size_t				nStorage;	///< size of storage, in bytes
+	bool				fUpdate;	///< the update flag
+	uint32_t			iAppBank;	///< the app bank selector
+	bool				fRecover;	///< the platform asks for serial recovery
+	int				serialFd;	///< the serial port (a pty master), or -1
+	uint32_t			serialIdleMs;	///< the port is closed after this long without input
+	uint64_t			serialLastMs;	///< when input last arrived
+	McciBootloaderHostSim_Result_t	result;		///< how the boot ended
+	McciBootloaderError_t		failureCode;	///< if result is Failed, the error
+	uint32_t			launchAddress;	///< if result is Launched, where the app was started
+	McciBootloaderState_t		state;		///< last annunciator state
+	uint32_t			nStates;	///< number of phases shown by the annunciator
+	uint32_t			nProgress;	///< number of progress updates shown
+	uint32_t			nAnnunciatorInits; ///< number of times the annunciator was set up since reset
+	uint32_t			nStatesEarly;	///< number of states shown before it was set up
+	uint32_t			nPagesErased;	///< number of flash pages erased
+	uint32_t			nBytesWritten;	///< number of flash bytes written
+	uint32_t			nEepromWrites;	///< number of EEPROM cells written
+	uint32_t			nPowerOps;	///< erases, half-page programs and EEPROM writes since reset
+	uint32_t			powerCutAfter;	///< cut the power when nPowerOps reaches this; 0 for never
+	McciBootloaderHostSim_PowerOp_t	lastPowerOp;	///< the last of those operations
+	uint32_t			nBytesRead;	///< number of storage bytes read
+	uint32_t			nStorageReads;	///< number of storage read transactions
+	uint32_t			nStorageWaits;	///< number of reads long enough to wait for
+	uint32_t			nStorageWaitBytes; ///< number of bytes in those reads
+	uint32_t			nDelays;	///< number of calls to delay
+	uint32_t			nDelayMs;	///< total ms of delay requested
+	uint32_t			nSerialBytesIn;	///< number of bytes received on the serial port
+	uint32_t			nSerialBytesOut; ///< number of bytes sent on the serial port
+	size_t				nSerialRing;	///< bytes lent to the serial driver
+	size_t				nStackUsed;	///< most host stack used by the boot, less the verifier
+	size_t				nScratch;	///< bytes of scratch lent to the verifier
+	size_t				nScratchUsed;	///< most host stack used by the verifier
+	uint32_t			nScratchCalls;	///< number of signature checks run on the scratch
+	jmp_buf				exit;		///< where fail and startApp go
+	} McciBootloaderHostSim_t;
+
+extern McciBootloaderHostSim_t g_McciBootloaderHostSim;
+
+/****************************************************************************\
+|
+|	APIs
+|
+\****************************************************************************/
+
+bool
+McciBootloaderHostSim_init(void);
+
+McciBootloaderHostSim_Result_t
+McciBootloaderHostSim_run(void);
+
+bool
+McciBootloaderHostSim_checkStorageImage(
+	McciBootloaderStorageAddress_t address
+	);
+
+MCCI_BOOTLOADER_END_DECLS
+
+#endif /* _mccibootloader_hostsim_h_ */
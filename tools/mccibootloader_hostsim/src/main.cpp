@@ -0,0 +1,1383 @@
+/*
+
+Module:	main.cpp
+
+Function:
+	Main app logic for mccibootloader_hostsim.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_hostsim.h"
+#include "mcci_bootloader_appinfo.h"
+#include "mccibootloader_fragment.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/personality.h>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace std;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+///
+/// \brief a rough model of the time an update takes on the device
+///
+/// \details The flash times are the typical page-erase and half-page
+///	programming times from the STM32L0 data sheets; the SPI time
+///	assumes an 8 MHz clock and a 4-byte command per read transaction.
+///	Hashing and signature checks are not included. EEPROM writes (the
+///	update flag and app bank) are only counted by `--power-cut-every`.
+///
+constexpr double kSpiMicrosPerByte = 1.0;
+constexpr double kSpiBytesPerRead = 4;
+constexpr double kEraseMillisPerPage = 3.2;
+constexpr double kProgramMillisPerHalfPage = 3.2;
+constexpr double kEepromMillisPerWrite = 3.2;
+
+///
+/// \brief the waits, for `--wait`
+///
+/// \details When the ABZ boards sleep while waiting, long SPI reads are
+///	done by DMA at the full 16 MHz SPI clock. Every wait for flash,
+///	SPI or a delay could be slept; SysTick also wakes the CPU once
+///	a millisecond. The CPU runs at 32 MHz.
+///
+constexpr double kSpiDmaMicrosPerByte = 0.5;
+constexpr double kCpuCyclesPerMicro = 32;
+
+/// \brief the application
+class App_t
+	{
+public:
+	int begin(int argc, char **argv);
+
+private:
+	void scanArgs(int argc, char **argv);
+	void usage(const string &message);
+	[[noreturn]] void fatal(const string &message);
+
+	std::vector<uint8_t> readFile(const string &name);
+	void writeFile(const string &name, const std::vector<uint8_t> &data);
+	void load(const string &name, uint8_t *pDest, size_t nDest);
+
+	int makeImage();
+	void writeElf(const string &name, const std::vector<uint8_t> &image, uint32_t holeStart);
+	int simulate();
+	int powerCut();
+	void openSerial();
+	void closeSerial();
+	int fuota();
+
+	string		progname;
+	bool		fVerbose = false;
+	bool		fMakeImage = false;
+
+	// simulation
+	string		bootname;
+	string		appname;
+	string		bank2name;	///< --bank2: the app in the second app bank
+	uint32_t	appBank = 1;	///< --app-bank: the bank selected, 1 or 2
+	string		primaryname;
+	string		fallbackname;
+	string		directoryname;
+	std::vector<std::pair<uint32_t, string>> slots;	///< --slot: other images in storage
+	string		expectname;
+	string		flashoutname;
+	bool		fUpdate = false;
+	bool		fSleep = true;
+	string		serialname;	///< --serial: where to put the serial port
+	bool		fRecover = false;	///< --recover: ask for serial recovery
+	uint32_t	serialIdleMs = 5000;	///< --serial-idle: close the port after this long
+	int		serialSlaveFd = -1;	///< our own handle on the serial port
+	uint32_t	powerCutEvery = 0;	///< --power-cut-every: cut after every nth operation
+
+	// image generation
+	string		outname;
+	uint32_t	address = MCCI_BOOTLOADER_HOSTSIM_APP_BASE;
+	uint32_t	size = 64 * 1024;
+	uint32_t	seed = 1;
+	uint32_t	nEdits = 0;
+	string		elfname;
+	uint32_t	elfHole = 0;
+
+	// fragment delivery
+	string		fuotaname;
+	double		lossPercent = 0;
+	uint32_t	nTrials = 100;
+	};
+
+const char * const kErrorNames[] =
+	{
+	"OK",
+	"BootloaderNotValid",
+	"ResetClockNotValid",
+	"NoAppImage",
+	"EraseFailed",
+	"ReadFailed",
+	"FlashWriteFailed",
+	"FlashVerifyFailed",
+	"FlashNotFound",
+	"FlashNotSupported",
+	"PackageNotValid",
+	"BlockHashMismatch",
+	"ImageNotValid",
+	"SignatureNotValid",
+	"HostTimeout",
+	};
+
+constexpr size_t kAuthSize = sizeof(McciBootloader_SignatureBlock_t);
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+int main(
+	int argc,
+	char **argv
+	)
+	{
+	// the simulated flash is mapped at a fixed address, and the kernel
+	// may put the (randomized) heap there. Where we're allowed to, run
+	// again without address randomization, so that it can't happen.
+	int const persona = personality(0xffffffff);
+
+	if (persona != -1 && (persona & ADDR_NO_RANDOMIZE) == 0 &&
+	    personality(persona | ADDR_NO_RANDOMIZE) != -1)
+		execv("/proc/self/exe", argv);
+
+	App_t app;
+
+	return app.begin(argc, argv);
+	}
+
+int App_t::begin(int argc, char **argv)
+	{
+	this->scanArgs(argc, argv);
+
+	if (this->fMakeImage)
+		return this->makeImage();
+	else if (this->fuotaname != "")
+		return this->fuota();
+	else
+		return this->simulate();
+	}
+
+void App_t::scanArgs(int argc, char **argv)
+	{
+	this->progname = argv[0];
+	auto const pSlash = this->progname.find_last_of('/');
+	if (pSlash != string::npos)
+		this->progname = this->progname.substr(pSlash + 1);
+
+	auto const getValue = [this, &argv](const string &arg) -> string
+		{
+		if (*argv == nullptr)
+			this->usage("missing value for " + arg);
+		return *argv++;
+		};
+
+	auto const getNumber = [getValue](const string &arg) -> uint32_t
+		{
+		return uint32_t(std::stoul(getValue(arg), nullptr, 0));
+		};
+
+	++argv;
+	std::vector<string> posArgs;
+
+	while (*argv != nullptr)
+		{
+		string const arg = *argv++;
+
+		if (arg == "-v" || arg == "--verbose")
+			this->fVerbose = true;
+		else if (arg == "--boot")
+			this->bootname = getValue(arg);
+		else if (arg == "--app")
+			this->appname = getValue(arg);
+		else if (arg == "--bank2")
+			this->bank2name = getValue(arg);
+		else if (arg == "--app-bank")
+			{
+			this->appBank = getNumber(arg);
+			if (this->appBank != 1 && this->appBank != 2)
+				this->usage("--app-bank must be 1 or 2");
+			}
+		else if (arg == "--primary")
+			this->primaryname = getValue(arg);
+		else if (arg == "--fallback")
+			this->fallbackname = getValue(arg);
+		else if (arg == "--directory")
+			this->directoryname = getValue(arg);
+		else if (arg == "--slot")
+			{
+			uint32_t const slotAddress = getNumber(arg);
+
+			this->slots.emplace_back(slotAddress, getValue(arg));
+			}
+		else if (arg == "--update")
+			this->fUpdate = true;
+		else if (arg == "--expect")
+			this->expectname = getValue(arg);
+		else if (arg == "--flash-output")
+			this->flashoutname = getValue(arg);
+		else if (arg == "--wait")
+			{
+			string const mode = getValue(arg);
+
+			if (mode == "sleep")
+				this->fSleep = true;
+			else if (mode == "spin")
+				this->fSleep = false;
+			else
+				this->usage("--wait must be sleep or spin");
+			}
+		else if (arg == "--serial")
+			this->serialname = getValue(arg);
+		else if (arg == "--recover")
+			this->fRecover = true;
+		else if (arg == "--serial-idle")
+			this->serialIdleMs = getNumber(arg);
+		else if (arg == "--power-cut-every")
+			{
+			this->powerCutEvery = getNumber(arg);
+			if (this->powerCutEvery == 0)
+				this->usage("--power-cut-every must be at least 1");
+			}
+		else if (arg == "--make-image")
+			this->fMakeImage = true;
+		else if (arg == "--address")
+			this->address = getNumber(arg);
+		else if (arg == "--size")
+			this->size = getNumber(arg);
+		else if (arg == "--seed")
+			this->seed = getNumber(arg);
+		else if (arg == "--edits")
+			this->nEdits = getNumber(arg);
+		else if (arg == "--elf")
+			this->elfname = getValue(arg);
+		else if (arg == "--elf-hole")
+			this->elfHole = getNumber(arg);
+		else if (arg == "--fuota")
+			this->fuotaname = getValue(arg);
+		else if (arg == "--loss")
+			this->lossPercent = std::stod(getValue(arg));
+		else if (arg == "--trials")
+			this->nTrials = getNumber(arg);
+		else if (arg.substr(0, 1) == "-")
+			this->usage("unknown arg: " + arg);
+		else
+			posArgs.push_back(arg);
+		}
+
+	if (this->fMakeImage)
+		{
+		if (posArgs.size() != 1)
+			this->usage("--make-image needs exactly one output file");
+		this->outname = posArgs[0];
+		}
+	else
+		{
+		if (posArgs.size() != 0)
+			this->usage("extra arguments");
+		if (this->bootname == "")
+			this->usage("--boot is required");
+		if (this->lossPercent < 0 || this->lossPercent > 100)
+			this->usage("--loss must be 0 to 100");
+		if (this->powerCutEvery != 0 && (this->serialname != "" || this->flashoutname != ""))
+			this->usage("--power-cut-every can't be used with --serial or --flash-output");
+		}
+	}
+
+void App_t::usage(const string &message)
+	{
+	string usage = message;
+	if (usage != "")
+		usage.append("\n");
+
+	usage.append("usage: ");
+	usage.append(this->progname);
+	usage.append(" --boot {file} --[app {file} bank2 {file} app-bank {1|2} primary {file} fallback {file} directory {file} slot {address} {file} update expect {file} flash-output {file} wait {sleep|spin} serial {link} serial-idle {ms} recover power-cut-every {n}] -[v]\n");
+	usage.append("   or: ");
+	usage.append(this->progname);
+	usage.append(" --make-image --[address {addr} size {bytes} seed {n} edits {n} elf {file} elf-hole {bytes}] {outfile}\n");
+	usage.append("   or: ");
+	usage.append(this->progname);
+	usage.append(" --boot {file} --fuota {fragfile} --[loss {percent} trials {n} seed {n} expect {file}] -[v]\n");
+	fprintf(stderr, "%s\n", usage.c_str());
+	exit(EXIT_FAILURE);
+	}
+
+void App_t::fatal(const string &message)
+	{
+	fprintf(stderr, "?%s: %s\n", this->progname.c_str(), message.c_str());
+	exit(EXIT_FAILURE);
+	}
+
+std::vector<uint8_t> App_t::readFile(const string &name)
+	{
+	std::ifstream infile { name, ios::binary };
+
+	if (! infile.is_open())
+		this->fatal("can't open: " + name);
+
+	return std::vector<uint8_t>(
+		std::istreambuf_iterator<char>(infile),
+		std::istreambuf_iterator<char>()
+		);
+	}
+
+void App_t::writeFile(const string &name, const std::vector<uint8_t> &data)
+	{
+	std::ofstream outfile { name, ios::binary | ios::trunc };
+
+	if (! outfile.is_open())
+		this->fatal("can't create: " + name);
+
+	outfile.write((const char *)data.data(), data.size());
+	outfile.close();
+	if (! outfile)
+		this->fatal("can't write: " + name);
+	}
+
+void App_t::load(const string &name, uint8_t *pDest, size_t nDest)
+	{
+	auto const data = this->readFile(name);
+
+	if (data.size() > nDest)
+		this->fatal("file too big for its region: " + name);
+
+	memcpy(pDest, data.data(), data.size());
+	}
+
+/*
+
+Name:	App_t::makeImage()
+
+Function:
+	Write a synthetic, unsigned app image.
+
+Definition:
+	int App_t::makeImage();
+
+Description:
+	We don't have a cross compiler here, so for testing we make
+	images that look enough like firmware to be interesting. The
+	image is a vector table and AppInfo, followed by "functions":
+	runs of 16-bit "instructions" drawn from a small vocabulary,
+	each ending with a literal pool of absolute addresses of other
+	functions. The result compresses and differences roughly the
+	way real code does.
+
+	--edits n changes the code of n functions, as a small source
+	change would. Functions change size, so everything after them
+	moves, and literal pools that refer to moved functions change.
+	Images with the same seed and different edit counts make good
+	base/target pairs for delta packages.
+
+	The output is ready for `mccibootloader_image --force-binary`:
+	the AppInfo is filled in, and space is left for the signature
+	block.
+
+	--elf names a file to get the same image as an ELF executable
+	(see writeElf()). With --elf-hole n, n bytes in the middle of the
+	image are left out of the ELF sections, as the linker does for
+	alignment; they are zero in both outputs.
+
+Returns:
+	EXIT_SUCCESS, or exits via fatal().
+
+*/
+
+int App_t::makeImage()
+	{
+	constexpr size_t kHeaderSize = 256;
+	constexpr size_t kAppInfoOffset = 0xC0;
+
+	if (this->size < kHeaderSize * 2 || (this->address & 0xFF) != 0)
+		this->fatal("image size or address is not valid");
+
+	std::mt19937 rng { this->seed };
+	std::vector<uint16_t> vocabulary(64);
+
+	for (auto &v : vocabulary)
+		v = uint16_t(rng());
+
+	// lay out the functions: lengths in 16-bit units, then the
+	// instruction seeds. An edit reseeds one function and changes
+	// its length.
+	struct Function_t
+		{
+		uint32_t	nInstructions;
+		uint32_t	nLiterals;
+		uint32_t	seed;
+		uint32_t	offset;
+		};
+	std::vector<Function_t> functions;
+
+	for (size_t n = kHeaderSize; n < this->size; )
+		{
+		Function_t f;
+
+		f.nInstructions = 16 + rng() % 240;
+		f.nLiterals = 1 + rng() % 4;
+		f.seed = rng();
+		f.offset = 0;
+		functions.push_back(f);
+		n += f.nInstructions * 2 + f.nLiterals * 4;
+		}
+
+	std::mt19937 editRng { this->seed ^ 0x5A5A5A5Au };
+
+	for (uint32_t i = 0; i < this->nEdits; ++i)
+		{
+		auto &f = functions[editRng() % functions.size()];
+
+		f.seed = editRng();
+		f.nInstructions = 16 + editRng() % 240;
+		}
+
+	uint32_t offset = kHeaderSize;
+
+	for (auto &f : functions)
+		{
+		f.offset = offset;
+		offset += f.nInstructions * 2 + f.nLiterals * 4;
+		}
+
+	uint32_t const imagesize = offset;
+	std::vector<uint8_t> image(imagesize + kAuthSize);
+
+	auto const put32 = [&image](size_t i, uint32_t v)
+		{
+		image[i + 0] = uint8_t(v >> 0);
+		image[i + 1] = uint8_t(v >> 8);
+		image[i + 2] = uint8_t(v >> 16);
+		image[i + 3] = uint8_t(v >> 24);
+		};
+
+	// the vectors: stack, then reset and the other handlers, all in
+	// the first function.
+	uint32_t const entry = this->address + functions[0].offset + 1;
+
+	put32(0, 0x20005000);
+	for (size_t i = 4; i < kAppInfoOffset; i += 4)
+		put32(i, entry);
+
+	// the AppInfo
+	put32(kAppInfoOffset + 0, MCCI_BOOTLOADER_APP_INFO_MAGIC);
+	put32(kAppInfoOffset + 4, sizeof(McciBootloader_AppInfo_t));
+	put32(kAppInfoOffset + 8, this->address);
+	put32(kAppInfoOffset + 12, imagesize);
+	put32(kAppInfoOffset + 16, kAuthSize);
+
+	// the functions
+	for (auto const &f : functions)
+		{
+		std::mt19937 frng { f.seed };
+		size_t i = f.offset;
+
+		for (uint32_t j = 0; j < f.nInstructions; ++j, i += 2)
+			{
+			auto const v = vocabulary[frng() % vocabulary.size()];
+
+			image[i + 0] = uint8_t(v);
+			image[i + 1] = uint8_t(v >> 8);
+			}
+
+		for (uint32_t j = 0; j < f.nLiterals; ++j, i += 4)
+			put32(i, this->address + functions[frng() % functions.size()].offset + 1);
+		}
+
+	// the hole is half-way through, clear of the header and the
+	// signature block.
+	uint32_t const holeStart = (imagesize / 2) & ~uint32_t(3);
+
+	if (this->elfHole > imagesize - holeStart)
+		this->fatal("--elf-hole is too big for the image");
+
+	std::fill(image.begin() + holeStart, image.begin() + holeStart + this->elfHole, 0);
+
+	this->writeFile(this->outname, image);
+
+	if (this->elfname != "")
+		this->writeElf(this->elfname, image, holeStart);
+
+	if (this->fVerbose)
+		std::cout << this->outname << ": " << functions.size() << " functions, "
+			  << imagesize << " bytes\n";
+
+	return EXIT_SUCCESS;
+	}
+
+/*
+
+Name:	App_t::writeElf()
+
+Function:
+	Write an image as an ARM ELF executable, with a hole.
+
+Definition:
+	void App_t::writeElf(
+		const string &name,
+		const std::vector<uint8_t> &image,
+		uint32_t holeStart
+		);
+
+Description:
+	The ELF file has the segments a linker makes for a Cortex-M
+	app: text from the start of the image to holeStart, with a
+	.bss-style tail covering the first half of the hole; read-only
+	data after the hole; and a writable RAM segment with nothing in
+	the file, which mccibootloader_image skips. The hole (this->elfHole
+	bytes) isn't in the file at all.
+
+Returns:
+	No explicit result; errors are fatal.
+
+*/
+
+void App_t::writeElf(
+	const string &name,
+	const std::vector<uint8_t> &image,
+	uint32_t holeStart
+	)
+	{
+	constexpr uint32_t kElfHeaderSize = 52;
+	constexpr uint32_t kProgramHeaderSize = 32;
+	constexpr uint32_t kDataOffset = 0x100;
+	constexpr uint32_t kFlagX = 1, kFlagW = 2, kFlagR = 4;
+
+	uint32_t const tail = this->elfHole / 2;
+	uint32_t const rodataStart = holeStart + this->elfHole;
+	uint32_t const rodataSize = uint32_t(image.size()) - rodataStart;
+	std::vector<uint8_t> elf(kDataOffset + holeStart + rodataSize);
+
+	auto const put16 = [&elf](size_t i, uint16_t v)
+		{
+		elf[i + 0] = uint8_t(v >> 0);
+		elf[i + 1] = uint8_t(v >> 8);
+		};
+	auto const put32 = [&elf](size_t i, uint32_t v)
+		{
+		elf[i + 0] = uint8_t(v >> 0);
+		elf[i + 1] = uint8_t(v >> 8);
+		elf[i + 2] = uint8_t(v >> 16);
+		elf[i + 3] = uint8_t(v >> 24);
+		};
+
+	// the ELF header: 32-bit, little-endian, executable, ARM
+	static const uint8_t ident[] = { 0x7F, 'E', 'L', 'F', 1, 1, 1 };
+
+	memcpy(&elf[0], ident, sizeof(ident));
+	put16(16, 2);
+	put16(18, 40);
+	put32(20, 1);
+	put32(24, this->address + 0x101);
+	put32(28, kElfHeaderSize);
+	put16(40, kElfHeaderSize);
+	put16(42, kProgramHeaderSize);
+	put16(44, 3);
+
+	// the program headers
+	auto const putSegment = [&](unsigned i, uint32_t offset, uint32_t address, uint32_t filesz, uint32_t memsz, uint32_t flags)
+		{
+		size_t const ph = kElfHeaderSize + i * kProgramHeaderSize;
+
+		put32(ph + 0, 1);		// PT_LOAD
+		put32(ph + 4, offset);
+		put32(ph + 8, address);
+		put32(ph + 12, address);
+		put32(ph + 16, filesz);
+		put32(ph + 20, memsz);
+		put32(ph + 24, flags);
+		put32(ph + 28, 4);
+		};
+
+	putSegment(0, kDataOffset, this->address, holeStart, holeStart + tail, kFlagR | kFlagX);
+	putSegment(1, kDataOffset + holeStart, this->address + rodataStart, rodataSize, rodataSize, kFlagR);
+	putSegment(2, uint32_t(elf.size()), 0x20000000, 0, 0x400, kFlagR | kFlagW);
+
+	// the data, without the hole
+	memcpy(&elf[kDataOffset], &image[0], holeStart);
+	memcpy(&elf[kDataOffset + holeStart], &image[rodataStart], rodataSize);
+
+	this->writeFile(name, elf);
+	}
+
+/*
+
+Name:	App_t::simulate()
+
+Function:
+	Boot the simulated device once.
+
+Definition:
+	int App_t::simulate();
+
+Description:
+	System flash and storage are loaded from the named files (the
+	second app bank, if any, at MCCI_BOOTLOADER_HOSTSIM_APP_BANK2_BASE,
+	the slot directory, if any, at MCCI_BOOTLOADER_HOSTSIM_DIRECTORY,
+	and each --slot at its address), and the bootloader is run from
+	reset. We print how the boot ended (and, with two app banks, the
+	bank selected afterwards), and optionally compare the app that
+	was launched with an expected image.
+
+	With --power-cut-every, the boot is instead run many times, with
+	the power cut at different points; see powerCut().
+
+Returns:
+	EXIT_SUCCESS if the app was launched (and matches the expected
+	image, if given); EXIT_FAILURE otherwise.
+
+*/
+
+int App_t::simulate()
+	{
+	auto * const pSim = &g_McciBootloaderHostSim;
+
+	if (! McciBootloaderHostSim_init())
+		this->fatal(string("can't map simulated flash: ") + std::strerror(errno));
+
+	std::vector<uint8_t> storage(MCCI_BOOTLOADER_HOSTSIM_STORAGE_SIZE, 0xFF);
+
+	pSim->pStorage = storage.data();
+	pSim->nStorage = storage.size();
+	pSim->fUpdate = this->fUpdate;
+	pSim->iAppBank = this->appBank - 1;
+	pSim->fRecover = this->fRecover;
+
+	if (this->serialname != "")
+		this->openSerial();
+
+	this->load(this->bootname, pSim->pFlash, MCCI_BOOTLOADER_HOSTSIM_BOOT_SIZE);
+
+	if (this->appname != "")
+		this->load(
+			this->appname,
+			pSim->pFlash + MCCI_BOOTLOADER_HOSTSIM_BOOT_SIZE,
+			MCCI_BOOTLOADER_HOSTSIM_APP_SIZE
+			);
+
+	// with one app bank, this is just part of the app region.
+	if (this->bank2name != "")
+		this->load(
+			this->bank2name,
+			pSim->pFlash + (MCCI_BOOTLOADER_HOSTSIM_APP_BANK2_BASE - MCCI_BOOTLOADER_HOSTSIM_FLASH_BASE),
+			MCCI_BOOTLOADER_HOSTSIM_APP_BASE + MCCI_BOOTLOADER_HOSTSIM_APP_SIZE - MCCI_BOOTLOADER_HOSTSIM_APP_BANK2_BASE
+			);
+
+	if (this->primaryname != "")
+		this->load(
+			this->primaryname,
+			&storage[MCCI_BOOTLOADER_HOSTSIM_PRIMARY],
+			storage.size() - MCCI_BOOTLOADER_HOSTSIM_PRIMARY
+			);
+
+	if (this->fallbackname != "")
+		this->load(
+			this->fallbackname,
+			&storage[MCCI_BOOTLOADER_HOSTSIM_FALLBACK],
+			MCCI_BOOTLOADER_HOSTSIM_PRIMARY - MCCI_BOOTLOADER_HOSTSIM_FALLBACK
+			);
+
+	if (this->directoryname != "")
+		this->load(
+			this->directoryname,
+			&storage[MCCI_BOOTLOADER_HOSTSIM_DIRECTORY],
+			MCCI_BOOTLOADER_HOSTSIM_FALLBACK - MCCI_BOOTLOADER_HOSTSIM_DIRECTORY
+			);
+
+	for (auto const &slot : this->slots)
+		{
+		if (slot.first >= storage.size())
+			this->fatal("slot address is outside the storage: " + slot.second);
+
+		this->load(slot.second, &storage[slot.first], storage.size() - slot.first);
+		}
+
+	if (this->powerCutEvery != 0)
+		return this->powerCut();
+
+	auto const tStart = std::chrono::steady_clock::now();
+	auto const result = McciBootloaderHostSim_run();
+	auto const tHost = std::chrono::steady_clock::now() - tStart;
+	int status = EXIT_SUCCESS;
+
+	this->closeSerial();
+
+	if (result == McciBootloaderHostSim_Result_Launched)
+		std::cout << "launched\n";
+	else
+		{
+		auto const code = pSim->failureCode;
+
+		std::cout << "failed: "
+			  << (code < sizeof(kErrorNames) / sizeof(kErrorNames[0]) ? kErrorNames[code] : "?")
+			  << " (" << code << ")\n";
+		status = EXIT_FAILURE;
+		}
+
+	if (MCCI_BOOTLOADER_APP_BANKS > 1)
+		{
+		std::cout << "app bank: " << pSim->iAppBank + 1;
+		if (result == McciBootloaderHostSim_Result_Launched)
+			std::cout << ", launched at 0x" << std::hex << std::setfill('0') << std::setw(8)
+				  << pSim->launchAddress << std::dec << std::setfill(' ');
+		std::cout << "\n";
+		}
+
+	if (this->fVerbose)
+		{
+		double const tSpi = (pSim->nBytesRead + kSpiBytesPerRead * pSim->nStorageReads) * kSpiMicrosPerByte / 1000.0;
+		double const tErase = pSim->nPagesErased * kEraseMillisPerPage;
+		double const tProgram = pSim->nBytesWritten / MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE * kProgramMillisPerHalfPage;
+
+		std::cout << "pages erased: " << pSim->nPagesErased
+			  << ", bytes written: " << pSim->nBytesWritten
+			  << ", storage bytes read: " << pSim->nBytesRead
+			  << " in " << pSim->nStorageReads << " reads"
+			  << ", update flag: " << (pSim->fUpdate ? "set" : "clear")
+			  << "\n";
+
+		std::cout << std::fixed << std::setprecision(1)
+			  << "estimated device time: " << tSpi + tErase + tProgram << " ms"
+			  << " (storage " << tSpi << " ms, erase " << tErase
+			  << " ms, program " << tProgram << " ms)"
+			  << "; host time: "
+			  << std::chrono::duration_cast<std::chrono::microseconds>(tHost).count() << " us"
+			  << "\n";
+
+		// each flash operation, long storage read and delay tick is a
+		// wait; spinning, that's time that could have been slept.
+		uint32_t const nHalfPages = pSim->nBytesWritten / MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE;
+		uint32_t const nDelayTicks = pSim->nDelayMs + pSim->nDelays;
+		double const tStorageWait = pSim->nStorageWaitBytes *
+			(this->fSleep ? kSpiDmaMicrosPerByte : kSpiMicrosPerByte) / 1000.0;
+		double const tWait = tErase + tProgram + tStorageWait + nDelayTicks;
+
+		std::cout << "waits: " << pSim->nPagesErased + nHalfPages + pSim->nStorageWaits + nDelayTicks
+			  << " (" << pSim->nPagesErased << " erase, " << nHalfPages << " program, "
+			  << pSim->nStorageWaits << " storage, " << nDelayTicks << " delay ticks); "
+			  << (this->fSleep ? "slept " : "spun ") << tWait << " ms ("
+			  << tWait * 1000.0 * kCpuCyclesPerMicro / 1e6 << " Mcycles)";
+		if (this->fSleep)
+			std::cout << ", about " << uint32_t(tWait) + pSim->nPagesErased + nHalfPages + pSim->nStorageWaits
+				  << " wakeups\n";
+		else
+			std::cout << " that could have been slept\n";
+
+		if (this->serialname != "")
+			std::cout << "serial: " << pSim->nSerialBytesIn << " bytes in, "
+				  << pSim->nSerialBytesOut << " bytes out, "
+				  << pSim->nSerialRing << " bytes of ring\n";
+
+		// progress rides on the annunciator's own timing; it costs no ticks.
+		std::cout << "annunciator: " << pSim->nStates << " states, "
+			  << pSim->nProgress << " progress updates";
+		if (McciBootloader_getStatePercent(pSim->state) >= 0)
+			std::cout << ", last " << McciBootloader_getStatePercent(pSim->state) << "%";
+		if (pSim->nStatesEarly != 0)
+			std::cout << ", " << pSim->nStatesEarly << " before annunciatorInit()";
+		if (pSim->nAnnunciatorInits > 1)
+			std::cout << ", set up " << pSim->nAnnunciatorInits << " times";
+		std::cout << "\n";
+
+		// host frames are bigger than the device's; compare, don't copy.
+		std::cout << "host stack used: boot " << pSim->nStackUsed << " bytes";
+		if (pSim->nScratch != 0)
+			std::cout << ", signature check " << pSim->nScratchUsed
+				  << " bytes (lent " << pSim->nScratch << " bytes of scratch, "
+				  << pSim->nScratchCalls << " checks)";
+		std::cout << "\n";
+		}
+
+	std::vector<uint8_t> const app(
+		pSim->pFlash + MCCI_BOOTLOADER_HOSTSIM_BOOT_SIZE,
+		pSim->pFlash + MCCI_BOOTLOADER_HOSTSIM_BOOT_SIZE + MCCI_BOOTLOADER_HOSTSIM_APP_SIZE
+		);
+
+	if (this->flashoutname != "")
+		this->writeFile(this->flashoutname, app);
+
+	if (this->expectname != "")
+		{
+		auto const expect = this->readFile(this->expectname);
+
+		// compare with the app that was launched, in whichever bank.
+		size_t const launchOffset =
+			result == McciBootloaderHostSim_Result_Launched
+				? pSim->launchAddress - MCCI_BOOTLOADER_HOSTSIM_APP_BASE
+				: 0;
+
+		if (launchOffset <= app.size() &&
+		    expect.size() <= app.size() - launchOffset &&
+		    std::equal(expect.begin(), expect.end(), app.begin() + launchOffset))
+			std::cout << "app matches " << this->expectname << "\n";
+		else
+			{
+			std::cout << "app does not match " << this->expectname << "\n";
+			status = EXIT_FAILURE;
+			}
+		}
+
+	return status;
+	}
+
+/*
+
+Name:	App_t::powerCut()
+
+Function:
+	Cut the power during a boot, at each point in turn, and check
+	that the device recovers.
+
+Definition:
+	int App_t::powerCut();
+
+Description:
+	Called by simulate() once flash and storage are loaded. We first
+	boot without a cut, to learn how the boot should end and how many
+	operations that survive a power failure -- page erases, half-page
+	programs and EEPROM writes -- it takes. Then, after every
+	this->powerCutEvery of those operations in turn, we put flash,
+	storage, the update flag and the app bank back as they were, boot
+	with the power cut after that operation, and boot again. The
+	second boot should launch the same app at the same address as the
+	boot without a cut, and leave the update flag and app bank the
+	same way. Two other endings are safe, and are counted separately:
+
+	- it launched the --fallback image. That's how an interrupted
+	  delta update ends, as the base image is gone.
+
+	- it launched the app it would have launched before, which this
+	  boot didn't change. With two app banks, that's how a bank switch
+	  ends if the power fails after the request is consumed.
+
+	Anything else is a failure.
+
+	For each cut, we work out what the recovery boot cost: pages
+	erased, half pages programmed, storage read, EEPROM cells written
+	and signature checks, with the device time estimated as for -v
+	(plus the EEPROM writes). With -v, each cut gets a line; failures
+	always do. A summary follows, by the kind of operation cut, so that
+	runs can be compared as the bootloader changes.
+
+Returns:
+	EXIT_SUCCESS if the boot without a cut launched an app (matching
+	--expect, if given) and no cut failed; EXIT_FAILURE otherwise.
+
+*/
+
+int App_t::powerCut()
+	{
+	auto * const pSim = &g_McciBootloaderHostSim;
+
+	/// \brief what a boot cost
+	struct Cost_t
+		{
+		uint32_t	nPagesErased;
+		uint32_t	nBytesWritten;
+		uint32_t	nBytesRead;
+		uint32_t	nStorageReads;
+		uint32_t	nEepromWrites;
+		uint32_t	nChecks;
+
+		double ms() const
+			{
+			return (this->nBytesRead + kSpiBytesPerRead * this->nStorageReads) * kSpiMicrosPerByte / 1000.0 +
+			       this->nPagesErased * kEraseMillisPerPage +
+			       this->nBytesWritten / MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE * kProgramMillisPerHalfPage +
+			       this->nEepromWrites * kEepromMillisPerWrite;
+			}
+		};
+
+	/// \brief how the boot after a cut ended
+	enum Outcome_t
+		{
+		kRecovered, kFellBack, kKeptOld, kFailed, kNumOutcomes
+		};
+
+	const char * const kOutcomeNames[] = { "recovered", "fell back", "kept old app", "failed" };
+
+	/// \brief the cuts after one kind of operation
+	struct Summary_t
+		{
+		uint32_t	nCuts = 0;
+		uint32_t	nOutcomes[kNumOutcomes] = {};
+		double		tTotal = 0;
+		double		tMax = 0;
+		uint32_t	iWorst = 0;
+		};
+
+	// indexed by McciBootloaderHostSim_PowerOp_t; [0] is for all of them.
+	const char * const kOpNames[] = { "all", "erase", "program", "EEPROM" };
+	Summary_t summary[4];
+
+	std::vector<uint8_t> const flash(pSim->pFlash, pSim->pFlash + MCCI_BOOTLOADER_HOSTSIM_FLASH_SIZE);
+	std::vector<uint8_t> const storage(pSim->pStorage, pSim->pStorage + pSim->nStorage);
+	bool const fUpdate = pSim->fUpdate;
+	uint32_t const iAppBank = pSim->iAppBank;
+	std::vector<uint8_t> fallback;
+
+	if (this->fallbackname != "")
+		fallback = this->readFile(this->fallbackname);
+
+	auto const restore = [&]()
+		{
+		std::copy(flash.begin(), flash.end(), pSim->pFlash);
+		std::copy(storage.begin(), storage.end(), pSim->pStorage);
+		pSim->fUpdate = fUpdate;
+		pSim->iAppBank = iAppBank;
+		};
+
+	auto const clearCounts = [pSim]()
+		{
+		pSim->nPagesErased = 0;
+		pSim->nBytesWritten = 0;
+		pSim->nBytesRead = 0;
+		pSim->nStorageReads = 0;
+		pSim->nStorageWaits = 0;
+		pSim->nStorageWaitBytes = 0;
+		pSim->nDelays = 0;
+		pSim->nDelayMs = 0;
+		pSim->nEepromWrites = 0;
+		pSim->nStates = 0;
+		pSim->nProgress = 0;
+		};
+
+	auto const getCost = [pSim]()
+		{
+		return Cost_t
+			{
+			pSim->nPagesErased,
+			pSim->nBytesWritten,
+			pSim->nBytesRead,
+			pSim->nStorageReads,
+			pSim->nEepromWrites,
+			pSim->nScratchCalls,
+			};
+		};
+
+	auto const failureName = [pSim]() -> string
+		{
+		auto const code = pSim->failureCode;
+
+		return string(code < sizeof(kErrorNames) / sizeof(kErrorNames[0]) ? kErrorNames[code] : "?") +
+			" (" + std::to_string(code) + ")";
+		};
+
+	// the app just launched, as far as its AppInfo says it goes.
+	auto const getLaunched = [pSim]()
+		{
+		size_t const offset = pSim->launchAddress - MCCI_BOOTLOADER_HOSTSIM_FLASH_BASE;
+		size_t size = MCCI_BOOTLOADER_HOSTSIM_FLASH_SIZE - offset;
+		const McciBootloader_AppInfo_t * const pAppInfo =
+			McciBootloaderPlatform_getAppInfo(pSim->pFlash + offset, size);
+
+		if (pAppInfo != nullptr && pAppInfo->imagesize + pAppInfo->authsize <= size)
+			size = pAppInfo->imagesize + pAppInfo->authsize;
+
+		return std::make_pair(offset, size);
+		};
+
+	// the boot without a cut
+	restore();
+	clearCounts();
+	pSim->powerCutAfter = 0;
+
+	if (McciBootloaderHostSim_run() != McciBootloaderHostSim_Result_Launched)
+		{
+		std::cout << "failed: " << failureName() << "\n";
+		return EXIT_FAILURE;
+		}
+
+	uint32_t const nOps = pSim->nPowerOps;
+	uint32_t const launchAddress = pSim->launchAddress;
+	bool const fUpdateAfter = pSim->fUpdate;
+	uint32_t const iAppBankAfter = pSim->iAppBank;
+	Cost_t const boot = getCost();
+	auto const launched = getLaunched();
+	std::vector<uint8_t> const app(
+		pSim->pFlash + launched.first,
+		pSim->pFlash + launched.first + launched.second
+		);
+
+	std::cout << std::fixed << std::setprecision(1)
+		  << "launched at 0x" << std::hex << std::setfill('0') << std::setw(8)
+		  << launchAddress << std::dec << std::setfill(' ')
+		  << " after " << nOps << " operations ("
+		  << boot.nPagesErased << " erase, "
+		  << boot.nBytesWritten / MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE << " program, "
+		  << boot.nEepromWrites << " EEPROM); estimated device time: "
+		  << boot.ms() << " ms\n";
+
+	if (this->expectname != "")
+		{
+		auto const expect = this->readFile(this->expectname);
+
+		if (expect.size() <= app.size() &&
+		    std::equal(expect.begin(), expect.end(), app.begin()))
+			std::cout << "app matches " << this->expectname << "\n";
+		else
+			{
+			std::cout << "app does not match " << this->expectname << "\n";
+			return EXIT_FAILURE;
+			}
+		}
+
+	// the cuts
+	for (uint32_t iCut = this->powerCutEvery; iCut <= nOps; iCut += this->powerCutEvery)
+		{
+		restore();
+		clearCounts();
+		pSim->powerCutAfter = iCut;
+
+		auto const cutResult = McciBootloaderHostSim_run();
+		auto const op = pSim->lastPowerOp;
+		Cost_t const lost = getCost();
+		Outcome_t outcome = kFailed;
+		string problem;
+
+		pSim->powerCutAfter = 0;
+		clearCounts();
+
+		// the boots are the same up to the cut, so this can't happen.
+		if (cutResult != McciBootloaderHostSim_Result_PowerLost)
+			problem = "boot ended before the cut";
+		else if (McciBootloaderHostSim_run() != McciBootloaderHostSim_Result_Launched)
+			problem = failureName();
+		else
+			{
+			auto const now = getLaunched();
+			const uint8_t * const pNow = pSim->pFlash + now.first;
+
+			if (pSim->launchAddress == launchAddress &&
+			    std::equal(app.begin(), app.end(), pSim->pFlash + launched.first))
+				{
+				if (pSim->fUpdate != fUpdateAfter)
+					problem = string("update flag left ") + (pSim->fUpdate ? "set" : "clear");
+				else if (pSim->iAppBank != iAppBankAfter)
+					problem = "app bank left at " + std::to_string(pSim->iAppBank + 1);
+				else
+					outcome = kRecovered;
+				}
+			else if (fallback.size() != 0 &&
+				 fallback.size() <= MCCI_BOOTLOADER_HOSTSIM_FLASH_SIZE - now.first &&
+				 std::equal(fallback.begin(), fallback.end(), pNow))
+				outcome = kFellBack;
+			else if (std::equal(pNow, pNow + now.second, flash.begin() + now.first))
+				outcome = kKeptOld;
+			else
+				problem = "launched another app";
+			}
+
+		Cost_t const recovery = getCost();
+		double const tRecovery = recovery.ms();
+
+		for (auto * const pSummary : { &summary[0], &summary[op] })
+			{
+			pSummary->nCuts += 1;
+			pSummary->nOutcomes[outcome] += 1;
+			pSummary->tTotal += tRecovery;
+			if (tRecovery > pSummary->tMax || pSummary->iWorst == 0)
+				{
+				pSummary->tMax = tRecovery;
+				pSummary->iWorst = iCut;
+				}
+			}
+
+		if (this->fVerbose || outcome == kFailed)
+			{
+			std::cout << "cut after operation " << iCut << " (" << kOpNames[op] << "): "
+				  << "lost " << lost.ms() << " ms; recovery "
+				  << recovery.nPagesErased << " erase, "
+				  << recovery.nBytesWritten / MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE << " program, "
+				  << recovery.nBytesRead << " bytes read, "
+				  << recovery.nEepromWrites << " EEPROM, "
+				  << recovery.nChecks << " checks, "
+				  << tRecovery << " ms; " << kOutcomeNames[outcome];
+			if (problem != "")
+				std::cout << ": " << problem;
+			std::cout << "\n";
+			}
+		}
+
+	for (size_t i = 0; i < sizeof(summary) / sizeof(summary[0]); ++i)
+		{
+		auto const &s = summary[i];
+
+		if (s.nCuts == 0)
+			continue;
+
+		std::cout << kOpNames[i] << ": " << s.nCuts << " cuts";
+		for (size_t j = 0; j < kNumOutcomes; ++j)
+			std::cout << ", " << s.nOutcomes[j] << " " << kOutcomeNames[j];
+		std::cout << "; recovery mean " << s.tTotal / s.nCuts << " ms, max " << s.tMax
+			  << " ms (cut after operation " << s.iWorst << ")\n";
+		}
+
+	if (summary[0].nCuts == 0)
+		std::cout << "nothing to cut\n";
+
+	return summary[0].nOutcomes[kFailed] == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+/*
+
+Name:	App_t::openSerial()
+
+Function:
+	Make the simulated serial port.
+
+Definition:
+	void App_t::openSerial();
+
+Description:
+	The port is a pseudo-terminal: the bootloader reads and writes
+	the master side, and this->serialname is made a symbolic link to
+	the slave side, for the host (`mccibootloader_image --send`) to
+	open. We keep the slave open ourselves, in raw mode, so that the
+	host can come and go.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::openSerial()
+	{
+	auto * const pSim = &g_McciBootloaderHostSim;
+	int const fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+	if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+		this->fatal("can't make a pseudo-terminal");
+
+	const char * const pSlaveName = ptsname(fd);
+	int const slaveFd = pSlaveName == nullptr ? -1 : open(pSlaveName, O_RDWR | O_NOCTTY);
+
+	if (slaveFd < 0)
+		this->fatal("can't open the pseudo-terminal");
+
+	struct termios tio;
+
+	if (tcgetattr(slaveFd, &tio) == 0)
+		{
+		cfmakeraw(&tio);
+		tcsetattr(slaveFd, TCSANOW, &tio);
+		}
+
+	unlink(this->serialname.c_str());
+	if (symlink(pSlaveName, this->serialname.c_str()) != 0)
+		this->fatal("can't make link: " + this->serialname);
+
+	pSim->serialFd = fd;
+	pSim->serialIdleMs = this->serialIdleMs;
+	this->serialSlaveFd = slaveFd;
+	}
+
+void App_t::closeSerial()
+	{
+	auto * const pSim = &g_McciBootloaderHostSim;
+
+	if (pSim->serialFd < 0)
+		return;
+
+	// closing the master discards what the host hasn't read yet, such
+	// as the Result after a launch; give it a second to read it. What
+	// we wrote last may not have reached the slave yet, so it must be
+	// empty twice in a row.
+	for (unsigned i = 0, nEmpty = 0; i < 100 && nEmpty < 2; ++i)
+		{
+		int nPending = 0;
+
+		if (ioctl(this->serialSlaveFd, FIONREAD, &nPending) != 0)
+			break;
+
+		nEmpty = nPending == 0 ? nEmpty + 1 : 0;
+		usleep(10 * 1000);
+		}
+
+	unlink(this->serialname.c_str());
+	close(this->serialSlaveFd);
+	close(pSim->serialFd);
+	pSim->serialFd = -1;
+	this->serialSlaveFd = -1;
+	}
+
+/*
+
+Name:	App_t::fuota()
+
+Function:
+	Simulate multicast delivery of a fragment file, with losses.
+
+Definition:
+	int App_t::fuota();
+
+Description:
+	The fragments written by `mccibootloader_image --fuota-output` are
+	sent in order, as a LoRaWAN multicast session would send them,
+	this->nTrials times. In each trial, each fragment is lost with
+	probability this->lossPercent, and the rest are given to the
+	reference decoder until it has rebuilt the image. The image is
+	then placed in the primary storage region, as the receiving app
+	would place it, and checked with McciBootloader_checkStorageImage()
+	using the public key of the bootloader from --boot. With --expect,
+	the image is also compared with the signed image.
+
+	Trials in which too many fragments were lost to rebuild the image
+	are counted, but are not errors.
+
+Returns:
+	EXIT_SUCCESS if every rebuilt image passed; EXIT_FAILURE otherwise.
+
+*/
+
+int App_t::fuota()
+	{
+	namespace Fragment = McciBootloader_Fragment;
+	auto * const pSim = &g_McciBootloaderHostSim;
+
+	if (! McciBootloaderHostSim_init())
+		this->fatal(string("can't map simulated flash: ") + std::strerror(errno));
+
+	this->load(this->bootname, pSim->pFlash, MCCI_BOOTLOADER_HOSTSIM_BOOT_SIZE);
+
+	auto const file = this->readFile(this->fuotaname);
+	Fragment::FileHeader_t header;
+
+	if (! header.get(file.data(), file.size()))
+		this->fatal("not a fragment file: " + this->fuotaname);
+
+	size_t const nSent = size_t(header.nFragments) + header.nParity;
+	size_t const recordSize = 2 + header.fragmentSize;
+
+	if (file.size() != Fragment::FileHeader_t::kSize + nSent * recordSize)
+		this->fatal("fragment file is the wrong size: " + this->fuotaname);
+
+	if (header.imageSize > MCCI_BOOTLOADER_HOSTSIM_STORAGE_SIZE - MCCI_BOOTLOADER_HOSTSIM_PRIMARY)
+		this->fatal("image is too big for the primary storage region");
+
+	std::vector<uint8_t> expect;
+	if (this->expectname != "")
+		expect = this->readFile(this->expectname);
+
+	std::vector<uint8_t> storage(MCCI_BOOTLOADER_HOSTSIM_STORAGE_SIZE);
+
+	pSim->pStorage = storage.data();
+	pSim->nStorage = storage.size();
+
+	uint32_t nRebuilt = 0;
+	uint32_t nPassed = 0;
+	uint32_t nMismatched = 0;
+	size_t nNeededTotal = 0;
+	size_t nNeededMax = 0;
+
+	for (uint32_t iTrial = 0; iTrial < this->nTrials; ++iTrial)
+		{
+		std::mt19937 rng { this->seed * 1000003u + iTrial };
+		std::bernoulli_distribution lost { this->lossPercent / 100.0 };
+		Fragment::Decoder_t decoder { header.nFragments, header.fragmentSize };
+		size_t iSent;
+
+		for (iSent = 0; iSent < nSent && ! decoder.isComplete(); ++iSent)
+			{
+			if (lost(rng))
+				continue;
+
+			const uint8_t * const pRecord = &file[Fragment::FileHeader_t::kSize + iSent * recordSize];
+
+			decoder.add(pRecord[0] | ((pRecord[1] & 0x3F) << 8), pRecord + 2);
+			}
+
+		if (! decoder.isComplete())
+			continue;
+
+		++nRebuilt;
+		nNeededTotal += decoder.nReceived();
+		nNeededMax = std::max(nNeededMax, decoder.nReceived());
+
+		auto image = decoder.image();
+		image.resize(header.imageSize);
+
+		std::fill(storage.begin(), storage.end(), 0xFF);
+		std::copy(image.begin(), image.end(), storage.begin() + MCCI_BOOTLOADER_HOSTSIM_PRIMARY);
+
+		bool const fPassed = McciBootloaderHostSim_checkStorageImage(MCCI_BOOTLOADER_HOSTSIM_PRIMARY);
+		bool const fMatched = this->expectname == "" || image == expect;
+
+		if (fPassed)
+			++nPassed;
+		if (! fMatched)
+			++nMismatched;
+
+		if (this->fVerbose)
+			std::cout << "trial " << iTrial << ": rebuilt from "
+				  << decoder.nReceived() << " of " << iSent << " fragments sent; "
+				  << (fPassed ? "passed" : "failed") << " storage check"
+				  << (fMatched ? "" : "; image does not match") << "\n";
+		}
+
+	std::cout << std::fixed << std::setprecision(1)
+		  << "loss " << this->lossPercent << "%: rebuilt " << nRebuilt
+		  << " of " << this->nTrials << " trial(s) from "
+		  << header.nFragments << " + " << header.nParity << " fragment(s)";
+	if (nRebuilt != 0)
+		std::cout << "; fragments needed: mean "
+			  << double(nNeededTotal) / nRebuilt << ", max " << nNeededMax;
+	std::cout << "; storage check: " << nPassed << " passed, "
+		  << nRebuilt - nPassed << " failed";
+	if (this->expectname != "")
+		std::cout << "; " << nMismatched << " mismatched";
+	std::cout << "\n";
+
+	return (nPassed == nRebuilt && nMismatched == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+/**** end of main.cpp ****/
@@ -0,0 +1,824 @@
+/*
+
+Module:	platform.c
+
+Function:
+	The simulated platform: gk_McciBootloaderPlatformInterface and
+	friends, for running the bootloader on a Linux host.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_hostsim.h"
+#include "mcci_bootloader_appinfo.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+static McciBootloaderPlatform_SystemInitFn_t hostsim_systemInit;
+static McciBootloaderPlatform_PrepareForLaunchFn_t hostsim_prepareForLaunch;
+static McciBootloaderPlatform_FailFn_t hostsim_fail;
+static McciBootloaderPlatform_DelayMsFn_t hostsim_delayMs;
+static McciBootloaderPlatform_GetUpdateFlagFn_t hostsim_getUpdate;
+static McciBootloaderPlatform_SetUpdateFlagFn_t hostsim_setUpdate;
+static McciBootloaderPlatform_GetAppBankFn_t hostsim_getAppBank;
+static McciBootloaderPlatform_SetAppBankFn_t hostsim_setAppBank;
+static McciBootloaderPlatform_SystemFlashEraseFn_t hostsim_systemFlashErase;
+static McciBootloaderPlatform_SystemFlashWriteFn_t hostsim_systemFlashWrite;
+static McciBootloaderPlatform_StorageInitFn_t hostsim_storageInit;
+static McciBootloaderPlatform_StorageReadFn_t hostsim_storageRead;
+static McciBootloaderPlatform_GetPrimaryStorageAddressFn_t hostsim_getPrimaryStorageAddress;
+static McciBootloaderPlatform_GetFallbackStorageAddressFn_t hostsim_getFallbackStorageAddress;
+static McciBootloaderPlatform_GetDirectoryStorageAddressFn_t hostsim_getDirectoryStorageAddress;
+static McciBootloaderPlatform_SpiInitFn_t hostsim_spiInit;
+static McciBootloaderPlatform_SpiTransferFn_t hostsim_spiTransfer;
+static McciBootloaderPlatform_SerialInitFn_t hostsim_serialInit;
+static McciBootloaderPlatform_SerialReadFn_t hostsim_serialRead;
+static McciBootloaderPlatform_SerialWriteFn_t hostsim_serialWrite;
+static McciBootloaderPlatform_GetRecoveryRequestFn_t hostsim_getRecoveryRequest;
+static McciBootloaderPlatform_AnnunciatorInitFn_t hostsim_annunciatorInit;
+static McciBootloaderPlatform_AnnunciatorIndicateStateFn_t hostsim_annunciatorIndicateState;
+
+static bool
+hostsim_isFlashRange(
+	uintptr_t address,
+	size_t nBytes
+	);
+
+static size_t
+hostsim_runOnStack(
+	McciBootloaderPlatform_StackFn_t *pFn,
+	void *pArg,
+	uint8_t *pStack,
+	size_t nStack
+	);
+
+static McciBootloaderPlatform_StackFn_t hostsim_boot;
+
+static uint64_t
+hostsim_getMs(void);
+
+static void
+hostsim_powerOp(
+	McciBootloaderHostSim_PowerOp_t op
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+const McciBootloaderPlatform_Interface_t
+gk_McciBootloaderPlatformInterface =
+	{
+	.pSystemInit = hostsim_systemInit,
+	.pPrepareForLaunch = hostsim_prepareForLaunch,
+	.pFail = hostsim_fail,
+	.pDelayMs = hostsim_delayMs,
+	.pGetUpdate = hostsim_getUpdate,
+	.pSetUpdate = hostsim_setUpdate,
+	.pGetAppBank = hostsim_getAppBank,
+	.pSetAppBank = hostsim_setAppBank,
+	.pSystemFlashErase = hostsim_systemFlashErase,
+	.pSystemFlashWrite = hostsim_systemFlashWrite,
+	.Storage =
+		{
+		.pInit = hostsim_storageInit,
+		.pRead = hostsim_storageRead,
+		.pGetPrimaryAddress = hostsim_getPrimaryStorageAddress,
+		.pGetFallbackAddress = hostsim_getFallbackStorageAddress,
+		.pGetDirectoryAddress = hostsim_getDirectoryStorageAddress,
+		},
+	.Spi =
+		{
+		.pInit = hostsim_spiInit,
+		.pTransfer = hostsim_spiTransfer,
+		},
+	.Serial =
+		{
+		.pInit = hostsim_serialInit,
+		.pRead = hostsim_serialRead,
+		.pWrite = hostsim_serialWrite,
+		.pGetRecoveryRequest = hostsim_getRecoveryRequest,
+		},
+	.Annunciator =
+		{
+		.pInit = hostsim_annunciatorInit,
+		.pIndicateState = hostsim_annunciatorIndicateState,
+		},
+	};
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+McciBootloaderHostSim_t g_McciBootloaderHostSim;
+
+/// \brief the stack for the boot
+static uint8_t s_bootStack[MCCI_BOOTLOADER_HOSTSIM_STACK_SIZE] __attribute__((__aligned__(16)));
+
+/// \brief the stack for McciBootloaderPlatform_callOnStack()
+static uint8_t s_scratchStack[MCCI_BOOTLOADER_HOSTSIM_STACK_SIZE] __attribute__((__aligned__(16)));
+
+/// \brief the function for hostsim_runOnStack() to call, and its argument
+static McciBootloaderPlatform_StackFn_t *s_pStackFn;
+static void *s_pStackArg;
+
+/*
+
+Name:	McciBootloaderHostSim_init()
+
+Function:
+	Map the simulated system flash.
+
+Definition:
+	bool McciBootloaderHostSim_init(void);
+
+Description:
+	The bootloader uses real addresses (from the link script) for
+	the system flash, and the 32-bit addresses in image headers are
+	used as pointers. So we map an anonymous region at the flash
+	address; the program is linked without PIE, and main() runs it
+	without address randomization, so that the address is free. The
+	flash starts out erased.
+
+Returns:
+	true if the flash could be mapped, false (with errno set)
+	otherwise.
+
+*/
+
+bool
+McciBootloaderHostSim_init(void)
+	{
+	void * const pFlash = mmap(
+		(void *)(uintptr_t) MCCI_BOOTLOADER_HOSTSIM_FLASH_BASE,
+		MCCI_BOOTLOADER_HOSTSIM_FLASH_SIZE,
+		PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+		-1,
+		0
+		);
+
+	if (pFlash == MAP_FAILED)
+		return false;
+
+	// kernels before 4.17 take MAP_FIXED_NOREPLACE as a hint.
+	if (pFlash != (void *)(uintptr_t) MCCI_BOOTLOADER_HOSTSIM_FLASH_BASE)
+		{
+		munmap(pFlash, MCCI_BOOTLOADER_HOSTSIM_FLASH_SIZE);
+		errno = EEXIST;
+		return false;
+		}
+
+	g_McciBootloaderHostSim.pFlash = pFlash;
+	g_McciBootloaderHostSim.serialFd = -1;
+	return true;
+	}
+
+/*
+
+Name:	McciBootloaderHostSim_run()
+
+Function:
+	Run the bootloader once, from reset.
+
+Definition:
+	McciBootloaderHostSim_Result_t McciBootloaderHostSim_run(void);
+
+Description:
+	McciBootloader_main() never returns; it ends by launching the
+	app or by failing. Our versions of those functions record what
+	happened and longjmp back here. If powerCutAfter is set, the boot
+	also ends after that many erases, half-page programs and EEPROM
+	writes, as if the power had failed.
+
+	The boot runs on a painted stack of its own, so that we can
+	report how much it used (less what the signature check used on
+	its scratch stack; see McciBootloaderPlatform_callOnStack()).
+
+Returns:
+	How the boot ended.
+
+*/
+
+McciBootloaderHostSim_Result_t
+McciBootloaderHostSim_run(void)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+
+	pSim->result = McciBootloaderHostSim_Result_Running;
+	pSim->failureCode = McciBootloaderError_OK;
+	pSim->state = McciBootloaderState_Initial;
+	pSim->launchAddress = 0;
+	pSim->nAnnunciatorInits = 0;
+	pSim->nStatesEarly = 0;
+	pSim->nPowerOps = 0;
+	pSim->lastPowerOp = McciBootloaderHostSim_PowerOp_None;
+	pSim->nScratch = 0;
+	pSim->nScratchUsed = 0;
+	pSim->nScratchCalls = 0;
+
+	pSim->nStackUsed = hostsim_runOnStack(hostsim_boot, NULL, s_bootStack, sizeof(s_bootStack));
+
+	return pSim->result;
+	}
+
+/* run the bootloader; on the boot stack, so we must catch the longjmp here */
+static void
+hostsim_boot(
+	void *pArg
+	)
+	{
+	if (setjmp(g_McciBootloaderHostSim.exit) == 0)
+		McciBootloader_main();
+	}
+
+/* call (*pFn)(pArg) on a painted stack, and return how much it used */
+static void
+hostsim_stackTrampoline(void)
+	{
+	(*s_pStackFn)(s_pStackArg);
+	}
+
+static size_t
+hostsim_runOnStack(
+	McciBootloaderPlatform_StackFn_t *pFn,
+	void *pArg,
+	uint8_t *pStack,
+	size_t nStack
+	)
+	{
+	ucontext_t caller;
+	ucontext_t callee;
+
+	McciBootloader_paintStack(pStack, pStack + nStack);
+
+	getcontext(&callee);
+	callee.uc_stack.ss_sp = pStack;
+	callee.uc_stack.ss_size = nStack;
+	callee.uc_link = &caller;
+
+	s_pStackFn = pFn;
+	s_pStackArg = pArg;
+	makecontext(&callee, hostsim_stackTrampoline, 0);
+	swapcontext(&caller, &callee);
+
+	return McciBootloader_getStackUsed(pStack, pStack + nStack);
+	}
+
+/*
+
+Name:	McciBootloaderHostSim_checkStorageImage()
+
+Function:
+	Check an image in simulated storage, as the bootloader would.
+
+Definition:
+	bool McciBootloaderHostSim_checkStorageImage(
+		McciBootloaderStorageAddress_t address
+		);
+
+Description:
+	The public key is taken from the signature block of the
+	bootloader in the simulated flash, as McciBootloader_main() does,
+	and the image at \p address is checked with
+	McciBootloader_checkStorageImage(). A call to
+	McciBootloaderPlatform_fail() counts as a failed check.
+
+Returns:
+	true if the image passed, false otherwise.
+
+*/
+
+bool
+McciBootloaderHostSim_checkStorageImage(
+	McciBootloaderStorageAddress_t address
+	)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+	volatile bool fResult = false;
+
+	pSim->result = McciBootloaderHostSim_Result_Running;
+	pSim->failureCode = McciBootloaderError_OK;
+
+	if (setjmp(pSim->exit) == 0)
+		{
+		const McciBootloader_AppInfo_t * const pBootloaderAppInfo =
+			McciBootloaderPlatform_getAppInfo(
+				&gk_McciBootloader_BootBase,
+				McciBootloader_codeSize(&gk_McciBootloader_BootBase, &gk_McciBootloader_BootTop)
+				);
+		const McciBootloader_SignatureBlock_t * const pBootloaderSigBlock =
+			pBootloaderAppInfo == NULL
+				? NULL
+				: McciBootloaderPlatform_getSignatureBlock(pBootloaderAppInfo);
+		McciBootloader_AppInfo_t appInfo;
+
+		if (pBootloaderSigBlock != NULL)
+			fResult = McciBootloader_checkStorageImage(
+					address,
+					&appInfo,
+					&pBootloaderSigBlock->publicKey
+					);
+		}
+
+	return fResult;
+	}
+
+/*
+
+Name:	McciBootloaderPlatform_entry()
+
+Function:
+	Simulated platform entry.
+
+Definition:
+	void McciBootloaderPlatform_entry(void);
+
+Description:
+	On the target this initializes RAM; the host C runtime has done
+	that for us, so we just call the system init method.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloaderPlatform_entry(void)
+	{
+	McciBootloaderPlatform_systemInit();
+	}
+
+/*
+
+Name:	McciBootloaderPlatform_startApp()
+
+Function:
+	Simulated app launch.
+
+Definition:
+	void McciBootloaderPlatform_startApp(
+		const void *pAppBase
+		);
+
+Description:
+	Record that the app was launched, and where, and return to
+	McciBootloaderHostSim_run().
+
+Returns:
+	Doesn't return.
+
+*/
+
+void
+McciBootloaderPlatform_startApp(
+	const void *pAppBase
+	)
+	{
+	McciBootloaderPlatform_prepareForLaunch();
+	g_McciBootloaderHostSim.result = McciBootloaderHostSim_Result_Launched;
+	g_McciBootloaderHostSim.launchAddress = (uint32_t)(uintptr_t) pAppBase;
+	longjmp(g_McciBootloaderHostSim.exit, 1);
+	}
+
+/*
+
+Name:	McciBootloaderPlatform_callOnStack()
+
+Function:
+	Simulated call on a lent stack.
+
+Definition:
+	void McciBootloaderPlatform_callOnStack(
+		McciBootloaderPlatform_StackFn_t *pFn,
+		void *pArg,
+		void *pStack,
+		size_t nStack
+		);
+
+Description:
+	Host code needs more stack than the device, so the lent stack
+	is only painted, as it would be on the device (so that code that
+	relies on its contents fails here), and the function runs on a
+	stack of our own. The most that it used is reported, along with
+	the size of the lent stack.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloaderPlatform_callOnStack(
+	McciBootloaderPlatform_StackFn_t *pFn,
+	void *pArg,
+	void *pStack,
+	size_t nStack
+	)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+
+	McciBootloader_paintStack(pStack, (uint8_t *)pStack + nStack);
+
+	size_t const nUsed = hostsim_runOnStack(pFn, pArg, s_scratchStack, sizeof(s_scratchStack));
+
+	pSim->nScratch = nStack;
+	pSim->nScratchCalls += 1;
+	if (nUsed > pSim->nScratchUsed)
+		pSim->nScratchUsed = nUsed;
+	}
+
+/****************************************************************************\
+|
+|	The platform methods
+|
+\****************************************************************************/
+
+static void
+hostsim_systemInit(void)
+	{
+	}
+
+static void
+hostsim_prepareForLaunch(void)
+	{
+	}
+
+static void
+hostsim_fail(
+	McciBootloaderError_t errorCode
+	)
+	{
+	g_McciBootloaderHostSim.result = McciBootloaderHostSim_Result_Failed;
+	g_McciBootloaderHostSim.failureCode = errorCode;
+	longjmp(g_McciBootloaderHostSim.exit, 1);
+	}
+
+static void
+hostsim_delayMs(
+	uint32_t ms
+	)
+	{
+	g_McciBootloaderHostSim.nDelays += 1;
+	g_McciBootloaderHostSim.nDelayMs += ms;
+	}
+
+static bool
+hostsim_getUpdate(void)
+	{
+	return g_McciBootloaderHostSim.fUpdate;
+	}
+
+/* as on the board, the EEPROM cell is only written if it changes */
+static void
+hostsim_setUpdate(
+	bool fUpdate
+	)
+	{
+	if (g_McciBootloaderHostSim.fUpdate == fUpdate)
+		return;
+
+	g_McciBootloaderHostSim.fUpdate = fUpdate;
+	hostsim_powerOp(McciBootloaderHostSim_PowerOp_Eeprom);
+	}
+
+static uint32_t
+hostsim_getAppBank(void)
+	{
+	return g_McciBootloaderHostSim.iAppBank;
+	}
+
+static void
+hostsim_setAppBank(
+	uint32_t iBank
+	)
+	{
+	if (g_McciBootloaderHostSim.iAppBank == iBank)
+		return;
+
+	g_McciBootloaderHostSim.iAppBank = iBank;
+	hostsim_powerOp(McciBootloaderHostSim_PowerOp_Eeprom);
+	}
+
+/* erased STM32L0 flash reads as zero; erase is by 128-byte page */
+static bool
+hostsim_systemFlashErase(
+	volatile const void *pBase,
+	size_t nBytes
+	)
+	{
+	uintptr_t const address = (uintptr_t) pBase;
+
+	nBytes = (nBytes + MCCI_BOOTLOADER_HOSTSIM_PAGE_SIZE - 1) & ~(MCCI_BOOTLOADER_HOSTSIM_PAGE_SIZE - 1);
+
+	if ((address % MCCI_BOOTLOADER_HOSTSIM_PAGE_SIZE) != 0 ||
+	    ! hostsim_isFlashRange(address, nBytes))
+		return false;
+
+	/* a page at a time, so that the power can be cut between them */
+	for (size_t i = 0; i < nBytes; i += MCCI_BOOTLOADER_HOSTSIM_PAGE_SIZE)
+		{
+		memset((void *) (address + i), 0, MCCI_BOOTLOADER_HOSTSIM_PAGE_SIZE);
+		g_McciBootloaderHostSim.nPagesErased += 1;
+		hostsim_powerOp(McciBootloaderHostSim_PowerOp_Erase);
+		}
+	return true;
+	}
+
+/* writes are by half-page, and (as on the real part) only to erased flash */
+static bool
+hostsim_systemFlashWrite(
+	volatile const void *pDest,
+	const void *pSrc,
+	size_t nBytes
+	)
+	{
+	uintptr_t const address = (uintptr_t) pDest;
+	uint32_t * const pFlash = (uint32_t *) address;
+	size_t i;
+
+	if (((uintptr_t) pSrc & 3) != 0 ||
+	    (nBytes % MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE) != 0 ||
+	    (address % MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE) != 0 ||
+	    ! hostsim_isFlashRange(address, nBytes))
+		return false;
+
+	for (i = 0; i < nBytes / sizeof(uint32_t); ++i)
+		{
+		if (pFlash[i] != 0)
+			return false;
+		}
+
+	for (i = 0; i < nBytes; i += MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE)
+		{
+		memcpy((uint8_t *)pFlash + i, (const uint8_t *)pSrc + i, MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE);
+		g_McciBootloaderHostSim.nBytesWritten += MCCI_BOOTLOADER_HOSTSIM_HALF_PAGE_SIZE;
+		hostsim_powerOp(McciBootloaderHostSim_PowerOp_Program);
+		}
+	return true;
+	}
+
+static void
+hostsim_storageInit(void)
+	{
+	}
+
+static bool
+hostsim_storageRead(
+	McciBootloaderStorageAddress_t address,
+	uint8_t *pBuffer,
+	size_t nBuffer
+	)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+
+	if (address > pSim->nStorage || pSim->nStorage - address < nBuffer)
+		return false;
+
+	memcpy(pBuffer, pSim->pStorage + address, nBuffer);
+	pSim->nBytesRead += nBuffer;
+	pSim->nStorageReads += 1;
+	if (nBuffer >= MCCI_BOOTLOADER_HOSTSIM_SPI_DMA_MIN)
+		{
+		pSim->nStorageWaits += 1;
+		pSim->nStorageWaitBytes += nBuffer;
+		}
+	return true;
+	}
+
+static McciBootloaderStorageAddress_t
+hostsim_getPrimaryStorageAddress(void)
+	{
+	return MCCI_BOOTLOADER_HOSTSIM_PRIMARY;
+	}
+
+static McciBootloaderStorageAddress_t
+hostsim_getFallbackStorageAddress(void)
+	{
+	return MCCI_BOOTLOADER_HOSTSIM_FALLBACK;
+	}
+
+static McciBootloaderStorageAddress_t
+hostsim_getDirectoryStorageAddress(void)
+	{
+	return MCCI_BOOTLOADER_HOSTSIM_DIRECTORY;
+	}
+
+static void
+hostsim_spiInit(void)
+	{
+	}
+
+static void
+hostsim_spiTransfer(
+	uint8_t *pRx,
+	const uint8_t *pTx,
+	size_t nBytes,
+	bool fContinue
+	)
+	{
+	}
+
+/*
+|| The serial port is a pty, opened by main() for --serial. The ring is
+|| painted, as the DMA would overwrite it on the device, and we report
+|| that the host can send all of it ahead; the pty buffers more than that.
+|| There's no way to see that the host has gone away, so the port is
+|| reported closed when nothing has arrived for a while.
+*/
+static size_t
+hostsim_serialInit(
+	uint8_t *pBuffer,
+	size_t nBuffer
+	)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+
+	if (pSim->serialFd < 0)
+		return 0;
+
+	McciBootloader_paintStack(pBuffer, pBuffer + nBuffer);
+	pSim->nSerialRing = nBuffer;
+	pSim->serialLastMs = hostsim_getMs();
+	return nBuffer;
+	}
+
+static size_t
+hostsim_serialRead(
+	uint8_t *pBuffer,
+	size_t nBuffer,
+	uint32_t timeoutMs
+	)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+	struct pollfd pfd = { .fd = pSim->serialFd, .events = POLLIN };
+
+	if (pSim->serialFd < 0)
+		return MCCI_BOOTLOADER_SERIAL_CLOSED;
+
+	for (;;)
+		{
+		uint64_t const idleMs = hostsim_getMs() - pSim->serialLastMs;
+
+		if (idleMs >= pSim->serialIdleMs)
+			return MCCI_BOOTLOADER_SERIAL_CLOSED;
+
+		uint32_t waitMs = pSim->serialIdleMs - (uint32_t)idleMs;
+		if (waitMs > timeoutMs)
+			waitMs = timeoutMs;
+
+		int const nReady = poll(&pfd, 1, (int)waitMs);
+
+		if (nReady < 0 && errno == EINTR)
+			continue;
+		if (nReady < 0 || (pfd.revents & (POLLERR | POLLNVAL)) != 0)
+			return MCCI_BOOTLOADER_SERIAL_CLOSED;
+		if (nReady == 0)
+			{
+			if (waitMs == timeoutMs)
+				return 0;
+			continue;
+			}
+
+		ssize_t const nRead = read(pSim->serialFd, pBuffer, nBuffer);
+
+		if (nRead < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (nRead <= 0)
+			return MCCI_BOOTLOADER_SERIAL_CLOSED;
+
+		pSim->nSerialBytesIn += (uint32_t)nRead;
+		pSim->serialLastMs = hostsim_getMs();
+		return (size_t)nRead;
+		}
+	}
+
+static void
+hostsim_serialWrite(
+	const uint8_t *pBuffer,
+	size_t nBuffer
+	)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+
+	while (pSim->serialFd >= 0 && nBuffer > 0)
+		{
+		ssize_t const nWritten = write(pSim->serialFd, pBuffer, nBuffer);
+
+		if (nWritten < 0 && errno == EINTR)
+			continue;
+		if (nWritten <= 0)
+			break;
+
+		pSim->nSerialBytesOut += (uint32_t)nWritten;
+		pBuffer += nWritten;
+		nBuffer -= (size_t)nWritten;
+		}
+	}
+
+static bool
+hostsim_getRecoveryRequest(void)
+	{
+	return g_McciBootloaderHostSim.fRecover;
+	}
+
+static void
+hostsim_annunciatorInit(void)
+	{
+	g_McciBootloaderHostSim.nAnnunciatorInits += 1;
+	}
+
+static void
+hostsim_annunciatorIndicateState(
+	McciBootloaderState_t state
+	)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+
+	/* on the device, these would never be seen */
+	if (pSim->nAnnunciatorInits == 0)
+		pSim->nStatesEarly += 1;
+
+	if (McciBootloader_getStatePercent(state) < 0)
+		pSim->nStates += 1;
+	else
+		pSim->nProgress += 1;
+
+	pSim->state = state;
+	}
+
+static bool
+hostsim_isFlashRange(
+	uintptr_t address,
+	size_t nBytes
+	)
+	{
+	uintptr_t const base = MCCI_BOOTLOADER_HOSTSIM_FLASH_BASE;
+	uintptr_t const top = base + MCCI_BOOTLOADER_HOSTSIM_FLASH_SIZE;
+
+	return base <= address && address <= top && nBytes <= top - address;
+	}
+
+/* the host's monotonic time, in ms */
+static uint64_t
+hostsim_getMs(void)
+	{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000u + (uint64_t)now.tv_nsec / 1000000u;
+	}
+
+/*
+|| Count an operation that changes flash or EEPROM, and cut the power
+|| after it if asked to. The power is only cut between operations; a page
+|| is never left partly erased or programmed.
+*/
+static void
+hostsim_powerOp(
+	McciBootloaderHostSim_PowerOp_t op
+	)
+	{
+	McciBootloaderHostSim_t * const pSim = &g_McciBootloaderHostSim;
+
+	pSim->nPowerOps += 1;
+	pSim->lastPowerOp = op;
+
+	if (op == McciBootloaderHostSim_PowerOp_Eeprom)
+		pSim->nEepromWrites += 1;
+
+	if (pSim->nPowerOps == pSim->powerCutAfter)
+		{
+		pSim->result = McciBootloaderHostSim_Result_PowerLost;
+		longjmp(pSim->exit, 1);
+		}
+	}
+
+/**** end of platform.c ****/
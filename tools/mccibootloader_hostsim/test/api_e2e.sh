@@ -0,0 +1,96 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  api_e2e.sh
+#
+# Function:
+#	End-to-end test of the libmccibootloader_image C API: check that
+#	the shared library exports only the API, sign an image from
+#	several threads with mccibootloader_image_apicheck, check the
+#	result with mccibootloader_image, check that bad keys and images
+#	return a status, and boot the result with mccibootloader_hostsim.
+#
+# Usage:
+#	api_e2e.sh {hostsim} {mccibootloader_image} {apicheck} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+APICHECK="$3"
+KEY="$4"
+DIR="$5"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {apicheck} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# record a result: name, then a command that succeeds if the case passes
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" > /dev/null 2>&1 ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+"$SIM" --make-image --address 0x08005000 --size 70000 --seed 5 "$DIR/app.raw"
+
+# succeed if the shared library's dynamic symbols are all API functions
+exportsOnlyApi() {
+	nm -D --defined-only "$1" > "$DIR/exports.txt"
+	grep -q ' mccibootloader_image_sign$' "$DIR/exports.txt" &&
+	! grep -v ' mccibootloader_image_[a-z0-9_]*$' "$DIR/exports.txt"
+}
+
+echo "== C API"
+LIB="$(dirname "$APICHECK")/libmccibootloader_image.so"
+if [ -f "$LIB" ]; then
+	check "library exports only the C API" exportsOnlyApi "$LIB"
+fi
+check "sign from 8 threads"		"$APICHECK" "$KEY" "$DIR/app.raw" "$DIR/app.bin" 8
+check "command line verifies the result" "$TOOL" --verify -k "$KEY" --force-binary "$DIR/app.bin"
+check "bad keys and images return a status" "$APICHECK" --errors "$KEY" "$DIR/app.raw"
+
+# the command line, re-signing without changing the AppInfo, must
+# produce the same bytes: ed25519 signatures are deterministic.
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/app.bin" "$DIR/app.resigned.bin" > /dev/null
+check "command line gives the same bytes" cmp "$DIR/app.bin" "$DIR/app.resigned.bin"
+
+echo
+echo "== boot tests"
+check "boot the signed image"		"$SIM" --boot "$DIR/boot.bin" --app "$DIR/app.bin" --expect "$DIR/app.bin"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
@@ -0,0 +1,120 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  artifacts_e2e.sh
+#
+# Function:
+#	End-to-end test of the extra outputs of mccibootloader_image
+#	(--output-bin, --output-hex, --output-srec, --output-slot): sign
+#	an image once, check that each output holds the same image, and
+#	boot the storage-slot output with mccibootloader_hostsim. An ELF
+#	input with holes between its sections must give the same image
+#	as the flat binary.
+#
+# Usage:
+#	artifacts_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# record a result: name, then a command that succeeds if the case passes
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" > /dev/null 2>&1 ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# the size of a storage slot (MCCI_BOOTLOADER_BOARD_CATENA_ABZ_STORAGE_IMAGE_SIZE)
+SLOTSIZE=$((168 * 1024))
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+# an image that crosses a 64k boundary, so the HEX file needs two
+# extended address records.
+"$SIM" --make-image --address 0x08005000 --size 70000 --seed 3 "$DIR/v1.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time \
+	--output-bin "$DIR/v1.copy.bin" \
+	--output-hex "$DIR/v1.hex" \
+	--output-srec "$DIR/v1.srec" \
+	--output-slot "$DIR/v1.slot" \
+	--depfile "$DIR/v1.d" \
+	"$DIR/v1.raw" "$DIR/v1.bin"
+
+# the same kind of image as an ELF file, with a hole between sections
+# and a .bss tail; the ELF is signed in place.
+"$SIM" --make-image --address 0x08005000 --size 30000 --seed 7 \
+	--elf "$DIR/v2.elf" --elf-hole 64 "$DIR/v2.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/v2.raw" "$DIR/v2.bin" > /dev/null
+"$TOOL" -s -k "$KEY" --no-add-time \
+	--output-bin "$DIR/v2.elf.bin" \
+	--output-elf "$DIR/v2.copy.elf" \
+	"$DIR/v2.elf" "$DIR/v2.signed.elf"
+
+echo "== extra outputs"
+check "flat binary matches output"		cmp "$DIR/v1.bin" "$DIR/v1.copy.bin"
+check "slot is padded to slot size"		test "$(wc -c < "$DIR/v1.slot")" -eq $SLOTSIZE
+check "slot starts with the image"		cmp -n "$(wc -c < "$DIR/v1.bin")" "$DIR/v1.bin" "$DIR/v1.slot"
+check "HEX has two address records"		test "$(grep -c '^:02000004' "$DIR/v1.hex")" -eq 2
+check "depfile names every output"		grep -q "v1.bin .*v1.copy.bin .*v1.hex .*v1.srec .*v1.slot:" "$DIR/v1.d"
+
+check "ELF load image matches binary"		cmp "$DIR/v2.bin" "$DIR/v2.elf.bin"
+check "signed ELF is the same size"		test "$(wc -c < "$DIR/v2.signed.elf")" -eq "$(wc -c < "$DIR/v2.elf")"
+check "ELF copy matches output"			cmp "$DIR/v2.signed.elf" "$DIR/v2.copy.elf"
+
+# objcopy isn't always installed; if it is, use it to read the HEX
+# and S-record files back.
+if command -v objcopy > /dev/null 2>&1 ; then
+	objcopy -I ihex -O binary "$DIR/v1.hex" "$DIR/v1.hex.bin"
+	objcopy -I srec -O binary "$DIR/v1.srec" "$DIR/v1.srec.bin"
+	check "HEX decodes to the image"	cmp "$DIR/v1.bin" "$DIR/v1.hex.bin"
+	check "S-records decode to the image"	cmp "$DIR/v1.bin" "$DIR/v1.srec.bin"
+else
+	echo "SKIP: objcopy not found, not decoding HEX and S-records"
+fi
+
+echo
+echo "== boot tests"
+check "update from slot image"		"$SIM" --boot "$DIR/boot.bin" --primary "$DIR/v1.slot" --update --expect "$DIR/v1.bin"
+check "boot image signed from ELF"	"$SIM" --boot "$DIR/boot.bin" --app "$DIR/v2.elf.bin"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
@@ -0,0 +1,144 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  banks_e2e.sh
+#
+# Function:
+#	End-to-end test of the two-bank app layout: build
+#	mccibootloader_hostsim with two app banks, sign apps linked for
+#	each bank with mccibootloader_image, and check that the bootloader
+#	switches banks on request, refuses bad banks, rolls back, and
+#	recovers from storage. Also compares the cost of an update made
+#	by switching banks with one copied from storage.
+#
+# Usage:
+#	banks_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+#	{hostsim} is the usual (one bank) simulator, for comparison.
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	April 2021
+#
+##############################################################################
+
+set -e
+
+SIM1="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+SRCDIR="$(cd "$(dirname "$0")/.." && pwd)"
+mkdir -p "$DIR"
+DIR="$(cd "$DIR" && pwd)"
+rm -rf "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# the app banks: flash bank 1 after the bootloader, and flash bank 2.
+BANK1=0x08005000
+BANK2=0x08018000
+
+# build the simulator with two app banks
+BUILD="$DIR/build"
+make -C "$SRCDIR" --no-print-directory \
+	T_BUILDTREE="$BUILD" \
+	MCCI_BOOTLOADER_APP_BANKS=2 \
+	all > "$BUILD.log" 2>&1 || { cat "$BUILD.log" 1>&2; exit 1; }
+SIM="$(find "$BUILD" -type f -name mccibootloader_hostsim -perm -u+x | head -n 1)"
+
+# make a signed image: name address size seed
+makeImage() {
+	"$SIM" --make-image --address "$2" --size "$3" --seed "$4" "$DIR/$1.raw"
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/$1.raw" "$DIR/$1.bin" > /dev/null
+}
+
+# copy a file, changing one byte: from to offset
+damage() {
+	cp "$1" "$2"
+	printf '\125' | dd of="$2" bs=1 seek="$3" conv=notrunc 2> /dev/null
+}
+
+# run a case: name, expected first line, expected bank, then simulator args
+check() {
+	NAME="$1"
+	EXPECT="$2"
+	BANK="$3"
+	shift 3
+
+	RESULT="$("$SIM" --boot "$DIR/boot.bin" "$@" || true)"
+	if [ "$(echo "$RESULT" | head -n 1)" = "$EXPECT" ] &&
+	   echo "$RESULT" | grep -q "^app bank: $BANK\>" &&
+	   ! echo "$RESULT" | grep -q "does not match" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		echo "$RESULT" | sed -e 's/^/	/'
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# report the cost of a boot: name, simulator, then simulator args
+bench() {
+	printf "%-40s" "$1"
+	BENCHSIM="$2"
+	shift 2
+	RESULT="$("$BENCHSIM" -v --boot "$DIR/boot.bin" "$@")"
+	FLASH="$(echo "$RESULT" | sed -n -e 's/^estimated device time: \([0-9.]*\) ms.*/\1/p')"
+	NCHECKS="$(echo "$RESULT" | sed -n -e 's/^host stack used:.* \([0-9]*\) checks).*/\1/p')"
+	echo "device time $FLASH ms (less hashing), ${NCHECKS:-0} signature checks"
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+# a1 runs in bank 1, b2 in bank 2; b1 is linked for bank 1, and big for
+# the whole app region, as with one bank.
+makeImage a1 $BANK1 65536 7
+makeImage b2 $BANK2 65536 8
+makeImage b1 $BANK1 65536 9
+makeImage big $BANK1 131072 10
+damage "$DIR/a1.bin" "$DIR/a1.bad.bin" 5000
+damage "$DIR/b2.bin" "$DIR/b2.bad.bin" 5000
+
+echo "== cost of an update"
+bench "one bank: copied from storage"		"$SIM1" --app "$DIR/a1.bin" --primary "$DIR/b1.bin" --update
+bench "two banks: switch banks"			"$SIM" --app "$DIR/a1.bin" --bank2 "$DIR/b2.bin" --update
+bench "two banks: bad bank, roll back"		"$SIM" --app "$DIR/a1.bin" --bank2 "$DIR/b2.bad.bin" --app-bank 2
+echo
+
+echo "== boot tests"
+check "bank 1 selected"				launched 1 --app "$DIR/a1.bin" --bank2 "$DIR/b2.bin" --expect "$DIR/a1.bin"
+check "bank 2 selected"				launched 2 --app "$DIR/a1.bin" --bank2 "$DIR/b2.bin" --app-bank 2 --expect "$DIR/b2.bin"
+check "update switches to bank 2"		launched 2 --app "$DIR/a1.bin" --bank2 "$DIR/b2.bin" --update --expect "$DIR/b2.bin"
+check "update switches back to bank 1"		launched 1 --app "$DIR/a1.bin" --bank2 "$DIR/b2.bin" --app-bank 2 --update --expect "$DIR/a1.bin"
+check "update to a damaged bank is refused"	launched 1 --app "$DIR/a1.bin" --bank2 "$DIR/b2.bad.bin" --update --expect "$DIR/a1.bin"
+check "update to an empty bank is refused"	launched 1 --app "$DIR/a1.bin" --update --expect "$DIR/a1.bin"
+check "app linked for the other bank is refused" launched 1 --app "$DIR/a1.bin" --bank2 "$DIR/b1.bin" --update --expect "$DIR/a1.bin"
+check "bad bank 2 rolls back to bank 1"		launched 1 --app "$DIR/a1.bin" --bank2 "$DIR/b2.bad.bin" --app-bank 2 --expect "$DIR/a1.bin"
+check "bad bank 1 rolls over to bank 2"		launched 2 --app "$DIR/a1.bad.bin" --bank2 "$DIR/b2.bin" --expect "$DIR/b2.bin"
+check "no good bank: bank 1 app from storage"	launched 1 --app "$DIR/a1.bad.bin" --primary "$DIR/b1.bin" --expect "$DIR/b1.bin"
+check "no good bank: bank 2 app from storage"	launched 2 --app "$DIR/a1.bad.bin" --primary "$DIR/b2.bin" --expect "$DIR/b2.bin"
+check "no good bank, nothing in storage"	"failed: NoAppImage (3)" 1 --app "$DIR/a1.bad.bin" --bank2 "$DIR/b2.bad.bin"
+check "one-bank app still runs"			launched 1 --app "$DIR/big.bin" --expect "$DIR/big.bin"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
@@ -0,0 +1,135 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  blockhash_e2e.sh
+#
+# Function:
+#	End-to-end test of storage images with block hash tables: make
+#	and sign images with mccibootloader_image, damage them in various
+#	ways, and boot them with mccibootloader_hostsim. Also reports
+#	the cost of rejecting a damaged image, and the stack used.
+#
+# Usage:
+#	blockhash_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# make an image and its storage image with block hashes: name address size seed
+makeImage() {
+	"$SIM" --make-image --address "$2" --size "$3" --seed "$4" "$DIR/$1.raw"
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time \
+		--block-hash-output "$DIR/$1.img" \
+		"$DIR/$1.raw" "$DIR/$1.bin"
+}
+
+# copy a file, changing one byte: from to offset
+damage() {
+	cp "$1" "$2"
+	printf '\125' | dd of="$2" bs=1 seek="$3" conv=notrunc 2> /dev/null
+}
+
+# report the storage reads needed to reject an image: name file
+rejectCost() {
+	printf "%-40s" "$1"
+	"$SIM" -v --boot "$DIR/boot.bin" --app "$DIR/w1.bin" --primary "$2" --update |
+		sed -n -e 's/^pages erased.*storage bytes read: \([0-9]*\).*/\1 bytes read/p'
+}
+
+# report the host stack used by a boot: name, then simulator args
+stackCost() {
+	printf "%-40s" "$1"
+	shift
+	"$SIM" -v --boot "$DIR/boot.bin" "$@" |
+		sed -n -e 's/^host stack used: //p'
+}
+
+# run a case: name, expected first line, then simulator args
+check() {
+	NAME="$1"
+	EXPECT="$2"
+	shift 2
+
+	RESULT="$("$SIM" --boot "$DIR/boot.bin" "$@" || true)"
+	if [ "$(echo "$RESULT" | head -n 1)" = "$EXPECT" ] && ! echo "$RESULT" | grep -q "does not match" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		echo "$RESULT" | sed -e 's/^/	/'
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+echo "== block hash tables (synthetic images)"
+printf "v1 (64 KiB):    "; makeImage v1 0x08005000 65536 7
+printf "w1 (128 KiB):   "; makeImage w1 0x08005000 131072 11
+printf "w1 (1 KiB blocks): "
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time --block-size 1024 \
+	--block-hash-output "$DIR/w1.1k.img" "$DIR/w1.raw" "$DIR/w1.1k.bin"
+echo
+
+# the table follows the image and its signature block.
+SIZE=$(wc -c < "$DIR/w1.bin")
+damage "$DIR/w1.bin" "$DIR/w1.bad-early.bin" 5000
+damage "$DIR/w1.img" "$DIR/w1.bad-early.img" 5000
+damage "$DIR/w1.img" "$DIR/w1.bad-late.img" $((SIZE - 300))
+damage "$DIR/w1.img" "$DIR/w1.bad-hash.img" $((SIZE + 16 + 64 + 10))
+damage "$DIR/w1.img" "$DIR/w1.bad-sig.img" $(($(wc -c < "$DIR/w1.img") - 10))
+
+echo "== cost of rejecting an image damaged at offset 5000"
+rejectCost "w1, full image hash:" "$DIR/w1.bad-early.bin"
+rejectCost "w1, block hashes:" "$DIR/w1.bad-early.img"
+echo
+
+echo "== host stack used; the signature check runs on the block buffer"
+stackCost "w1, full image hash:" --app "$DIR/v1.bin" --primary "$DIR/w1.bin" --update
+stackCost "w1, block hashes:" --app "$DIR/v1.bin" --primary "$DIR/w1.img" --update
+echo
+
+echo "== boot tests"
+check "update with block hashes"			launched --app "$DIR/w1.bin" --primary "$DIR/v1.img" --update --expect "$DIR/v1.bin"
+check "update with block hashes, larger image"		launched --app "$DIR/v1.bin" --primary "$DIR/w1.img" --update --expect "$DIR/w1.bin"
+check "early bad block is rejected"			launched --app "$DIR/v1.bin" --primary "$DIR/w1.bad-early.img" --update --expect "$DIR/v1.bin"
+check "late bad block is rejected"			launched --app "$DIR/v1.bin" --primary "$DIR/w1.bad-late.img" --update --expect "$DIR/v1.bin"
+check "bad block hash is rejected"			launched --app "$DIR/v1.bin" --primary "$DIR/w1.bad-hash.img" --update --expect "$DIR/v1.bin"
+check "bad table signature is rejected"			launched --app "$DIR/v1.bin" --primary "$DIR/w1.bad-sig.img" --update --expect "$DIR/v1.bin"
+check "table for another block size is ignored"		launched --app "$DIR/v1.bin" --primary "$DIR/w1.1k.img" --update --expect "$DIR/w1.bin"
+check "fallback with block hashes"			launched --primary "$DIR/w1.bad-early.img" --fallback "$DIR/v1.img" --expect "$DIR/v1.bin"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
@@ -0,0 +1,173 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  cache_e2e.sh
+#
+# Function:
+#	End-to-end test of mccibootloader_image --cache-dir and --depfile:
+#	check that a repeated build reuses the signed image and leaves the
+#	output alone, that changing the key, version or comment signs
+#	again, that damaged entries are thrown away, and that the depfile
+#	names the right files.
+#
+# Usage:
+#	cache_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	April 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -rf "$DIR"/*
+
+NPASS=0
+NFAIL=0
+CACHE="$DIR/cache"
+
+# record a result: name, then a command that succeeds if the case passes
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" > /dev/null 2>&1 ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# sign app.raw through the cache, with the time added: output, then options
+sign() {
+	OUT="$1"
+	shift
+	"$TOOL" -s -v -k "$KEY" --force-binary --cache-dir "$CACHE" "$@" "$DIR/app.raw" "$DIR/$OUT" > "$DIR/sign.log" 2>&1
+}
+
+# succeed if the last sign() logged the message
+logged() {
+	grep -q "^$1" "$DIR/sign.log"
+}
+
+# the one cache entry
+entry() {
+	find "$CACHE" -name '*.bin'
+}
+
+# succeed if the cache holds $1 entries
+entries() {
+	[ "$(entry | wc -l)" -eq "$1" ]
+}
+
+# succeed if two files differ
+differs() {
+	! cmp -s "$1" "$2"
+}
+
+# succeed if a file is no newer than the stamp
+untouched() {
+	[ -z "$(find "$1" -newer "$DIR/stamp")" ]
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+"$SIM" --make-image --address 0x08005000 --size 30000 --seed 7 "$DIR/app.raw"
+
+echo "== cache hits"
+sign app.bin
+check "first build misses"			logged "cache miss: "
+check "...and fills the cache"			logged "cache entry written: "
+check "...with one entry"			entries 1
+check "...and the output verifies"		"$TOOL" --verify -k "$KEY" --force-binary "$DIR/app.bin"
+cp "$DIR/app.bin" "$DIR/first.bin"
+
+# the timestamp is in seconds; make sure signing again would change it.
+touch "$DIR/stamp"
+sleep 1
+sign app.bin
+check "second build hits"			logged "cache hit: "
+check "...and gives the same bytes"		cmp "$DIR/first.bin" "$DIR/app.bin"
+check "...and doesn't rewrite the output"	untouched "$DIR/app.bin"
+check "...or the cache entry"			untouched "$(entry)"
+
+rm "$DIR/app.bin"
+sign app.bin
+check "a missing output is written from the cache" cmp "$DIR/first.bin" "$DIR/app.bin"
+
+echo
+echo "== damaged entries"
+ENTRY="$(entry)"
+printf 'not a signature!' | dd of="$ENTRY" bs=1 seek=20000 conv=notrunc 2> /dev/null
+sign app.bin
+check "corrupted entry is rejected"		logged "cache entry doesn't verify, removed: "
+check "...and the image is signed again"	logged "cache entry written: "
+check "...with a new timestamp"			differs "$DIR/first.bin" "$DIR/app.bin"
+check "...that verifies"			"$TOOL" --verify -k "$KEY" --force-binary "$DIR/app.bin"
+check "...and replaces the entry"		cmp "$DIR/app.bin" "$ENTRY"
+
+head -c 1000 "$ENTRY" > "$DIR/short.bin"
+mv "$DIR/short.bin" "$ENTRY"
+sign app.bin
+check "truncated entry is rejected"		logged "cache entry has wrong size, removed: "
+check "...and the image is signed again"	"$TOOL" --verify -k "$KEY" --force-binary "$DIR/app.bin"
+check "...and replaces the entry"		cmp "$DIR/app.bin" "$ENTRY"
+
+echo
+echo "== cache keys"
+cp "$DIR/app.bin" "$DIR/current.bin"
+sign version.bin -V 1.2.3
+check "a new version misses"			logged "cache miss: "
+sign comment.bin -c other
+check "a new comment misses"			logged "cache miss: "
+if command -v ssh-keygen > /dev/null; then
+	ssh-keygen -q -t ed25519 -N "" -C other -f "$DIR/other.pem"
+	"$TOOL" -s -v -k "$DIR/other.pem" --force-binary --cache-dir "$CACHE" "$DIR/app.raw" "$DIR/other.bin" > "$DIR/sign.log" 2>&1
+	check "a new key misses"		logged "cache miss: "
+	check "...and signs with that key"	"$TOOL" --verify -k "$DIR/other.pem" --force-binary "$DIR/other.bin"
+fi
+sign again.bin
+check "the first options still hit"		logged "cache hit: "
+check "...and give the same image"		cmp "$DIR/current.bin" "$DIR/again.bin"
+check "a cached image boots"			"$SIM" --boot "$DIR/boot.bin" --app "$DIR/again.bin" --expect "$DIR/again.bin"
+
+echo
+echo "== depfile"
+sign app.bin --depfile "$DIR/app.bin.d"
+echo "$DIR/app.bin: $DIR/app.raw $KEY" > "$DIR/expect.d"
+check "depfile names the input and key"		cmp "$DIR/expect.d" "$DIR/app.bin.d"
+sign app.bin --depfile "$DIR/app.bin.d" --output-hex "$DIR/app.hex"
+echo "$DIR/app.bin $DIR/app.hex: $DIR/app.raw $KEY" > "$DIR/expect.d"
+check "depfile lists every output"		cmp "$DIR/expect.d" "$DIR/app.bin.d"
+cp "$DIR/app.raw" "$DIR/my app.raw"
+"$TOOL" -s -k "$KEY" --force-binary --cache-dir "$CACHE" --depfile "$DIR/space.d" "$DIR/my app.raw" "$DIR/my app.bin" > /dev/null
+echo "$DIR/my\\ app.bin: $DIR/my\\ app.raw $KEY" > "$DIR/expect.d"
+check "depfile escapes spaces"			cmp "$DIR/expect.d" "$DIR/space.d"
+check "a dry run writes no depfile"		sh -c "'$TOOL' -s -k '$KEY' --force-binary --dry-run --depfile '$DIR/dry.d' '$DIR/app.raw' '$DIR/dry.bin' > /dev/null && [ ! -f '$DIR/dry.d' ]"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
@@ -0,0 +1,124 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  compose_e2e.sh
+#
+# Function:
+#	End-to-end test of mccibootloader_image --compose: lay signed
+#	images out as SPI flash images, check the layout, and boot the
+#	slots with mccibootloader_hostsim.
+#
+# Usage:
+#	compose_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# record a result: name, then a command that succeeds if the case passes
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" > /dev/null 2>&1 ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# copy one slot (in KiB) out of a chip image: chip offset out
+slot() {
+	dd if="$1" of="$3" bs=1024 skip="$2" count=168 2> /dev/null
+}
+
+# the storage layout (mcci_bootloader_board_catena_abz.h)
+CHIPSIZE=$((1024 * 1024))
+FALLBACK=64
+UPDATE=256
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+"$SIM" --make-image --address 0x08005000 --size 70000 --seed 3 "$DIR/v1.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/v1.raw" "$DIR/v1.bin"
+"$SIM" --make-image --address 0x08005000 --size 40000 --seed 9 "$DIR/v2.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/v2.raw" "$DIR/v2.bin"
+
+# an unsigned copy, which must be refused.
+cp "$DIR/v2.raw" "$DIR/v2.unsigned.bin"
+
+cat > "$DIR/manifest" <<END
+# chip			fallback		primary
+$DIR/sku1.bin		$DIR/v1.bin
+$DIR/sku2.bin		$DIR/v1.bin		$DIR/v2.bin
+$DIR/sku2.hex		$DIR/v1.bin		$DIR/v2.bin
+$DIR/sku3.bin		$DIR/v2.unsigned.bin
+$DIR/sku4.bin		$DIR/boot.bin
+END
+
+echo "== compose"
+if "$TOOL" --compose --force-binary -k "$KEY" "$DIR/manifest" > "$DIR/compose.log" ; then
+	RESULT=0
+else
+	RESULT=1
+fi
+sed -e 's/^/	/' "$DIR/compose.log"
+
+slot "$DIR/sku2.bin" $FALLBACK "$DIR/sku2.fallback"
+slot "$DIR/sku2.bin" $UPDATE "$DIR/sku2.primary"
+slot "$DIR/sku1.bin" $UPDATE "$DIR/sku1.primary"
+
+check "bad slot images make the run fail"	test $RESULT -eq 1
+check "chip images are full size"		test "$(wc -c < "$DIR/sku2.bin")" -eq $CHIPSIZE
+check "empty slot is erased"			test "$(od -An -v -tx1 "$DIR/sku1.primary" | tr -s ' \n' '\n\n' | sort -u | tr -d '\n')" = "ff"
+check "unsigned image is refused"		test ! -e "$DIR/sku3.bin"
+check "bootloader image is refused"		test ! -e "$DIR/sku4.bin"
+check "HEX holds only the slots"		test "$(wc -c < "$DIR/sku2.hex")" -lt $CHIPSIZE
+
+if command -v objcopy > /dev/null 2>&1 ; then
+	objcopy -I ihex -O binary --gap-fill 0xff "$DIR/sku2.hex" "$DIR/sku2.hex.bin"
+	check "HEX matches the chip image"	cmp -i $((FALLBACK * 1024)):0 "$DIR/sku2.bin" "$DIR/sku2.hex.bin" -n $(wc -c < "$DIR/sku2.hex.bin")
+else
+	echo "SKIP: objcopy not found, not decoding HEX"
+fi
+
+echo
+echo "== boot tests"
+check "boot from fallback slot"		"$SIM" --boot "$DIR/boot.bin" --fallback "$DIR/sku2.fallback" --expect "$DIR/v1.bin"
+check "update from primary slot"	"$SIM" --boot "$DIR/boot.bin" --app "$DIR/v1.bin" --primary "$DIR/sku2.primary" --update --expect "$DIR/v2.bin"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
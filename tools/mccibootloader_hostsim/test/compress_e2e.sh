@@ -0,0 +1,110 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  compress_e2e.sh
+#
+# Function:
+#	End-to-end test of compressed packages: make and sign images with
+#	mccibootloader_image, compare the package sizes and update times
+#	with full images, and boot them with mccibootloader_hostsim.
+#
+# Usage:
+#	compress_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# make an image and its compressed package: name address size seed
+makeImage() {
+	"$SIM" --make-image --address "$2" --size "$3" --seed "$4" "$DIR/$1.raw"
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time \
+		--compressed-output "$DIR/$1.pkg" \
+		"$DIR/$1.raw" "$DIR/$1.bin"
+}
+
+# report the modeled update time for a storage image: name file
+updateTime() {
+	printf "%-28s" "$1"
+	"$SIM" -v --boot "$DIR/boot.bin" --primary "$2" --update |
+		sed -n -e 's/^estimated device time: //p'
+}
+
+# run a case: name, expected first line, then simulator args
+check() {
+	NAME="$1"
+	EXPECT="$2"
+	shift 2
+
+	RESULT="$("$SIM" --boot "$DIR/boot.bin" "$@" || true)"
+	if [ "$(echo "$RESULT" | head -n 1)" = "$EXPECT" ] && ! echo "$RESULT" | grep -q "does not match" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		echo "$RESULT" | sed -e 's/^/	/'
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+echo "== compression report (synthetic images)"
+printf "v1 (64 KiB):    "; makeImage v1 0x08005000 65536 7
+printf "w1 (128 KiB):   "; makeImage w1 0x08005000 131072 11
+echo
+
+echo "== update time (modeled; see README)"
+updateTime "v1, full image:" "$DIR/v1.bin"
+updateTime "v1, compressed:" "$DIR/v1.pkg"
+updateTime "w1, full image:" "$DIR/w1.bin"
+updateTime "w1, compressed:" "$DIR/w1.pkg"
+echo
+
+# damaged copies of a package: one has a byte flipped in the payload,
+# the other is cut short.
+cp "$DIR/v1.pkg" "$DIR/v1.bad.pkg"
+printf '\377' | dd of="$DIR/v1.bad.pkg" bs=1 seek=300 conv=notrunc 2> /dev/null
+head -c 1000 "$DIR/v1.pkg" > "$DIR/v1.short.pkg"
+
+echo "== boot tests"
+check "compressed update"				launched --app "$DIR/w1.bin" --primary "$DIR/v1.pkg" --update --expect "$DIR/v1.bin"
+check "compressed update, larger image"			launched --app "$DIR/v1.bin" --primary "$DIR/w1.pkg" --update --expect "$DIR/w1.bin"
+check "compressed update with no app"			launched --primary "$DIR/w1.pkg" --expect "$DIR/w1.bin"
+check "corrupted compressed package is ignored"		launched --app "$DIR/v1.bin" --primary "$DIR/v1.bad.pkg" --update --expect "$DIR/v1.bin"
+check "truncated compressed package is ignored"		launched --app "$DIR/v1.bin" --primary "$DIR/v1.short.pkg" --update --expect "$DIR/v1.bin"
+check "compressed fallback"				launched --primary "$DIR/v1.bad.pkg" --fallback "$DIR/w1.pkg" --expect "$DIR/w1.bin"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
@@ -0,0 +1,118 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  delta_e2e.sh
+#
+# Function:
+#	End-to-end test of update packages: make and sign images with
+#	mccibootloader_image, then boot them with mccibootloader_hostsim.
+#
+# Usage:
+#	delta_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# make an image: name address size seed edits
+makeImage() {
+	"$SIM" --make-image --address "$2" --size "$3" --seed "$4" --edits "$5" "$DIR/$1.raw"
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/$1.raw" "$DIR/$1.bin" > /dev/null
+}
+
+# make a delta package: base target
+makeDelta() {
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time \
+		--delta-base "$DIR/$1.bin" --delta-output "$DIR/$1-$2.pkg" \
+		"$DIR/$2.raw" "$DIR/$2.bin"
+}
+
+# run a case: name, expected first line, then simulator args
+check() {
+	NAME="$1"
+	EXPECT="$2"
+	shift 2
+
+	RESULT="$("$SIM" --boot "$DIR/boot.bin" "$@" || true)"
+	if [ "$(echo "$RESULT" | head -n 1)" = "$EXPECT" ] && ! echo "$RESULT" | grep -q "does not match" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		echo "$RESULT" | sed -e 's/^/	/'
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+makeImage boot 0x08000000 4096 1 0
+
+echo "== delta size report (synthetic images)"
+makeImage v1 0x08005000 65536 7 0
+makeImage v2 0x08005000 65536 7 3
+makeImage v3 0x08005000 65536 7 40
+makeImage w1 0x08005000 131072 11 0
+makeImage w2 0x08005000 131072 11 1
+makeImage other 0x08005000 65536 8 0
+printf "v1 -> v2 (3 functions changed):   "; makeDelta v1 v2
+printf "v1 -> v3 (40 functions changed):  "; makeDelta v1 v3
+printf "w1 -> w2 (1 function changed):    "; makeDelta w1 w2
+printf "v2 -> w2 (unrelated images):      "; makeDelta v2 w2
+echo
+
+# a corrupted copy of a package: flip one byte in the payload
+cp "$DIR/v1-v2.pkg" "$DIR/v1-v2.bad.pkg"
+printf '\377' | dd of="$DIR/v1-v2.bad.pkg" bs=1 seek=300 conv=notrunc 2> /dev/null
+
+echo "== boot tests"
+check "no update: app launches"				launched --app "$DIR/v1.bin" --expect "$DIR/v1.bin"
+check "full image update"				launched --app "$DIR/v1.bin" --primary "$DIR/v2.bin" --update --expect "$DIR/v2.bin"
+check "delta update v1 -> v2"				launched --app "$DIR/v1.bin" --primary "$DIR/v1-v2.pkg" --update --expect "$DIR/v2.bin"
+check "delta update v1 -> v3"				launched --app "$DIR/v1.bin" --primary "$DIR/v1-v3.pkg" --update --expect "$DIR/v3.bin"
+check "delta update that grows the image"		launched --app "$DIR/v2.bin" --primary "$DIR/v2-w2.pkg" --update --expect "$DIR/w2.bin"
+check "corrupted delta is ignored"			launched --app "$DIR/v1.bin" --primary "$DIR/v1-v2.bad.pkg" --update --expect "$DIR/v1.bin"
+check "delta for another base is ignored"		launched --app "$DIR/other.bin" --primary "$DIR/v1-v2.pkg" --update --expect "$DIR/other.bin"
+check "delta with no app uses the fallback"		launched --primary "$DIR/v1-v2.pkg" --fallback "$DIR/v1.bin" --expect "$DIR/v1.bin"
+check "delta with no app and no fallback fails"	"failed: NoAppImage (3)" --primary "$DIR/v1-v2.pkg"
+
+echo
+echo "== waits: a full update, then a delta, sleeping then spinning"
+for WAIT in sleep spin; do
+	for PRIMARY in v2.bin v1-v2.pkg; do
+		printf "%-5s %-10s " "$WAIT" "$PRIMARY"
+		"$SIM" -v --wait "$WAIT" --boot "$DIR/boot.bin" --app "$DIR/v1.bin" --primary "$DIR/$PRIMARY" --update |
+			sed -n -e 's/^waits: //p'
+	done
+done
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
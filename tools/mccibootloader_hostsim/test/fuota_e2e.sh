@@ -0,0 +1,100 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  fuota_e2e.sh
+#
+# Function:
+#	End-to-end test of FUOTA fragments: sign an image and fragment it
+#	with mccibootloader_image, then deliver the fragments with losses,
+#	rebuild the image in storage, and check it with
+#	mccibootloader_hostsim.
+#
+# Usage:
+#	fuota_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# copy a file, changing one byte: from to offset
+damage() {
+	cp "$1" "$2"
+	printf '\125' | dd of="$2" bs=1 seek="$3" conv=notrunc 2> /dev/null
+}
+
+# run a case: name, expected status (pass or fail), pattern, then simulator args
+check() {
+	NAME="$1"
+	STATUS="$2"
+	PATTERN="$3"
+	shift 3
+
+	if RESULT="$("$SIM" --boot "$DIR/boot.bin" "$@")"; then
+		GOT=pass
+	else
+		GOT=fail
+	fi
+
+	if [ "$GOT" = "$STATUS" ] && echo "$RESULT" | grep -q -e "$PATTERN" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		echo "$RESULT" | sed -e 's/^/	/'
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+echo "== fragments (synthetic image)"
+"$SIM" --make-image --address 0x08005000 --size 20000 --seed 5 "$DIR/app.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time \
+	--fuota-output "$DIR/app.frag" --fragment-size 50 --fuota-redundancy 40 \
+	"$DIR/app.raw" "$DIR/app.bin"
+echo
+
+# the first uncoded fragment's data starts after the 16-byte header and
+# its own 2-byte index.
+damage "$DIR/app.frag" "$DIR/app.bad.frag" $((16 + 2 + 20))
+
+echo "== delivery tests"
+check "no loss"				pass "rebuilt 100 of 100"	--fuota "$DIR/app.frag" --expect "$DIR/app.bin"
+check "10% loss"			pass "rebuilt 100 of 100"	--fuota "$DIR/app.frag" --loss 10 --expect "$DIR/app.bin"
+check "20% loss"			pass "rebuilt 100 of 100"	--fuota "$DIR/app.frag" --loss 20 --expect "$DIR/app.bin"
+check "too much loss is not an error"	pass "rebuilt 0 of 100"	--fuota "$DIR/app.frag" --loss 45 --expect "$DIR/app.bin"
+check "bad fragment fails the check"	fail "storage check: 0 passed, 1 failed" --fuota "$DIR/app.bad.frag" --trials 1
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
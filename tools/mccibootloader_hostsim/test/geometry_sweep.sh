@@ -0,0 +1,255 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  geometry_sweep.sh
+#
+# Function:
+#	Benchmark the bootloader's image block geometry: build
+#	mccibootloader_hostsim for a range of block sizes and buffer
+#	counts, run the same updates with each, model the time each
+#	would take on the device, and recommend a setting for each board.
+#
+# Usage:
+#	geometry_sweep.sh {mccibootloader_image} {keyfile} {workdir} [options]
+#
+#	--sizes "n ..."	block sizes to try (default 256 to 8192)
+#	--counts "n ..."	buffer counts to try (default 1 2 4)
+#	--sha-us n	modeled time of one SHA-512 block on the device
+#			(default 600 microseconds)
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	April 2021
+#
+##############################################################################
+
+set -e
+
+TOOL="$1"
+KEY="$2"
+DIR="$3"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {mccibootloader_image} {keyfile} {workdir} [--sizes \"n ...\"] [--counts \"n ...\"] [--sha-us n]" 1>&2
+	exit 1
+fi
+shift 3
+
+SIZES="256 512 1024 2048 4096 8192"
+COUNTS="1 2 4"
+SHA_US=600
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	--sizes)	SIZES="$2"; shift 2 ;;
+	--counts)	COUNTS="$2"; shift 2 ;;
+	--sha-us)	SHA_US="$2"; shift 2 ;;
+	*)		echo "$0: unknown option: $1" 1>&2; exit 1 ;;
+	esac
+done
+
+SRCDIR="$(cd "$(dirname "$0")/.." && pwd)"
+mkdir -p "$DIR"
+DIR="$(cd "$DIR" && pwd)"
+rm -rf "$DIR"/*
+
+##############################################################################
+#
+#	The boards. Each line gives the target, the RAM available for the
+#	block buffer, the SPI time per byte (ns), and the time per read
+#	transaction (ns): the 4-byte command, chip select and the calls.
+#	Today the ABZ boards are the same here: they share a link script,
+#	and an MX25V8035F on SPI2 at 16 MHz, polled a byte at a time.
+#
+##############################################################################
+
+BOARDS="\
+McciBootloader_4801	4096	1000	10000
+McciBootloader_46xx	4096	1000	10000
+"
+
+NFAIL=0
+
+# make an image: name address size seed edits
+makeImage() {
+	"$SIM0" --make-image --address "$2" --size "$3" --seed "$4" --edits "$5" "$DIR/$1.raw"
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/$1.raw" "$DIR/$1.bin" > /dev/null
+}
+
+# copy a file, changing one byte: from to offset
+damage() {
+	cp "$1" "$2"
+	printf '\125' | dd of="$2" bs=1 seek="$3" conv=notrunc 2> /dev/null
+}
+
+# build the simulator for a geometry: size count; sets SIM
+buildSim() {
+	BUILD="$DIR/build-$1x$2"
+	make -C "$SRCDIR" --no-print-directory \
+		T_BUILDTREE="$BUILD" \
+		MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE="$1" \
+		MCCI_BOOTLOADER_IMAGE_BLOCK_COUNT="$2" \
+		all > "$BUILD.log" 2>&1 || { cat "$BUILD.log" 1>&2; exit 1; }
+	SIM="$(find "$BUILD" -type f -name mccibootloader_hostsim -perm -u+x | head -n 1)"
+}
+
+# run a scenario, and append the counts to the results:
+#	size count scenario expected-first-line, then simulator args
+# results: size count scenario ok erased written bytes reads scratch
+run() {
+	S="$1"
+	N="$2"
+	SCENARIO="$3"
+	EXPECT="$4"
+	shift 4
+
+	RESULT="$("$SIM" -v --boot "$DIR/boot.bin" "$@" || true)"
+	OK=1
+	if [ "$(echo "$RESULT" | head -n 1)" != "$EXPECT" ] || echo "$RESULT" | grep -q "does not match" ; then
+		echo "FAIL: ${S}x${N} $SCENARIO" 1>&2
+		echo "$RESULT" | sed -e 's/^/	/' 1>&2
+		OK=0
+		NFAIL=$((NFAIL + 1))
+	fi
+
+	COUNTS_LINE="$(echo "$RESULT" | sed -n -e 's/^pages erased: \([0-9]*\), bytes written: \([0-9]*\), storage bytes read: \([0-9]*\) in \([0-9]*\) reads.*/\1 \2 \3 \4/p')"
+	SCRATCH=0
+	if echo "$RESULT" | grep -q "^host stack used: .*signature check" ; then
+		SCRATCH=1
+	fi
+	echo "$S $N $SCENARIO $OK $COUNTS_LINE $SCRATCH" >> "$DIR/results.txt"
+}
+
+##############################################################################
+#
+#	The images don't depend on the geometry; the tables and deltas do.
+#	v1 is in flash; w1 is a new app, and v2 is v1 with a few edits.
+#
+##############################################################################
+
+buildSim 4096 1
+SIM0="$SIM"
+
+"$SIM0" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+makeImage v1 0x08005000 98304 7 0
+makeImage v2 0x08005000 98304 7 4
+makeImage w1 0x08005000 131072 11 0
+IMAGESIZE=$(wc -c < "$DIR/w1.bin")
+
+echo "== image block geometry sweep: w1 is $IMAGESIZE bytes, v1 to v2 is a delta"
+echo "   full: update to w1 with one hash; table: update to w1 with a block hash table"
+echo "   reject: reject w1 with a table, damaged at offset 5000; delta: update v1 to v2"
+echo
+
+for S in $SIZES; do
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time --block-size "$S" \
+		--block-hash-output "$DIR/w1-$S.img" "$DIR/w1.raw" "$DIR/w1-$S.bin" > /dev/null
+	damage "$DIR/w1-$S.img" "$DIR/w1-$S.bad.img" 5000
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time --block-size "$S" \
+		--delta-base "$DIR/v1.bin" --delta-output "$DIR/v1-v2-$S.pkg" \
+		"$DIR/v2.raw" "$DIR/v2-$S.bin" > /dev/null
+
+	for N in $COUNTS; do
+		# the headers must fit in the buffer
+		if [ $((S * N)) -lt 512 ]; then
+			continue
+		fi
+
+		buildSim "$S" "$N"
+		run "$S" "$N" full	launched --app "$DIR/v1.bin" --primary "$DIR/w1.bin" --update --expect "$DIR/w1.bin"
+		run "$S" "$N" table	launched --app "$DIR/v1.bin" --primary "$DIR/w1-$S.img" --update --expect "$DIR/w1.bin"
+		run "$S" "$N" reject	launched --app "$DIR/v1.bin" --primary "$DIR/w1-$S.bad.img" --update --expect "$DIR/v1.bin"
+		run "$S" "$N" delta	launched --app "$DIR/v1.bin" --primary "$DIR/v1-v2-$S.pkg" --update --expect "$DIR/v2.bin"
+	done
+done
+
+##############################################################################
+#
+#	Model each board. The flash times are the typical STM32L0 page
+#	erase and half-page programming times (3.2 ms); a table adds one
+#	SHA-512 block per image block, and half a block per hash in the
+#	table. The score is the sum of the three updates; the rejection
+#	cost is shown, but not scored. A geometry is only recommended if
+#	the buffer fits the board's RAM, holds the block hash table, and
+#	is big enough to be the stack for the signature check.
+#
+##############################################################################
+
+echo "$BOARDS" | while read BOARD RAM NS_BYTE NS_READ; do
+	[ -n "$BOARD" ] || continue
+
+	echo "== $BOARD: $RAM bytes for the buffer, $NS_BYTE ns per SPI byte, $NS_READ ns per read"
+	awk -v ram="$RAM" -v nsByte="$NS_BYTE" -v nsRead="$NS_READ" -v shaUs="$SHA_US" \
+	    -v imageSize="$IMAGESIZE" -v board="$BOARD" '
+	function model(erased, written, bytes, reads) {
+		return (reads * nsRead + bytes * nsByte) / 1e6 + (erased + written / 64) * 3.2;
+	}
+	{
+		key = $1 "x" $2;
+		if (! (key in seen)) {
+			seen[key] = 1;
+			order[n++] = key;
+			size[key] = $1;
+			count[key] = $2;
+			ok[key] = 1;
+			scratch[key] = 1;
+		}
+		ok[key] = ok[key] && $4;
+		scratch[key] = scratch[key] && $9;
+		t[key, $3] = model($5, $6, $7, $8);
+		read[key, $3] = $7;
+	}
+	END {
+		printf "%-10s %7s %9s %9s %9s %9s %9s  %s\n", "geometry", "buffer", "full", "table", "delta", "score", "reject", "notes";
+		best = "";
+		for (i = 0; i < n; ++i) {
+			k = order[i];
+			buffer = size[k] * count[k];
+			# one padding block per image block, and the table itself
+			nBlocks = int((imageSize + size[k] - 1) / size[k]);
+			# without the table, rejecting reads the whole image
+			fTable = read[k, "reject"] < imageSize;
+			tTable = t[k, "table"];
+			if (fTable)
+				tTable += nBlocks * 1.5 * shaUs / 1000;
+			score = t[k, "full"] + tTable + t[k, "delta"];
+			notes = "";
+			if (! ok[k])
+				notes = notes " FAILED";
+			if (buffer > ram)
+				notes = notes " too big for RAM";
+			if (! scratch[k])
+				notes = notes " verifier on stack";
+			if (! fTable)
+				notes = notes " table too big";
+			printf "%-10s %7d %7.0fms %7.0fms %7.0fms %7.0fms %8dB %s\n", k, buffer, t[k, "full"], tTable, t[k, "delta"], score, read[k, "reject"], notes;
+			if (ok[k] && buffer <= ram && scratch[k] && fTable &&
+			    (best == "" || score < bestScore - 0.5 || (score < bestScore + 0.5 && buffer < bestBuffer))) {
+				best = k;
+				bestScore = score;
+				bestBuffer = buffer;
+			}
+		}
+		if (best == "")
+			printf "recommended for %s: none of these fit\n", board;
+		else
+			printf "recommended for %s: BOOTLOADER_IMAGE_BLOCK_SIZE %d, BOOTLOADER_IMAGE_BLOCK_COUNT %d (%.0f ms)\n", board, size[best], count[best], bestScore;
+	}' "$DIR/results.txt"
+	echo
+done
+
+if [ "$NFAIL" -ne 0 ]; then
+	echo "$NFAIL failed"
+	exit 1
+fi
@@ -0,0 +1,172 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  power_e2e.sh
+#
+# Function:
+#	End-to-end test of power failures: run mccibootloader_hostsim
+#	with --power-cut-every, so that each boot is interrupted after
+#	every flash erase, half-page program and EEPROM write in turn,
+#	and check that the next boot always ends well: with the app the
+#	uninterrupted boot launched, or, where the design says so, with
+#	the fallback image or the old app. Then reports what recovering
+#	costs, as a benchmark.
+#
+# Usage:
+#	power_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	April 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+SRCDIR="$(cd "$(dirname "$0")/.." && pwd)"
+mkdir -p "$DIR"
+DIR="$(cd "$DIR" && pwd)"
+rm -rf "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# build the simulator with two app banks, as test/banks_e2e.sh does
+BUILD="$DIR/build"
+make -C "$SRCDIR" --no-print-directory \
+	T_BUILDTREE="$BUILD" \
+	MCCI_BOOTLOADER_APP_BANKS=2 \
+	all > "$BUILD.log" 2>&1 || { cat "$BUILD.log" 1>&2; exit 1; }
+SIM2="$(find "$BUILD" -type f -name mccibootloader_hostsim -perm -u+x | head -n 1)"
+
+# make a signed image: name address size seed [edits]
+makeImage() {
+	"$SIM" --make-image --address "$2" --size "$3" --seed "$4" --edits "${5:-0}" "$DIR/$1.raw"
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/$1.raw" "$DIR/$1.bin" > /dev/null
+}
+
+# copy a file, changing one byte: from to offset
+damage() {
+	cp "$1" "$2"
+	printf '\125' | dd of="$2" bs=1 seek="$3" conv=notrunc 2> /dev/null
+}
+
+# run a campaign, cutting after every operation: name, simulator, then
+# a shell condition on OPS (the operations in the uninterrupted boot),
+# CUTS, RECOVERED, FELLBACK, KEPT and FAILED (the counts from the
+# summary) and RESULT, then simulator args.
+check() {
+	NAME="$1"
+	CHECKSIM="$2"
+	COND="$3"
+	shift 3
+
+	STATUS=0
+	RESULT="$("$CHECKSIM" --boot "$DIR/boot.bin" --power-cut-every 1 "$@" 2>&1)" || STATUS=$?
+	COUNTS="$(echo "$RESULT" | sed -n -e 's/^all: \([0-9]*\) cuts, \([0-9]*\) recovered, \([0-9]*\) fell back, \([0-9]*\) kept old app, \([0-9]*\) failed;.*/\1 \2 \3 \4 \5/p')"
+	read CUTS RECOVERED FELLBACK KEPT FAILED <<-EOF
+		${COUNTS:-0 0 0 0 0}
+	EOF
+	OPS="$(echo "$RESULT" | sed -n -e 's/^launched at .* after \([0-9]*\) operations.*/\1/p')"
+
+	if [ "$STATUS" -eq 0 ] && eval "$COND" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		echo "$RESULT" | sed -e 's/^/	/'
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# report the cost of recovery: name, simulator, then simulator args
+bench() {
+	printf "%-36s" "$1"
+	BENCHSIM="$2"
+	shift 2
+	"$BENCHSIM" --boot "$DIR/boot.bin" --power-cut-every 1 "$@" |
+		sed -n \
+			-e 's/^launched at .* estimated device time: \(.*\)/boot \1;/p' \
+			-e 's/^all: \([0-9]*\) cuts,.*; recovery mean \([0-9.]* ms\), max \([0-9.]* ms\).*/\1 cuts, recovery mean \2, max \3/p' |
+		paste -s -d ' ' -
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+makeImage old 0x08005000 20000 2
+makeImage new 0x08005000 24000 3
+makeImage v2 0x08005000 24000 3 4
+damage "$DIR/old.bin" "$DIR/old.bad.bin" 5000
+damage "$DIR/new.bin" "$DIR/new.bad.bin" 5000
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time \
+	--compressed-output "$DIR/new.pkg" "$DIR/new.raw" "$DIR/new.bin" > /dev/null
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time \
+	--delta-base "$DIR/new.bin" --delta-output "$DIR/new-v2.pkg" "$DIR/v2.raw" "$DIR/v2.bin" > /dev/null
+
+# the banks: a1 and b1 run in bank 1, b2 in bank 2.
+makeImage a1 0x08005000 20000 7
+makeImage b1 0x08005000 20000 9
+makeImage b2 0x08018000 20000 8
+damage "$DIR/a1.bin" "$DIR/a1.bad.bin" 5000
+
+ALL='[ "$CUTS" -gt 0 ] && [ "$RECOVERED" -eq "$CUTS" ]'
+
+echo "== power failures"
+check "(2) launch: nothing to cut" "$SIM"			'echo "$RESULT" | grep -q "^nothing to cut"' \
+	--app "$DIR/old.bin" --expect "$DIR/old.bin"
+check "(4) update: always the new app" "$SIM"			"$ALL" \
+	--app "$DIR/old.bin" --primary "$DIR/new.bin" --update --expect "$DIR/new.bin"
+check "(4) compressed update" "$SIM"				"$ALL" \
+	--app "$DIR/old.bin" --primary "$DIR/new.pkg" --update --expect "$DIR/new.bin"
+check "(5) no app: from the primary image" "$SIM"		"$ALL" \
+	--app "$DIR/old.bad.bin" --primary "$DIR/new.bin" --expect "$DIR/new.bin"
+check "(5) no app: compressed primary image" "$SIM"		"$ALL" \
+	--primary "$DIR/new.pkg" --expect "$DIR/new.bin"
+check "(6) bad primary: from the fallback image" "$SIM"	"$ALL" \
+	--app "$DIR/old.bad.bin" --primary "$DIR/new.bad.bin" --fallback "$DIR/new.bin" --expect "$DIR/new.bin"
+check "(6) bad primary, update flag set" "$SIM"		"$ALL" \
+	--app "$DIR/old.bad.bin" --primary "$DIR/new.bad.bin" --fallback "$DIR/new.bin" --update --expect "$DIR/new.bin"
+check "delta update: new app, or the fallback" "$SIM"		'[ "$CUTS" -gt 0 ] && [ "$RECOVERED" -gt 0 ] && [ "$FELLBACK" -gt 0 ] && [ "$KEPT" -eq 0 ]' \
+	--app "$DIR/new.bin" --primary "$DIR/new-v2.pkg" --fallback "$DIR/new.bin" --update --expect "$DIR/v2.bin"
+check "cutting every 10th operation" "$SIM"		'[ "$CUTS" -eq $((OPS / 10)) ] && [ "$FAILED" -eq 0 ]' \
+	--app "$DIR/old.bin" --primary "$DIR/new.bin" --update --power-cut-every 10
+check "two banks: switch to the new app, or keep the old" "$SIM2"	'[ "$CUTS" -gt 0 ] && [ "$FELLBACK" -eq 0 ] && [ "$RECOVERED" -gt 0 ] && [ "$FAILED" -eq 0 ]' \
+	--app "$DIR/a1.bin" --bank2 "$DIR/b2.bin" --update --expect "$DIR/b2.bin"
+check "two banks: roll over from a bad bank" "$SIM2"		"$ALL" \
+	--app "$DIR/a1.bad.bin" --bank2 "$DIR/b2.bin" --expect "$DIR/b2.bin"
+check "two banks: no good bank, bank 1 from storage" "$SIM2"	"$ALL" \
+	--app "$DIR/a1.bad.bin" --primary "$DIR/b1.bin" --expect "$DIR/b1.bin"
+check "two banks: no good bank, bank 2 from storage" "$SIM2"	"$ALL" \
+	--app "$DIR/a1.bad.bin" --primary "$DIR/b2.bin" --expect "$DIR/b2.bin"
+echo
+
+echo "== cost of recovery"
+bench "(4) update"			"$SIM" --app "$DIR/old.bin" --primary "$DIR/new.bin" --update
+bench "(4) compressed update"		"$SIM" --app "$DIR/old.bin" --primary "$DIR/new.pkg" --update
+bench "(6) from the fallback"		"$SIM" --app "$DIR/old.bad.bin" --primary "$DIR/new.bad.bin" --fallback "$DIR/new.bin"
+bench "delta update"			"$SIM" --app "$DIR/new.bin" --primary "$DIR/new-v2.pkg" --fallback "$DIR/new.bin" --update
+bench "two banks: from storage"		"$SIM2" --app "$DIR/a1.bad.bin" --primary "$DIR/b2.bin"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
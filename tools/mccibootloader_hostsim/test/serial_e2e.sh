@@ -0,0 +1,154 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  serial_e2e.sh
+#
+# Function:
+#	End-to-end test of serial recovery: run mccibootloader_hostsim
+#	with its serial port on a pseudo-terminal, send it images with
+#	`mccibootloader_image --send`, and check that good images are
+#	programmed and launched, and that bad ones are refused.
+#
+# Usage:
+#	serial_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	April 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+DIR="$(cd "$DIR" && pwd)"
+rm -rf "$DIR"/*
+
+NPASS=0
+NFAIL=0
+SIMPID=
+
+trap '[ -n "$SIMPID" ] && kill $SIMPID 2> /dev/null' EXIT
+
+# record a result: name, then a command that succeeds if the case passes
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		sed -e 's/^/	/' "$DIR/sim.log" "$DIR/send.log" 2> /dev/null || true
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# make a signed image: name address size seed [key]
+makeImage() {
+	"$SIM" --make-image --address "$2" --size "$3" --seed "$4" "$DIR/$1.raw"
+	"$TOOL" -s -k "${5:-$KEY}" --force-binary --no-add-time "$DIR/$1.raw" "$DIR/$1.bin" > /dev/null
+}
+
+# start the simulator in the background with a serial port; simulator args
+startSim() {
+	rm -f "$DIR/tty" "$DIR/sim.log" "$DIR/send.log"
+	"$SIM" -v --boot "$DIR/boot.bin" --serial "$DIR/tty" --serial-idle 1000 "$@" > "$DIR/sim.log" 2>&1 &
+	SIMPID=$!
+	for _ in $(seq 50); do
+		[ -e "$DIR/tty" ] && return 0
+		# it may have run without the port, and gone
+		kill -0 $SIMPID 2> /dev/null || return 0
+		sleep 0.1
+	done
+	return 1
+}
+
+# send an image: expected result, image, then extra args for the sender
+send() {
+	EXPECT="$1"
+	FILE="$2"
+	shift 2
+
+	"$TOOL" --send "$DIR/tty" --force-binary "$@" "$FILE" >> "$DIR/send.log" 2>&1 || true
+	[ "$(sed -n -e 's/^result: \([A-Za-z]*\) .*/\1/p' "$DIR/send.log" | tail -n 1)" = "$EXPECT" ]
+}
+
+# wait for the simulator to finish: expected first line
+endSim() {
+	wait $SIMPID || true
+	SIMPID=
+	[ "$(head -n 1 "$DIR/sim.log")" = "$1" ] && ! grep -q "does not match" "$DIR/sim.log"
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+makeImage old 0x08005000 30000 2
+makeImage app 0x08005000 60000 3
+makeImage elsewhere 0x08010000 20000 4
+cp "$DIR/app.bin" "$DIR/bad.bin"
+printf '\125' | dd of="$DIR/bad.bin" bs=1 seek=5000 conv=notrunc 2> /dev/null
+
+echo "== serial recovery"
+check "no app: image is received and launched" \
+	eval 'startSim --expect "$DIR/app.bin" && send OK "$DIR/app.bin" && endSim launched'
+check "lost frames are sent again" \
+	eval 'startSim --expect "$DIR/app.bin" && send OK "$DIR/app.bin" --send-corrupt 5 && endSim launched && ! grep -q " 0 frame(s) resent" "$DIR/send.log"'
+check "window of one frame" \
+	eval 'startSim --expect "$DIR/app.bin" && send OK "$DIR/app.bin" --send-window 1 && endSim launched'
+check "recovery on request replaces a good app" \
+	eval 'startSim --app "$DIR/old.bin" --recover --expect "$DIR/app.bin" && send OK "$DIR/app.bin" && endSim launched'
+check "...with the annunciator set up first, once" \
+	eval 'grep -q "^annunciator: " "$DIR/sim.log" && ! grep -q "before annunciatorInit\|set up [0-9]* times" "$DIR/sim.log"'
+check "without a request, the good app runs" \
+	eval 'startSim --app "$DIR/old.bin" --expect "$DIR/old.bin" && endSim launched'
+check "damaged image is refused, then a good one is taken" \
+	eval 'startSim --expect "$DIR/app.bin" && send SignatureNotValid "$DIR/bad.bin" && send OK "$DIR/app.bin" && endSim launched'
+check "refused image leaves no app to launch" \
+	eval 'startSim --app "$DIR/old.bin" --recover && send SignatureNotValid "$DIR/bad.bin" && endSim "failed: NoAppImage (3)"'
+check "image for another address is refused" \
+	eval 'startSim && send ImageNotValid "$DIR/elsewhere.bin" && endSim "failed: NoAppImage (3)"'
+if command -v ssh-keygen > /dev/null; then
+	ssh-keygen -q -t ed25519 -N "" -C other -f "$DIR/other.pem"
+	makeImage other 0x08005000 20000 5 "$DIR/other.pem"
+	check "image signed with another key is refused" \
+		eval 'startSim && send SignatureNotValid "$DIR/other.bin" && endSim "failed: NoAppImage (3)"'
+fi
+check "sender won't send an image that fails its checks" \
+	eval '! "$TOOL" --send /dev/null --force-binary -k "$KEY" "$DIR/bad.bin" > /dev/null 2>&1'
+
+echo
+echo "== cost of a recovery"
+startSim --expect "$DIR/app.bin"
+"$TOOL" --send "$DIR/tty" --force-binary "$DIR/app.bin" | sed -n -e 's/^sent/host: sent/p'
+wait $SIMPID || true
+SIMPID=
+sed -n -e 's/^estimated device time/device: estimated flash time/p' -e 's/^serial:/device: serial:/p' "$DIR/sim.log"
+# the pty is much faster than a real port; show what the wire would take.
+sed -n -e 's/^serial: \([0-9]*\) bytes in.*/\1/p' "$DIR/sim.log" |
+	awk '{ printf "device: %d bytes take %.1f ms at 921600 baud, while flash is written\n", $1, $1 * 10 * 1000 / 921600 }'
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
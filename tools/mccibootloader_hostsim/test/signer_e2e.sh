@@ -0,0 +1,139 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  signer_e2e.sh
+#
+# Function:
+#	End-to-end test of the signer backends: sign images with a key
+#	file, with an external signer process, and with the signing
+#	daemon, singly and in batches, and boot the results with
+#	mccibootloader_hostsim.
+#
+# Usage:
+#	signer_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -rf "$DIR"/*
+
+NPASS=0
+NFAIL=0
+NIMAGES=12
+SOCKET="$DIR/signer.sock"
+HSM="$TOOL --daemon --stdio -v -k $KEY"
+
+# report a result: name, then a command that succeeds if the case passed
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# compare each image in a directory with the one signed with the key file
+sameAsKeyfile() {
+	for i in $(seq 1 $NIMAGES); do
+		cmp -s "$DIR/keyfile/app$i.bin" "$DIR/$1/app$i.bin" || return 1
+	done
+}
+
+# boot a storage image, and check the app: storage-file expected-app
+boots() {
+	RESULT="$("$SIM" --boot "$DIR/boot.bin" --primary "$1" --update --expect "$2" || true)"
+	[ "$(echo "$RESULT" | head -n 1)" = "launched" ] && ! echo "$RESULT" | grep -q "does not match"
+}
+
+# write an OpenSSH public key file for a key the signer doesn't have
+otherKey() {
+	{ printf '\000\000\000\013ssh-ed25519\000\000\000\040'; head -c 32 "$DIR/app1.raw"; } |
+		base64 | tr -d '\n' | sed -e 's/^/ssh-ed25519 /' -e 's/$/ other/' > "$1"
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+mkdir "$DIR/keyfile" "$DIR/command" "$DIR/daemon"
+for i in $(seq 1 $NIMAGES); do
+	"$SIM" --make-image --address 0x08005000 --size $((20000 + 1000 * i)) --seed $i "$DIR/app$i.raw"
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/app$i.raw" "$DIR/keyfile/app$i.bin"
+	echo "$DIR/app$i.raw $DIR/command/app$i.bin" >> "$DIR/command.list"
+	echo "$DIR/app$i.raw $DIR/daemon/app$i.bin" >> "$DIR/daemon.list"
+done
+
+echo "== batch signing"
+"$TOOL" -s --batch --signer-command "$HSM" --force-binary --no-add-time @"$DIR/command.list" 2> "$DIR/command.log"
+grep -c '^request' "$DIR/command.log" | sed -e 's/^/signer requests: /'
+
+"$TOOL" --daemon --socket "$SOCKET" -k "$KEY" &
+DAEMON=$!
+trap 'kill $DAEMON 2> /dev/null' EXIT
+while [ ! -S "$SOCKET" ]; do sleep 0.1; done
+
+"$TOOL" -s --batch --socket "$SOCKET" --force-binary --no-add-time @"$DIR/daemon.list"
+echo
+
+echo "== signer tests"
+check "external signer batch matches key file"	sameAsKeyfile command
+check "external signer batch is one request"	grep -q '^request 2: opcode 5, 800 bytes in, 768 bytes out, status 0$' "$DIR/command.log"
+check "external signer got no more requests"	[ "$(grep -c '^request' "$DIR/command.log")" -eq 2 ]
+check "daemon batch matches key file"		sameAsKeyfile daemon
+check "batch-signed image boots"		boots "$DIR/command/app$NIMAGES.bin" "$DIR/keyfile/app$NIMAGES.bin"
+
+"$TOOL" -s --signer-command "$HSM" --force-binary --no-add-time \
+	--compressed-output "$DIR/app1.pkg" "$DIR/app1.raw" "$DIR/command/single1.bin" > /dev/null 2>&1
+check "external signer signs one image"		cmp -s "$DIR/keyfile/app1.bin" "$DIR/command/single1.bin"
+check "external signer signs packages"		boots "$DIR/app1.pkg" "$DIR/keyfile/app1.bin"
+otherKey "$DIR/other.pem.pub"
+check "unknown key is refused"			sh -c "'$TOOL' -s --signer-command '$HSM' --public-key '$DIR/other.pem.pub' --force-binary '$DIR/app1.raw' '$DIR/x.bin' 2>&1 | grep -q \"doesn't have the key\""
+check "failed signer is reported"		sh -c "! '$TOOL' -s --signer-command false --force-binary '$DIR/app1.raw' '$DIR/x.bin' 2> /dev/null"
+
+# an output that can't be written fails that image, not the batch.
+mkdir "$DIR/partial"
+if "$TOOL" -s --batch -k "$KEY" --force-binary --no-add-time \
+	"$DIR/app1.raw" "$DIR/partial/app1.bin" \
+	"$DIR/app2.raw" "$DIR/missing/app2.bin" \
+	"$DIR/app3.raw" "$DIR/partial/app3.bin" > "$DIR/partial.log" 2>&1; then
+	PARTIAL=0
+else
+	PARTIAL=$?
+fi
+check "unwritable output fails the batch"	[ "$PARTIAL" -eq 1 ]
+check "...and the other images are written"	sh -c "cmp -s '$DIR/keyfile/app1.bin' '$DIR/partial/app1.bin' && cmp -s '$DIR/keyfile/app3.bin' '$DIR/partial/app3.bin'"
+check "...and counted"				grep -q '^signed 2 of 3 image(s)' "$DIR/partial.log"
+check "...and the failure is summarized"	grep -q "^  $DIR/app2.raw: can't create: $DIR/missing/app2.bin: No such file or directory\$" "$DIR/partial.log"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
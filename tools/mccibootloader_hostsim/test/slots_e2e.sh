@@ -0,0 +1,141 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  slots_e2e.sh
+#
+# Function:
+#	End-to-end test of the slot directory: sign images of different
+#	versions with mccibootloader_image, place them in storage with a
+#	signed directory, and recover the app with mccibootloader_hostsim.
+#	Also benchmarks slot selection with and without the directory.
+#
+# Usage:
+#	slots_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	April 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# the slots: the usual fallback and primary, and one more.
+FALLBACK=0x10000
+PRIMARY=0x40000
+SLOT3=0x80000
+
+# make a signed image: name size seed version
+makeImage() {
+	"$SIM" --make-image --address 0x08005000 --size "$2" --seed "$3" "$DIR/$1.raw"
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time -V "$4" "$DIR/$1.raw" "$DIR/$1.bin" > /dev/null
+}
+
+# copy a file, changing one byte: from to offset
+damage() {
+	cp "$1" "$2"
+	printf '\125' | dd of="$2" bs=1 seek="$3" conv=notrunc 2> /dev/null
+}
+
+# run a case: name, expected first line, then simulator args
+check() {
+	NAME="$1"
+	EXPECT="$2"
+	shift 2
+
+	RESULT="$("$SIM" --boot "$DIR/boot.bin" "$@" || true)"
+	if [ "$(echo "$RESULT" | head -n 1)" = "$EXPECT" ] && ! echo "$RESULT" | grep -q "does not match" ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		echo "$RESULT" | sed -e 's/^/	/'
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# report the cost of recovering the app: name, then simulator args
+bench() {
+	printf "%-44s" "$1"
+	shift
+	"$SIM" -v --boot "$DIR/boot.bin" "$@" |
+		sed -n \
+			-e 's/^pages erased.*storage bytes read: \([0-9]*\) in \([0-9]*\) reads.*/\1 bytes in \2 reads, /p' \
+			-e 's/^estimated device time:.*(storage \([0-9.]*\) ms.*/storage \1 ms, /p' \
+			-e 's/^host stack used:.* \([0-9]*\) checks).*/\1 signature checks/p' |
+		tr -d '\n'
+	echo
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+# v1 is the factory image, v2 the last update, v3 the newest.
+makeImage v1 98304 7 1.0.0
+makeImage v2 110592 8 1.1.0
+makeImage v3 122880 9 1.2.0
+makeImage v3b 122880 10 1.2.0
+
+echo "== slot directory"
+"$TOOL" -s -k "$KEY" --slot-directory "$DIR/dir.bin" \
+	$FALLBACK="$DIR/v1.bin" $PRIMARY="$DIR/v2.bin" $SLOT3="$DIR/v3.bin"
+"$TOOL" -s -k "$KEY" --slot-directory "$DIR/dir-old.bin" \
+	$FALLBACK="$DIR/v1.bin" $PRIMARY="$DIR/v2.bin"
+damage "$DIR/dir.bin" "$DIR/dir.bad.bin" 20
+damage "$DIR/v3.bin" "$DIR/v3.bad.bin" 5000
+damage "$DIR/v1.bin" "$DIR/v1.bad.bin" 5000
+damage "$DIR/v2.bin" "$DIR/v2.bad.bin" 5000
+echo
+
+# the app flash is empty, so each boot recovers from storage.
+SLOTS="--fallback $DIR/v1.bin --primary $DIR/v2.bin --slot $SLOT3"
+
+echo "== cost of recovering the app"
+bench "no directory: primary"				$SLOTS "$DIR/v3.bin"
+bench "no directory, bad primary: fallback"		--fallback "$DIR/v1.bin" --primary "$DIR/v2.bad.bin" --slot $SLOT3 "$DIR/v3.bin"
+bench "directory: newest slot"				$SLOTS "$DIR/v3.bin" --directory "$DIR/dir.bin"
+bench "directory, bad primary: newest slot"		--fallback "$DIR/v1.bin" --primary "$DIR/v2.bad.bin" --slot $SLOT3 "$DIR/v3.bin" --directory "$DIR/dir.bin"
+bench "directory, newest slot rewritten: next"		$SLOTS "$DIR/v3b.bin" --directory "$DIR/dir.bin"
+bench "directory, newest slot damaged: next"		$SLOTS "$DIR/v3.bad.bin" --directory "$DIR/dir.bin"
+echo
+
+echo "== boot tests"
+check "no directory: primary, as before"		launched $SLOTS "$DIR/v3.bin" --expect "$DIR/v2.bin"
+check "directory: newest version"			launched $SLOTS "$DIR/v3.bin" --directory "$DIR/dir.bin" --expect "$DIR/v3.bin"
+check "directory without the newest slot"		launched $SLOTS "$DIR/v3.bin" --directory "$DIR/dir-old.bin" --expect "$DIR/v2.bin"
+check "rewritten slot is skipped"			launched $SLOTS "$DIR/v3b.bin" --directory "$DIR/dir.bin" --expect "$DIR/v2.bin"
+check "damaged slot is skipped"				launched $SLOTS "$DIR/v3.bad.bin" --directory "$DIR/dir.bin" --expect "$DIR/v2.bin"
+check "bad directory signature: primary"		launched $SLOTS "$DIR/v3.bin" --directory "$DIR/dir.bad.bin" --expect "$DIR/v2.bin"
+check "no directory, bad primary: fallback"		launched --fallback "$DIR/v1.bin" --primary "$DIR/v2.bad.bin" --slot $SLOT3 "$DIR/v3.bin" --expect "$DIR/v1.bin"
+check "only the oldest slot is good"			launched --fallback "$DIR/v1.bin" --primary "$DIR/v2.bad.bin" --slot $SLOT3 "$DIR/v3.bad.bin" --directory "$DIR/dir.bin" --expect "$DIR/v1.bin"
+check "no good slots"					"failed: NoAppImage (3)" --fallback "$DIR/v1.bad.bin" --primary "$DIR/v2.bad.bin" --slot $SLOT3 "$DIR/v3.bad.bin" --directory "$DIR/dir.bin"
+check "update still uses the primary"			launched --app "$DIR/v1.bin" $SLOTS "$DIR/v3.bin" --directory "$DIR/dir.bin" --update --expect "$DIR/v2.bin"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
@@ -0,0 +1,150 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  trace_e2e.sh
+#
+# Function:
+#	End-to-end test of mccibootloader_image --trace-file and --stats:
+#	sign one image and a batch, and check that the trace is valid
+#	Chrome trace-event JSON with every phase and a span per file, and
+#	that --stats prints the summary.
+#
+# Usage:
+#	trace_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	April 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+NIMAGES=4
+PHASES="scanArgs selfTest setupSigner read parse header hash sign write"
+
+# record a result: name, then a command that succeeds if the case passes
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" > /dev/null 2>&1 ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# succeed if a trace file is well-formed Chrome trace-event JSON: every
+# event names its phase and thread, and every span has a start and a
+# duration.
+validTrace() {
+	python3 - "$1" <<'EOF'
+import json, sys
+
+with open(sys.argv[1]) as f:
+	events = json.load(f)["traceEvents"]
+
+assert len(events) != 0
+for e in events:
+	assert isinstance(e["name"], str) and e["ph"] in ("X", "M")
+	assert isinstance(e["pid"], int) and isinstance(e["tid"], int)
+	if e["ph"] == "X":
+		assert e["cat"] in ("phase", "file")
+		assert e["ts"] >= 0 and e["dur"] >= 0
+		assert e["args"]["cpu_us"] >= 0
+EOF
+}
+
+# succeed if a trace has a span: trace category name [file [count]]
+span() {
+	N="$(grep -c "^{\"name\":\"$3\",\"cat\":\"$2\",\"ph\":\"X\",.*\"args\":{.*${4:+\"file\":\"$4\"}" "$1" || true)"
+	[ "$N" -eq "${5:-1}" ]
+}
+
+# succeed if a trace has every phase: trace
+allPhases() {
+	for PHASE in $PHASES; do
+		grep -q "^{\"name\":\"$PHASE\",\"cat\":\"phase\"" "$1" || return 1
+	done
+}
+
+# succeed if --stats reported a phase: log phase calls
+stat() {
+	grep -q "^$2 *$3 *[0-9.]* *[0-9.]*\$" "$1"
+}
+
+"$SIM" --make-image --address 0x08005000 --size 30000 --seed 1 --elf "$DIR/app.elf" "$DIR/app.raw"
+for i in $(seq 1 $NIMAGES); do
+	"$SIM" --make-image --address 0x08005000 --size $((20000 + 1000 * i)) --seed $i "$DIR/batch$i.raw"
+	echo "$DIR/batch$i.raw $DIR/batch$i.bin" >> "$DIR/batch.list"
+done
+
+echo "== one image"
+"$TOOL" -s -k "$KEY" --stats --trace-file "$DIR/app.json" "$DIR/app.elf" "$DIR/app.out.elf" > "$DIR/app.log"
+if command -v python3 > /dev/null; then
+	check "trace is valid JSON"			validTrace "$DIR/app.json"
+fi
+check "trace has every phase"			allPhases "$DIR/app.json"
+check "...each once"				span "$DIR/app.json" phase hash "$DIR/app.elf"
+check "trace names the process"			grep -q '"name":"process_name","ph":"M",.*"name":"mccibootloader_image"' "$DIR/app.json"
+check "stats has a row per phase"		sh -c "for p in $PHASES; do grep -q \"^\$p  *1 \" '$DIR/app.log' || exit 1; done"
+check "...and the elapsed time"			grep -q '^elapsed: [0-9.]* ms$' "$DIR/app.log"
+check "...and the file"				grep -q "^ *[0-9.]* *[0-9.]*  $DIR/app.elf\$" "$DIR/app.log"
+check "the output is still right"		"$TOOL" --verify -k "$KEY" "$DIR/app.out.elf"
+
+echo
+echo "== batch"
+"$TOOL" -s --batch -j 2 -k "$KEY" --force-binary --stats --trace-file "$DIR/batch.json" @"$DIR/batch.list" > "$DIR/batch.log"
+if command -v python3 > /dev/null; then
+	check "trace is valid JSON"			validTrace "$DIR/batch.json"
+fi
+check "trace has every phase"			allPhases "$DIR/batch.json"
+check "the batch is signed in one span"		span "$DIR/batch.json" phase sign
+for i in $(seq 1 $NIMAGES); do
+	check "batch$i has its file spans"	span "$DIR/batch.json" file "$DIR/batch$i.raw" "$DIR/batch$i.raw" 2
+	check "...and is hashed and written"	sh -c "grep -q '^{\"name\":\"hash\",.*\"file\":\"$DIR/batch$i.raw\"' '$DIR/batch.json' && grep -q '^{\"name\":\"write\",.*\"file\":\"$DIR/batch$i.raw\"' '$DIR/batch.json'"
+done
+check "stats counts each file's phases"		stat "$DIR/batch.log" read $NIMAGES
+check "...and one signing request"		stat "$DIR/batch.log" sign 1
+check "...and names the threads"		grep -q '^elapsed: [0-9.]* ms on [0-9]* threads$' "$DIR/batch.log"
+check "...and lists the files"			grep -q "^$NIMAGES file(s):\$" "$DIR/batch.log"
+
+echo
+echo "== verify"
+"$TOOL" --verify -j 2 -k "$KEY" --force-binary --trace-file "$DIR/verify.json" "$DIR"/batch*.bin > /dev/null
+if command -v python3 > /dev/null; then
+	check "trace is valid JSON"			validTrace "$DIR/verify.json"
+fi
+check "each image is verified in a span"	sh -c "for i in \$(seq 1 $NIMAGES); do grep -q '^{\"name\":\"verify\",.*\"file\":\"$DIR/batch'\$i'.bin\"' '$DIR/verify.json' || exit 1; done"
+check "without --stats, nothing is printed"	sh -c "'$TOOL' -s -k '$KEY' --force-binary --trace-file '$DIR/quiet.json' '$DIR/batch1.raw' '$DIR/quiet.bin' | grep -q . && exit 1; [ -s '$DIR/quiet.json' ]"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
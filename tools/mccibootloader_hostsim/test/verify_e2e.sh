@@ -0,0 +1,235 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  verify_e2e.sh
+#
+# Function:
+#	End-to-end test of mccibootloader_image --verify: check a
+#	directory of good and damaged images, given as a directory and
+#	as list files, with one and with several workers, and check the
+#	result reported for each file, the summary, and the exit status.
+#
+# Usage:
+#	verify_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	April 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -rf "$DIR"/*
+
+NPASS=0
+NFAIL=0
+MIXED="$DIR/mixed"
+APP=0x08005000
+
+# record a result: name, then a command that succeeds if the case passes
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" > /dev/null 2>&1 ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# write a 32-bit little-endian value into a file: file offset value
+put32() {
+	printf "$(printf '\\%03o\\%03o\\%03o\\%03o' \
+		$(($3 & 255)) $((($3 >> 8) & 255)) $((($3 >> 16) & 255)) $((($3 >> 24) & 255)))" |
+		dd of="$1" bs=1 seek=$(($2)) conv=notrunc 2> /dev/null
+}
+
+# flip the bits of the byte at an offset: file offset
+flip() {
+	BYTE=$(od -A n -t u1 -j $(($2)) -N 1 "$1")
+	printf "$(printf '\\%03o' $((BYTE ^ 255)))" |
+		dd of="$1" bs=1 seek=$(($2)) conv=notrunc 2> /dev/null
+}
+
+# make an app image, patch the header, and sign it: name seed [offset value]...
+makeApp() {
+	NAME="$1"
+	"$SIM" --make-image --address $APP --size 12000 --seed "$2" "$DIR/$NAME.raw"
+	shift 2
+	while [ $# -ge 2 ]; do
+		put32 "$DIR/$NAME.raw" "$1" "$2"
+		shift 2
+	done
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/$NAME.raw" "$MIXED/$NAME.bin" > /dev/null
+}
+
+# run --verify, keeping the output and the exit status: log args...
+verify() {
+	LOG="$DIR/$1"
+	shift
+	if "$TOOL" --verify --force-binary "$@" > "$LOG" 2>&1; then
+		STATUS=0
+	else
+		STATUS=$?
+	fi
+}
+
+# succeed if the last verify() exited with the given status
+status() {
+	[ "$STATUS" -eq "$1" ]
+}
+
+# succeed if the last verify() logged the line (a regular expression)
+logged() {
+	grep -q "^$1\$" "$LOG"
+}
+
+# succeed if the last verify() logged nothing matching a regular expression
+lacks() {
+	! grep -q "$1" "$LOG"
+}
+
+# succeed if the last verify() listed a file as failed for the reason
+failed() {
+	logged "  $MIXED/$1: $2"
+}
+
+# succeed if the last verify() listed no failure for the file
+notFailed() {
+	! grep -q "^  $MIXED/$1: " "$LOG"
+}
+
+# succeed if the bootloader launches an app image
+boots() {
+	"$SIM" --boot "$DIR/boot.bin" --app "$1" --expect "$1"
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+mkdir "$MIXED"
+
+# two good images; the second has its entry point just past page zero.
+makeApp good1 1
+makeApp good2 2 4 $((APP + 0x100 + 1))
+
+# damaged headers, signed as they are.
+makeApp stack 3 0 0x20000402
+makeApp entry 4 4 $((APP + 0xFE + 1))
+makeApp thumb 5 4 $((APP + 0x200))
+makeApp target 6 0xC8 0x08010000
+
+# damage after signing.
+makeApp authsize 7
+put32 "$MIXED/authsize.bin" 0xD0 0x40
+makeApp short 8
+head -c 8000 "$MIXED/short.bin" > "$DIR/short.bin"
+mv "$DIR/short.bin" "$MIXED/short.bin"
+makeApp hash 9
+flip "$MIXED/hash.bin" 5000
+makeApp signature 10
+flip "$MIXED/signature.bin" $(($(wc -c < "$MIXED/signature.bin") - 1))
+
+# signed with a key we don't check against.
+if command -v ssh-keygen > /dev/null; then
+	ssh-keygen -q -t ed25519 -N "" -C other -f "$DIR/other.pem"
+	"$TOOL" -s -k "$DIR/other.pem" --force-binary --no-add-time "$DIR/good1.raw" "$MIXED/otherkey.bin" > /dev/null
+	NBAD=9
+else
+	NBAD=8
+fi
+
+# not an image name; directory scans skip it.
+echo "not an image" > "$MIXED/notes.txt"
+NIMAGES=$((NBAD + 2))
+
+echo "== directory"
+verify dir.log -k "$KEY" -j 4 "$MIXED"
+check "mixed directory fails"			status 1
+check "...and counts each image"		logged "verified $NIMAGES image(s): 2 passed, $NBAD failed"
+check "...and lists the failures"		logged "Failures:"
+check "good image passes"			notFailed good1.bin
+check "entry point just past page zero passes"	notFailed good2.bin
+check "bad stack is refused"			failed stack.bin "stack pointer 0x20000402 is not 4-byte aligned"
+check "entry point in page zero is refused"	failed entry.bin "entry point 0x080050ff is outside of the image"
+check "entry point that isn't Thumb is refused"	failed thumb.bin "entry point 0x08005200 is not a Thumb address"
+check "AppInfo for another address is refused"	failed target.bin "AppInfo.targetAddress 0x08010000 is neither the app nor the bootloader base"
+check "AppInfo with a bad authsize is refused"	failed authsize.bin "AppInfo.authsize 0x00000040 is not 0x000000a0"
+check "truncated image is refused"		failed short.bin "file is truncated: AppInfo needs .*"
+check "bad hash is refused"			failed hash.bin "SHA-512 hash mismatch"
+check "bad signature is refused"		failed signature.bin "ed25519 signature is not valid"
+if [ "$NBAD" -eq 9 ]; then
+	check "image from another key is refused" failed otherkey.bin "image was signed with a different public key"
+fi
+check "other files are skipped"			lacks "notes.txt"
+
+verify verbose.log -v -k "$KEY" "$MIXED"
+check "-v lists the good images"		logged "ok: $MIXED/good1.bin (0x08005000, v0.0.0, \"\")"
+check "...and not the bad ones"			lacks "^ok: $MIXED/stack.bin"
+
+echo
+echo "== the bootloader agrees"
+check "entry point just past page zero boots"	boots "$MIXED/good2.bin"
+check "entry point in page zero doesn't"	eval '! boots "$MIXED/entry.bin"'
+check "bad stack doesn't"			eval '! boots "$MIXED/stack.bin"'
+
+echo
+echo "== workers"
+verify j1.log -k "$KEY" -j 1 "$MIXED"
+verify j8.log -k "$KEY" -j 8 "$MIXED"
+check "one worker reports the same as eight"	cmp "$DIR/j1.log" "$DIR/j8.log"
+check "...and as four"				cmp "$DIR/j1.log" "$DIR/dir.log"
+
+echo
+echo "== list files"
+printf '%s\n' "$MIXED/good1.bin" "" "# a comment" "$MIXED/good2.bin" > "$DIR/good.list"
+verify good.log -k "$KEY" @"$DIR/good.list"
+check "good list passes"			status 0
+check "...and counts each image"		logged "verified 2 image(s): 2 passed, 0 failed"
+check "...with no failures listed"		lacks "Failures:"
+
+printf '%s\n' "$MIXED/hash.bin" "$MIXED/missing.bin" > "$DIR/bad.list"
+verify mixed.log -k "$KEY" -j 2 @"$DIR/bad.list" "$MIXED/good1.bin"
+check "list and file together fail"		status 1
+check "...and count each image"			logged "verified 3 image(s): 1 passed, 2 failed"
+check "...naming the bad image"			failed hash.bin "SHA-512 hash mismatch"
+check "...and the missing one"			failed missing.bin "can't read .*"
+
+verify stdin.log -k "$KEY" @- < "$DIR/good.list"
+check "list from stdin passes"			status 0
+
+verify nolist.log -k "$KEY" @"$DIR/nonexistent.list"
+check "missing list file is an error"		status 1
+
+echo
+echo "== embedded key"
+verify nokey.log "$MIXED/good1.bin"
+check "no key checks the embedded key"		status 0
+check "...and says so"				logged "warning: no public key supplied; signatures were checked against the embedded key"
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
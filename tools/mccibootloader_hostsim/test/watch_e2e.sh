@@ -0,0 +1,136 @@
+#!/bin/sh
+
+##############################################################################
+#
+# Module:  watch_e2e.sh
+#
+# Function:
+#	End-to-end test of mccibootloader_image --watch: change the input
+#	in the ways linkers do, and check that each complete version is
+#	signed, and that partial writes are not.
+#
+# Usage:
+#	watch_e2e.sh {hostsim} {mccibootloader_image} {keyfile} {workdir}
+#
+# Copyright notice:
+#	This file copyright (C) 2021 by
+#
+#		MCCI Corporation
+#		3520 Krums Corners Road
+#		Ithaca, NY  14850
+#
+#	See accompanying LICENSE file for license information.
+#
+# Author:
+#	Terry Moore, MCCI Corporation	March 2021
+#
+##############################################################################
+
+set -e
+
+SIM="$1"
+TOOL="$2"
+KEY="$3"
+DIR="$4"
+
+if [ -z "$DIR" ]; then
+	echo "usage: $0 {hostsim} {mccibootloader_image} {keyfile} {workdir}" 1>&2
+	exit 1
+fi
+
+mkdir -p "$DIR"
+rm -rf "$DIR/out"
+rm -f "$DIR"/*
+
+NPASS=0
+NFAIL=0
+
+# record a result: name, then a command that succeeds if the case passes
+check() {
+	NAME="$1"
+	shift
+
+	if "$@" > /dev/null 2>&1 ; then
+		echo "PASS: $NAME"
+		NPASS=$((NPASS + 1))
+	else
+		echo "FAIL: $NAME"
+		NFAIL=$((NFAIL + 1))
+	fi
+}
+
+# wait up to 5 seconds for the log ($2, default watch.log) to have $1 lines
+waitlog() {
+	for _ in $(seq 50); do
+		[ "$(grep -c '^signed\|waiting' "$DIR/${2:-watch.log}")" -ge "$1" ] && return 0
+		sleep 0.1
+	done
+	return 1
+}
+
+# sign $1 the usual way, as the reference for what --watch should write
+reference() {
+	"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$1" "$DIR/ref.bin" > /dev/null
+}
+
+"$SIM" --make-image --address 0x08000000 --size 4096 --seed 1 "$DIR/boot.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time "$DIR/boot.raw" "$DIR/boot.bin" > /dev/null
+
+for SEED in 1 2 3; do
+	"$SIM" --make-image --address 0x08005000 --size 20000 --seed $SEED "$DIR/v$SEED.raw"
+done
+
+cp "$DIR/v1.raw" "$DIR/app.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time --watch --watch-delay 50 \
+	"$DIR/app.raw" "$DIR/app.bin" > "$DIR/watch.log" 2>&1 &
+WATCHER=$!
+trap 'kill $WATCHER $WATCHER2 2> /dev/null' EXIT
+
+echo "== watch"
+reference "$DIR/v1.raw"
+check "signs the input at startup"	waitlog 1
+check "startup output is right"	cmp "$DIR/app.bin" "$DIR/ref.bin"
+
+# rewrite in place, slowly: the first half must not be signed.
+( head -c 10000 "$DIR/v2.raw"; sleep 0.5; tail -c +10001 "$DIR/v2.raw" ) > "$DIR/app.raw"
+reference "$DIR/v2.raw"
+check "signs a rewritten input"		waitlog 2
+check "partial write isn't signed"	test "$(grep -c '^signed\|waiting' "$DIR/watch.log")" -eq 2
+check "rewritten output is right"	cmp "$DIR/app.bin" "$DIR/ref.bin"
+
+# replace by rename, as lld does.
+cp "$DIR/v3.raw" "$DIR/app.raw.tmp"
+mv "$DIR/app.raw.tmp" "$DIR/app.raw"
+reference "$DIR/v3.raw"
+check "signs a renamed input"		waitlog 3
+check "renamed output is right"		cmp "$DIR/app.bin" "$DIR/ref.bin"
+
+# a bad input is reported, and the watch goes on.
+head -c 100 "$DIR/v1.raw" > "$DIR/app.raw"
+check "reports a bad input"		waitlog 4
+check "keeps running after an error"	kill -0 $WATCHER
+
+echo
+echo "== boot tests"
+check "boot the last good output"	"$SIM" --boot "$DIR/boot.bin" --app "$DIR/app.bin" --expect "$DIR/ref.bin"
+
+echo
+echo "== output errors"
+# an output that can't be created is reported too, and signed once it can be.
+cp "$DIR/v1.raw" "$DIR/app2.raw"
+"$TOOL" -s -k "$KEY" --force-binary --no-add-time --watch --watch-delay 50 \
+	"$DIR/app2.raw" "$DIR/out/app2.bin" > "$DIR/watch2.log" 2>&1 &
+WATCHER2=$!
+check "reports an output it can't create"	waitlog 1 watch2.log
+check "...and says why"			grep -q "can't create: .*No such file or directory" "$DIR/watch2.log"
+check "keeps running after a write error"	kill -0 $WATCHER2
+mkdir "$DIR/out"
+cp "$DIR/v1.raw" "$DIR/app2.raw"
+reference "$DIR/v1.raw"
+check "signs once the output can be created"	waitlog 2 watch2.log
+check "that output is right"			cmp "$DIR/out/app2.bin" "$DIR/ref.bin"
+kill $WATCHER2
+
+echo
+echo "$NPASS passed, $NFAIL failed"
+[ "$NFAIL" -eq 0 ]
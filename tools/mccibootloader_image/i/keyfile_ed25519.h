@@ -36,6 +36,7 @@ public:
 	void end();
 	void clear();
 	bool read();
+	bool readPublic();
 
 	static constexpr char kName[] = "ssh-ed25519";
 	std::string m_filename;
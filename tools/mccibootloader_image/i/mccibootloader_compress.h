@@ -0,0 +1,64 @@
+/*
+
+Module:	mccibootloader_compress.h
+
+Function:
+	Encoder and reference decoder for compressed update packages.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mccibootloader_compress_h_
+#define _mccibootloader_compress_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+///
+/// \brief compressed packages
+///
+/// \details The payload is an LZ4 block (see mcci_bootloader_package.h
+///	in the bootloader). The encoder follows the LZ4 end-of-block rules,
+///	so the payload can also be checked with any LZ4 block decoder.
+///
+namespace McciBootloader_Compress {
+
+/// \brief the shortest match
+constexpr std::size_t kMinMatch = 4;
+
+/// \brief the window: matches can reach back this far
+constexpr std::size_t kLog2WindowSize = 16;
+constexpr std::size_t kWindowSize = std::size_t(1) << kLog2WindowSize;
+
+/// \brief compress \p input.
+std::vector<std::uint8_t>
+encode(
+	const std::vector<std::uint8_t> &input
+	);
+
+/// \brief decompress \p payload the way the bootloader does, returning
+///	false if it's not valid.
+bool
+decode(
+	const std::vector<std::uint8_t> &payload,
+	std::size_t outputSize,
+	std::vector<std::uint8_t> &output
+	);
+
+} // namespace McciBootloader_Compress
+
+#endif /* _mccibootloader_compress_h_ */
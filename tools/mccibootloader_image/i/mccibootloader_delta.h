@@ -0,0 +1,74 @@
+/*
+
+Module:	mccibootloader_delta.h
+
+Function:
+	Encoder and reference decoder for delta update packages.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mccibootloader_delta_h_
+#define _mccibootloader_delta_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+///
+/// \brief delta packages
+///
+/// \details The instruction stream is described in the bootloader's
+///	mcci_bootloader_package.h. The bootloader rebuilds the image in
+///	place, one window at a time, so the encoder never emits a COPY
+///	whose source is in a window that precedes the window being built.
+///
+namespace McciBootloader_Delta {
+
+/// \brief the opcodes, in the low two bits of each instruction
+enum class Op_t : std::uint8_t
+	{
+	kCopy = 0,		///< followed by a zig-zag offset; copy from the base
+	kAdd = 1,		///< followed by the bytes
+	kRun = 2,		///< followed by one byte, repeated
+	};
+
+/// \brief the default window size: the bootloader's default image block size
+constexpr std::size_t kLog2WindowSize = 12;
+constexpr std::size_t kWindowSize = std::size_t(1) << kLog2WindowSize;
+
+/// \brief compute the instructions that turn \p base into \p target.
+std::vector<std::uint8_t>
+encode(
+	const std::vector<std::uint8_t> &base,
+	const std::vector<std::uint8_t> &target,
+	std::size_t windowSize = kWindowSize
+	);
+
+/// \brief apply \p payload to \p base the way the bootloader does,
+///	returning false if the instructions are not valid.
+bool
+decode(
+	const std::vector<std::uint8_t> &base,
+	const std::vector<std::uint8_t> &payload,
+	std::size_t targetSize,
+	std::vector<std::uint8_t> &target,
+	std::size_t windowSize = kWindowSize
+	);
+
+} // namespace McciBootloader_Delta
+
+#endif /* _mccibootloader_delta_h_ */
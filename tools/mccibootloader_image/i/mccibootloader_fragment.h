@@ -0,0 +1,148 @@
+/*
+
+Module:	mccibootloader_fragment.h
+
+Function:
+	Fragmentation with parity for LoRaWAN multicast (FUOTA) delivery
+	of signed images.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mccibootloader_fragment_h_
+#define _mccibootloader_fragment_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+///
+/// \brief fragmentation of images for LoRaWAN multicast
+///
+/// \details This follows the LoRaWAN Fragmented Data Block Transport
+///	specification (TS004). The image is padded to a multiple of the
+///	fragment size and split into M uncoded fragments, numbered 1 to
+///	M. Parity fragment M + n is the XOR of the uncoded fragments
+///	selected by matrixLine(n, M). A receiver can rebuild the image
+///	from any M fragments whose rows are independent; in practice,
+///	a few more than M are needed.
+///
+namespace McciBootloader_Fragment {
+
+/// \brief the largest fragment index (the FragIndex field is 14 bits)
+constexpr std::uint32_t kMaxIndex = 0x3FFF;
+
+/// \brief the largest fragment (the FragSize field is one byte)
+constexpr std::size_t kMaxFragmentSize = 255;
+
+///
+/// \brief the header of a fragment file (--fuota-output)
+///
+/// \details All fields are little-endian. The header is followed by
+///	nFragments + nParity records, each of which is the payload of a
+///	DataFragment command: a two-byte FragIndex (index in bits 13:0,
+///	session in bits 15:14), then fragmentSize bytes of data. The
+///	fields match those of the FragSessionSetup command.
+///
+struct FileHeader_t
+	{
+	static constexpr std::uint32_t kMagic = (('M' << 0) | ('F' << 8) | ('R' << 16) | ('0' << 24));
+	static constexpr std::size_t kSize = 16;
+
+	std::uint16_t	nFragments;	///< M, the number of uncoded fragments
+	std::uint16_t	nParity;	///< the number of parity fragments
+	std::uint8_t	fragmentSize;	///< bytes of data per fragment
+	std::uint8_t	padding;	///< bytes of padding in the last uncoded fragment
+	std::uint8_t	session;	///< the fragmentation session (0..3)
+	std::uint32_t	imageSize;	///< size of the image: nFragments * fragmentSize - padding
+
+	/// \brief append the wire form to \p out.
+	void put(std::vector<std::uint8_t> &out) const;
+
+	/// \brief decode the wire form from \p p[0..n); false if not valid.
+	bool get(const std::uint8_t *p, std::size_t n);
+	};
+
+/// \brief set \p line to the TS004 parity matrix row for parity
+///	fragment \p n (1-based) of \p m uncoded fragments.
+void
+matrixLine(
+	std::uint32_t n,
+	std::uint32_t m,
+	std::vector<bool> &line
+	);
+
+/// \brief fragment \p image, returning a complete fragment file.
+std::vector<std::uint8_t>
+encode(
+	const std::vector<std::uint8_t> &image,
+	std::size_t fragmentSize,
+	std::size_t nParity,
+	std::uint8_t session = 0
+	);
+
+///
+/// \brief rebuilds an image from fragments, as a receiver would
+///
+/// \details Fragments can be added in any order. Each is reduced
+///	against the rows already held (Gaussian elimination over GF(2)),
+///	so the work per fragment is proportional to M * fragment size,
+///	and redundant fragments are simply dropped.
+///
+class Decoder_t
+	{
+public:
+	Decoder_t(std::size_t nFragments, std::size_t fragmentSize);
+
+	/// \brief add fragment \p index (1-based); returns true when complete.
+	bool add(std::uint32_t index, const std::uint8_t *pData);
+
+	/// \brief true when every uncoded fragment is known
+	bool isComplete() const
+		{ return this->m_nRows == this->m_nFragments; }
+
+	/// \brief the number of fragments added
+	std::size_t nReceived() const
+		{ return this->m_nReceived; }
+
+	/// \brief the rebuilt image (nFragments * fragmentSize bytes);
+	///	only valid when isComplete().
+	std::vector<std::uint8_t> image();
+
+private:
+	using Word_t = std::uint64_t;
+	static constexpr std::size_t kWordBits = 64;
+
+	Word_t *row(std::size_t i)
+		{ return &this->m_rows[i * this->m_nWords]; }
+	std::uint8_t *data(std::size_t i)
+		{ return &this->m_data[i * this->m_fragmentSize]; }
+
+	std::size_t			m_nFragments;
+	std::size_t			m_fragmentSize;
+	std::size_t			m_nWords;
+	std::size_t			m_nRows { 0 };
+	std::size_t			m_nReceived { 0 };
+	std::vector<Word_t>		m_rows;		///< row i has its lowest set bit at i, if m_fRow[i]
+	std::vector<std::uint8_t>	m_data;		///< the data for each row
+	std::vector<bool>		m_fRow;		///< which rows are held
+	std::vector<Word_t>		m_scratchRow;
+	std::vector<std::uint8_t>	m_scratchData;
+	};
+
+} // namespace McciBootloader_Fragment
+
+#endif /* _mccibootloader_fragment_h_ */
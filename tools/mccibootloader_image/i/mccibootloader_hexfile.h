@@ -0,0 +1,69 @@
+/*
+
+Module:	mccibootloader_hexfile.h
+
+Function:
+	Intel HEX and Motorola S-record encoders.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mccibootloader_hexfile_h_
+#define _mccibootloader_hexfile_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+///
+/// \brief text encodings of memory images
+///
+/// \details The encoders write one record at a time from the caller's
+///	buffers, so the cost is proportional to the bytes encoded; gaps
+///	between segments aren't written at all, and a programmer leaves
+///	them unchanged (usually erased).
+///
+namespace McciBootloader_HexFile {
+
+/// \brief a run of bytes to be loaded at \c address
+struct Segment_t
+	{
+	std::uint32_t		address;	///< load address of \c p[0]
+	const std::uint8_t	*p;		///< the bytes
+	std::size_t		n;		///< number of bytes
+	};
+
+/// \brief write \p segments to \p os as Intel HEX (I32HEX).
+void
+writeIntelHex(
+	std::ostream &os,
+	const std::vector<Segment_t> &segments
+	);
+
+/// \brief write \p segments to \p os as S-records (S0, S3 and S7),
+///	with \p header in the S0 record.
+void
+writeSrec(
+	std::ostream &os,
+	const std::vector<Segment_t> &segments,
+	const std::string &header
+	);
+
+} // namespace McciBootloader_HexFile
+
+#endif /* _mccibootloader_hexfile_h_ */
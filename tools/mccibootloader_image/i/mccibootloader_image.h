@@ -38,8 +38,11 @@ Author:
 #include <ios>
 #include <iostream>
 #include <fstream>
+#include <memory>
 
 #include "mccibootloader_elf.h"
+#include "mccibootloader_loadimage.h"
+#include "mccibootloader_trace.h"
 #include "keyfile_ed25519.h"
 
 using namespace std;
@@ -108,8 +111,11 @@ namespace McciVersion {
 } // namespace McciVersion
 
 
-// a forward reference
+// forward references
 struct McciBootloader_AppInfo_Wire_t;
+struct McciBootloader_PackageHeader_Wire_t;
+struct McciBootloader_VerifyResult_t;
+namespace McciBootloader_Signer { class Backend_t; }
 
 // the application structure
 struct App_t
@@ -123,18 +129,75 @@ struct App_t
 	bool		fAddTime;
 	bool		fDryRun;
 	bool		fForceBinary;
+	bool		fVerify;
+	bool		fCompose;
+	bool		fSlotDirectory;
+	bool		fDaemon;
+	bool		fWatch;
+	bool		fBatch;
+	bool		fStdio;
+	bool		fCaptureErrors;
+	bool		fStats;
 	char 		*pComment;
+	std::uint64_t	posixTimestamp;		///< with fAddTime, the time to use; 0 means now
 	std::string	infilename;
 	std::string	outfilename;
 	std::string	progname;
 	std::string	keyfilename;
-	std::vector<uint8_t>	fileimage;
+	std::string	publickeyfilename;
+	std::vector<std::string> keyfilenames;
+	std::string	socketname;
+	std::string	signercommand;
+	std::string	tracefilename;
+	std::string	cachedirname;
+	std::string	depfilename;
+	std::string	cachefilename;
+	std::string	deltabasename;
+	std::string	deltaoutputname;
+	std::string	compressedoutputname;
+	std::string	blockhashoutputname;
+	std::string	fuotaoutputname;
+	std::string	sendportname;		///< with --send, the serial port of the bootloader
+	unsigned	log2BlockSize;		///< with blockhashoutputname or deltaoutputname, log2 of the bootloader's block size
+	unsigned	fragmentSize;		///< with fuotaoutputname, bytes per fragment
+	unsigned	fuotaRedundancy;	///< with fuotaoutputname, parity fragments, in percent
+
+	/// \brief an extra output, written from the same hashed image
+	struct Artifact_t
+		{
+		enum class Kind_t
+			{
+			kBinary,	///< flat binary (--output-bin)
+			kElf,		///< patched ELF (--output-elf)
+			kHex,		///< Intel HEX (--output-hex)
+			kSrec,		///< Motorola S-records (--output-srec)
+			kSlot,		///< padded storage slot (--output-slot)
+			};
+
+		Kind_t		kind;
+		std::string	filename;
+		};
+
+	std::vector<Artifact_t>	vArtifacts;
+	std::vector<std::string> verifyArgs;
+	std::vector<std::string> composeArgs;
+	std::vector<std::string> slotDirectoryArgs;	///< with fSlotDirectory, the output, then address=file for each slot
+	std::vector<std::string> batchArgs;
+	unsigned	nJobs;
+	unsigned	watchDelayMs;		///< with fWatch, how long the input must be quiet
+	unsigned	sendBaud;		///< with --send, the baud rate
+	unsigned	sendWindow;		///< with --send, Data frames to send ahead; 0 for as many as the bootloader allows
+	unsigned	sendBreakMs;		///< with --send, how long to hold a break first; 0 for none
+	unsigned	sendTimeoutMs;		///< with --send, how long to wait for the bootloader
+	unsigned	sendCorruptEvery;	///< with --send, damage every Nth Data frame, once; for testing
+	std::vector<uint8_t>	fileimage;	///< the flat image; for ELF input, see flattenImage()
 	McciVersion::Version_t	appVersion;
 	bool		fAppVersion;
 
 	struct AppElf_t
 		{
 		std::vector<uint8_t>	image;
+		McciBootloader_Elf::LoadImage_t load;	///< the load image, as a view of this->image
 		const McciBootloader_Elf::ElfIdent32_t *pIdent32;
 		std::vector<McciBootloader_Elf::ElfIdent32_t::ProgramHeader_t> vHeaders;
 		std::uint32_t	targetAddress;
@@ -147,12 +210,44 @@ struct App_t
 	mcci_tweetnacl_sha512_t fileHash;
 	const McciBootloader_AppInfo_Wire_t *pFileAppInfo;
 
+	/// \brief what we sign with; shared by copies (see signer()).
+	std::shared_ptr<McciBootloader_Signer::Backend_t> pSigner;
+
+	/// \brief the phase timings, for --stats and --trace-file; shared
+	///	by copies. Null if neither was given.
+	std::shared_ptr<McciBootloader_Trace::Recorder_t> pTrace;
+
+	/// \brief thrown by usage(), fatal() and --version to end begin()
+	///	with \p status. Only entry points catch it, so nothing in the
+	///	library exits the process.
+	struct Exit_t
+		{
+		int	status;
+		};
+
 	int begin(int argc, char **argv);
 	bool isUsingElf() const
 		{ return this->elf.image.size() != 0; }
 
+	/// \brief the benchmark driver runs the individual phases.
+	friend struct AppBenchmark_t;
+
+	/// \brief so does the C API (mccibootloader_image_api.h).
+	friend struct AppApi_t;
+
 private:
 	void scanArgs(int argc, char **argv);
+	int run();
+	void writeTrace();
+
+	/// \brief time the enclosing scope as \p pName, if --stats or
+	///	--trace-file was given.
+	McciBootloader_Trace::Span_t span(
+		const char *pName,
+		McciBootloader_Trace::Kind_t kind = McciBootloader_Trace::Kind_t::kPhase
+		) const
+		{ return { this->pTrace.get(), pName, this->infilename, kind }; }
+
 	[[noreturn]] void usage(const string &message);
 	[[noreturn]] void fatal(const string &message);
 	void verbose(const string &message);
@@ -160,12 +255,47 @@ private:
 	void addHeader();
 	void addHash();
 	void addSignature();
+	void putSignature(const mcci_tweetnacl_sign_signature_t &signature);
+	void setupSigner();
+	McciBootloader_Signer::Backend_t &signer();
 	void testNaCl();
 	void dump(const string &message, const uint8_t *pBegin, const uint8_t *pEnd);
+	void processImage();
 	void readImage();
+	void parseImage();
 	void writeImage();
-	void elfImagePrep();
+	size_t imageSize() const;
+	uint8_t *imagePointer(size_t offset, size_t n);
+	uint8_t *imageBytes(size_t offset, size_t n, const char *pWhat);
+	void hashImage(mcci_tweetnacl_sha512_t &hash, size_t n) const;
+	void flattenImage();
+	const std::vector<uint8_t> &outputImage() const;
 	void setAppVersion(const string &versionString);
+	int verify();
+	const mcci_tweetnacl_sign_publickey_t *readCheckKey();
+	void verifyFile(McciBootloader_VerifyResult_t &result, const mcci_tweetnacl_sign_publickey_t *pPublicKey, std::vector<uint8_t> *pImage = nullptr) const;
+	void verifyImage(McciBootloader_VerifyResult_t &result, const mcci_tweetnacl_sign_publickey_t *pPublicKey);
+	static void checkSignatureBlock(const uint8_t *pImage, uint32_t imagesize, const mcci_tweetnacl_sign_publickey_t *pPublicKey, bool fCheckSignature, std::vector<string> &failures);
+	[[noreturn]] void runSigner();
+	int watch();
+	int signBatch();
+	bool cacheLookup();
+	bool cacheEntryIsValid(const std::vector<uint8_t> &entry) const;
+	void cacheStore();
+	bool outputIsUnchanged(const string &filename) const;
+	void writeDepfile();
+	McciBootloader_AppInfo_Wire_t findPackageAppInfo(App_t &app, const string &name);
+	std::vector<uint8_t> makePackage(McciBootloader_PackageHeader_Wire_t &header, const std::vector<uint8_t> &payload);
+	void appendSignature(std::vector<uint8_t> &data);
+	void writePackage(const std::vector<uint8_t> &package, const string &filename);
+	void writeDeltaPackage();
+	void writeCompressedPackage();
+	void writeBlockHashImage();
+	void writeFuotaFragments();
+	void writeArtifacts();
+	int compose();
+	int writeSlotDirectory();
+	int sendImage();
 
 	Keyfile_ed25519_t keyfile;
 	};
@@ -214,6 +344,33 @@ private:
 	uint8_t m_v[4];
 	};
 
+// the layout of the image
+class uint16_le_t
+	{
+public:
+	uint16_le_t(uint16_t v = 0)
+		: m_v 	{
+			std::uint8_t(v & 0xFF),
+		        std::uint8_t(v >> 8)
+			}
+		{}
+	void put(uint16_t v)
+		{
+		this->m_v[0] = std::uint8_t(v >>  0);
+		this->m_v[1] = std::uint8_t(v >>  8);
+		}
+	uint16_t get(void) const
+		{
+		return uint16_t(
+			(uint16_t(this->m_v[0]) << 0) |
+			(uint16_t(this->m_v[1]) << 8) |
+			0
+			);
+		}
+private:
+	uint8_t m_v[2];
+	};
+
 // the layout of the image
 class uint64_le_t
 	{
@@ -268,10 +425,8 @@ public:
 
 	std::string get() const
 		{
-		size_t n = (this->m_v[a_nch - 1] == '\0') 
-				? a_nch 
-				: std::strlen(this->m_v)
-				;
+		// stop at the first NUL; a full-length comment has none.
+		size_t n = std::find(this->m_v, this->m_v + a_nch, '\0') - this->m_v;
 
 		return std::string(this->m_v, n);
 		}
@@ -364,6 +519,187 @@ static_assert(
 	"wrong size for McciBootloader_SignatureBlock_Wire_t"
 	);
 
+/// \brief The portable form of the update package header.
+///
+/// \details See mcci_bootloader_package.h in the bootloader. The header
+///	is followed by the payload, and then by a signature block covering
+///	the header and payload.
+///
+struct McciBootloader_PackageHeader_Wire_t
+	{
+	static constexpr uint32_t kMagic = (('M' << 0) | ('P' << 8) | ('K' << 16) | ('0' << 24));
+
+	/// \brief the package types
+	enum class Type_t : std::uint8_t
+		{
+		kDelta = 1,			///< copy/add instructions against the app in flash
+		kCompressed = 2,		///< the image, compressed as an LZ4 block
+		};
+
+	uint32_le_t	magic = kMagic;		///< the format identifier.
+	uint16_le_t	size = sizeof(*this);	///< size of this structure, in bytes
+	std::uint8_t	type { 0 };		///< a Type_t
+	std::uint8_t	log2WindowSize { 0 };	///< log2 of the window size
+	uint32_le_t	payloadSize { 0 };	///< size of the payload, in bytes
+	uint32_le_t	baseSize { 0 };		///< delta: imagesize + authsize of the base image
+	std::uint8_t	baseHash[64] = {0};	///< delta: the hash of the base image
+	std::uint8_t	targetHash[64] = {0};	///< the hash of the resulting image
+	McciBootloader_AppInfo_Wire_t appInfo;	///< the AppInfo of the resulting image
+	};
+
+static_assert(
+	sizeof(McciBootloader_PackageHeader_Wire_t) == 208,
+	"wrong size for McciBootloader_PackageHeader_Wire_t"
+	);
+
+/// \brief The portable form of the block hash table header.
+///
+/// \details See mcci_bootloader_blockhash.h in the bootloader. The
+///	header is followed by one SHA-512 hash for each block of the image,
+///	and then by a signature block covering the header and hashes.
+///
+struct McciBootloader_BlockHashHeader_Wire_t
+	{
+	static constexpr uint32_t kMagic = (('M' << 0) | ('B' << 8) | ('H' << 16) | ('0' << 24));
+	static constexpr unsigned kLog2BlockSize = 12;
+
+	uint32_le_t	magic = kMagic;		///< the format identifier.
+	uint16_le_t	size = sizeof(*this);	///< size of this structure, in bytes
+	std::uint8_t	log2BlockSize { kLog2BlockSize }; ///< log2 of the block size
+	std::uint8_t	reserved { 0 };		///< zero
+	uint32_le_t	imageSize { 0 };	///< imagesize + authsize of the image
+	uint32_le_t	nBlocks { 0 };		///< number of block hashes
+	};
+
+static_assert(
+	sizeof(McciBootloader_BlockHashHeader_Wire_t) == 16,
+	"wrong size for McciBootloader_BlockHashHeader_Wire_t"
+	);
+
+/// \brief The portable form of the slot directory header.
+///
+/// \details See mcci_bootloader_directory.h in the bootloader. The
+///	header is followed by \c nSlots entries, and then by a signature
+///	block covering the header and entries.
+///
+struct McciBootloader_DirectoryHeader_Wire_t
+	{
+	static constexpr uint32_t kMagic = (('M' << 0) | ('S' << 8) | ('D' << 16) | ('0' << 24));
+
+	uint32_le_t	magic = kMagic;		///< the format identifier.
+	uint16_le_t	size = sizeof(*this);	///< size of this structure, in bytes
+	uint16_le_t	nSlots { 0 };		///< number of entries
+	};
+
+static_assert(
+	sizeof(McciBootloader_DirectoryHeader_Wire_t) == 8,
+	"wrong size for McciBootloader_DirectoryHeader_Wire_t"
+	);
+
+/// \brief The portable form of a slot directory entry.
+struct McciBootloader_DirectoryEntry_Wire_t
+	{
+	uint32_le_t	address { 0 };		///< storage address of the slot
+	uint32_le_t	nSigned { 0 };		///< offset of the slot's signature block
+	McciBootloader_AppInfo_Wire_t appInfo;	///< the AppInfo of the image in (or made by) the slot
+	std::uint8_t	hash[64] = {0};		///< the hash from the slot's signature block
+	};
+
+static_assert(
+	sizeof(McciBootloader_DirectoryEntry_Wire_t) == 136,
+	"wrong size for McciBootloader_DirectoryEntry_Wire_t"
+	);
+
+/// \brief The portable form of a serial recovery frame header.
+///
+/// \details See mcci_bootloader_serial.h in the bootloader. The header
+///	is followed by \c length bytes of payload, and then by the CRC-32
+///	of everything after the sync byte.
+///
+struct McciBootloader_SerialFrameHeader_Wire_t
+	{
+	static constexpr std::uint8_t kSync = 0xA5;
+	static constexpr unsigned kDataMax = 256;	///< Data frame payload, but the last
+	static constexpr unsigned kCrcSize = 4;
+
+	enum Type_t : std::uint8_t
+		{
+		kHello = 1,	///< host: start a session; \c offset is the image size
+		kReady,		///< bootloader: session started; payload is McciBootloader_SerialReady_Wire_t
+		kData,		///< host: image bytes, starting at \c offset
+		kAck,		///< bootloader: the bytes before \c offset are in flash
+		kNak,		///< bootloader: a frame was lost; send again from \c offset
+		kResult,	///< bootloader: session over; \c offset is the McciBootloaderError_t
+		};
+
+	std::uint8_t	sync = kSync;		///< kSync
+	std::uint8_t	type { 0 };		///< the Type_t
+	uint16_le_t	length { 0 };		///< number of payload bytes
+	uint32_le_t	offset { 0 };		///< position in the image, or as given by \c type
+	};
+
+static_assert(
+	sizeof(McciBootloader_SerialFrameHeader_Wire_t) == 8,
+	"wrong size for McciBootloader_SerialFrameHeader_Wire_t"
+	);
+
+/// \brief The portable form of the payload of a serial recovery Ready frame.
+struct McciBootloader_SerialReady_Wire_t
+	{
+	uint16_le_t	window { 0 };		///< Data frames the host may send ahead
+	uint16_le_t	dataMax { 0 };		///< payload of each Data frame, but the last
+	uint32_le_t	reason { 0 };		///< why the bootloader is in recovery
+	};
+
+static_assert(
+	sizeof(McciBootloader_SerialReady_Wire_t) == 8,
+	"wrong size for McciBootloader_SerialReady_Wire_t"
+	);
+
+///
+/// \brief the memory map used by the bootloader when checking images
+///
+/// \details These values repeat the link-time constants from
+///	platform/board/mcci/catena_abz/mk/mccibootloader.ld and the
+///	storage layout from mcci_bootloader_board_catena_abz.h, so that
+///	\c --verify can apply the same limits as the device, and
+///	\c --compose can lay out the SPI flash (an MX25V8035F) the same way.
+///
+struct McciBootloader_MemoryMap_t
+	{
+	static constexpr uint32_t kSocRamBase = 0x20000000;
+	static constexpr uint32_t kSocRamTop = kSocRamBase + 20 * 1024;
+	static constexpr uint32_t kBootBase = McciBootloader_AppInfo_Wire_t::kBootloaderAddress;
+	static constexpr uint32_t kBootSize = 20 * 1024;
+	static constexpr uint32_t kAppBase = McciBootloader_AppInfo_Wire_t::kAppAddress;
+	static constexpr uint32_t kAppSize = 192 * 1024 - (kBootSize + 4 * 1024);
+	static constexpr uint32_t kStorageImageSize = 168 * 1024;
+	static constexpr uint32_t kStorageFallbackBase = 64 * 1024;
+	static constexpr uint32_t kStorageUpdateBase = 256 * 1024;
+	static constexpr uint32_t kStorageDirectoryBase = 60 * 1024;
+	static constexpr uint32_t kStorageChipSize = 1024 * 1024;
+	static constexpr uint8_t kStorageErased = 0xFF;
+	};
+
+static_assert(
+	McciBootloader_MemoryMap_t::kStorageDirectoryBase + 4 * 1024 <= McciBootloader_MemoryMap_t::kStorageFallbackBase &&
+	McciBootloader_MemoryMap_t::kStorageFallbackBase + McciBootloader_MemoryMap_t::kStorageImageSize <= McciBootloader_MemoryMap_t::kStorageUpdateBase &&
+	McciBootloader_MemoryMap_t::kStorageUpdateBase + McciBootloader_MemoryMap_t::kStorageImageSize <= McciBootloader_MemoryMap_t::kStorageChipSize,
+	"storage slots overlap or don't fit in the chip"
+	);
+
+///
+/// \brief the outcome of verifying one file
+///
+struct McciBootloader_VerifyResult_t
+	{
+	std::string			filename;	///< the file that was checked
+	std::vector<std::string>	failures;	///< the reasons the check failed; empty for success
+	McciBootloader_AppInfo_Wire_t	appInfo;	///< the AppInfo found in the image
+	bool				fAppInfo { false };	///< true if \c appInfo is valid
+	bool				fKeyChecked { false };	///< true if the signature was checked against a supplied key
+	};
+
 template <uint32_t a_nVec>
 struct McciBootloader_CortexAbstract_PageZeroContents_t
 	{
@@ -442,6 +778,10 @@ struct McciBootloader_AppInfoOffset_t
 	{
 	const char *pModelName;		//> the name of the architecture or model used for this table
 	size_t appInfoOffset;		//> the byte offset of the appinfo in the file image
+	size_t pageZeroSize;		//> the size of page zero; the entry point must follow it
 	};
 
+/// \brief the AppInfo offsets we probe, in order.
+extern const McciBootloader_AppInfoOffset_t vAppInfoOffsets[3];
+
 #endif /* _mccibootloader_image_h_ */
@@ -0,0 +1,191 @@
+/*
+
+Module:	mccibootloader_image_api.h
+
+Function:
+	C API for hashing, signing and checking MCCI bootloader images
+	in-process (libmccibootloader_image).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mccibootloader_image_api_h_
+#define _mccibootloader_image_api_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/****************************************************************************\
+|
+|	Linkage
+|
+\****************************************************************************/
+
+/*
+|| The library is built with hidden visibility; only the functions
+|| declared here are exported from the shared library. (The shared
+|| library isn't built on Windows.)
+*/
+#if defined(_WIN32)
+# define MCCIBOOTLOADER_IMAGE_API
+#else
+# define MCCIBOOTLOADER_IMAGE_API	__attribute__((__visibility__("default")))
+#endif
+
+/// \brief the version of this API; the major version changes only if
+///	existing callers would break.
+#define	MCCIBOOTLOADER_IMAGE_API_VERSION_MAJOR	1
+#define	MCCIBOOTLOADER_IMAGE_API_VERSION_MINOR	0
+#define	MCCIBOOTLOADER_IMAGE_API_VERSION	\
+	((MCCIBOOTLOADER_IMAGE_API_VERSION_MAJOR << 16) | MCCIBOOTLOADER_IMAGE_API_VERSION_MINOR)
+
+/****************************************************************************\
+|
+|	Types
+|
+\****************************************************************************/
+
+/// \brief the result of an API call
+typedef enum mccibootloader_image_status_e
+	{
+	MCCIBOOTLOADER_IMAGE_STATUS_OK = 0,		///< success
+	MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER,	///< a required pointer was NULL, or similar
+	MCCIBOOTLOADER_IMAGE_STATUS_BAD_KEY,		///< the key couldn't be read, or has no private part
+	MCCIBOOTLOADER_IMAGE_STATUS_BAD_IMAGE,		///< the image couldn't be parsed or signed
+	MCCIBOOTLOADER_IMAGE_STATUS_VERIFY_FAILED,	///< the image failed one or more checks
+	MCCIBOOTLOADER_IMAGE_STATUS_INTERNAL_ERROR,	///< something unexpected happened
+	} mccibootloader_image_status_t;
+
+/// \brief an ed25519 key pair, or just the public key
+typedef struct mccibootloader_image_key_s
+	{
+	uint8_t		publicKey[32];	///< the public key
+	uint8_t		privateKey[64];	///< the private key (NaCl form), if fPrivate
+	uint8_t		fPrivate;	///< non-zero if privateKey is valid
+	uint8_t		reserved[7];	///< zero
+	} mccibootloader_image_key_t;
+
+/// \brief a diagnostic message, filled in on failure
+typedef struct mccibootloader_image_message_s
+	{
+	char		text[256];	///< NUL-terminated; truncated if necessary
+	} mccibootloader_image_message_t;
+
+/// \brief the interesting fields of an AppInfo
+typedef struct mccibootloader_image_appinfo_s
+	{
+	uint32_t	targetAddress;	///< where the image is loaded
+	uint32_t	imageSize;	///< size of the app, not including authentication data
+	uint32_t	authSize;	///< size of the authentication data
+	uint32_t	version;	///< semantic version (major, minor, patch, local)
+	uint64_t	posixTimestamp;	///< build or signing time
+	char		comment[17];	///< NUL-terminated
+	uint8_t		reserved[7];	///< zero
+	} mccibootloader_image_appinfo_t;
+
+/// \brief flags for mccibootloader_image_sign_options_t::flags, and for
+///	the flags argument of the other functions.
+#define	MCCIBOOTLOADER_IMAGE_FLAG_FORCE_BINARY	(UINT32_C(1) << 0)	///< don't treat the image as ELF
+#define	MCCIBOOTLOADER_IMAGE_FLAG_HASH_ONLY	(UINT32_C(1) << 1)	///< hash, but don't sign (-h)
+#define	MCCIBOOTLOADER_IMAGE_FLAG_SET_TIME	(UINT32_C(1) << 2)	///< set the timestamp (-t)
+#define	MCCIBOOTLOADER_IMAGE_FLAG_SET_VERSION	(UINT32_C(1) << 3)	///< set the version (-V)
+
+/// \brief options for mccibootloader_image_sign()
+typedef struct mccibootloader_image_sign_options_s
+	{
+	uint32_t	size;		///< sizeof(mccibootloader_image_sign_options_t)
+	uint32_t	flags;		///< MCCIBOOTLOADER_IMAGE_FLAG_...
+	uint32_t	version;	///< with FLAG_SET_VERSION, the new version
+	uint32_t	reserved;	///< zero
+	uint64_t	posixTimestamp;	///< with FLAG_SET_TIME, the time to use; 0 means now
+	const char	*pComment;	///< if not NULL, the new comment (up to 16 bytes)
+	} mccibootloader_image_sign_options_t;
+
+/****************************************************************************\
+|
+|	Functions
+|
+|	All functions are reentrant: they keep no state between calls, so
+|	any number of threads may call them at once, as long as they don't
+|	share output buffers. Images are passed in caller buffers, which
+|	may hold a flat binary image or a linked ELF file. Signing never
+|	changes the size of an image: the linker reserves room for the
+|	signature block.
+|
+\****************************************************************************/
+
+/// \brief return MCCIBOOTLOADER_IMAGE_API_VERSION as built into the library
+MCCIBOOTLOADER_IMAGE_API uint32_t
+mccibootloader_image_api_version(void);
+
+/// \brief return a name for \p status (never NULL)
+MCCIBOOTLOADER_IMAGE_API const char *
+mccibootloader_image_status_name(
+	mccibootloader_image_status_t status
+	);
+
+/// \brief the size of the signature block that follows each image
+MCCIBOOTLOADER_IMAGE_API size_t
+mccibootloader_image_auth_size(void);
+
+/// \brief read an OpenSSH ed25519 key file (private, or .pub)
+MCCIBOOTLOADER_IMAGE_API mccibootloader_image_status_t
+mccibootloader_image_key_read(
+	const char *pFilename,
+	mccibootloader_image_key_t *pKey,
+	mccibootloader_image_message_t *pMessage	/* optional */
+	);
+
+/// \brief find and decode the AppInfo of an image
+MCCIBOOTLOADER_IMAGE_API mccibootloader_image_status_t
+mccibootloader_image_get_appinfo(
+	const uint8_t *pImage,
+	size_t nImage,
+	uint32_t flags,
+	mccibootloader_image_appinfo_t *pAppInfo,
+	mccibootloader_image_message_t *pMessage	/* optional */
+	);
+
+/// \brief update the AppInfo, then hash and sign an image, in place
+MCCIBOOTLOADER_IMAGE_API mccibootloader_image_status_t
+mccibootloader_image_sign(
+	uint8_t *pImage,
+	size_t nImage,
+	const mccibootloader_image_key_t *pKey,
+	const mccibootloader_image_sign_options_t *pOptions,	/* optional */
+	mccibootloader_image_message_t *pMessage		/* optional */
+	);
+
+/// \brief check an image as the bootloader would (as for --verify)
+MCCIBOOTLOADER_IMAGE_API mccibootloader_image_status_t
+mccibootloader_image_verify(
+	const uint8_t *pImage,
+	size_t nImage,
+	uint32_t flags,
+	const mccibootloader_image_key_t *pKey,		/* optional */
+	mccibootloader_image_appinfo_t *pAppInfo,	/* optional */
+	mccibootloader_image_message_t *pMessage	/* optional */
+	);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _mccibootloader_image_api_h_ */
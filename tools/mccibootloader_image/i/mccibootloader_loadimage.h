@@ -0,0 +1,110 @@
+/*
+
+Module:	mccibootloader_loadimage.h
+
+Function:
+	A scatter/gather view of the load image of an ELF file.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#ifndef _mccibootloader_loadimage_h_
+#define _mccibootloader_loadimage_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mcci_tweetnacl_hash.h"
+
+namespace McciBootloader_Elf {
+
+///
+/// \brief the load image of an ELF file, as a view over its segments
+///
+/// \details The load image is what the bootloader sees in flash: the
+///	bytes from the first PT_LOAD segment's physical address to the end
+///	of the last one. Each segment contributes \c filesz bytes from the
+///	file, followed by \c memsz - \c filesz bytes of zero (a .bss tail);
+///	gaps between segments (alignment holes) are also zero. Nothing is
+///	copied: the segment data stays in the ELF file image, which is
+///	passed to each method, so that copies of the owner don't share a
+///	pointer. Only file-backed bytes can be patched; the fill must stay
+///	zero.
+///
+class LoadImage_t
+	{
+public:
+	/// \brief one PT_LOAD segment
+	struct Segment_t
+		{
+		std::uint32_t	imageOffset;	///< offset of the segment in the load image
+		std::uint32_t	fileOffset;	///< offset of the segment's data in the ELF file
+		std::uint32_t	filesz;		///< bytes of data in the file
+		std::uint32_t	memsz;		///< bytes in the load image (>= filesz)
+		};
+
+	/// \brief forget all segments
+	void clear()
+		{
+		this->m_segments.clear();
+		this->m_size = 0;
+		}
+
+	/// \brief add a segment. Segments must be added in ascending order
+	///	and must not overlap; returns false if \p segment doesn't fit.
+	bool add(const Segment_t &segment);
+
+	/// \brief the size of the load image
+	std::size_t size() const
+		{ return this->m_size; }
+
+	/// \brief the segments
+	const std::vector<Segment_t> &segments() const
+		{ return this->m_segments; }
+
+	/// \brief the number of bytes of fill (gaps and .bss tails)
+	std::size_t fillSize() const;
+
+	/// \brief return a pointer into \p file for bytes [offset, offset + n)
+	///	of the load image, or nullptr if they aren't all stored in
+	///	the file data of one segment.
+	std::uint8_t *find(std::vector<std::uint8_t> &file, std::size_t offset, std::size_t n) const;
+
+	/// \brief set \p hash to the SHA-512 of the first \p n bytes of the
+	///	load image.
+	void hash(
+		const std::vector<std::uint8_t> &file,
+		std::size_t n,
+		mcci_tweetnacl_sha512_t &hash
+		) const;
+
+	/// \brief set \p image to a flat copy of the load image.
+	void flatten(const std::vector<std::uint8_t> &file, std::vector<std::uint8_t> &image) const;
+
+	/// \brief copy the flat load image \p image back into \p file.
+	///	Returns false, leaving \p file unchanged, if \p image is the
+	///	wrong size or has non-zero data in the fill.
+	bool store(std::vector<std::uint8_t> &file, const std::vector<std::uint8_t> &image) const;
+
+private:
+	std::vector<Segment_t>	m_segments;
+	std::size_t		m_size { 0 };
+	};
+
+} // namespace McciBootloader_Elf
+
+#endif /* _mccibootloader_loadimage_h_ */
@@ -0,0 +1,168 @@
+/*
+
+Module:	mccibootloader_signer.h
+
+Function:
+	Wire protocol for the mccibootloader_image signing daemon, and
+	the signer backends that the tool signs with.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#ifndef _mccibootloader_signer_h_
+#define _mccibootloader_signer_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include "mccibootloader_image.h"
+
+#include <atomic>
+#include <memory>
+
+///
+/// \brief the signing daemon protocol
+///
+/// \details Clients connect to a Unix-domain stream socket and send
+///	requests, each a RequestHeader_Wire_t followed by \c length bytes
+///	of payload. Requests may be pipelined: a client may send any number
+///	of requests before reading responses. The daemon serves requests
+///	concurrently, so responses may arrive in any order; each response
+///	carries the \c requestId of its request.
+///
+///	Keys are selected by public key. An all-zero selector selects the
+///	first key loaded by the daemon.
+///
+///	The same protocol is spoken over a pair of pipes to an external
+///	signer process (--signer-command); there, requests are answered
+///	in order. \c mccibootloader_image \c --daemon \c --stdio is such
+///	a process.
+///
+namespace McciBootloader_Signer {
+
+/// \brief the request magic number, "MSQ0"
+constexpr std::uint32_t kRequestMagic = (('M' << 0) | ('S' << 8) | ('Q' << 16) | ('0' << 24));
+/// \brief the response magic number, "MSR0"
+constexpr std::uint32_t kResponseMagic = (('M' << 0) | ('S' << 8) | ('R' << 16) | ('0' << 24));
+/// \brief the largest payload we accept
+constexpr std::uint32_t kMaxPayload = 16 * 1024 * 1024;
+
+/// \brief the operations
+enum class Opcode_t : std::uint8_t
+	{
+	kGetKeys = 1,		///< no payload; response is the public keys, 32 bytes each.
+	kHash = 2,		///< payload is data; response is its SHA-512.
+	kSignHash = 3,		///< payload is selector[32] + hash[64]; response is signature[64].
+	kSignImage = 4,		///< payload is selector[32] + image bytes up to AppInfo.imagesize;
+				///  response is the signature block: publicKey[32] + hash[64] + signature[64].
+	kSignHashes = 5,	///< payload is selector[32] + n * hash[64]; response is n * signature[64].
+	};
+
+/// \brief the response status codes
+enum class Status_t : std::uint8_t
+	{
+	kSuccess = 0,		///< request was completed
+	kBadRequest = 1,	///< unknown opcode or malformed payload
+	kUnknownKey = 2,	///< the selector doesn't match a loaded key
+	kTooLarge = 3,		///< payload exceeds kMaxPayload
+	kFailed = 4,		///< the crypto operation failed
+	};
+
+/// \brief the header of a request
+struct RequestHeader_Wire_t
+	{
+	uint32_le_t	magic { kRequestMagic };	///< kRequestMagic
+	uint32_le_t	requestId;			///< chosen by the client, echoed in the response
+	uint32_le_t	length;				///< number of payload bytes that follow
+	std::uint8_t	opcode { 0 };			///< an Opcode_t
+	std::uint8_t	reserved[3] { 0 };		///< zero
+	};
+
+static_assert(sizeof(RequestHeader_Wire_t) == 16, "wrong size for RequestHeader_Wire_t");
+
+/// \brief the header of a response
+struct ResponseHeader_Wire_t
+	{
+	uint32_le_t	magic { kResponseMagic };	///< kResponseMagic
+	uint32_le_t	requestId;			///< copied from the request
+	uint32_le_t	length;				///< number of payload bytes that follow
+	std::uint8_t	status { 0 };			///< a Status_t
+	std::uint8_t	reserved[3] { 0 };		///< zero
+	};
+
+static_assert(sizeof(ResponseHeader_Wire_t) == 16, "wrong size for ResponseHeader_Wire_t");
+
+/// \brief the size of a key selector
+constexpr std::size_t kSelectorSize = sizeof(mcci_tweetnacl_sign_publickey_t);
+
+/// \brief the most hashes a client puts in one kSignHashes request
+constexpr std::size_t kMaxHashesPerRequest = 4096;
+
+static_assert(
+	kSelectorSize + kMaxHashesPerRequest * sizeof(mcci_tweetnacl_sha512_t) <= kMaxPayload,
+	"kMaxHashesPerRequest is too large"
+	);
+
+///
+/// \brief something that signs SHA-512 hashes with an ed25519 key
+///
+/// \details The tool hashes images and packages itself; only the hashes
+///	go to the backend, many at a time if it can take them, so that an
+///	external signer costs one round trip per batch rather than one per
+///	image. Backends are shared by copies of App_t, so signHashes() must
+///	be safe to call from several threads. Errors are thrown as
+///	std::runtime_error.
+///
+class Backend_t
+	{
+public:
+	virtual ~Backend_t() {}
+
+	/// \brief the public key that signatures will verify against
+	virtual const mcci_tweetnacl_sign_publickey_t &publicKey() const = 0;
+
+	/// \brief sign \p nHashes hashes, putting the signatures in \p pSignatures.
+	virtual void signHashes(
+		const mcci_tweetnacl_sha512_t *pHashes,
+		std::size_t nHashes,
+		mcci_tweetnacl_sign_signature_t *pSignatures
+		) = 0;
+
+	/// \brief a short description, for messages
+	virtual std::string name() const = 0;
+
+	/// \brief the number of requests sent to an external signer so far
+	unsigned long nRequests() const
+		{ return this->m_nRequests; }
+
+protected:
+	std::atomic<unsigned long>	m_nRequests { 0 };
+	};
+
+/// \brief sign in-process with a key read from an OpenSSH key file.
+std::shared_ptr<Backend_t>
+makeKeyfileBackend(const Keyfile_ed25519_t &key);
+
+/// \brief sign with the signing daemon listening on \p socketname.
+///	An all-zero \p selector selects the daemon's first key.
+std::shared_ptr<Backend_t>
+makeSocketBackend(const std::string &socketname, const mcci_tweetnacl_sign_publickey_t &selector);
+
+/// \brief sign with a process started by running \p command with the
+///	shell, speaking the daemon protocol on its stdin and stdout.
+std::shared_ptr<Backend_t>
+makeCommandBackend(const std::string &command, const mcci_tweetnacl_sign_publickey_t &selector);
+
+} // namespace McciBootloader_Signer
+
+#endif /* _mccibootloader_signer_h_ */
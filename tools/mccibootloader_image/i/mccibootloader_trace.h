@@ -0,0 +1,146 @@
+/*
+
+Module:	mccibootloader_trace.h
+
+Function:
+	Phase timing for mccibootloader_image (--stats, --trace-file).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#ifndef _mccibootloader_trace_h_
+#define _mccibootloader_trace_h_	/* prevent multiple includes */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+///
+/// \brief timing of the phases of a run
+///
+/// \details Each phase of the work is timed by a Span_t, which records
+///	the wall-clock time and the CPU time of the calling thread. A
+///	span with a null recorder does nothing at all, so the timing
+///	costs a pointer test per phase unless --stats or --trace-file
+///	was given. Spans may nest, and may be recorded from any thread.
+///
+namespace McciBootloader_Trace {
+
+/// \brief a point in time
+struct Stamp_t
+	{
+	std::chrono::steady_clock::time_point	wall;	///< wall-clock time
+	std::int64_t				cpuNs;	///< CPU time of this thread, in ns
+
+	/// \brief the time now
+	static Stamp_t now();
+	};
+
+/// \brief the kinds of span
+enum class Kind_t : std::uint8_t
+	{
+	kPhase,		///< a phase of the work (read, hash, sign, ...)
+	kFile,		///< all the work on one file
+	};
+
+/// \brief a timed span
+struct Event_t
+	{
+	const char	*pName;		///< the phase, or "file"
+	Kind_t		kind;
+	std::string	file;		///< the file being worked on, if any
+	unsigned	tid;		///< small thread number, from 1
+	std::int64_t	startNs;	///< wall-clock start, from the start of the run
+	std::int64_t	wallNs;		///< wall-clock duration
+	std::int64_t	cpuNs;		///< CPU time used by the thread
+	};
+
+///
+/// \brief collects the spans of a run
+///
+class Recorder_t
+	{
+public:
+	/// \brief start a recording; times are relative to \p start.
+	Recorder_t(const Stamp_t &start)
+		: m_start(start)
+		{}
+
+	/// \brief record a span.
+	void add(
+		const char *pName,
+		Kind_t kind,
+		const std::string &file,
+		const Stamp_t &start,
+		const Stamp_t &end
+		);
+
+	/// \brief write the human-readable summary.
+	void writeSummary(std::ostream &os) const;
+
+	/// \brief write the spans as Chrome trace-event JSON.
+	void writeChromeTrace(std::ostream &os) const;
+
+private:
+	mutable std::mutex			m_mutex;
+	Stamp_t					m_start;
+	std::vector<Event_t>			m_events;
+	std::map<std::thread::id, unsigned>	m_tids;
+	};
+
+///
+/// \brief times the enclosing scope, if there's a recorder
+///
+class Span_t
+	{
+public:
+	Span_t(Recorder_t *pRecorder, const char *pName, const std::string &file, Kind_t kind = Kind_t::kPhase)
+		: m_pRecorder(pRecorder)
+		, m_pName(pName)
+		, m_kind(kind)
+		{
+		if (pRecorder != nullptr)
+			{
+			this->m_file = file;
+			this->m_start = Stamp_t::now();
+			}
+		}
+
+	~Span_t()
+		{
+		if (this->m_pRecorder != nullptr)
+			this->m_pRecorder->add(this->m_pName, this->m_kind, this->m_file, this->m_start, Stamp_t::now());
+		}
+
+	Span_t(const Span_t &) = delete;
+	Span_t &operator=(const Span_t &) = delete;
+
+private:
+	Recorder_t		*m_pRecorder;
+	const char		*m_pName;
+	Kind_t			m_kind;
+	std::string		m_file;		///< a copy, as the owner may go first
+	Stamp_t			m_start;
+	};
+
+} // namespace McciBootloader_Trace
+
+#endif /* _mccibootloader_trace_h_ */
@@ -0,0 +1,464 @@
+/*
+
+Module:	api.cpp
+
+Function:
+	The C API of libmccibootloader_image (mccibootloader_image_api.h).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_image_api.h"
+
+#include <stdexcept>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+///
+/// \brief the implementation of the C API
+///
+/// \details Each call works on its own App_t, set up the way verifyFile()
+///	sets up its workers: errors throw std::runtime_error, and nothing
+///	is printed. So calls share no state, and may run on any number of
+///	threads at once.
+///
+struct AppApi_t
+	{
+	/// \brief an App_t with the defaults the command line would give
+	static void setup(App_t &app, const uint8_t *pImage, size_t nImage, uint32_t flags)
+		{
+		app.progname = "libmccibootloader_image";
+		app.infilename = "image";
+		app.fCaptureErrors = true;
+		app.fForceBinary = (flags & MCCIBOOTLOADER_IMAGE_FLAG_FORCE_BINARY) != 0;
+		app.authSize =
+			sizeof(mcci_tweetnacl_sign_publickey_t) +
+			sizeof(mcci_tweetnacl_sha512_t) +
+			mcci_tweetnacl_sign_signature_size();
+
+		app.fileimage.assign(pImage, pImage + nImage);
+		app.parseImage();
+		}
+
+	static void getAppInfo(App_t &app, McciBootloader_AppInfo_Wire_t &appInfo)
+		{
+		uint8_t *pAppInfo;
+
+		for (auto const &Entry : vAppInfoOffsets)
+			{
+			if (app.probeHeader(Entry.appInfoOffset, appInfo, pAppInfo))
+				return;
+			}
+
+		app.fatal("could not find valid AppInfo structure");
+		}
+
+	static void sign(
+		App_t &app,
+		const mccibootloader_image_key_t &key,
+		const mccibootloader_image_sign_options_t &options
+		)
+		{
+		memcpy(app.keyfile.m_public.bytes, key.publicKey, sizeof(app.keyfile.m_public.bytes));
+		memcpy(app.keyfile.m_private.bytes, key.privateKey, sizeof(app.keyfile.m_private.bytes));
+
+		app.fAddTime = (options.flags & MCCIBOOTLOADER_IMAGE_FLAG_SET_TIME) != 0;
+		app.posixTimestamp = options.posixTimestamp;
+		app.fAppVersion = (options.flags & MCCIBOOTLOADER_IMAGE_FLAG_SET_VERSION) != 0;
+		app.appVersion = options.version;
+		app.pComment = const_cast<char *>(options.pComment);
+
+		app.addHeader();
+		app.addHash();
+		if ((options.flags & MCCIBOOTLOADER_IMAGE_FLAG_HASH_ONLY) == 0)
+			app.addSignature();
+
+		// the result is the patched input, ELF or flat.
+		if (app.isUsingElf())
+			app.fileimage = std::move(app.elf.image);
+		}
+
+	static void verify(
+		App_t &app,
+		McciBootloader_VerifyResult_t &result,
+		const mccibootloader_image_key_t *pKey
+		)
+		{
+		mcci_tweetnacl_sign_publickey_t publicKey;
+
+		if (pKey != nullptr)
+			memcpy(publicKey.bytes, pKey->publicKey, sizeof(publicKey.bytes));
+
+		app.verifyImage(result, pKey != nullptr ? &publicKey : nullptr);
+		}
+	};
+
+namespace {
+
+/// \brief copy \p text to \p pMessage, if not null.
+void setMessage(mccibootloader_image_message_t *pMessage, const std::string &text)
+	{
+	if (pMessage == nullptr)
+		return;
+
+	auto const n = std::min(text.size(), sizeof(pMessage->text) - 1);
+	memcpy(pMessage->text, text.data(), n);
+	pMessage->text[n] = '\0';
+	}
+
+/// \brief copy the interesting parts of \p appInfo to \p pAppInfo, if not null.
+void setAppInfo(mccibootloader_image_appinfo_t *pAppInfo, const McciBootloader_AppInfo_Wire_t &appInfo)
+	{
+	if (pAppInfo == nullptr)
+		return;
+
+	memset(pAppInfo, 0, sizeof(*pAppInfo));
+	pAppInfo->targetAddress = appInfo.targetAddress.get();
+	pAppInfo->imageSize = appInfo.imagesize.get();
+	pAppInfo->authSize = appInfo.authsize.get();
+	pAppInfo->version = appInfo.version.get();
+	pAppInfo->posixTimestamp = appInfo.posixTimestamp.get();
+
+	auto const comment = appInfo.comment.get();
+	memcpy(pAppInfo->comment, comment.data(), std::min(comment.size(), sizeof(pAppInfo->comment) - 1));
+	}
+
+/// \brief run \p fn, turning exceptions into \p status and a message.
+template <typename Fn_t>
+mccibootloader_image_status_t
+guard(mccibootloader_image_status_t status, mccibootloader_image_message_t *pMessage, const Fn_t &fn)
+	{
+	setMessage(pMessage, "");
+
+	try	{
+		return fn();
+		}
+	catch (std::runtime_error &e)
+		{
+		setMessage(pMessage, e.what());
+		return status;
+		}
+	catch (std::exception &e)
+		{
+		setMessage(pMessage, e.what());
+		return MCCIBOOTLOADER_IMAGE_STATUS_INTERNAL_ERROR;
+		}
+	catch (...)
+		{
+		setMessage(pMessage, "unexpected exception");
+		return MCCIBOOTLOADER_IMAGE_STATUS_INTERNAL_ERROR;
+		}
+	}
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+uint32_t
+mccibootloader_image_api_version(void)
+	{
+	return MCCIBOOTLOADER_IMAGE_API_VERSION;
+	}
+
+const char *
+mccibootloader_image_status_name(
+	mccibootloader_image_status_t status
+	)
+	{
+	switch (status)
+		{
+	case MCCIBOOTLOADER_IMAGE_STATUS_OK:			return "OK";
+	case MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER:	return "INVALID_PARAMETER";
+	case MCCIBOOTLOADER_IMAGE_STATUS_BAD_KEY:		return "BAD_KEY";
+	case MCCIBOOTLOADER_IMAGE_STATUS_BAD_IMAGE:		return "BAD_IMAGE";
+	case MCCIBOOTLOADER_IMAGE_STATUS_VERIFY_FAILED:		return "VERIFY_FAILED";
+	case MCCIBOOTLOADER_IMAGE_STATUS_INTERNAL_ERROR:	return "INTERNAL_ERROR";
+	default:						return "<<unknown>>";
+		}
+	}
+
+size_t
+mccibootloader_image_auth_size(void)
+	{
+	return sizeof(McciBootloader_SignatureBlock_Wire_t);
+	}
+
+/*
+
+Name:	mccibootloader_image_key_read()
+
+Function:
+	Read a key for use with the other API functions.
+
+Definition:
+	mccibootloader_image_status_t mccibootloader_image_key_read(
+		const char *pFilename,
+		mccibootloader_image_key_t *pKey,
+		mccibootloader_image_message_t *pMessage
+		);
+
+Description:
+	pFilename names an OpenSSH ed25519 private key file (not password
+	protected), or a public key file (.pem.pub). For a public key file,
+	pKey->fPrivate is set to zero, and the key can only be used for
+	checking images.
+
+Returns:
+	MCCIBOOTLOADER_IMAGE_STATUS_OK, or BAD_KEY if the file can't be
+	read.
+
+*/
+
+mccibootloader_image_status_t
+mccibootloader_image_key_read(
+	const char *pFilename,
+	mccibootloader_image_key_t *pKey,
+	mccibootloader_image_message_t *pMessage
+	)
+	{
+	if (pFilename == nullptr || pKey == nullptr)
+		return MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER;
+
+	return guard(MCCIBOOTLOADER_IMAGE_STATUS_BAD_KEY, pMessage,
+		[pFilename, pKey]()
+		{
+		Keyfile_ed25519_t keyfile;
+
+		memset(pKey, 0, sizeof(*pKey));
+		keyfile.begin(pFilename);
+
+		if (keyfile.read())
+			{
+			memcpy(pKey->privateKey, keyfile.m_private.bytes, sizeof(pKey->privateKey));
+			pKey->fPrivate = 1;
+			}
+		else if (! keyfile.readPublic())
+			throw std::runtime_error(string("can't read key file: ") + pFilename);
+
+		memcpy(pKey->publicKey, keyfile.m_public.bytes, sizeof(pKey->publicKey));
+		return MCCIBOOTLOADER_IMAGE_STATUS_OK;
+		});
+	}
+
+/*
+
+Name:	mccibootloader_image_get_appinfo()
+
+Function:
+	Find and decode the AppInfo of an image.
+
+Definition:
+	mccibootloader_image_status_t mccibootloader_image_get_appinfo(
+		const uint8_t *pImage,
+		size_t nImage,
+		uint32_t flags,
+		mccibootloader_image_appinfo_t *pAppInfo,
+		mccibootloader_image_message_t *pMessage
+		);
+
+Description:
+	The AppInfo is found the way the command line finds it, at the
+	offset for each supported architecture in turn. ELF files are
+	handled unless MCCIBOOTLOADER_IMAGE_FLAG_FORCE_BINARY is set.
+
+Returns:
+	MCCIBOOTLOADER_IMAGE_STATUS_OK, or BAD_IMAGE if no AppInfo is
+	found.
+
+*/
+
+mccibootloader_image_status_t
+mccibootloader_image_get_appinfo(
+	const uint8_t *pImage,
+	size_t nImage,
+	uint32_t flags,
+	mccibootloader_image_appinfo_t *pAppInfo,
+	mccibootloader_image_message_t *pMessage
+	)
+	{
+	if (pImage == nullptr || pAppInfo == nullptr)
+		return MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER;
+
+	return guard(MCCIBOOTLOADER_IMAGE_STATUS_BAD_IMAGE, pMessage,
+		[=]()
+		{
+		App_t app {};
+		McciBootloader_AppInfo_Wire_t appInfo;
+
+		AppApi_t::setup(app, pImage, nImage, flags);
+		AppApi_t::getAppInfo(app, appInfo);
+		setAppInfo(pAppInfo, appInfo);
+		return MCCIBOOTLOADER_IMAGE_STATUS_OK;
+		});
+	}
+
+/*
+
+Name:	mccibootloader_image_sign()
+
+Function:
+	Hash and sign an image in place.
+
+Definition:
+	mccibootloader_image_status_t mccibootloader_image_sign(
+		uint8_t *pImage,
+		size_t nImage,
+		const mccibootloader_image_key_t *pKey,
+		const mccibootloader_image_sign_options_t *pOptions,
+		mccibootloader_image_message_t *pMessage
+		);
+
+Description:
+	This does what `mccibootloader_image -s` (or -h, with
+	MCCIBOOTLOADER_IMAGE_FLAG_HASH_ONLY) does to a file: the AppInfo is
+	updated as the options say, and the signature block is filled in.
+	If pOptions is NULL, the AppInfo is left as is (like --no-add-time).
+
+	The image is only changed if signing succeeds.
+
+Returns:
+	MCCIBOOTLOADER_IMAGE_STATUS_OK for success; BAD_KEY if the key has
+	no private part; BAD_IMAGE if the image can't be signed.
+
+*/
+
+mccibootloader_image_status_t
+mccibootloader_image_sign(
+	uint8_t *pImage,
+	size_t nImage,
+	const mccibootloader_image_key_t *pKey,
+	const mccibootloader_image_sign_options_t *pOptions,
+	mccibootloader_image_message_t *pMessage
+	)
+	{
+	mccibootloader_image_sign_options_t options {};
+
+	if (pImage == nullptr || pKey == nullptr)
+		return MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER;
+
+	// take what the caller knows about; later fields stay zero.
+	if (pOptions != nullptr)
+		{
+		if (pOptions->size < offsetof(mccibootloader_image_sign_options_t, pComment) + sizeof(pOptions->pComment))
+			return MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER;
+
+		memcpy(&options, pOptions, std::min<size_t>(pOptions->size, sizeof(options)));
+		}
+
+	if (! pKey->fPrivate && (options.flags & MCCIBOOTLOADER_IMAGE_FLAG_HASH_ONLY) == 0)
+		{
+		setMessage(pMessage, "key has no private part");
+		return MCCIBOOTLOADER_IMAGE_STATUS_BAD_KEY;
+		}
+
+	return guard(MCCIBOOTLOADER_IMAGE_STATUS_BAD_IMAGE, pMessage,
+		[=, &options]()
+		{
+		App_t app {};
+
+		AppApi_t::setup(app, pImage, nImage, options.flags);
+		AppApi_t::sign(app, *pKey, options);
+
+		if (app.fileimage.size() != nImage)
+			throw std::logic_error("signing changed the image size");
+
+		memcpy(pImage, app.fileimage.data(), nImage);
+		return MCCIBOOTLOADER_IMAGE_STATUS_OK;
+		});
+	}
+
+/*
+
+Name:	mccibootloader_image_verify()
+
+Function:
+	Check an image the way the bootloader will.
+
+Definition:
+	mccibootloader_image_status_t mccibootloader_image_verify(
+		const uint8_t *pImage,
+		size_t nImage,
+		uint32_t flags,
+		const mccibootloader_image_key_t *pKey,
+		mccibootloader_image_appinfo_t *pAppInfo,
+		mccibootloader_image_message_t *pMessage
+		);
+
+Description:
+	The checks are those of `mccibootloader_image --verify`. If pKey
+	is not NULL, the image must be signed with that key; otherwise the
+	signature is checked against the key embedded in the image. If
+	pAppInfo is not NULL and the AppInfo was found, it's filled in.
+
+Returns:
+	MCCIBOOTLOADER_IMAGE_STATUS_OK if the image passed; VERIFY_FAILED
+	if not, in which case the message lists the failures.
+
+*/
+
+mccibootloader_image_status_t
+mccibootloader_image_verify(
+	const uint8_t *pImage,
+	size_t nImage,
+	uint32_t flags,
+	const mccibootloader_image_key_t *pKey,
+	mccibootloader_image_appinfo_t *pAppInfo,
+	mccibootloader_image_message_t *pMessage
+	)
+	{
+	if (pImage == nullptr)
+		return MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER;
+
+	return guard(MCCIBOOTLOADER_IMAGE_STATUS_VERIFY_FAILED, pMessage,
+		[=]()
+		{
+		App_t app {};
+		McciBootloader_VerifyResult_t result;
+
+		AppApi_t::setup(app, pImage, nImage, flags);
+		AppApi_t::verify(app, result, pKey);
+
+		if (result.fAppInfo)
+			setAppInfo(pAppInfo, result.appInfo);
+
+		if (result.failures.size() == 0)
+			return MCCIBOOTLOADER_IMAGE_STATUS_OK;
+
+		string text;
+		for (auto const &why : result.failures)
+			text += (text == "" ? "" : "; ") + why;
+
+		setMessage(pMessage, text);
+		return MCCIBOOTLOADER_IMAGE_STATUS_VERIFY_FAILED;
+		});
+	}
+
+/**** end of api.cpp ****/
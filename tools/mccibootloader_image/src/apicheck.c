@@ -0,0 +1,415 @@
+/*
+
+Module:	apicheck.c
+
+Function:
+	main() for mccibootloader_image_apicheck, which signs an image
+	with the shared library's C API, from several threads at once,
+	and checks that bad input is reported rather than fatal.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image_api.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+#define	kMaxThreads	64
+
+/* the timestamp used for signing, so that the result is repeatable */
+#define	kTimestamp	UINT64_C(1616000000)
+
+typedef struct SignJob_s
+	{
+	const mccibootloader_image_key_t	*pKey;
+	const uint8_t				*pInput;
+	size_t					nInput;
+	uint8_t					*pImage;
+	mccibootloader_image_status_t		status;
+	mccibootloader_image_message_t		message;
+	} SignJob_t;
+
+static int checkErrors(const char *pKeyfile, const char *pInfile);
+static int expectStatus(const char *pWhat, mccibootloader_image_status_t status, mccibootloader_image_status_t expected, const mccibootloader_image_message_t *pMessage);
+static void *signThread(void *pArg);
+static uint8_t *readFile(const char *pName, size_t *pSize);
+static void fail(const char *pWhat, mccibootloader_image_status_t status, const mccibootloader_image_message_t *pMessage);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+static const char kUsage[] =
+	"usage: mccibootloader_image_apicheck keyfile infile outfile [nThreads]\n"
+	"   or: mccibootloader_image_apicheck --errors keyfile infile\n";
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	main()
+
+Function:
+	Sign an image with the C API, checking that concurrent calls give
+	the same result.
+
+Definition:
+	int main(int argc, char **argv);
+
+Description:
+	The image in infile is signed with the key in keyfile, nThreads
+	times at once (default 8), with the timestamp set to a fixed
+	value. All the results must be the same, and must pass
+	mccibootloader_image_verify() with the key. The result is then
+	written to outfile.
+
+	The output can then be checked with mccibootloader_image --verify,
+	and booted with mccibootloader_hostsim.
+
+	With --errors, the API is instead given missing and malformed keys
+	and images (see checkErrors()); each call must return the documented
+	status, rather than ending the process.
+
+Returns:
+	EXIT_SUCCESS if all went well, EXIT_FAILURE otherwise.
+
+*/
+
+int main(int argc, char **argv)
+	{
+	mccibootloader_image_key_t key;
+	mccibootloader_image_message_t message;
+	mccibootloader_image_appinfo_t appInfo;
+	mccibootloader_image_status_t status;
+	SignJob_t jobs[kMaxThreads];
+	pthread_t threads[kMaxThreads];
+	unsigned nThreads;
+	unsigned i;
+	uint8_t *pInput;
+	size_t nInput;
+	FILE *pOut;
+
+	if (argc == 4 && strcmp(argv[1], "--errors") == 0)
+		return checkErrors(argv[2], argv[3]);
+
+	if (argc < 4 || argc > 5)
+		{
+		fputs(kUsage, stderr);
+		return EXIT_FAILURE;
+		}
+
+	nThreads = argc > 4 ? (unsigned) strtoul(argv[4], NULL, 0) : 8;
+	if (nThreads == 0 || nThreads > kMaxThreads)
+		{
+		fputs(kUsage, stderr);
+		return EXIT_FAILURE;
+		}
+
+	if (mccibootloader_image_api_version() >> 16 != MCCIBOOTLOADER_IMAGE_API_VERSION_MAJOR)
+		{
+		fprintf(stderr, "library API version mismatch: %#x\n", (unsigned) mccibootloader_image_api_version());
+		return EXIT_FAILURE;
+		}
+
+	status = mccibootloader_image_key_read(argv[1], &key, &message);
+	if (status != MCCIBOOTLOADER_IMAGE_STATUS_OK)
+		fail("key_read", status, &message);
+
+	pInput = readFile(argv[2], &nInput);
+
+	for (i = 0; i < nThreads; ++i)
+		{
+		memset(&jobs[i], 0, sizeof(jobs[i]));
+		jobs[i].pKey = &key;
+		jobs[i].pInput = pInput;
+		jobs[i].nInput = nInput;
+		jobs[i].pImage = malloc(nInput);
+		if (jobs[i].pImage == NULL)
+			{
+			fputs("out of memory\n", stderr);
+			return EXIT_FAILURE;
+			}
+
+		if (pthread_create(&threads[i], NULL, signThread, &jobs[i]) != 0)
+			{
+			fputs("can't create thread\n", stderr);
+			return EXIT_FAILURE;
+			}
+		}
+
+	for (i = 0; i < nThreads; ++i)
+		{
+		pthread_join(threads[i], NULL);
+		if (jobs[i].status != MCCIBOOTLOADER_IMAGE_STATUS_OK)
+			fail("sign", jobs[i].status, &jobs[i].message);
+		if (memcmp(jobs[i].pImage, jobs[0].pImage, nInput) != 0)
+			{
+			fprintf(stderr, "thread %u: result differs from thread 0\n", i);
+			return EXIT_FAILURE;
+			}
+		}
+
+	status = mccibootloader_image_verify(
+		jobs[0].pImage, nInput, 0, &key, &appInfo, &message
+		);
+	if (status != MCCIBOOTLOADER_IMAGE_STATUS_OK)
+		fail("verify", status, &message);
+
+	if (appInfo.posixTimestamp != kTimestamp)
+		{
+		fputs("timestamp wasn't set\n", stderr);
+		return EXIT_FAILURE;
+		}
+
+	/* a flipped byte must be caught */
+	if (nThreads > 1)
+		{
+		jobs[1].pImage[0x40] ^= 1;
+		if (mccibootloader_image_verify(jobs[1].pImage, nInput, 0, &key, NULL, &message) !=
+			MCCIBOOTLOADER_IMAGE_STATUS_VERIFY_FAILED)
+			{
+			fputs("corrupted image passed verify\n", stderr);
+			return EXIT_FAILURE;
+			}
+		}
+
+	pOut = fopen(argv[3], "wb");
+	if (pOut == NULL ||
+	    fwrite(jobs[0].pImage, 1, nInput, pOut) != nInput ||
+	    fclose(pOut) != 0)
+		{
+		fprintf(stderr, "can't write %s\n", argv[3]);
+		return EXIT_FAILURE;
+		}
+
+	printf("signed %s with %u thread(s): %#x bytes, target %#x\n",
+		argv[2], nThreads, (unsigned) appInfo.imageSize, (unsigned) appInfo.targetAddress
+		);
+
+	for (i = 0; i < nThreads; ++i)
+		free(jobs[i].pImage);
+	free(pInput);
+
+	return EXIT_SUCCESS;
+	}
+
+/*
+
+Name:	checkErrors()
+
+Function:
+	Check that the C API reports bad keys and images with a status.
+
+Definition:
+	static int checkErrors(const char *pKeyfile, const char *pInfile);
+
+Description:
+	pKeyfile is a good private key, and pInfile a good unsigned image.
+	Each API function is then called with arguments it must refuse: a
+	missing key file, a file that isn't a key, NULL buffers, a buffer
+	of garbage, and the image cut short. The library must return the
+	status documented for each case, with a message; in particular,
+	nothing may exit the process.
+
+Returns:
+	EXIT_SUCCESS if every call returned the expected status,
+	EXIT_FAILURE otherwise.
+
+*/
+
+static int checkErrors(const char *pKeyfile, const char *pInfile)
+	{
+	mccibootloader_image_key_t key;
+	mccibootloader_image_key_t badKey;
+	mccibootloader_image_message_t message;
+	mccibootloader_image_appinfo_t appInfo;
+	uint8_t garbage[4096];
+	uint8_t *pInput;
+	size_t nInput;
+	size_t nShort;
+	unsigned i;
+	int nFailed;
+
+	nFailed = 0;
+	if (mccibootloader_image_key_read(pKeyfile, &key, &message) != MCCIBOOTLOADER_IMAGE_STATUS_OK)
+		{
+		fprintf(stderr, "can't read %s: %s\n", pKeyfile, message.text);
+		return EXIT_FAILURE;
+		}
+
+	pInput = readFile(pInfile, &nInput);
+	for (i = 0; i < sizeof(garbage); ++i)
+		garbage[i] = (uint8_t) (i * 0x9Du + 0x5Bu);
+
+	/* keys */
+	nFailed += expectStatus("key_read of a missing file",
+		mccibootloader_image_key_read("/nonexistent/key.pem", &badKey, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_BAD_KEY, &message
+		);
+	nFailed += expectStatus("key_read of an image",
+		mccibootloader_image_key_read(pInfile, &badKey, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_BAD_KEY, &message
+		);
+	nFailed += expectStatus("key_read with no key",
+		mccibootloader_image_key_read(pKeyfile, NULL, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER, NULL
+		);
+
+	/* buffers */
+	nFailed += expectStatus("get_appinfo of NULL",
+		mccibootloader_image_get_appinfo(NULL, 0, 0, &appInfo, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER, NULL
+		);
+	nFailed += expectStatus("get_appinfo of garbage",
+		mccibootloader_image_get_appinfo(garbage, sizeof(garbage), 0, &appInfo, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_BAD_IMAGE, &message
+		);
+	nFailed += expectStatus("sign NULL",
+		mccibootloader_image_sign(NULL, nInput, &key, NULL, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_INVALID_PARAMETER, NULL
+		);
+	nFailed += expectStatus("sign garbage",
+		mccibootloader_image_sign(garbage, sizeof(garbage), &key, NULL, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_BAD_IMAGE, &message
+		);
+
+	/* the image cut off before its signature block, then before its AppInfo */
+	nShort = nInput > mccibootloader_image_auth_size() ? nInput - mccibootloader_image_auth_size() : 0;
+	nFailed += expectStatus("sign a truncated image",
+		mccibootloader_image_sign(pInput, nShort, &key, NULL, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_BAD_IMAGE, &message
+		);
+	nFailed += expectStatus("get_appinfo of a truncated image",
+		mccibootloader_image_get_appinfo(pInput, 64, 0, &appInfo, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_BAD_IMAGE, &message
+		);
+	nFailed += expectStatus("verify garbage",
+		mccibootloader_image_verify(garbage, sizeof(garbage), 0, &key, NULL, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_VERIFY_FAILED, &message
+		);
+	nFailed += expectStatus("verify an unsigned image",
+		mccibootloader_image_verify(pInput, nInput, 0, &key, NULL, &message),
+		MCCIBOOTLOADER_IMAGE_STATUS_VERIFY_FAILED, &message
+		);
+
+	free(pInput);
+
+	if (nFailed != 0)
+		return EXIT_FAILURE;
+
+	printf("error paths: all calls returned the expected status\n");
+	return EXIT_SUCCESS;
+	}
+
+/* report a call that returned the wrong status, or no message; return 1 if so */
+static int expectStatus(
+	const char *pWhat,
+	mccibootloader_image_status_t status,
+	mccibootloader_image_status_t expected,
+	const mccibootloader_image_message_t *pMessage
+	)
+	{
+	if (status != expected)
+		{
+		fprintf(stderr, "%s: got %s, expected %s\n",
+			pWhat,
+			mccibootloader_image_status_name(status),
+			mccibootloader_image_status_name(expected)
+			);
+		return 1;
+		}
+
+	if (pMessage != NULL && pMessage->text[0] == '\0')
+		{
+		fprintf(stderr, "%s: %s, but no message\n", pWhat, mccibootloader_image_status_name(status));
+		return 1;
+		}
+
+	return 0;
+	}
+
+static void *signThread(void *pArg)
+	{
+	SignJob_t * const pJob = pArg;
+	mccibootloader_image_sign_options_t options;
+
+	memset(&options, 0, sizeof(options));
+	options.size = sizeof(options);
+	options.flags = MCCIBOOTLOADER_IMAGE_FLAG_SET_TIME;
+	options.posixTimestamp = kTimestamp;
+
+	memcpy(pJob->pImage, pJob->pInput, pJob->nInput);
+	pJob->status = mccibootloader_image_sign(
+		pJob->pImage, pJob->nInput, pJob->pKey, &options, &pJob->message
+		);
+
+	return NULL;
+	}
+
+static uint8_t *readFile(const char *pName, size_t *pSize)
+	{
+	FILE *pFile;
+	uint8_t *pBuffer;
+	long n;
+
+	pFile = fopen(pName, "rb");
+	if (pFile == NULL ||
+	    fseek(pFile, 0, SEEK_END) != 0 ||
+	    (n = ftell(pFile)) < 0 ||
+	    fseek(pFile, 0, SEEK_SET) != 0)
+		{
+		fprintf(stderr, "can't read %s\n", pName);
+		exit(EXIT_FAILURE);
+		}
+
+	pBuffer = malloc(n == 0 ? 1 : (size_t) n);
+	if (pBuffer == NULL || fread(pBuffer, 1, (size_t) n, pFile) != (size_t) n)
+		{
+		fprintf(stderr, "can't read %s\n", pName);
+		exit(EXIT_FAILURE);
+		}
+
+	fclose(pFile);
+	*pSize = (size_t) n;
+	return pBuffer;
+	}
+
+static void fail(
+	const char *pWhat,
+	mccibootloader_image_status_t status,
+	const mccibootloader_image_message_t *pMessage
+	)
+	{
+	fprintf(stderr, "%s: %s: %s\n",
+		pWhat, mccibootloader_image_status_name(status), pMessage->text
+		);
+	exit(EXIT_FAILURE);
+	}
+
+/**** end of apicheck.c ****/
@@ -0,0 +1,186 @@
+/*
+
+Module:	artifacts.cpp
+
+Function:
+	Extra outputs (--output-bin, --output-elf, --output-hex,
+	--output-srec, --output-slot).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_hexfile.h"
+
+using namespace McciBootloader_HexFile;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief write \p n bytes at \p p, then \p fill up to \p nTotal bytes.
+void writePadded(std::ostream &os, const uint8_t *p, size_t n, size_t nTotal, uint8_t fill)
+	{
+	os.write((const char *)p, n);
+
+	char buffer[4096];
+	std::memset(buffer, fill, sizeof(buffer));
+
+	for (size_t nPad = nTotal - n; nPad != 0; )
+		{
+		auto const nThis = std::min(nPad, sizeof(buffer));
+		os.write(buffer, nThis);
+		nPad -= nThis;
+		}
+	}
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::writeArtifacts()
+
+Function:
+	Write the extra outputs requested on the command line.
+
+Definition:
+	void App_t::writeArtifacts();
+
+Description:
+	Each output is written directly from this->fileimage (the flat
+	image) or this->elf.image (the patched ELF image), so the image is
+	read, hashed and signed only once however many outputs there are.
+	For ELF input, the flat image is only made if a flat output was
+	asked for.
+
+	The flat image is loaded at the target address from the AppInfo.
+	The options are checked before anything is written, so that a bad
+	combination doesn't leave some outputs stale and others new.
+	The storage-slot image is the flat image padded with 0xFF (erased
+	SPI flash) to the size of a storage slot.
+
+Returns:
+	No explicit result. Errors are fatal.
+
+*/
+
+void App_t::writeArtifacts()
+	{
+	if (this->vArtifacts.size() == 0)
+		return;
+
+	bool const fFlat = std::any_of(
+		this->vArtifacts.begin(), this->vArtifacts.end(),
+		[](const Artifact_t &artifact) { return artifact.kind != Artifact_t::Kind_t::kElf; }
+		);
+
+	if (fFlat)
+		this->flattenImage();
+
+	const uint8_t * const pImage = this->fileimage.data();
+	size_t const nImage = this->imageSize();
+	uint32_t base;
+	bool fFoundBase = false;
+
+	// the load address comes from the AppInfo; if we took the image
+	// from the cache, this->pFileAppInfo isn't set, so look again.
+	for (auto const &Entry : vAppInfoOffsets)
+		{
+		McciBootloader_AppInfo_Wire_t appInfo;
+		uint8_t *pAppInfo;
+
+		if (nImage >= Entry.appInfoOffset + sizeof(appInfo) &&
+		    this->probeHeader(Entry.appInfoOffset, appInfo, pAppInfo))
+			{
+			base = appInfo.targetAddress.get();
+			fFoundBase = true;
+			break;
+			}
+		}
+
+	if (! fFoundBase)
+		this->fatal(this->infilename + ": could not find valid AppInfo structure");
+
+	for (auto const &artifact : this->vArtifacts)
+		{
+		if (artifact.kind == Artifact_t::Kind_t::kElf && ! this->isUsingElf())
+			this->usage("--output-elf needs an ELF input file");
+
+		if (artifact.kind == Artifact_t::Kind_t::kSlot &&
+		    nImage > McciBootloader_MemoryMap_t::kStorageImageSize)
+			this->fatal("image is too big for a storage slot: " + artifact.filename);
+		}
+
+	for (auto const &artifact : this->vArtifacts)
+		{
+		if (this->fDryRun)
+			{
+			this->verbose("dry run, skipping write: " + artifact.filename);
+			continue;
+			}
+
+		std::ofstream outfile { artifact.filename, ios::binary | ios::trunc };
+		if (! outfile.is_open())
+			this->fatal("can't create: " + artifact.filename);
+
+		switch (artifact.kind)
+			{
+		case Artifact_t::Kind_t::kBinary:
+			outfile.write((const char *)pImage, nImage);
+			break;
+
+		case Artifact_t::Kind_t::kElf:
+			outfile.write((const char *)this->elf.image.data(), this->elf.image.size());
+			break;
+
+		case Artifact_t::Kind_t::kHex:
+			writeIntelHex(outfile, { { base, pImage, nImage } });
+			break;
+
+		case Artifact_t::Kind_t::kSrec:
+			writeSrec(outfile, { { base, pImage, nImage } }, filebasename(artifact.filename.c_str()));
+			break;
+
+		case Artifact_t::Kind_t::kSlot:
+			writePadded(outfile, pImage, nImage, McciBootloader_MemoryMap_t::kStorageImageSize, 0xFF);
+			break;
+			}
+
+		outfile.close();
+		if (! outfile)
+			this->fatal("can't write: " + artifact.filename);
+
+		this->verbose("output file successfully written: " + artifact.filename);
+		}
+	}
+
+/**** end of artifacts.cpp ****/
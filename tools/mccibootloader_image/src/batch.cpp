@@ -0,0 +1,322 @@
+/*
+
+Module:	batch.cpp
+
+Function:
+	App_t::signBatch(): hash and sign many images, with one request
+	to the signer (--batch).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_signer.h"
+
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief one image to be signed
+struct BatchJob_t
+	{
+	std::string		infilename;
+	std::string		outfilename;
+	std::unique_ptr<App_t>	pApp;		///< the worker, holding the hashed image
+	std::string		error;		///< why it failed; empty for success
+	};
+
+} // namespace
+
+static void addJobs(
+	const std::vector<string> &args,
+	std::vector<BatchJob_t> &jobs
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::signBatch()
+
+Function:
+	Hash and sign a batch of images.
+
+Definition:
+	int App_t::signBatch();
+
+Description:
+	this->batchArgs holds pairs of input and output file names, or
+	list files ("@file", or "@-" for stdin) with one input and output
+	per line. Each image is read, its header updated and hashed, on
+	this->nJobs worker threads. Then all the hashes are given to the
+	signer at once: for the daemon or an external signer, that's one
+	round trip per kMaxHashesPerRequest images, rather than one per
+	image. Finally the signatures are placed and the outputs written.
+
+	An image that can't be read or hashed is reported, and the rest
+	are still signed.
+
+Returns:
+	EXIT_SUCCESS if every image was signed, EXIT_FAILURE otherwise.
+
+*/
+
+int App_t::signBatch()
+	{
+	std::vector<BatchJob_t> jobs;
+
+	try	{
+		addJobs(this->batchArgs, jobs);
+		}
+	catch (std::exception &e)
+		{
+		this->fatal(e.what());
+		}
+
+	if (jobs.size() == 0)
+		this->fatal("no images to sign");
+
+	auto const tStart = std::chrono::steady_clock::now();
+
+	// read and hash each image.
+	unsigned nJobs = this->nJobs;
+	if (nJobs == 0)
+		nJobs = std::max(1u, std::thread::hardware_concurrency());
+	if (nJobs > jobs.size())
+		nJobs = unsigned(jobs.size());
+
+	std::atomic<size_t> iNext { 0 };
+	auto const worker = [this, &iNext, &jobs]()
+		{
+		for (size_t i; (i = iNext++) < jobs.size(); )
+			{
+			auto &job = jobs[i];
+
+			job.pApp.reset(new App_t(*this));
+
+			auto &app = *job.pApp;
+
+			app.fCaptureErrors = true;
+			app.fVerbose = false;
+			app.fBatch = false;
+			app.infilename = job.infilename;
+			app.outfilename = job.outfilename;
+
+			auto const span = app.span("file", McciBootloader_Trace::Kind_t::kFile);
+
+			try	{
+				app.readImage();
+				app.addHeader();
+				app.addHash();
+				}
+			catch (std::exception &e)
+				{
+				job.error = e.what();
+				job.pApp.reset();
+				}
+			}
+		};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < nJobs; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto &t : threads)
+		t.join();
+
+	// sign all the hashes at once.
+	std::vector<mcci_tweetnacl_sha512_t> hashes;
+	std::vector<BatchJob_t *> hashed;
+
+	for (auto &job : jobs)
+		{
+		if (job.pApp)
+			{
+			hashes.push_back(job.pApp->fileHash);
+			hashed.push_back(&job);
+			}
+		}
+
+	std::vector<mcci_tweetnacl_sign_signature_t> signatures(hashes.size());
+	auto const nRequestsBefore = this->signer().nRequests();
+
+	if (this->fSign && hashes.size() != 0)
+		{
+		auto const span = this->span("sign");
+
+		try	{
+			this->signer().signHashes(hashes.data(), hashes.size(), signatures.data());
+			}
+		catch (std::exception &e)
+			{
+			this->fatal(e.what());
+			}
+		}
+
+	auto const nRequests = this->signer().nRequests() - nRequestsBefore;
+
+	// place the signatures and write the results.
+	size_t nSigned = 0;
+
+	for (size_t i = 0; i < hashed.size(); ++i)
+		{
+		auto &job = *hashed[i];
+		auto &app = *job.pApp;
+		auto const span = app.span("file", McciBootloader_Trace::Kind_t::kFile);
+
+		try	{
+			if (this->fSign)
+				app.putSignature(signatures[i]);
+
+			app.writeImage();
+			++nSigned;
+			this->verbose((this->fSign ? "signed " : "hashed ") + job.infilename + " -> " + job.outfilename);
+			}
+		catch (std::exception &e)
+			{
+			job.error = e.what();
+			}
+
+		job.pApp.reset();
+		}
+
+	auto const ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - tStart
+				).count();
+
+	// report.
+	std::cout << (this->fSign ? "signed " : "hashed ") << nSigned
+		  << " of " << jobs.size() << " image(s) with " << this->signer().name();
+	if (nRequests != 0)
+		std::cout << " in " << nRequests << " request(s)";
+	std::cout << " (" << ms << " ms)\n";
+
+	if (nSigned != jobs.size())
+		{
+		std::cout << "\nFailures:\n";
+		for (auto const &job : jobs)
+			{
+			if (job.error != "")
+				std::cout << "  " << job.infilename << ": " << job.error << "\n";
+			}
+		}
+
+	std::cout << std::flush;
+	return nSigned == jobs.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+/*
+
+Name:	addJobs()
+
+Function:
+	Expand the --batch arguments into a list of jobs.
+
+Definition:
+	static void addJobs(
+		const std::vector<string> &args,
+		std::vector<BatchJob_t> &jobs
+		);
+
+Description:
+	An argument of the form "@file" names a list file ("@-" for
+	stdin), in which each line that isn't blank or a comment ("#")
+	gives an input and output file name, separated by white space.
+	Other arguments are taken in pairs, input then output.
+
+Returns:
+	No explicit result; throws std::runtime_error if the arguments
+	are malformed.
+
+*/
+
+static void addJobs(
+	const std::vector<string> &args,
+	std::vector<BatchJob_t> &jobs
+	)
+	{
+	auto const addJob = [&jobs](const string &infilename, const string &outfilename)
+		{
+		if (infilename == outfilename)
+			throw std::runtime_error("--batch output must not be the input: " + infilename);
+
+		jobs.push_back(BatchJob_t { infilename, outfilename, nullptr, "" });
+		};
+
+	for (size_t iArg = 0; iArg < args.size(); ++iArg)
+		{
+		auto const &arg = args[iArg];
+
+		if (arg.size() > 1 && arg[0] == '@')
+			{
+			auto const listname = arg.substr(1);
+			std::ifstream listfile;
+			std::istream *pList = &std::cin;
+
+			if (listname != "-")
+				{
+				listfile.open(listname);
+				if (! listfile.is_open())
+					throw std::runtime_error("can't read list file: " + listname);
+				pList = &listfile;
+				}
+
+			for (string line; std::getline(*pList, line); )
+				{
+				std::istringstream fields(line);
+				string infilename, outfilename, extra;
+
+				if (! (fields >> infilename) || infilename[0] == '#')
+					continue;
+
+				if (! (fields >> outfilename) || (fields >> extra))
+					throw std::runtime_error(listname + ": expected an input and an output file name: " + line);
+
+				addJob(infilename, outfilename);
+				}
+			}
+		else if (iArg + 1 < args.size() && args[iArg + 1][0] != '@')
+			{
+			addJob(arg, args[iArg + 1]);
+			++iArg;
+			}
+		else
+			throw std::runtime_error("missing --batch output file name for " + arg);
+		}
+	}
+
+/**** end of batch.cpp ****/
@@ -0,0 +1,617 @@
+/*
+
+Module:	benchmark.cpp
+
+Function:
+	main() and phase timing for mccibootloader_image_bench.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_image_version.h"
+
+#include <atomic>
+#include <filesystem>
+#include <iomanip>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+/// \brief the result of timing one phase
+struct BenchResult_t
+	{
+	uint64_t	nIterations = 0;	///< number of timed runs
+	double		seconds = 0;		///< total time in the timed sections
+	uint64_t	nAllocs = 0;		///< allocations in the timed sections
+	uint64_t	nAllocBytes = 0;	///< bytes allocated in the timed sections
+	};
+
+/// \brief the benchmark driver; a friend of App_t so it can run the phases.
+struct AppBenchmark_t
+	{
+	std::string		progname;
+	std::string		keyfilename;
+	std::string		outfilename;
+	double			minSeconds = 0.25;
+	unsigned		minIterations = 3;
+	fs::path		tmpdir;
+	std::ostream		*pOut = &std::cout;
+	Keyfile_ed25519_t	keyfile;
+
+	int begin(int argc, char **argv);
+	void scanArgs(int argc, char **argv);
+	[[noreturn]] void usage(const string &message);
+	[[noreturn]] void fatal(const string &message);
+
+	std::unique_ptr<App_t> newApp(const fs::path &infile) const;
+	void report(
+		const char *pPhase,
+		const char *pInput,
+		size_t size,
+		unsigned nSegments,
+		const BenchResult_t &r
+		);
+
+	template <typename a_Setup, typename a_Body>
+	BenchResult_t measure(a_Setup setup, a_Body body) const;
+
+	void benchKeyfile();
+	void benchBinary(size_t size);
+	void benchProbe(const McciBootloader_AppInfoOffset_t &entry);
+	void benchElf(size_t size, unsigned nSegments);
+	};
+
+static std::vector<uint8_t> makeImage(
+	size_t size,
+	size_t appInfoOffset,
+	uint32_t seed
+	);
+
+static std::vector<uint8_t> makeElf(
+	const std::vector<uint8_t> &image,
+	unsigned nSegments
+	);
+
+static void writeFile(
+	const fs::path &path,
+	const std::vector<uint8_t> &data
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+/// \brief the image sizes we sweep over
+static const size_t kImageSizes[] =
+	{
+	16 * 1024, 32 * 1024, 64 * 1024, 128 * 1024,
+	256 * 1024, 512 * 1024, 1024 * 1024,
+	};
+
+/// \brief the program header counts we sweep over for ELF inputs
+static const unsigned kElfSegments[] =
+	{
+	1, 4, 16, 64, 256, 1024,
+	};
+
+/// \brief the size of the ELF images used for the program-header sweep
+static constexpr size_t kElfImageSize = 256 * 1024;
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+//
+// Allocation accounting. We replace the global allocation functions
+// so that every phase can report how much it allocates.
+//
+static std::atomic<uint64_t> gnAllocs { 0 };
+static std::atomic<uint64_t> gnAllocBytes { 0 };
+
+void *operator new(std::size_t n)
+	{
+	++gnAllocs;
+	gnAllocBytes += n;
+
+	void * const p = std::malloc(n == 0 ? 1 : n);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+	}
+
+void *operator new[](std::size_t n)
+	{
+	return operator new(n);
+	}
+
+void operator delete(void *p) noexcept
+	{
+	std::free(p);
+	}
+
+void operator delete[](void *p) noexcept
+	{
+	std::free(p);
+	}
+
+void operator delete(void *p, std::size_t) noexcept
+	{
+	std::free(p);
+	}
+
+void operator delete[](void *p, std::size_t) noexcept
+	{
+	std::free(p);
+	}
+
+int main(
+	int argc,
+	char **argv
+	)
+	{
+	AppBenchmark_t bench;
+
+	// the App_t phases we drive end with Exit_t on errors.
+	try	{
+		return bench.begin(argc, argv);
+		}
+	catch (App_t::Exit_t &e)
+		{
+		return e.status;
+		}
+	}
+
+int AppBenchmark_t::begin(int argc, char **argv)
+	{
+	this->scanArgs(argc, argv);
+
+	std::ofstream outfile;
+	if (this->outfilename != "")
+		{
+		outfile.open(this->outfilename, ios::trunc);
+		if (! outfile.is_open())
+			this->fatal("can't create: " + this->outfilename);
+		this->pOut = &outfile;
+		}
+
+	this->tmpdir = fs::temp_directory_path() / ("mccibootloader_bench." + std::to_string(getpid()));
+	fs::create_directories(this->tmpdir);
+
+	// the configuration record, so results can be compared later.
+	*this->pOut	<< "{\"record\":\"config\""
+			<< ",\"tool\":\"mccibootloader_image\""
+			<< ",\"version\":\""
+			<< unsigned(McciVersion::getMajor(kVersion)) << "."
+			<< unsigned(McciVersion::getMinor(kVersion)) << "."
+			<< unsigned(McciVersion::getPatch(kVersion)) << "."
+			<< unsigned(McciVersion::getLocal(kVersion)) << "\""
+			<< ",\"compiler\":\"" << __VERSION__ << "\""
+			<< ",\"min_seconds\":" << this->minSeconds
+			<< ",\"min_iterations\":" << this->minIterations
+			<< "}\n";
+
+	this->benchKeyfile();
+
+	this->keyfile.begin(this->keyfilename);
+	if (! this->keyfile.read())
+		this->fatal("can't read key file: " + this->keyfilename);
+
+	for (auto const &entry : vAppInfoOffsets)
+		this->benchProbe(entry);
+
+	for (auto const size : kImageSizes)
+		this->benchBinary(size);
+
+	for (auto const nSegments : kElfSegments)
+		this->benchElf(kElfImageSize, nSegments);
+
+	fs::remove_all(this->tmpdir);
+	return EXIT_SUCCESS;
+	}
+
+void AppBenchmark_t::scanArgs(int argc, char **argv)
+	{
+	this->progname = filebasename(*argv++);
+
+	for (;;)
+		{
+		auto const pThisarg = *argv++;
+
+		if (pThisarg == NULL)
+			break;
+
+		string arg = pThisarg;
+
+		if (arg == "-k" || arg == "--keyfile")
+			{
+			if (*argv == nullptr)
+				this->usage("missing keyfile name");
+			this->keyfilename = *argv++;
+			}
+		else if (arg == "-o" || arg == "--output")
+			{
+			if (*argv == nullptr)
+				this->usage("missing output file name");
+			this->outfilename = *argv++;
+			}
+		else if (arg == "--min-time")
+			{
+			if (*argv == nullptr)
+				this->usage("missing min-time value");
+
+			char *pEnd;
+			this->minSeconds = std::strtod(*argv, &pEnd);
+			if (*pEnd != '\0' || !(this->minSeconds >= 0))
+				this->usage(string("illegal min-time: ") + *argv);
+			++argv;
+			}
+		else
+			{
+			this->usage("unknown arg: " + arg);
+			}
+		}
+
+	if (this->keyfilename == "")
+		this->usage("a keyfile is required");
+	}
+
+[[noreturn]]
+void AppBenchmark_t::usage(const string &message)
+	{
+	fprintf(stderr, "%s: usage: %s -k {keyfile} [-o {outfile}] [--min-time {seconds}]\n",
+		message.c_str(), this->progname.c_str());
+	exit(EXIT_FAILURE);
+	}
+
+[[noreturn]]
+void AppBenchmark_t::fatal(const string &message)
+	{
+	fprintf(stderr, "?%s: %s\n", this->progname.c_str(), message.c_str());
+	if (! this->tmpdir.empty())
+		{
+		std::error_code ec;
+		fs::remove_all(this->tmpdir, ec);
+		}
+	exit(EXIT_FAILURE);
+	}
+
+///
+/// \brief time a phase
+///
+/// \param setup	called before each run, outside of the timed section
+/// \param body		the phase being timed
+///
+/// \details The phase is repeated until it has run for at least
+///	minSeconds, and at least minIterations times.
+///
+template <typename a_Setup, typename a_Body>
+BenchResult_t AppBenchmark_t::measure(a_Setup setup, a_Body body) const
+	{
+	BenchResult_t r;
+
+	while (r.seconds < this->minSeconds || r.nIterations < this->minIterations)
+		{
+		setup();
+
+		auto const nAllocs = gnAllocs.load();
+		auto const nAllocBytes = gnAllocBytes.load();
+		auto const tStart = std::chrono::steady_clock::now();
+
+		body();
+
+		auto const tEnd = std::chrono::steady_clock::now();
+
+		r.nAllocs += gnAllocs.load() - nAllocs;
+		r.nAllocBytes += gnAllocBytes.load() - nAllocBytes;
+		r.seconds += std::chrono::duration<double>(tEnd - tStart).count();
+		++r.nIterations;
+		}
+
+	return r;
+	}
+
+void AppBenchmark_t::report(
+	const char *pPhase,
+	const char *pInput,
+	size_t size,
+	unsigned nSegments,
+	const BenchResult_t &r
+	)
+	{
+	double const n = double(r.nIterations);
+	double const secondsPerOp = r.seconds / n;
+
+	*this->pOut	<< "{\"record\":\"result\""
+			<< ",\"phase\":\"" << pPhase << "\""
+			<< ",\"input\":\"" << pInput << "\""
+			<< ",\"size\":" << size
+			<< ",\"segments\":" << nSegments
+			<< ",\"iterations\":" << r.nIterations
+			<< ",\"ns_per_op\":" << std::fixed << std::setprecision(1) << secondsPerOp * 1e9
+			<< ",\"mib_per_s\":" << std::setprecision(3) << (secondsPerOp > 0 ? size / secondsPerOp / (1024.0 * 1024.0) : 0.0)
+			<< ",\"allocs_per_op\":" << std::setprecision(2) << r.nAllocs / n
+			<< ",\"alloc_bytes_per_op\":" << std::setprecision(1) << r.nAllocBytes / n
+			<< std::defaultfloat
+			<< "}\n"
+			<< std::flush;
+	}
+
+/// \brief make a fresh App_t, set up as the command line would for signing.
+std::unique_ptr<App_t> AppBenchmark_t::newApp(const fs::path &infile) const
+	{
+	std::unique_ptr<App_t> pApp { new App_t {} };
+
+	pApp->progname = this->progname;
+	pApp->infilename = infile.string();
+	pApp->outfilename = (this->tmpdir / "output").string();
+	pApp->fHash = pApp->fSign = pApp->fUpdate = true;
+	pApp->fAddTime = true;
+	pApp->authSize =
+		sizeof(mcci_tweetnacl_sign_publickey_t) +
+		sizeof(mcci_tweetnacl_sha512_t) +
+		mcci_tweetnacl_sign_signature_size();
+	pApp->keyfile = this->keyfile;
+	return pApp;
+	}
+
+void AppBenchmark_t::benchKeyfile()
+	{
+	Keyfile_ed25519_t k;
+	std::error_code ec;
+	auto const size = fs::file_size(this->keyfilename, ec);
+
+	auto const r = this->measure(
+		[&]() { k.begin(this->keyfilename); },
+		[&]()
+			{
+			if (! k.read())
+				this->fatal("can't read key file: " + this->keyfilename);
+			}
+		);
+
+	this->report("keyfile", "pem", ec ? 0 : size_t(size), 0, r);
+	}
+
+void AppBenchmark_t::benchProbe(const McciBootloader_AppInfoOffset_t &entry)
+	{
+	auto const size = kImageSizes[0];
+	auto const infile = this->tmpdir / "probe.bin";
+	auto const image = makeImage(size, entry.appInfoOffset, 1);
+	std::unique_ptr<App_t> pApp;
+
+	writeFile(infile, image);
+
+	auto const r = this->measure(
+		[&]()
+			{
+			pApp = this->newApp(infile);
+			pApp->fileimage = image;
+			pApp->fSize = image.size();
+			},
+		[&]() { pApp->addHeader(); }
+		);
+
+	std::string input = string("bin-") + entry.pModelName;
+	this->report("addHeader", input.c_str(), size, 0, r);
+	}
+
+void AppBenchmark_t::benchBinary(size_t size)
+	{
+	auto const infile = this->tmpdir / "input.bin";
+	auto const image = makeImage(size, vAppInfoOffsets[0].appInfoOffset, uint32_t(size));
+	std::unique_ptr<App_t> pApp;
+
+	writeFile(infile, image);
+
+	this->report("readImage", "bin", size, 0, this->measure(
+		[&]() { pApp = this->newApp(infile); },
+		[&]() { pApp->readImage(); }
+		));
+
+	// the remaining phases work on a single prepared image.
+	pApp = this->newApp(infile);
+	pApp->readImage();
+	pApp->addHeader();
+
+	this->report("addHash", "bin", size, 0, this->measure(
+		[]() {},
+		[&]() { pApp->addHash(); }
+		));
+
+	this->report("addSignature", "bin", size, 0, this->measure(
+		[]() {},
+		[&]() { pApp->addSignature(); }
+		));
+
+	this->report("writeImage", "bin", size, 0, this->measure(
+		[]() {},
+		[&]() { pApp->writeImage(); }
+		));
+	}
+
+void AppBenchmark_t::benchElf(size_t size, unsigned nSegments)
+	{
+	auto const infile = this->tmpdir / "input.elf";
+	auto const image = makeImage(size, vAppInfoOffsets[0].appInfoOffset, uint32_t(nSegments));
+	std::unique_ptr<App_t> pApp;
+
+	writeFile(infile, makeElf(image, nSegments));
+
+	this->report("readImage", "elf", size, nSegments, this->measure(
+		[&]() { pApp = this->newApp(infile); },
+		[&]() { pApp->readImage(); }
+		));
+
+	pApp = this->newApp(infile);
+	pApp->readImage();
+	pApp->addHeader();
+
+	// the hash is taken over the sections, without copying them.
+	this->report("addHash", "elf", size, nSegments, this->measure(
+		[]() {},
+		[&]() { pApp->addHash(); }
+		));
+
+	// the flat image is only made for the outputs that need it.
+	this->report("flattenImage", "elf", size, nSegments, this->measure(
+		[&]() { pApp->fileimage.clear(); },
+		[&]() { pApp->flattenImage(); }
+		));
+
+	this->report("writeImage", "elf", size, nSegments, this->measure(
+		[]() {},
+		[&]() { pApp->writeImage(); }
+		));
+	}
+
+/// \brief make a plausible Cortex-M image with AppInfo at the given offset.
+static std::vector<uint8_t> makeImage(
+	size_t size,
+	size_t appInfoOffset,
+	uint32_t seed
+	)
+	{
+	std::vector<uint8_t> image(size);
+	uint32_t x = seed * 2654435761u + 1;
+
+	// fill with pseudo-random data, so that the AppInfo slots probed
+	// ahead of the real one don't match by accident.
+	for (auto &b : image)
+		{
+		// xorshift32
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		b = uint8_t(x);
+		}
+
+	McciBootloader_AppInfo_Wire_t appInfo;
+	auto const imagesize = uint32_t(size - sizeof(McciBootloader_SignatureBlock_Wire_t));
+
+	appInfo.targetAddress.put(appInfo.kAppAddress);
+	appInfo.imagesize.put(imagesize);
+	appInfo.authsize.put(sizeof(McciBootloader_SignatureBlock_Wire_t));
+	memcpy(&image.at(appInfoOffset), &appInfo, sizeof(appInfo));
+
+	CortexAppEntryContents_t appEntry { McciBootloader_MemoryMap_t::kSocRamTop, appInfo.kAppAddress + 0x101 };
+	memcpy(&image[0], &appEntry, sizeof(appEntry));
+
+	return image;
+	}
+
+/// \brief wrap an image in an ARM ELF executable with \p nSegments PT_LOAD segments
+static std::vector<uint8_t> makeElf(
+	const std::vector<uint8_t> &image,
+	unsigned nSegments
+	)
+	{
+	using McciBootloader_Elf::ElfIdent32_t;
+	using ProgramHeaderImage_t = ElfIdent32_t::ProgramHeaderImage_t;
+
+	std::vector<uint8_t> elf;
+	size_t const nHeaders = sizeof(ElfIdent32_t) + nSegments * sizeof(ProgramHeaderImage_t);
+	size_t const dataOffset = (nHeaders + 0xFFF) & ~size_t(0xFFF);
+
+	elf.resize(dataOffset + image.size());
+
+	auto const put16 = [](uint8_t (&v)[2], uint16_t x)
+		{
+		v[0] = uint8_t(x);
+		v[1] = uint8_t(x >> 8);
+		};
+	auto const put32 = [](uint8_t (&v)[4], uint32_t x)
+		{
+		v[0] = uint8_t(x);
+		v[1] = uint8_t(x >> 8);
+		v[2] = uint8_t(x >> 16);
+		v[3] = uint8_t(x >> 24);
+		};
+
+	// ELF header
+	ElfIdent32_t hdr;
+
+	memcpy(hdr.ei_magic, ElfIdent32_t::kElfMagic, sizeof(hdr.ei_magic));
+	hdr.ei_class = uint8_t(ElfIdent32_t::ei_class_t::k32bit);
+	hdr.ei_data = uint8_t(ElfIdent32_t::ei_data_t::kLittleEndian);
+	hdr.ei_version = uint8_t(ElfIdent32_t::ei_version_t::kVersion1);
+	hdr.ei_osabi = 0;
+	hdr.ei_abi = 0;
+	std::fill(std::begin(hdr.ei_padding), std::end(hdr.ei_padding), 0);
+	put16(hdr.e_type, uint16_t(ElfIdent32_t::e_type_t::kExec));
+	put16(hdr.e_machine, uint16_t(ElfIdent32_t::e_machine_t::kArm));
+	put32(hdr.e_version, uint32_t(ElfIdent32_t::e_version_t::kVersion1));
+	put32(hdr.e_entry, McciBootloader_AppInfo_Wire_t::kAppAddress + 0x101);
+	put32(hdr.e_phoff, sizeof(ElfIdent32_t));
+	put32(hdr.e_shoff, 0);
+	put32(hdr.e_flags, 0);
+	put16(hdr.e_ehsize, sizeof(ElfIdent32_t));
+	put16(hdr.e_phentsize, sizeof(ProgramHeaderImage_t));
+	put16(hdr.e_phnum, uint16_t(nSegments));
+	put16(hdr.e_shentsize, 0);
+	put16(hdr.e_shnum, 0);
+	put16(hdr.e_shstrndx, 0);
+	memcpy(&elf[0], &hdr, sizeof(hdr));
+
+	// program headers: split the image into nSegments contiguous pieces
+	size_t const nPerSegment = (image.size() / nSegments) & ~size_t(3);
+
+	for (unsigned i = 0; i < nSegments; ++i)
+		{
+		ProgramHeaderImage_t ph;
+		size_t const start = i * nPerSegment;
+		size_t const n = (i == nSegments - 1) ? image.size() - start : nPerSegment;
+		auto const address = uint32_t(McciBootloader_AppInfo_Wire_t::kAppAddress + start);
+
+		put32(ph.p_type, uint32_t(ElfIdent32_t::ProgramHeader_t::p_type_t::kLoad));
+		put32(ph.p_offset, uint32_t(dataOffset + start));
+		put32(ph.p_vaddr, address);
+		put32(ph.p_paddr, address);
+		put32(ph.p_filesz, uint32_t(n));
+		put32(ph.p_memsz, uint32_t(n));
+		put32(ph.p_flags, ElfIdent32_t::ProgramHeader_t::getFlagR() | ElfIdent32_t::ProgramHeader_t::getFlagX());
+		put32(ph.p_align, 4);
+
+		memcpy(&elf[sizeof(ElfIdent32_t) + i * sizeof(ph)], &ph, sizeof(ph));
+		}
+
+	memcpy(&elf[dataOffset], &image[0], image.size());
+	return elf;
+	}
+
+static void writeFile(
+	const fs::path &path,
+	const std::vector<uint8_t> &data
+	)
+	{
+	std::ofstream outfile { path, ios::binary | ios::trunc };
+
+	outfile.exceptions(ios::badbit | ios::failbit);
+	outfile.write((const char *)&data[0], data.size());
+	}
+
+/**** end of benchmark.cpp ****/
@@ -0,0 +1,144 @@
+/*
+
+Module:	blockhash.cpp
+
+Function:
+	Storage images with block hash tables (--block-hash-output).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+
+#include <atomic>
+#include <thread>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::writeBlockHashImage()
+
+Function:
+	Write this image, followed by a signed table of block hashes.
+
+Definition:
+	void App_t::writeBlockHashImage();
+
+Description:
+	this->fileimage must already be hashed and signed. We hash each
+	--block-size block of the image (including its signature block), using
+	this->nJobs threads (default: one per CPU), then sign the table
+	with the same key as the image, and write the image and table to
+	--block-hash-output. This is a storage image: the bootloader uses
+	the table to check the image block by block, but only programs
+	the image itself.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::writeBlockHashImage()
+	{
+	auto const appInfo = this->findPackageAppInfo(*this, this->infilename);
+	size_t const imageSize = appInfo.imagesize.get() + appInfo.authsize.get();
+	size_t const blockSize = size_t(1) << this->log2BlockSize;
+	size_t const nBlocks = (imageSize + blockSize - 1) / blockSize;
+
+	McciBootloader_BlockHashHeader_Wire_t header;
+
+	header.log2BlockSize = uint8_t(this->log2BlockSize);
+	header.imageSize.put(uint32_t(imageSize));
+	header.nBlocks.put(uint32_t(nBlocks));
+
+	// the table: the header, then the hashes.
+	std::vector<uint8_t> table(sizeof(header) + nBlocks * sizeof(mcci_tweetnacl_sha512_t));
+
+	memcpy(&table[0], &header, sizeof(header));
+
+	// hash the blocks. Each worker claims the next block until there
+	// are none left.
+	unsigned nJobs = this->nJobs;
+	if (nJobs == 0)
+		nJobs = std::max(1u, std::thread::hardware_concurrency());
+	if (nJobs > nBlocks)
+		nJobs = unsigned(std::max<size_t>(nBlocks, 1));
+
+	std::atomic<size_t> iNext { 0 };
+	auto const worker = [this, &iNext, &table, imageSize, blockSize, nBlocks]()
+		{
+		for (size_t i; (i = iNext++) < nBlocks; )
+			{
+			mcci_tweetnacl_sha512_t hash;
+			size_t const offset = i * blockSize;
+
+			mcci_tweetnacl_hash_sha512(
+				&hash,
+				&this->fileimage[offset],
+				std::min(blockSize, imageSize - offset)
+				);
+
+			memcpy(
+				&table[sizeof(McciBootloader_BlockHashHeader_Wire_t) + i * sizeof(hash.bytes)],
+				hash.bytes,
+				sizeof(hash.bytes)
+				);
+			}
+		};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < nJobs; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto &t : threads)
+		t.join();
+
+	this->appendSignature(table);
+
+	// the storage image: the image, then the table.
+	std::vector<uint8_t> storageImage(this->fileimage.begin(), this->fileimage.begin() + imageSize);
+
+	storageImage.insert(storageImage.end(), table.begin(), table.end());
+
+	std::cout << "block hash table: " << nBlocks << " blocks, "
+		  << table.size() << " bytes; storage image: "
+		  << storageImage.size() << " bytes\n";
+
+	this->writePackage(storageImage, this->blockhashoutputname);
+	}
+
+/**** end of blockhash.cpp ****/
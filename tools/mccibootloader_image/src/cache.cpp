@@ -0,0 +1,438 @@
+/*
+
+Module:	cache.cpp
+
+Function:
+	The signing cache (--cache-dir) and depfile (--depfile).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_image_version.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+static bool readWholeFile(
+	const string &filename,
+	std::vector<uint8_t> &contents
+	);
+
+static string depfileEscape(
+	const string &filename
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+// changing this invalidates every cache entry; do so if the way we
+// compute or store entries changes.
+static const char kCacheTag[] = "mccibootloader_image cache 1";
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::cacheLookup()
+
+Function:
+	Compute the cache key for this run, and look for a cached result.
+
+Definition:
+	bool App_t::cacheLookup();
+
+Description:
+	If --cache-dir was given, we compute the SHA-512 of the loadable
+	bytes of the input image, plus everything else that affects the
+	result: the public key, the app version, the comment, the timestamp
+	policy, and whether we're hashing or signing. The name of the
+	cache entry is derived from the hash, and saved in
+	this->cachefilename for use by cacheStore().
+
+	The key and the entry are the flat load image, so for ELF input
+	we flatten it here; a hit is stored back into the ELF sections.
+
+	If the entry exists, we check it as --verify would: the hash must
+	match, the public key must be the signer's, and if we're signing,
+	the signature must be good. An entry that fails is deleted, and
+	treated as a miss. Otherwise its contents replace this->fileimage,
+	and the caller can skip adding the header, hash and signature. If the
+	timestamp policy is --add-time, the cached image keeps the
+	timestamp of the run that created it; that's what makes a rebuild
+	of an unchanged image a no-op.
+
+	The public key is that of the signer, which setupSigner() has
+	already found, whichever backend is in use.
+
+Returns:
+	true if this->fileimage was loaded from the cache, false otherwise.
+
+*/
+
+bool App_t::cacheLookup()
+	{
+	this->cachefilename.clear();
+
+	if (this->cachedirname == "")
+		return false;
+
+	auto const span = this->span("cache");
+
+	// find the public key.
+	mcci_tweetnacl_sign_publickey_t publicKey;
+
+	memset(&publicKey, 0, sizeof(publicKey));
+	if (this->fHash)
+		publicKey = this->keyfile.m_public;
+
+	// gather the things that determine the output.
+	std::vector<uint8_t> keyData;
+	auto const append = [&keyData](const void *p, size_t n)
+		{
+		auto const pBytes = (const uint8_t *)p;
+		keyData.insert(keyData.end(), pBytes, pBytes + n);
+		};
+	auto const appendU32 = [&append](uint32_t v)
+		{
+		uint32_le_t le;
+		le.put(v);
+		append(&le, sizeof(le));
+		};
+
+	append(kCacheTag, sizeof(kCacheTag));
+	appendU32(kVersion);
+	appendU32((this->fHash ? 1u : 0u) | (this->fSign ? 2u : 0u) | (this->fAddTime ? 4u : 0u));
+	append(publicKey.bytes, sizeof(publicKey.bytes));
+	appendU32(this->fAppVersion ? 1 : 0);
+	appendU32(this->fAppVersion ? this->appVersion : 0);
+	if (this->pComment != nullptr)
+		{
+		appendU32(uint32_t(std::strlen(this->pComment)) + 1);
+		append(this->pComment, std::strlen(this->pComment));
+		}
+	else
+		appendU32(0);
+
+	this->flattenImage();
+	appendU32(uint32_t(this->fileimage.size()));
+	append(this->fileimage.data(), this->fileimage.size());
+
+	mcci_tweetnacl_sha512_t key;
+	mcci_tweetnacl_hash_sha512(&key, keyData.data(), keyData.size());
+
+	std::ostringstream name;
+	name << std::hex << std::setfill('0');
+	for (auto b : key.bytes)
+		name << std::setw(2) << unsigned(b);
+
+	auto const keyString = name.str();
+	this->cachefilename = (fs::path(this->cachedirname) / keyString.substr(0, 2) / (keyString + ".bin")).string();
+
+	// see if it's there.
+	std::vector<uint8_t> cached;
+
+	// the flat image is about to be patched; don't keep a stale copy.
+	auto const miss = [this](const string &why)
+		{
+		this->verbose(why + this->cachefilename);
+		if (this->isUsingElf())
+			this->fileimage.clear();
+		return false;
+		};
+
+	// a bad entry would be found again by the next build; remove it.
+	auto const discard = [this, &miss](const string &why)
+		{
+		std::error_code ec;
+
+		fs::remove(this->cachefilename, ec);
+		return miss(why);
+		};
+
+	if (! readWholeFile(this->cachefilename, cached))
+		return miss("cache miss: ");
+
+	// signing doesn't change the size of the loadable image.
+	if (cached.size() != this->fileimage.size())
+		return discard("cache entry has wrong size, removed: ");
+
+	if (! this->cacheEntryIsValid(cached))
+		return discard("cache entry doesn't verify, removed: ");
+
+	if (this->isUsingElf() && ! this->elf.load.store(this->elf.image, cached))
+		return discard("cache entry doesn't fit the ELF sections, removed: ");
+
+	this->verbose("cache hit: " + this->cachefilename);
+	this->fileimage = std::move(cached);
+	return true;
+	}
+
+/*
+
+Name:	App_t::cacheStore()
+
+Function:
+	Save the signed image in the cache.
+
+Definition:
+	void App_t::cacheStore();
+
+Description:
+	If cacheLookup() computed a cache entry name, the signed loadable
+	image is written there. The entry is written to a temporary file
+	and renamed into place, so concurrent builds sharing a cache never
+	see a partial entry. Failures are reported in verbose mode, but
+	are otherwise ignored: the cache is only an optimization.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::cacheStore()
+	{
+	if (this->cachefilename == "" || this->fDryRun)
+		return;
+
+	auto const span = this->span("cache");
+
+	this->flattenImage();
+
+	std::error_code ec;
+	fs::path const entry { this->cachefilename };
+
+	fs::create_directories(entry.parent_path(), ec);
+	if (ec)
+		{
+		this->verbose("can't create cache directory: " + entry.parent_path().string() + ": " + ec.message());
+		return;
+		}
+
+	std::ostringstream tempname;
+	tempname << this->cachefilename << ".tmp." << std::hex
+		 << std::chrono::steady_clock::now().time_since_epoch().count();
+
+	std::ofstream outfile { tempname.str(), ios::binary | ios::trunc };
+	if (! outfile.is_open())
+		{
+		this->verbose("can't create cache entry: " + tempname.str());
+		return;
+		}
+
+	outfile.write((const char *)this->fileimage.data(), this->fileimage.size());
+	outfile.close();
+	if (! outfile)
+		{
+		this->verbose("can't write cache entry: " + tempname.str());
+		fs::remove(tempname.str(), ec);
+		return;
+		}
+
+	fs::rename(tempname.str(), entry, ec);
+	if (ec)
+		{
+		this->verbose("can't rename cache entry: " + this->cachefilename + ": " + ec.message());
+		fs::remove(tempname.str(), ec);
+		return;
+		}
+
+	this->verbose("cache entry written: " + this->cachefilename);
+	}
+
+/*
+
+Name:	App_t::outputIsUnchanged()
+
+Function:
+	See whether an output file already has the contents we're about
+	to write.
+
+Definition:
+	bool App_t::outputIsUnchanged(
+		const string &filename
+		) const;
+
+Description:
+	The file is compared with outputImage().
+
+Returns:
+	true if the file exists and matches, false otherwise.
+
+*/
+
+bool App_t::outputIsUnchanged(const string &filename) const
+	{
+	if (filename == "")
+		return false;
+
+	std::error_code ec;
+	auto const size = fs::file_size(filename, ec);
+	if (ec || size != this->outputImage().size())
+		return false;
+
+	std::vector<uint8_t> contents;
+	if (! readWholeFile(filename, contents))
+		return false;
+
+	return contents == this->outputImage();
+	}
+
+/*
+
+Name:	App_t::writeDepfile()
+
+Function:
+	Write a make-style dependency file for the output.
+
+Definition:
+	void App_t::writeDepfile();
+
+Description:
+	If --depfile was given, we write a single rule naming the output
+	file and any extra outputs (--output-bin etc.) as the targets, and
+	the input image and key files as its prerequisites. Both make (via
+	-include) and ninja (via depfile =) understand the format.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::writeDepfile()
+	{
+	if (this->depfilename == "" || this->fDryRun)
+		return;
+
+	std::vector<string> targets;
+
+	if (this->fPatch)
+		targets.push_back(this->infilename);
+	else if (this->outfilename != "")
+		targets.push_back(this->outfilename);
+
+	for (auto const &artifact : this->vArtifacts)
+		targets.push_back(artifact.filename);
+
+	if (targets.size() == 0)
+		{
+		this->verbose("no output file, not writing depfile");
+		return;
+		}
+
+	std::ofstream depfile { this->depfilename, ios::trunc };
+	if (! depfile.is_open())
+		this->fatal("can't create depfile: " + this->depfilename);
+
+	for (auto const &target : targets)
+		depfile << (&target == &targets.front() ? "" : " ") << depfileEscape(target);
+	depfile << ":";
+	if (! this->fPatch)
+		depfile << " " << depfileEscape(this->infilename);
+	if (this->fHash && this->socketname == "")
+		depfile << " " << depfileEscape(this->keyfilename);
+	if (this->publickeyfilename != "")
+		depfile << " " << depfileEscape(this->publickeyfilename);
+	depfile << "\n";
+
+	depfile.close();
+	if (! depfile)
+		this->fatal("can't write depfile: " + this->depfilename);
+	}
+
+static bool readWholeFile(
+	const string &filename,
+	std::vector<uint8_t> &contents
+	)
+	{
+	std::ifstream infile { filename, ios::binary };
+	if (! infile.is_open())
+		return false;
+
+	contents.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+	return ! infile.bad();
+	}
+
+static string depfileEscape(
+	const string &filename
+	)
+	{
+	string result;
+
+	for (auto c : filename)
+		{
+		if (c == ' ' || c == '#')
+			result.push_back('\\');
+		else if (c == '$')
+			result.push_back('$');
+		result.push_back(c);
+		}
+
+	return result;
+	}
+
+/// \brief check the signature block of a cache entry, as --verify would.
+///
+/// \details Other builds write to the cache, so an entry may be damaged
+///	or simply wrong. The hash must match, the public key must be the
+///	signer's, and if we're signing, the signature must be good.
+///
+bool App_t::cacheEntryIsValid(
+	const std::vector<uint8_t> &entry
+	) const
+	{
+	for (auto const &Entry : vAppInfoOffsets)
+		{
+		McciBootloader_AppInfo_Wire_t appInfo;
+
+		if (entry.size() < Entry.appInfoOffset + sizeof(appInfo))
+			continue;
+
+		memcpy(&appInfo, &entry[Entry.appInfoOffset], sizeof(appInfo));
+		if (appInfo.magic.get() != appInfo.kMagic ||
+		    appInfo.size.get() != sizeof(appInfo))
+			continue;
+
+		auto const imagesize = appInfo.imagesize.get();
+
+		if (entry.size() < uint64_t(imagesize) + sizeof(McciBootloader_SignatureBlock_Wire_t))
+			return false;
+
+		std::vector<string> failures;
+
+		checkSignatureBlock(&entry[0], imagesize, &this->keyfile.m_public, this->fSign, failures);
+		return failures.size() == 0;
+		}
+
+	return false;
+	}
+
+/**** end of cache.cpp ****/
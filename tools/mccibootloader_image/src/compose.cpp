@@ -0,0 +1,408 @@
+/*
+
+Module:	compose.cpp
+
+Function:
+	App_t::compose(): lay signed images out as SPI flash images for
+	production (--compose).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_hexfile.h"
+
+#include <atomic>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using MemoryMap = McciBootloader_MemoryMap_t;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief one image to be placed in a storage slot
+struct ComposeSlot_t
+	{
+	McciBootloader_VerifyResult_t	result;	///< the outcome of checking the image
+	std::vector<uint8_t>		image;	///< the bytes to place in the slot
+	};
+
+/// \brief one chip image to be written
+struct ComposeChip_t
+	{
+	std::string		filename;		///< the output file
+	std::string		source;			///< manifest and line, for messages
+	size_t			iFallback;		///< index of the fallback slot image
+	size_t			iPrimary;		///< index of the primary slot image, or kNoSlot
+	std::vector<std::string> failures;		///< why the chip wasn't written
+	};
+
+constexpr size_t kNoSlot = ~size_t(0);
+
+/// \brief run \p fn(i) for i in [0, nItems) on up to \p nJobs threads.
+template <typename Fn_t>
+void runWorkers(unsigned nJobs, size_t nItems, const Fn_t &fn)
+	{
+	if (nJobs == 0)
+		nJobs = std::max(1u, std::thread::hardware_concurrency());
+	if (nJobs > nItems)
+		nJobs = unsigned(std::max<size_t>(nItems, 1));
+
+	std::atomic<size_t> iNext { 0 };
+	auto const worker = [&iNext, nItems, &fn]()
+		{
+		for (size_t i; (i = iNext++) < nItems; )
+			fn(i);
+		};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < nJobs; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto &t : threads)
+		t.join();
+	}
+
+/// \brief write \p n bytes of erased flash to \p os.
+void writeErased(std::ostream &os, size_t n)
+	{
+	static const std::vector<char> fill(64 * 1024, char(MemoryMap::kStorageErased));
+
+	while (n != 0)
+		{
+		auto const nThis = std::min(n, fill.size());
+		os.write(fill.data(), nThis);
+		n -= nThis;
+		}
+	}
+
+/// \brief does \p filename end with \p ext?
+bool hasExtension(const std::string &filename, const char *ext)
+	{
+	auto const n = std::strlen(ext);
+
+	return filename.size() > n && filename.compare(filename.size() - n, n, ext) == 0;
+	}
+
+} // namespace
+
+static void readManifest(
+	const string &manifestname,
+	std::vector<ComposeChip_t> &chips,
+	std::map<std::string, size_t> &slotIndex
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::compose()
+
+Function:
+	Build SPI flash images for production from signed app images.
+
+Definition:
+	int App_t::compose();
+
+Description:
+	Each entry in this->composeArgs names a manifest (see
+	readManifest()); each manifest line names one chip image to write,
+	the image for the fallback slot, and optionally the image for the
+	primary (update) slot.
+
+	Each distinct slot image is read and checked once, with the rules
+	used by --verify (those of McciBootloaderPlatform_checkImageValid()
+	and McciBootloader_checkCodeValid()), and must be an app image
+	that fits in a storage slot. Then the chip images are written.
+	Both steps use this->nJobs worker threads (default: one per CPU).
+
+	A chip image whose name ends in ".hex" or ".srec" is written as
+	Intel HEX or S-records containing just the slot images, so the
+	time to write it depends only on the size of the images; the
+	programmer leaves the rest of the chip erased. Any other name gets
+	a raw image of the whole chip, with 0xFF (erased) everywhere else.
+
+	A chip that uses an image that failed its checks isn't written;
+	the others are.
+
+Returns:
+	EXIT_SUCCESS if every chip image was written, EXIT_FAILURE
+	otherwise.
+
+*/
+
+int App_t::compose()
+	{
+	auto const pPublicKey = this->readCheckKey();
+
+	// read the manifests
+	std::vector<ComposeChip_t> chips;
+	std::map<std::string, size_t> slotIndex;
+
+	for (auto const &arg : this->composeArgs)
+		{
+		try	{
+			readManifest(arg, chips, slotIndex);
+			}
+		catch (std::exception &e)
+			{
+			this->fatal(e.what());
+			}
+		}
+
+	if (chips.size() == 0)
+		this->fatal("no chip images to compose");
+
+	// check each distinct slot image once.
+	std::vector<ComposeSlot_t> slots(slotIndex.size());
+
+	for (auto const &entry : slotIndex)
+		slots[entry.second].result.filename = entry.first;
+
+	runWorkers(this->nJobs, slots.size(),
+		[this, &slots, pPublicKey](size_t i)
+		{
+		auto &slot = slots[i];
+		auto &failures = slot.result.failures;
+
+		this->verifyFile(slot.result, pPublicKey, &slot.image);
+
+		if (slot.result.fAppInfo &&
+		    slot.result.appInfo.targetAddress.get() != MemoryMap::kAppBase)
+			failures.push_back("not an app image; only app images can be put in a storage slot");
+
+		if (slot.image.size() > MemoryMap::kStorageImageSize)
+			failures.push_back("file size " + std::to_string(slot.image.size()) + " exceeds the storage slot size");
+		});
+
+	// write the chip images.
+	runWorkers(this->nJobs, chips.size(),
+		[this, &slots, &chips](size_t i)
+		{
+		auto &chip = chips[i];
+		std::vector<McciBootloader_HexFile::Segment_t> segments;
+
+		for (auto const &placement :
+			{ std::make_pair(chip.iFallback, MemoryMap::kStorageFallbackBase),
+			  std::make_pair(chip.iPrimary, MemoryMap::kStorageUpdateBase) })
+			{
+			if (placement.first == kNoSlot)
+				continue;
+
+			auto const &slot = slots[placement.first];
+			if (slot.result.failures.size() != 0)
+				chip.failures.push_back("image failed its checks: " + slot.result.filename);
+			else
+				segments.push_back({ placement.second, slot.image.data(), slot.image.size() });
+			}
+
+		if (chip.failures.size() != 0 || this->fDryRun)
+			return;
+
+		std::ofstream outfile { chip.filename, ios::binary | ios::trunc };
+		if (! outfile.is_open())
+			{
+			chip.failures.push_back("can't create file");
+			return;
+			}
+
+		if (hasExtension(chip.filename, ".hex"))
+			McciBootloader_HexFile::writeIntelHex(outfile, segments);
+		else if (hasExtension(chip.filename, ".srec"))
+			McciBootloader_HexFile::writeSrec(outfile, segments, filebasename(chip.filename.c_str()));
+		else
+			{
+			size_t pos = 0;
+
+			for (auto const &segment : segments)
+				{
+				writeErased(outfile, segment.address - pos);
+				outfile.write((const char *)segment.p, segment.n);
+				pos = segment.address + segment.n;
+				}
+
+			writeErased(outfile, MemoryMap::kStorageChipSize - pos);
+			}
+
+		outfile.close();
+		if (! outfile)
+			chip.failures.push_back("can't write file");
+		});
+
+	// report.
+	size_t nFailedSlots = 0;
+	size_t nFailedChips = 0;
+
+	for (auto const &slot : slots)
+		{
+		if (slot.result.failures.size() != 0)
+			++nFailedSlots;
+		}
+
+	for (auto const &chip : chips)
+		{
+		if (chip.failures.size() != 0)
+			++nFailedChips;
+		else if (this->fVerbose)
+			{
+			std::cout << (this->fDryRun ? "ok (dry run): " : "ok: ") << chip.filename
+				  << " (fallback " << slots[chip.iFallback].result.filename;
+			if (chip.iPrimary != kNoSlot)
+				std::cout << ", primary " << slots[chip.iPrimary].result.filename;
+			std::cout << ")\n";
+			}
+		}
+
+	std::cout << "composed " << chips.size() - nFailedChips << " of "
+		  << chips.size() << " chip image(s) from "
+		  << slots.size() << " slot image(s); "
+		  << nFailedSlots << " slot image(s) failed their checks\n";
+
+	if (nFailedSlots != 0 || nFailedChips != 0)
+		{
+		std::cout << "\nFailures:\n";
+		for (auto const &slot : slots)
+			{
+			for (auto const &why : slot.result.failures)
+				std::cout << "  " << slot.result.filename << ": " << why << "\n";
+			}
+		for (auto const &chip : chips)
+			{
+			for (auto const &why : chip.failures)
+				std::cout << "  " << chip.filename << " (" << chip.source << "): " << why << "\n";
+			}
+		}
+
+	std::cout << std::flush;
+	return nFailedChips == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+/*
+
+Name:	readManifest()
+
+Function:
+	Read the chip images to be composed from a manifest.
+
+Definition:
+	static void readManifest(
+		const string &manifestname,
+		std::vector<ComposeChip_t> &chips,
+		std::map<std::string, size_t> &slotIndex
+		);
+
+Description:
+	Each line of the manifest names a chip image, the fallback slot
+	image, and optionally the primary slot image, separated by white
+	space:
+
+		sku-1234.bin	app-v1.2.0-signed.elf
+		sku-1235.hex	app-v1.2.0-signed.elf	app-v1.3.0-signed.bin
+
+	Blank lines and lines starting with '#' are ignored. If
+	\p manifestname is "-", the manifest is read from stdin.
+
+	Each distinct slot image name is given an index in \p slotIndex,
+	and the chip records the indices.
+
+Returns:
+	No explicit result. Throws on errors.
+
+*/
+
+static void readManifest(
+	const string &manifestname,
+	std::vector<ComposeChip_t> &chips,
+	std::map<std::string, size_t> &slotIndex
+	)
+	{
+	std::ifstream manifest;
+	std::istream *pManifest = &std::cin;
+
+	if (manifestname != "-")
+		{
+		manifest.open(manifestname);
+		if (! manifest.is_open())
+			throw std::runtime_error("can't read manifest: " + manifestname);
+		pManifest = &manifest;
+		}
+
+	auto const getSlot = [&slotIndex](const std::string &name)
+		{
+		auto const it = slotIndex.find(name);
+		if (it != slotIndex.end())
+			return it->second;
+
+		auto const i = slotIndex.size();
+		slotIndex.emplace(name, i);
+		return i;
+		};
+
+	unsigned iLine = 0;
+
+	for (string line; std::getline(*pManifest, line); )
+		{
+		++iLine;
+		if (line.size() != 0 && line.back() == '\r')
+			line.pop_back();
+		if (line.size() == 0 || line[0] == '#')
+			continue;
+
+		std::istringstream fields { line };
+		std::vector<std::string> names;
+
+		for (std::string name; fields >> name; )
+			names.push_back(name);
+
+		auto const where = manifestname + ":" + std::to_string(iLine);
+
+		if (names.size() == 0)
+			continue;
+		if (names.size() < 2 || names.size() > 3)
+			throw std::runtime_error(where + ": expected: chipfile fallback [primary]");
+
+		ComposeChip_t chip;
+
+		chip.filename = names[0];
+		chip.source = where;
+		chip.iFallback = getSlot(names[1]);
+		chip.iPrimary = names.size() > 2 ? getSlot(names[2]) : kNoSlot;
+
+		chips.push_back(std::move(chip));
+		}
+	}
+
+/**** end of compose.cpp ****/
@@ -0,0 +1,380 @@
+/*
+
+Module:	compress.cpp
+
+Function:
+	Compressed update packages (--compressed-output).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_compress.h"
+
+#include <iomanip>
+#include <sstream>
+
+using namespace McciBootloader_Compress;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief the last match must end this far before the end (LZ4 rule)
+constexpr std::size_t kLastLiterals = 5;
+
+/// \brief the last match must start this far before the end (LZ4 rule)
+constexpr std::size_t kMatchStartLimit = 12;
+
+/// \brief the longest distance that fits in the two-byte offset
+constexpr std::size_t kMaxDistance = 0xFFFF;
+
+/// \brief how many candidates we try at each position
+constexpr unsigned kMaxChain = 256;
+
+/// \brief log2 of the number of hash buckets
+constexpr unsigned kHashBits = 16;
+
+/// \brief accumulates the compressed block
+class Emitter_t
+	{
+public:
+	std::vector<std::uint8_t> payload;
+
+	/// \brief the extension bytes of a count that didn't fit in the token
+	void count(std::size_t v)
+		{
+		while (v >= 255)
+			{
+			this->payload.push_back(255);
+			v -= 255;
+			}
+		this->payload.push_back(std::uint8_t(v));
+		}
+
+	/// \brief a sequence: literals, then a match if \p nMatch isn't zero
+	void sequence(const std::uint8_t *pLiterals, std::size_t nLiterals, std::size_t distance, std::size_t nMatch)
+		{
+		std::size_t const matchCode = nMatch == 0 ? 0 : nMatch - kMinMatch;
+
+		this->payload.push_back(std::uint8_t(
+			(std::min<std::size_t>(nLiterals, 15) << 4) |
+			std::min<std::size_t>(matchCode, 15)
+			));
+
+		if (nLiterals >= 15)
+			this->count(nLiterals - 15);
+
+		this->payload.insert(this->payload.end(), pLiterals, pLiterals + nLiterals);
+
+		if (nMatch == 0)
+			return;
+
+		this->payload.push_back(std::uint8_t(distance));
+		this->payload.push_back(std::uint8_t(distance >> 8));
+
+		if (matchCode >= 15)
+			this->count(matchCode - 15);
+		}
+	};
+
+inline std::uint32_t seedHash(const std::uint8_t *p)
+	{
+	std::uint32_t const v = p[0] | (p[1] << 8) | (p[2] << 16) | (std::uint32_t(p[3]) << 24);
+
+	return (v * UINT32_C(2654435761)) >> (32 - kHashBits);
+	}
+
+/// \brief read the extension bytes of a count from \p payload.
+bool getCount(const std::vector<std::uint8_t> &payload, std::size_t &i, std::size_t &v)
+	{
+	std::uint8_t b;
+
+	do	{
+		if (i >= payload.size() || v > 0x1000000)
+			return false;
+
+		b = payload[i++];
+		v += b;
+		} while (b == 255);
+
+	return true;
+	}
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_Compress::encode()
+
+Function:
+	Compress an image.
+
+Definition:
+	std::vector<std::uint8_t> McciBootloader_Compress::encode(
+		const std::vector<std::uint8_t> &input
+		);
+
+Description:
+	This is a hash-chain matcher with one step of lazy evaluation: at
+	each position we find the longest match among up to kMaxChain
+	earlier positions with the same first four bytes, and then take
+	a literal instead if the next position has a longer match.
+
+	Compression time doesn't matter much here; decompression time in
+	the bootloader is set by the flash, not by the format.
+
+Returns:
+	The compressed block.
+
+*/
+
+std::vector<std::uint8_t>
+McciBootloader_Compress::encode(
+	const std::vector<std::uint8_t> &input
+	)
+	{
+	std::size_t const n = input.size();
+	std::size_t const matchEnd = n > kLastLiterals ? n - kLastLiterals : 0;
+	std::size_t const matchStartLimit = n > kMatchStartLimit ? n - kMatchStartLimit : 0;
+
+	// vHead[h] is the last position with hash h; vNext chains to
+	// earlier positions. Positions are added as we pass them.
+	std::vector<std::int32_t> vHead(std::size_t(1) << kHashBits, -1);
+	std::vector<std::int32_t> vNext(n, -1);
+	std::size_t nIndexed = 0;
+
+	// the longest match for input[pos...], or zero.
+	auto const findMatch = [&](std::size_t pos, std::size_t &source) -> std::size_t
+		{
+		for (; nIndexed < pos; ++nIndexed)
+			{
+			auto const h = seedHash(&input[nIndexed]);
+			vNext[nIndexed] = vHead[h];
+			vHead[h] = std::int32_t(nIndexed);
+			}
+
+		std::size_t bestLength = 0;
+		unsigned nTries = 0;
+
+		for (auto i = vHead[seedHash(&input[pos])];
+		     i >= 0 && pos - std::size_t(i) <= kMaxDistance && nTries < kMaxChain;
+		     i = vNext[i], ++nTries)
+			{
+			std::size_t len = 0;
+
+			while (pos + len < matchEnd && input[std::size_t(i) + len] == input[pos + len])
+				++len;
+
+			if (len > bestLength)
+				{
+				bestLength = len;
+				source = std::size_t(i);
+				}
+			}
+
+		return bestLength >= kMinMatch ? bestLength : 0;
+		};
+
+	Emitter_t emit;
+	std::size_t pos = 0;
+	std::size_t literalStart = 0;
+
+	while (pos < matchStartLimit)
+		{
+		std::size_t source;
+		std::size_t nextSource;
+		auto const length = findMatch(pos, source);
+
+		if (length == 0 ||
+		    (pos + 1 < matchStartLimit && findMatch(pos + 1, nextSource) > length))
+			{
+			++pos;
+			continue;
+			}
+
+		emit.sequence(&input[literalStart], pos - literalStart, pos - source, length);
+		pos += length;
+		literalStart = pos;
+		}
+
+	emit.sequence(input.data() + literalStart, n - literalStart, 0, 0);
+	return std::move(emit.payload);
+	}
+
+/*
+
+Name:	McciBootloader_Compress::decode()
+
+Function:
+	Decompress a payload the way the bootloader does.
+
+Definition:
+	bool McciBootloader_Compress::decode(
+		const std::vector<std::uint8_t> &payload,
+		std::size_t outputSize,
+		std::vector<std::uint8_t> &output
+		);
+
+Description:
+	This mirrors McciBootloader_programCompressed(), and applies the
+	same checks. We use it to check the encoder's output before
+	writing a package.
+
+Returns:
+	true if the payload is valid, in which case \p output is set to
+	the result; false otherwise.
+
+*/
+
+bool
+McciBootloader_Compress::decode(
+	const std::vector<std::uint8_t> &payload,
+	std::size_t outputSize,
+	std::vector<std::uint8_t> &output
+	)
+	{
+	std::vector<std::uint8_t> result;
+	std::size_t i = 0;
+
+	result.reserve(outputSize);
+
+	for (;;)
+		{
+		if (i >= payload.size())
+			return false;
+
+		auto const token = payload[i++];
+		std::size_t nLiterals = token >> 4;
+
+		if (nLiterals == 15 && ! getCount(payload, i, nLiterals))
+			return false;
+
+		if (nLiterals > outputSize - result.size() || nLiterals > payload.size() - i)
+			return false;
+
+		result.insert(result.end(), payload.begin() + i, payload.begin() + i + nLiterals);
+		i += nLiterals;
+
+		// the last sequence has no match
+		if (result.size() == outputSize)
+			break;
+
+		if (payload.size() - i < 2)
+			return false;
+
+		std::size_t const distance = payload[i] | (payload[i + 1] << 8);
+		std::size_t nMatch = token & 0xF;
+
+		i += 2;
+		if (nMatch == 15 && ! getCount(payload, i, nMatch))
+			return false;
+
+		nMatch += kMinMatch;
+
+		if (distance == 0 || distance > kWindowSize || distance > result.size() ||
+		    nMatch > outputSize - result.size())
+			return false;
+
+		// byte at a time, because the match can overlap the output
+		for (; nMatch != 0; --nMatch)
+			result.push_back(result[result.size() - distance]);
+		}
+
+	if (i != payload.size())
+		return false;
+
+	output = std::move(result);
+	return true;
+	}
+
+/*
+
+Name:	App_t::writeCompressedPackage()
+
+Function:
+	Make a signed compressed package containing this image.
+
+Definition:
+	void App_t::writeCompressedPackage();
+
+Description:
+	this->fileimage must already be hashed and signed. We compress the
+	image and its signature block, check the result with the reference
+	decoder, wrap it in a package header, sign the package with the
+	same key as the image, and write it to --compressed-output. A line
+	comparing the package size to the full image size is printed.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::writeCompressedPackage()
+	{
+	auto const appInfo = this->findPackageAppInfo(*this, this->infilename);
+	size_t const hashPos = appInfo.imagesize.get() + sizeof(mcci_tweetnacl_sign_publickey_t);
+	size_t const imageSize = appInfo.imagesize.get() + appInfo.authsize.get();
+
+	std::vector<uint8_t> const imageBytes(this->fileimage.begin(), this->fileimage.begin() + imageSize);
+
+	// compress and check
+	auto const payload = encode(imageBytes);
+	std::vector<uint8_t> check;
+
+	if (! decode(payload, imageSize, check) || check != imageBytes)
+		this->fatal("internal error: compressed payload doesn't reproduce the image");
+
+	// assemble the package
+	McciBootloader_PackageHeader_Wire_t header;
+
+	header.type = uint8_t(McciBootloader_PackageHeader_Wire_t::Type_t::kCompressed);
+	header.log2WindowSize = uint8_t(kLog2WindowSize);
+	memcpy(header.targetHash, &this->fileimage[hashPos], sizeof(header.targetHash));
+	header.appInfo = appInfo;
+
+	auto const package = this->makePackage(header, payload);
+
+	// report
+	std::ostringstream report;
+
+	report << "compressed package: " << package.size() << " bytes; full image: "
+	       << imageSize << " bytes; "
+	       << std::fixed << std::setprecision(1)
+	       << 100.0 * double(package.size()) / double(imageSize) << "%";
+
+	std::cout << report.str() << "\n";
+
+	this->writePackage(package, this->compressedoutputname);
+	}
+
+/**** end of compress.cpp ****/
@@ -0,0 +1,520 @@
+/*
+
+Module:	delta.cpp
+
+Function:
+	Delta update packages (--delta-base, --delta-output).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_delta.h"
+
+#include <iomanip>
+#include <sstream>
+
+using namespace McciBootloader_Delta;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief bytes hashed to find candidate matches
+constexpr std::size_t kSeedSize = 8;
+
+/// \brief the shortest COPY found by hashing that's worth emitting
+constexpr std::size_t kMinHashMatch = 8;
+
+/// \brief the shortest COPY that continues the previous COPY
+constexpr std::size_t kMinNextMatch = 4;
+
+/// \brief the shortest repeated byte that's worth a RUN
+constexpr std::size_t kMinRun = 6;
+
+/// \brief how many candidates we try at each position
+constexpr unsigned kMaxChain = 64;
+
+/// \brief log2 of the number of hash buckets
+constexpr unsigned kHashBits = 16;
+
+/// \brief accumulates the instruction stream
+class Emitter_t
+	{
+public:
+	std::vector<std::uint8_t> payload;
+
+	void varint(std::uint32_t v)
+		{
+		while (v >= 0x80)
+			{
+			this->payload.push_back(std::uint8_t(v | 0x80));
+			v >>= 7;
+			}
+		this->payload.push_back(std::uint8_t(v));
+		}
+
+	void op(Op_t op, std::size_t n)
+		{
+		this->varint((std::uint32_t(n - 1) << 2) | std::uint32_t(op));
+		}
+
+	/// \brief emit literals, using RUN for long runs of one byte.
+	void literals(const std::uint8_t *p, std::size_t n)
+		{
+		std::size_t iAdd = 0;
+
+		for (std::size_t i = 0; i < n; )
+			{
+			std::size_t nRun = 1;
+			while (i + nRun < n && p[i + nRun] == p[i])
+				++nRun;
+
+			if (nRun < kMinRun)
+				{
+				i += nRun;
+				continue;
+				}
+
+			if (iAdd < i)
+				{
+				this->op(Op_t::kAdd, i - iAdd);
+				this->payload.insert(this->payload.end(), p + iAdd, p + i);
+				}
+
+			this->op(Op_t::kRun, nRun);
+			this->payload.push_back(p[i]);
+			i += nRun;
+			iAdd = i;
+			}
+
+		if (iAdd < n)
+			{
+			this->op(Op_t::kAdd, n - iAdd);
+			this->payload.insert(this->payload.end(), p + iAdd, p + n);
+			}
+		}
+	};
+
+inline std::uint32_t seedHash(const std::uint8_t *p)
+	{
+	std::uint64_t v = 0;
+	for (std::size_t i = 0; i < kSeedSize; ++i)
+		v = (v << 8) | p[i];
+
+	return std::uint32_t((v * UINT64_C(0x9E3779B97F4A7C15)) >> (64 - kHashBits));
+	}
+
+/// \brief read an unsigned LEB128 value from \p payload.
+bool getVarint(const std::vector<std::uint8_t> &payload, std::size_t &i, std::uint32_t &v)
+	{
+	v = 0;
+	for (unsigned shift = 0; shift < 35 && i < payload.size(); shift += 7)
+		{
+		auto const b = payload[i++];
+
+		if (shift == 28 && (b & 0x70) != 0)
+			return false;
+
+		v |= std::uint32_t(b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+			return true;
+		}
+
+	return false;
+	}
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_Delta::encode()
+
+Function:
+	Compute the delta instructions that produce one image from another.
+
+Definition:
+	std::vector<std::uint8_t> McciBootloader_Delta::encode(
+		const std::vector<std::uint8_t> &base,
+		const std::vector<std::uint8_t> &target,
+		std::size_t windowSize
+		);
+
+Description:
+	This is a greedy matcher. At each position in the target, we
+	try continuing from the end of the previous COPY (cheap to encode,
+	and usually right, because most of the image is unchanged code
+	that has moved by a constant amount), and then up to kMaxChain
+	earlier positions in the base that start with the same kSeedSize
+	bytes. The longest match wins.
+
+	Matches are cut short where they would read a window of the base
+	that the bootloader has already overwritten: a byte written to
+	target window w must come from base offset w * windowSize or later.
+
+Returns:
+	The instruction stream.
+
+*/
+
+std::vector<std::uint8_t>
+McciBootloader_Delta::encode(
+	const std::vector<std::uint8_t> &base,
+	const std::vector<std::uint8_t> &target,
+	std::size_t windowSize
+	)
+	{
+	std::size_t const nBase = base.size();
+	std::size_t const nTarget = target.size();
+
+	// index the base. vHead[h] is the last position with hash h; vNext
+	// chains to earlier positions.
+	std::vector<std::int32_t> vHead(std::size_t(1) << kHashBits, -1);
+	std::vector<std::int32_t> vNext(nBase, -1);
+
+	for (std::size_t i = 0; i + kSeedSize <= nBase; ++i)
+		{
+		auto const h = seedHash(&base[i]);
+		vNext[i] = vHead[h];
+		vHead[h] = std::int32_t(i);
+		}
+
+	// the length of the match of target[pos...] with base[src...]
+	auto const matchLength = [&](std::size_t pos, std::size_t src) -> std::size_t
+		{
+		std::size_t n = 0;
+
+		while (pos + n < nTarget && src + n < nBase &&
+		       base[src + n] == target[pos + n] &&
+		       src + n >= (pos + n) / windowSize * windowSize)
+			++n;
+
+		return n;
+		};
+
+	Emitter_t emit;
+	std::size_t pos = 0;
+	std::size_t literalStart = 0;
+	std::size_t sourceNext = 0;
+	std::size_t targetNext = 0;
+
+	while (pos < nTarget)
+		{
+		std::size_t bestLength = 0;
+		std::size_t bestSource = 0;
+
+		// continue the previous copy; and the same displacement, if
+		// we've replaced some bytes.
+		for (auto const src : { sourceNext, sourceNext + (pos - targetNext) })
+			{
+			if (src < nBase)
+				{
+				auto const n = matchLength(pos, src);
+				if (n >= kMinNextMatch && n > bestLength)
+					{
+					bestLength = n;
+					bestSource = src;
+					}
+				}
+			}
+
+		// then try the hash chain.
+		if (pos + kSeedSize <= nTarget)
+			{
+			unsigned nTries = 0;
+
+			for (auto i = vHead[seedHash(&target[pos])];
+			     i >= 0 && nTries < kMaxChain;
+			     i = vNext[i], ++nTries)
+				{
+				auto const n = matchLength(pos, std::size_t(i));
+
+				if (n >= kMinHashMatch && n > bestLength)
+					{
+					bestLength = n;
+					bestSource = std::size_t(i);
+					}
+				}
+			}
+
+		if (bestLength == 0)
+			{
+			++pos;
+			continue;
+			}
+
+		emit.literals(&target[literalStart], pos - literalStart);
+
+		// the offset is relative to the end of the previous copy, zig-zag encoded.
+		auto const offset = std::int64_t(bestSource) - std::int64_t(sourceNext);
+
+		emit.op(Op_t::kCopy, bestLength);
+		emit.varint(std::uint32_t((offset << 1) ^ (offset >> 63)));
+
+		pos += bestLength;
+		literalStart = pos;
+		sourceNext = bestSource + bestLength;
+		targetNext = pos;
+		}
+
+	emit.literals(target.data() + literalStart, nTarget - literalStart);
+	return std::move(emit.payload);
+	}
+
+/*
+
+Name:	McciBootloader_Delta::decode()
+
+Function:
+	Apply delta instructions the way the bootloader does.
+
+Definition:
+	bool McciBootloader_Delta::decode(
+		const std::vector<std::uint8_t> &base,
+		const std::vector<std::uint8_t> &payload,
+		std::size_t targetSize,
+		std::vector<std::uint8_t> &target,
+		std::size_t windowSize
+		);
+
+Description:
+	This mirrors McciBootloader_programDelta(): the result is built
+	in place over a copy of the base, one window at a time, and the
+	same checks are applied to each instruction. We use it to check
+	the encoder's output before writing a package.
+
+Returns:
+	true if the instructions are valid, in which case \p target is
+	set to the result; false otherwise.
+
+*/
+
+bool
+McciBootloader_Delta::decode(
+	const std::vector<std::uint8_t> &base,
+	const std::vector<std::uint8_t> &payload,
+	std::size_t targetSize,
+	std::vector<std::uint8_t> &target,
+	std::size_t windowSize
+	)
+	{
+	std::size_t const nWindows = (targetSize + windowSize - 1) / windowSize;
+	std::vector<std::uint8_t> flash { base };
+	std::vector<std::uint8_t> window(windowSize);
+
+	if (flash.size() < nWindows * windowSize)
+		flash.resize(nWindows * windowSize);
+
+	std::size_t windowBase = 0;
+	std::size_t nWindow = 0;
+	std::size_t sourceNext = 0;
+	std::size_t iPayload = 0;
+
+	auto const flush = [&]()
+		{
+		std::fill(window.begin() + nWindow, window.end(), 0);
+		std::copy(window.begin(), window.end(), flash.begin() + windowBase);
+		windowBase += windowSize;
+		nWindow = 0;
+		};
+
+	while (windowBase + nWindow < targetSize)
+		{
+		std::uint32_t v;
+
+		if (! getVarint(payload, iPayload, v))
+			return false;
+
+		auto const op = Op_t(v & 3);
+		std::size_t nBytes = (v >> 2) + 1;
+		std::size_t source = 0;
+		std::uint8_t runByte = 0;
+
+		if (nBytes > targetSize - (windowBase + nWindow))
+			return false;
+
+		if (op == Op_t::kCopy)
+			{
+			std::uint32_t offset;
+
+			if (! getVarint(payload, iPayload, offset))
+				return false;
+
+			source = std::uint32_t(sourceNext + ((offset >> 1) ^ (0u - (offset & 1))));
+			if (source > base.size() || base.size() - source < nBytes)
+				return false;
+
+			sourceNext = source + nBytes;
+			}
+		else if (op == Op_t::kRun)
+			{
+			if (iPayload >= payload.size())
+				return false;
+			runByte = payload[iPayload++];
+			}
+		else if (op != Op_t::kAdd)
+			return false;
+
+		while (nBytes != 0)
+			{
+			auto const n = std::min(windowSize - nWindow, nBytes);
+
+			if (op == Op_t::kCopy)
+				{
+				if (source < windowBase)
+					return false;
+
+				std::copy_n(flash.begin() + source, n, window.begin() + nWindow);
+				source += n;
+				}
+			else if (op == Op_t::kRun)
+				std::fill_n(window.begin() + nWindow, n, runByte);
+			else
+				{
+				if (payload.size() - iPayload < n)
+					return false;
+
+				std::copy_n(payload.begin() + iPayload, n, window.begin() + nWindow);
+				iPayload += n;
+				}
+
+			nWindow += n;
+			nBytes -= n;
+			if (nWindow == windowSize)
+				flush();
+			}
+		}
+
+	if (nWindow != 0)
+		flush();
+
+	if (iPayload != payload.size())
+		return false;
+
+	target.assign(flash.begin(), flash.begin() + targetSize);
+	return true;
+	}
+
+/*
+
+Name:	App_t::writeDeltaPackage()
+
+Function:
+	Make a signed delta package that turns the base image into this
+	image.
+
+Definition:
+	void App_t::writeDeltaPackage();
+
+Description:
+	The base image (--delta-base) must be a signed image for the same
+	target address; it's the image the bootloader will find in flash
+	when it applies the package. this->fileimage must already be
+	hashed and signed. We compute the instructions for windows of
+	--block-size bytes, check them with
+	the reference decoder, wrap them in a package header, sign the
+	package with the same key as the image, and write it to
+	--delta-output. A line comparing the package size to the full
+	image size is printed.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::writeDeltaPackage()
+	{
+	// read the base image
+	App_t base {};
+
+	base.progname = this->progname;
+	base.infilename = this->deltabasename;
+	base.fForceBinary = this->fForceBinary;
+	base.authSize = this->authSize;
+	base.readImage();
+
+	auto const baseAppInfo = this->findPackageAppInfo(base, this->deltabasename);
+	auto const targetAppInfo = this->findPackageAppInfo(*this, this->infilename);
+
+	if (baseAppInfo.targetAddress.get() != targetAppInfo.targetAddress.get())
+		this->fatal("delta base is for a different target address: " + this->deltabasename);
+
+	size_t const baseHashPos = baseAppInfo.imagesize.get() + sizeof(mcci_tweetnacl_sign_publickey_t);
+	size_t const targetHashPos = targetAppInfo.imagesize.get() + sizeof(mcci_tweetnacl_sign_publickey_t);
+	size_t const baseSize = baseAppInfo.imagesize.get() + baseAppInfo.authsize.get();
+	size_t const targetSize = targetAppInfo.imagesize.get() + targetAppInfo.authsize.get();
+
+	// the bootloader checks the base by its hash, so it had better be right.
+	mcci_tweetnacl_sha512_t baseHash;
+
+	mcci_tweetnacl_hash_sha512(&baseHash, &base.fileimage[0], baseHashPos);
+	if (memcmp(baseHash.bytes, &base.fileimage[baseHashPos], sizeof(baseHash.bytes)) != 0)
+		this->fatal("delta base is not a hashed image: " + this->deltabasename);
+
+	std::vector<uint8_t> const baseBytes(base.fileimage.begin(), base.fileimage.begin() + baseSize);
+	std::vector<uint8_t> const targetBytes(this->fileimage.begin(), this->fileimage.begin() + targetSize);
+
+	// compute and check the instructions
+	size_t const windowSize = size_t(1) << this->log2BlockSize;
+	auto const payload = encode(baseBytes, targetBytes, windowSize);
+	std::vector<uint8_t> check;
+
+	if (! decode(baseBytes, payload, targetSize, check, windowSize) || check != targetBytes)
+		this->fatal("internal error: delta instructions don't reproduce the image");
+
+	// assemble the package
+	McciBootloader_PackageHeader_Wire_t header;
+
+	header.type = uint8_t(McciBootloader_PackageHeader_Wire_t::Type_t::kDelta);
+	header.log2WindowSize = uint8_t(this->log2BlockSize);
+	header.baseSize.put(uint32_t(baseSize));
+	memcpy(header.baseHash, baseHash.bytes, sizeof(header.baseHash));
+	memcpy(header.targetHash, &this->fileimage[targetHashPos], sizeof(header.targetHash));
+	header.appInfo = targetAppInfo;
+
+	auto const package = this->makePackage(header, payload);
+
+	// report
+	std::ostringstream report;
+
+	report << "delta package: " << package.size() << " bytes ("
+	       << payload.size() << " bytes of instructions); full image: "
+	       << targetSize << " bytes; "
+	       << std::fixed << std::setprecision(1)
+	       << 100.0 * double(package.size()) / double(targetSize) << "%";
+
+	std::cout << report.str() << "\n";
+
+	this->writePackage(package, this->deltaoutputname);
+	}
+
+/**** end of delta.cpp ****/
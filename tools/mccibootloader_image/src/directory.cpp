@@ -0,0 +1,402 @@
+/*
+
+Module:	directory.cpp
+
+Function:
+	App_t::writeSlotDirectory(): write a signed slot directory for the
+	storage (--slot-directory).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mccibootloader_image.h"
+
+#include <fstream>
+#include <stdexcept>
+
+using MemoryMap = McciBootloader_MemoryMap_t;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief one slot to be listed in the directory
+struct DirectorySlot_t
+	{
+	McciBootloader_VerifyResult_t	result;		///< the outcome of checking the slot
+	uint32_t			address;	///< the storage address of the slot
+	size_t				nBytes;		///< the size of the slot contents
+	McciBootloader_DirectoryEntry_Wire_t entry;	///< the directory entry
+	};
+
+/// \brief the directory has a sector to itself
+constexpr size_t kDirectorySectorSize = 4 * 1024;
+
+} // namespace
+
+static void checkPackageSlot(
+	DirectorySlot_t &slot,
+	const std::vector<uint8_t> &data,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	);
+
+static void checkSignedBytes(
+	DirectorySlot_t &slot,
+	const std::vector<uint8_t> &data,
+	size_t nSigned,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::writeSlotDirectory()
+
+Function:
+	Write a signed slot directory for the storage.
+
+Definition:
+	int App_t::writeSlotDirectory();
+
+Description:
+	this->slotDirectoryArgs[0] names the output; each of the rest is
+	"address=file", giving a file that will be placed in storage at
+	that address. The file may be a signed binary app image (with or
+	without a block hash table) or an update package.
+
+	Each file is checked as the bootloader will check it, and must be
+	signed with our key. The entry for it records the AppInfo of the
+	image it gives, and the hash from its signature block, so the
+	bootloader can rank the slots by version and can tell if a slot
+	has since been rewritten. The slots mustn't overlap each other,
+	or the directory's own sector at
+	McciBootloader_MemoryMap_t::kStorageDirectoryBase.
+
+	The directory is signed with the same signer as images, and
+	written to the output (unless --dry-run). The output is placed
+	in storage at kStorageDirectoryBase.
+
+Returns:
+	EXIT_SUCCESS if the directory was written, EXIT_FAILURE otherwise.
+
+*/
+
+int App_t::writeSlotDirectory()
+	{
+	auto const &outname = this->slotDirectoryArgs[0];
+	auto const pPublicKey = &this->keyfile.m_public;
+	std::vector<DirectorySlot_t> slots;
+
+	for (size_t i = 1; i < this->slotDirectoryArgs.size(); ++i)
+		{
+		auto const &arg = this->slotDirectoryArgs[i];
+		auto const pEquals = arg.find('=');
+		DirectorySlot_t slot {};
+		char *pEnd;
+
+		if (pEquals == string::npos || pEquals == 0)
+			this->usage("slot must be address=file: " + arg);
+
+		auto const address = std::strtoul(arg.c_str(), &pEnd, 0);
+		if (pEnd != arg.c_str() + pEquals || address >= MemoryMap::kStorageChipSize)
+			this->usage("illegal slot address: " + arg);
+
+		slot.address = uint32_t(address);
+		slot.result.filename = arg.substr(pEquals + 1);
+		slots.push_back(std::move(slot));
+		}
+
+	if (slots.size() > (kDirectorySectorSize - sizeof(McciBootloader_DirectoryHeader_Wire_t) - sizeof(McciBootloader_SignatureBlock_Wire_t)) / sizeof(McciBootloader_DirectoryEntry_Wire_t))
+		this->fatal("too many slots for one directory sector");
+
+	// check each slot, and make its entry.
+	for (auto &slot : slots)
+		{
+		auto &failures = slot.result.failures;
+		std::vector<uint8_t> data;
+
+			{
+			std::ifstream infile { slot.result.filename, ios::binary };
+
+			if (! infile.is_open())
+				{
+				failures.push_back("can't open file");
+				continue;
+				}
+
+			data.assign(
+				std::istreambuf_iterator<char>(infile),
+				std::istreambuf_iterator<char>()
+				);
+			}
+
+		if (data.size() >= sizeof(McciBootloader_PackageHeader_Wire_t) &&
+		    reinterpret_cast<const McciBootloader_PackageHeader_Wire_t *>(data.data())->magic.get() ==
+				McciBootloader_PackageHeader_Wire_t::kMagic)
+			{
+			checkPackageSlot(slot, data, pPublicKey);
+			}
+		else
+			{
+			this->verifyFile(slot.result, pPublicKey);
+
+			// the file goes into storage as is, so it must be a binary.
+			if (slot.result.failures.size() == 0 &&
+			    data.size() < uint64_t(slot.result.appInfo.imagesize.get()) + sizeof(McciBootloader_SignatureBlock_Wire_t))
+				failures.push_back("not a binary image; only binary images can be put in a storage slot");
+
+			if (failures.size() == 0)
+				{
+				slot.entry.appInfo = slot.result.appInfo;
+				slot.entry.nSigned = slot.result.appInfo.imagesize;
+				}
+			}
+
+		slot.nBytes = data.size();
+
+		if (slot.result.fAppInfo &&
+		    slot.result.appInfo.targetAddress.get() != MemoryMap::kAppBase)
+			failures.push_back("not an app image; only app images can be put in a storage slot");
+
+		if (uint64_t(slot.address) + slot.nBytes > MemoryMap::kStorageChipSize)
+			failures.push_back("slot doesn't fit in the storage");
+
+		if (failures.size() == 0)
+			{
+			slot.entry.address = slot.address;
+			memcpy(
+				slot.entry.hash,
+				&data[slot.entry.nSigned.get() + offsetof(McciBootloader_SignatureBlock_Wire_t, hash)],
+				sizeof(slot.entry.hash)
+				);
+			}
+		}
+
+	// the slots mustn't overlap each other or the directory
+	for (size_t i = 0; i < slots.size(); ++i)
+		{
+		auto &slot = slots[i];
+		auto const top = uint64_t(slot.address) + slot.nBytes;
+
+		if (slot.address < MemoryMap::kStorageDirectoryBase + kDirectorySectorSize &&
+		    MemoryMap::kStorageDirectoryBase < top)
+			slot.result.failures.push_back("slot overlaps the directory");
+
+		for (size_t j = 0; j < i; ++j)
+			{
+			auto const &other = slots[j];
+
+			if (slot.address < other.address + uint64_t(other.nBytes) &&
+			    other.address < top)
+				slot.result.failures.push_back("slot overlaps " + other.result.filename);
+			}
+		}
+
+	// report.
+	size_t nFailed = 0;
+
+	for (auto const &slot : slots)
+		{
+		if (slot.result.failures.size() != 0)
+			{
+			++nFailed;
+			for (auto const &why : slot.result.failures)
+				std::cout << "  " << slot.result.filename << ": " << why << "\n";
+			}
+		else if (this->fVerbose)
+			{
+			std::cout << "slot " << std::hex << slot.address << std::dec
+				  << ": " << slot.result.filename
+				  << " (version " << std::hex << slot.entry.appInfo.version.get() << std::dec
+				  << ", timestamp " << slot.entry.appInfo.posixTimestamp.get() << ")\n";
+			}
+		}
+
+	if (nFailed != 0)
+		{
+		std::cout << nFailed << " of " << slots.size() << " slot(s) failed their checks; directory not written\n"
+			  << std::flush;
+		return EXIT_FAILURE;
+		}
+
+	// the directory: the header, then the entries.
+	McciBootloader_DirectoryHeader_Wire_t header;
+
+	header.nSlots.put(uint16_t(slots.size()));
+
+	std::vector<uint8_t> directory((const uint8_t *)&header, (const uint8_t *)(&header + 1));
+
+	for (auto const &slot : slots)
+		directory.insert(
+			directory.end(),
+			(const uint8_t *)&slot.entry,
+			(const uint8_t *)(&slot.entry + 1)
+			);
+
+	this->appendSignature(directory);
+
+	std::cout << "slot directory: " << slots.size() << " slot(s), "
+		  << directory.size() << " bytes\n";
+
+	this->writePackage(directory, outname);
+	return EXIT_SUCCESS;
+	}
+
+/*
+
+Name:	checkPackageSlot()
+
+Function:
+	Check an update package for a slot, and make its entry.
+
+Definition:
+	static void checkPackageSlot(
+		DirectorySlot_t &slot,
+		const std::vector<uint8_t> &data,
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey
+		);
+
+Description:
+	The checks follow those McciBootloader_checkStorageImage() makes
+	of a package before it's unpacked: the header is sane, and the
+	header and payload are signed with our key. The entry gets the
+	AppInfo of the image the package makes.
+
+Returns:
+	No explicit result; failures are appended to slot.result.failures.
+
+*/
+
+static void checkPackageSlot(
+	DirectorySlot_t &slot,
+	const std::vector<uint8_t> &data,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	)
+	{
+	auto const &header = *reinterpret_cast<const McciBootloader_PackageHeader_Wire_t *>(data.data());
+	auto &failures = slot.result.failures;
+
+	if (header.size.get() != sizeof(header))
+		{
+		failures.push_back("package header is the wrong size");
+		return;
+		}
+
+	uint64_t const nSigned = uint64_t(header.size.get()) + header.payloadSize.get();
+
+	if (nSigned + sizeof(McciBootloader_SignatureBlock_Wire_t) > data.size())
+		{
+		failures.push_back("package is truncated");
+		return;
+		}
+
+	slot.result.appInfo = header.appInfo;
+	slot.result.fAppInfo = true;
+
+	checkSignedBytes(slot, data, size_t(nSigned), pPublicKey);
+
+	if (failures.size() == 0)
+		{
+		slot.entry.appInfo = header.appInfo;
+		slot.entry.nSigned.put(uint32_t(nSigned));
+		}
+	}
+
+/*
+
+Name:	checkSignedBytes()
+
+Function:
+	Check the signature block that follows signed data.
+
+Definition:
+	static void checkSignedBytes(
+		DirectorySlot_t &slot,
+		const std::vector<uint8_t> &data,
+		size_t nSigned,
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey
+		);
+
+Description:
+	The signature block at \p nSigned in \p data must have our public
+	key, the hash of the first \p nSigned bytes and the key, and a
+	good signature on that hash.
+
+Returns:
+	No explicit result; failures are appended to slot.result.failures.
+
+*/
+
+static void checkSignedBytes(
+	DirectorySlot_t &slot,
+	const std::vector<uint8_t> &data,
+	size_t nSigned,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	)
+	{
+	auto const pSigBlock = reinterpret_cast<const McciBootloader_SignatureBlock_Wire_t *>(&data[nSigned]);
+	auto &failures = slot.result.failures;
+	mcci_tweetnacl_sha512_t hash;
+
+	mcci_tweetnacl_hash_sha512(&hash, data.data(), nSigned + sizeof(pSigBlock->publicKey));
+
+	if (! mcci_tweetnacl_result_is_success(mcci_tweetnacl_verify_64(hash.bytes, pSigBlock->hash)))
+		{
+		failures.push_back("SHA-512 hash mismatch");
+		return;
+		}
+
+	slot.result.fKeyChecked = true;
+	if (! mcci_tweetnacl_result_is_success(mcci_tweetnacl_verify_32(pPublicKey->bytes, pSigBlock->publicKey)))
+		failures.push_back("signed with a different public key");
+
+	uint8_t signedMessage[sizeof(pSigBlock->signature) + sizeof(hash.bytes)];
+	uint8_t openedMessage[sizeof(signedMessage)];
+	size_t nActual;
+
+	memcpy(signedMessage, pSigBlock->signature, sizeof(pSigBlock->signature));
+	memcpy(signedMessage + sizeof(pSigBlock->signature), hash.bytes, sizeof(hash.bytes));
+
+	auto const result_open = mcci_tweetnacl_sign_open(
+			openedMessage,
+			&nActual,
+			signedMessage,
+			sizeof(signedMessage),
+			pPublicKey
+			);
+
+	if (! mcci_tweetnacl_result_is_success(result_open) ||
+	    nActual != sizeof(hash.bytes) ||
+	    ! mcci_tweetnacl_result_is_success(mcci_tweetnacl_verify_64(hash.bytes, openedMessage)))
+		failures.push_back("ed25519 signature is not valid");
+	}
+
+/**** end of directory.cpp ****/
@@ -0,0 +1,56 @@
+/*
+
+Module:	entry.cpp
+
+Function:
+	main() for mccibootloader_image.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+int main(
+	int argc,
+	char **argv
+	)
+	{
+	App_t app {};
+
+	return app.begin(argc, argv);
+	}
+
+/**** end of entry.cpp ****/
@@ -0,0 +1,417 @@
+/*
+
+Module:	fragment.cpp
+
+Function:
+	Fragmentation with parity for LoRaWAN multicast (FUOTA) delivery
+	of signed images: the encoder, and the reference decoder.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_fragment.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace McciBootloader_Fragment;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief the 23-bit pseudo-random sequence of TS004
+std::uint32_t prbs23(std::uint32_t x)
+	{
+	std::uint32_t const b0 = x & 1;
+	std::uint32_t const b1 = (x & 32) >> 5;
+
+	return (x >> 1) + ((b0 ^ b1) << 22);
+	}
+
+void put16(std::vector<std::uint8_t> &out, std::uint16_t v)
+	{
+	out.push_back(std::uint8_t(v));
+	out.push_back(std::uint8_t(v >> 8));
+	}
+
+void put32(std::vector<std::uint8_t> &out, std::uint32_t v)
+	{
+	put16(out, std::uint16_t(v));
+	put16(out, std::uint16_t(v >> 16));
+	}
+
+std::uint16_t get16(const std::uint8_t *p)
+	{
+	return std::uint16_t(p[0] | (p[1] << 8));
+	}
+
+std::uint32_t get32(const std::uint8_t *p)
+	{
+	return get16(p) | (std::uint32_t(get16(p + 2)) << 16);
+	}
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+void FileHeader_t::put(std::vector<std::uint8_t> &out) const
+	{
+	put32(out, kMagic);
+	put16(out, this->nFragments);
+	put16(out, this->nParity);
+	out.push_back(this->fragmentSize);
+	out.push_back(this->padding);
+	out.push_back(this->session);
+	out.push_back(0);
+	put32(out, this->imageSize);
+	}
+
+bool FileHeader_t::get(const std::uint8_t *p, std::size_t n)
+	{
+	if (n < kSize || get32(p) != kMagic || p[11] != 0)
+		return false;
+
+	this->nFragments = get16(p + 4);
+	this->nParity = get16(p + 6);
+	this->fragmentSize = p[8];
+	this->padding = p[9];
+	this->session = p[10];
+	this->imageSize = get32(p + 12);
+
+	return this->nFragments != 0 &&
+	       this->fragmentSize != 0 &&
+	       this->padding < this->fragmentSize &&
+	       this->session < 4 &&
+	       std::uint32_t(this->nFragments) + this->nParity <= kMaxIndex &&
+	       this->imageSize == std::uint32_t(this->nFragments) * this->fragmentSize - this->padding;
+	}
+
+/*
+
+Name:	McciBootloader_Fragment::matrixLine()
+
+Function:
+	Compute a row of the parity matrix.
+
+Definition:
+	void McciBootloader_Fragment::matrixLine(
+		std::uint32_t n,
+		std::uint32_t m,
+		std::vector<bool> &line
+		);
+
+Description:
+	This is matrix_line() from the LoRaWAN Fragmented Data Block
+	Transport specification: m/2 coefficients are drawn with the
+	PRBS23 generator, seeded from n. (If m is a power of two, the
+	modulus is m + 1, so that the draws aren't biased.) Both ends
+	compute the same rows, so only the index is sent.
+
+Returns:
+	No explicit result; \p line is resized to \p m.
+
+*/
+
+void
+McciBootloader_Fragment::matrixLine(
+	std::uint32_t n,
+	std::uint32_t m,
+	std::vector<bool> &line
+	)
+	{
+	std::uint32_t const mm = ((m & (m - 1)) == 0) ? m + 1 : m;
+	std::uint32_t x = 1 + 1001 * n;
+
+	line.assign(m, false);
+
+	for (std::uint32_t nCoeff = 0; nCoeff < m / 2; ++nCoeff)
+		{
+		std::uint32_t r = 1u << 16;
+
+		while (r >= m)
+			{
+			x = prbs23(x);
+			r = x % mm;
+			}
+
+		line[r] = true;
+		}
+	}
+
+/*
+
+Name:	McciBootloader_Fragment::encode()
+
+Function:
+	Split an image into fragments, and add parity fragments.
+
+Definition:
+	std::vector<std::uint8_t> McciBootloader_Fragment::encode(
+		const std::vector<std::uint8_t> &image,
+		std::size_t fragmentSize,
+		std::size_t nParity,
+		std::uint8_t session
+		);
+
+Description:
+	The image is padded with zeros to a multiple of fragmentSize.
+	The result is a fragment file (see FileHeader_t): the header,
+	then the uncoded fragments in order, then the parity fragments.
+
+Returns:
+	The fragment file. Throws std::invalid_argument if the sizes are
+	out of range.
+
+*/
+
+std::vector<std::uint8_t>
+McciBootloader_Fragment::encode(
+	const std::vector<std::uint8_t> &image,
+	std::size_t fragmentSize,
+	std::size_t nParity,
+	std::uint8_t session
+	)
+	{
+	if (fragmentSize == 0 || fragmentSize > kMaxFragmentSize)
+		throw std::invalid_argument("fragment size must be 1 to " + std::to_string(kMaxFragmentSize));
+	if (image.size() == 0 || session > 3)
+		throw std::invalid_argument("nothing to fragment");
+
+	std::size_t const m = (image.size() + fragmentSize - 1) / fragmentSize;
+
+	if (m + nParity > kMaxIndex)
+		throw std::invalid_argument(
+			"too many fragments (" + std::to_string(m + nParity) +
+			"); the limit is " + std::to_string(kMaxIndex)
+			);
+
+	FileHeader_t header;
+
+	header.nFragments = std::uint16_t(m);
+	header.nParity = std::uint16_t(nParity);
+	header.fragmentSize = std::uint8_t(fragmentSize);
+	header.padding = std::uint8_t(m * fragmentSize - image.size());
+	header.session = session;
+	header.imageSize = std::uint32_t(image.size());
+
+	std::vector<std::uint8_t> out;
+	out.reserve(FileHeader_t::kSize + (m + nParity) * (2 + fragmentSize));
+	header.put(out);
+
+	// the padded image, so each fragment is a simple slice
+	std::vector<std::uint8_t> padded(image);
+	padded.resize(m * fragmentSize, 0);
+
+	auto const putIndex = [&out, session](std::size_t index)
+		{
+		put16(out, std::uint16_t(index | (std::size_t(session) << 14)));
+		};
+
+	for (std::size_t i = 0; i < m; ++i)
+		{
+		putIndex(i + 1);
+		out.insert(out.end(), &padded[i * fragmentSize], &padded[(i + 1) * fragmentSize]);
+		}
+
+	std::vector<bool> line;
+	std::vector<std::uint8_t> parity(fragmentSize);
+
+	for (std::size_t n = 1; n <= nParity; ++n)
+		{
+		matrixLine(std::uint32_t(n), std::uint32_t(m), line);
+		std::fill(parity.begin(), parity.end(), 0);
+
+		for (std::size_t k = 0; k < m; ++k)
+			{
+			if (! line[k])
+				continue;
+
+			const std::uint8_t * const p = &padded[k * fragmentSize];
+			for (std::size_t j = 0; j < fragmentSize; ++j)
+				parity[j] ^= p[j];
+			}
+
+		putIndex(m + n);
+		out.insert(out.end(), parity.begin(), parity.end());
+		}
+
+	return out;
+	}
+
+Decoder_t::Decoder_t(std::size_t nFragments, std::size_t fragmentSize)
+	: m_nFragments(nFragments)
+	, m_fragmentSize(fragmentSize)
+	, m_nWords((nFragments + kWordBits - 1) / kWordBits)
+	, m_rows(nFragments * m_nWords)
+	, m_data(nFragments * fragmentSize)
+	, m_fRow(nFragments)
+	, m_scratchRow(m_nWords)
+	, m_scratchData(fragmentSize)
+	{}
+
+/*
+
+Name:	McciBootloader_Fragment::Decoder_t::add()
+
+Function:
+	Add a received fragment.
+
+Definition:
+	bool Decoder_t::add(std::uint32_t index, const std::uint8_t *pData);
+
+Description:
+	The fragment's row (a unit row for an uncoded fragment, or
+	matrixLine() for a parity fragment) is reduced against the rows
+	already held, lowest bit first. If it reduces to zero, the
+	fragment told us nothing new; otherwise it's kept as the row for
+	its lowest remaining bit.
+
+Returns:
+	true if the image is now complete.
+
+*/
+
+bool Decoder_t::add(std::uint32_t index, const std::uint8_t *pData)
+	{
+	if (index == 0 || index > kMaxIndex || this->isComplete())
+		return this->isComplete();
+
+	++this->m_nReceived;
+
+	auto &r = this->m_scratchRow;
+	std::fill(r.begin(), r.end(), 0);
+
+	if (index <= this->m_nFragments)
+		r[(index - 1) / kWordBits] |= Word_t(1) << ((index - 1) % kWordBits);
+	else
+		{
+		std::vector<bool> line;
+
+		matrixLine(std::uint32_t(index - this->m_nFragments), std::uint32_t(this->m_nFragments), line);
+		for (std::size_t k = 0; k < this->m_nFragments; ++k)
+			{
+			if (line[k])
+				r[k / kWordBits] |= Word_t(1) << (k % kWordBits);
+			}
+		}
+
+	std::memcpy(this->m_scratchData.data(), pData, this->m_fragmentSize);
+
+	for (std::size_t w = 0; w < this->m_nWords; ++w)
+		{
+		while (r[w] != 0)
+			{
+			std::size_t const pivot = w * kWordBits + std::size_t(__builtin_ctzll(r[w]));
+
+			if (! this->m_fRow[pivot])
+				{
+				// a new row: keep it.
+				std::memcpy(this->row(pivot), r.data(), this->m_nWords * sizeof(Word_t));
+				std::memcpy(this->data(pivot), this->m_scratchData.data(), this->m_fragmentSize);
+				this->m_fRow[pivot] = true;
+				++this->m_nRows;
+				return this->isComplete();
+				}
+
+			// eliminate the pivot bit; the held row has no lower bits.
+			const Word_t * const pRow = this->row(pivot);
+			for (std::size_t j = w; j < this->m_nWords; ++j)
+				r[j] ^= pRow[j];
+
+			const std::uint8_t * const pRowData = this->data(pivot);
+			for (std::size_t j = 0; j < this->m_fragmentSize; ++j)
+				this->m_scratchData[j] ^= pRowData[j];
+			}
+		}
+
+	// redundant
+	return false;
+	}
+
+/*
+
+Name:	McciBootloader_Fragment::Decoder_t::image()
+
+Function:
+	Solve for the uncoded fragments.
+
+Definition:
+	std::vector<std::uint8_t> Decoder_t::image();
+
+Description:
+	The rows held form an upper-triangular matrix with ones on the
+	diagonal. Working from the last row up, each row is cleared of
+	the bits above its diagonal, leaving its data equal to that of
+	the uncoded fragment.
+
+Returns:
+	The padded image. Throws std::logic_error if not complete.
+
+*/
+
+std::vector<std::uint8_t> Decoder_t::image()
+	{
+	if (! this->isComplete())
+		throw std::logic_error("fragment decoder: image is not complete");
+
+	for (std::size_t i = this->m_nFragments; i-- > 0; )
+		{
+		Word_t * const pRow = this->row(i);
+		std::uint8_t * const pData = this->data(i);
+
+		for (std::size_t w = i / kWordBits; w < this->m_nWords; ++w)
+			{
+			Word_t bits = pRow[w];
+
+			if (w == i / kWordBits)
+				bits &= ~((Word_t(2) << (i % kWordBits)) - 1);
+
+			while (bits != 0)
+				{
+				std::size_t const k = w * kWordBits + std::size_t(__builtin_ctzll(bits));
+				const std::uint8_t * const pOther = this->data(k);
+
+				bits &= bits - 1;
+				for (std::size_t j = 0; j < this->m_fragmentSize; ++j)
+					pData[j] ^= pOther[j];
+				}
+			}
+
+		// now the row is a unit row.
+		std::fill(pRow, pRow + this->m_nWords, 0);
+		pRow[i / kWordBits] = Word_t(1) << (i % kWordBits);
+		}
+
+	return this->m_data;
+	}
+
+/**** end of fragment.cpp ****/
@@ -0,0 +1,128 @@
+/*
+
+Module:	fuota.cpp
+
+Function:
+	App_t::writeFuotaFragments(): fragments with parity for LoRaWAN
+	multicast delivery (--fuota-output).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_fragment.h"
+
+#include <iomanip>
+#include <sstream>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::writeFuotaFragments()
+
+Function:
+	Split this image into fragments, with parity fragments, for
+	delivery by LoRaWAN multicast.
+
+Definition:
+	void App_t::writeFuotaFragments();
+
+Description:
+	this->fileimage must already be hashed and signed. The image and
+	its signature block (what the receiver must place in storage) are
+	split into this->fragmentSize-byte fragments, and
+	this->fuotaRedundancy percent more parity fragments are added,
+	following the LoRaWAN Fragmented Data Block Transport scheme (see
+	mccibootloader_fragment.h). Before writing, we check that the
+	reference decoder rebuilds the image from the fragments.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::writeFuotaFragments()
+	{
+	namespace Fragment = McciBootloader_Fragment;
+
+	auto const appInfo = this->findPackageAppInfo(*this, this->infilename);
+	size_t const imageSize = appInfo.imagesize.get() + appInfo.authsize.get();
+	size_t const nFragments = (imageSize + this->fragmentSize - 1) / this->fragmentSize;
+	size_t const nParity = (nFragments * this->fuotaRedundancy + 99) / 100;
+
+	std::vector<uint8_t> const imageBytes(this->fileimage.begin(), this->fileimage.begin() + imageSize);
+	std::vector<uint8_t> fragments;
+
+	try	{
+		fragments = Fragment::encode(imageBytes, this->fragmentSize, nParity);
+		}
+	catch (std::invalid_argument &e)
+		{
+		this->fatal(string("--fuota-output: ") + e.what());
+		}
+
+	// check: the decoder must rebuild the image from the parity
+	// fragments plus whatever uncoded fragments are needed.
+	Fragment::Decoder_t decoder { nFragments, this->fragmentSize };
+	size_t const recordSize = 2 + this->fragmentSize;
+
+	for (size_t i = nFragments; i < nFragments + nParity + nFragments && ! decoder.isComplete(); ++i)
+		{
+		const uint8_t * const pRecord = &fragments[Fragment::FileHeader_t::kSize + (i % (nFragments + nParity)) * recordSize];
+
+		decoder.add(pRecord[0] | ((pRecord[1] & 0x3F) << 8), pRecord + 2);
+		}
+
+	if (! decoder.isComplete())
+		this->fatal("internal error: fragments don't rebuild the image");
+
+	auto padded = decoder.image();
+	padded.resize(imageSize);
+	if (padded != imageBytes)
+		this->fatal("internal error: fragments rebuild the wrong image");
+
+	std::ostringstream report;
+
+	report << "fuota fragments: " << nFragments << " of " << this->fragmentSize
+	       << " bytes, plus " << nParity << " parity ("
+	       << this->fuotaRedundancy << "%); "
+	       << fragments.size() << " bytes";
+
+	std::cout << report.str() << "\n";
+
+	this->writePackage(fragments, this->fuotaoutputname);
+	}
+
+/**** end of fuota.cpp ****/
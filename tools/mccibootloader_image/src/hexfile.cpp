@@ -0,0 +1,240 @@
+/*
+
+Module:	hexfile.cpp
+
+Function:
+	Intel HEX and Motorola S-record encoders.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_hexfile.h"
+
+#include <algorithm>
+
+using namespace McciBootloader_HexFile;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief data bytes per HEX or S-record line
+constexpr std::size_t kBytesPerRecord = 16;
+
+/// \brief formats one record at a time, and writes it to a stream.
+///
+/// \details Both Intel HEX and Motorola S-records are lines of hex
+///	digits with a one-byte checksum; only the framing differs. The
+///	line is built in a fixed buffer, so nothing is copied but the
+///	bytes of one record.
+///
+class RecordWriter_t
+	{
+public:
+	RecordWriter_t(std::ostream &os)
+		: m_os(os)
+		{}
+
+	/// \brief write an Intel HEX record
+	void hex(std::uint8_t type, std::uint16_t address, const std::uint8_t *p, std::size_t n)
+		{
+		this->begin(":");
+		this->byte(std::uint8_t(n));
+		this->byte(std::uint8_t(address >> 8));
+		this->byte(std::uint8_t(address));
+		this->byte(type);
+		for (std::size_t i = 0; i < n; ++i)
+			this->byte(p[i]);
+		this->end(std::uint8_t(-this->m_sum));
+		}
+
+	/// \brief write an S-record with a 16- or 32-bit address
+	void srec(char type, std::uint32_t address, unsigned nAddress, const std::uint8_t *p, std::size_t n)
+		{
+		char const prefix[] = { 'S', type, '\0' };
+
+		this->begin(prefix);
+		this->byte(std::uint8_t(nAddress + n + 1));
+		for (unsigned i = nAddress; i > 0; --i)
+			this->byte(std::uint8_t(address >> (8 * (i - 1))));
+		for (std::size_t i = 0; i < n; ++i)
+			this->byte(p[i]);
+		this->end(std::uint8_t(~this->m_sum));
+		}
+
+private:
+	void begin(const char *prefix)
+		{
+		this->m_n = 0;
+		this->m_sum = 0;
+		while (*prefix != '\0')
+			this->m_line[this->m_n++] = *prefix++;
+		}
+
+	void byte(std::uint8_t b)
+		{
+		static constexpr char kDigits[] = "0123456789ABCDEF";
+
+		this->m_line[this->m_n++] = kDigits[b >> 4];
+		this->m_line[this->m_n++] = kDigits[b & 0xF];
+		this->m_sum += b;
+		}
+
+	void end(std::uint8_t checksum)
+		{
+		this->byte(checksum);
+		this->m_line[this->m_n++] = '\n';
+		this->m_os.write(this->m_line, this->m_n);
+		}
+
+	std::ostream	&m_os;
+	char		m_line[2 + 2 * (1 + 4 + 255 + 1) + 1];
+	std::size_t	m_n { 0 };
+	std::uint8_t	m_sum { 0 };
+	};
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	McciBootloader_HexFile::writeIntelHex()
+
+Function:
+	Write memory segments as Intel HEX.
+
+Definition:
+	void McciBootloader_HexFile::writeIntelHex(
+		std::ostream &os,
+		const std::vector<Segment_t> &segments
+		);
+
+Description:
+	Data records carry 16 bytes, and never cross a 64k boundary. An
+	extended linear address record (type 04) is written whenever the
+	upper 16 bits of the address change. The file ends with an EOF
+	record.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloader_HexFile::writeIntelHex(
+	std::ostream &os,
+	const std::vector<Segment_t> &segments
+	)
+	{
+	RecordWriter_t writer { os };
+	std::uint32_t upper = ~UINT32_C(0);
+
+	for (auto const &segment : segments)
+		{
+		for (std::size_t offset = 0; offset < segment.n; )
+			{
+			std::uint32_t const address = segment.address + std::uint32_t(offset);
+
+			// set the upper 16 bits of the address when they change
+			if ((address >> 16) != upper)
+				{
+				upper = address >> 16;
+				std::uint8_t const ela[] = { std::uint8_t(upper >> 8), std::uint8_t(upper) };
+				writer.hex(0x04, 0, ela, sizeof(ela));
+				}
+
+			// data records don't cross 64k boundaries
+			std::size_t const nThis = std::min<std::size_t>(
+				{ kBytesPerRecord, segment.n - offset, 0x10000 - (address & 0xFFFF) }
+				);
+
+			writer.hex(0x00, std::uint16_t(address), segment.p + offset, nThis);
+			offset += nThis;
+			}
+		}
+
+	writer.hex(0x01, 0, nullptr, 0);
+	}
+
+/*
+
+Name:	McciBootloader_HexFile::writeSrec()
+
+Function:
+	Write memory segments as Motorola S-records.
+
+Definition:
+	void McciBootloader_HexFile::writeSrec(
+		std::ostream &os,
+		const std::vector<Segment_t> &segments,
+		const std::string &header
+		);
+
+Description:
+	The file starts with an S0 record holding (up to 64 bytes of)
+	\p header, has one S3 record (32-bit address) for each 16 bytes of
+	data, and ends with an S7 record.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+McciBootloader_HexFile::writeSrec(
+	std::ostream &os,
+	const std::vector<Segment_t> &segments,
+	const std::string &header
+	)
+	{
+	RecordWriter_t writer { os };
+	auto const s0 = header.substr(0, 64);
+
+	writer.srec('0', 0, 2, (const std::uint8_t *)s0.data(), s0.size());
+
+	for (auto const &segment : segments)
+		{
+		for (std::size_t offset = 0; offset < segment.n; offset += kBytesPerRecord)
+			{
+			writer.srec(
+				'3',
+				segment.address + std::uint32_t(offset),
+				4,
+				segment.p + offset,
+				std::min(kBytesPerRecord, segment.n - offset)
+				);
+			}
+		}
+
+	writer.srec('7', 0, 4, nullptr, 0);
+	}
+
+/**** end of hexfile.cpp ****/
@@ -22,6 +22,7 @@ Author:
 #include "mccibootloader_image.h"
 
 #include "mccibootloader_elf.h"
+#include <cerrno>
 #include <sstream>
 
 using namespace McciBootloader_Elf;
@@ -32,6 +33,10 @@ using namespace McciBootloader_Elf;
 |
 \****************************************************************************/
 
+/// \brief the largest hole we fill between ELF sections. Alignment holes
+///	are small; a bigger gap is most likely a section that isn't meant
+///	for flash.
+constexpr uint32_t kMaxSectionGap = 64 * 1024;
 
 /****************************************************************************\
 |
@@ -50,24 +55,41 @@ using namespace McciBootloader_Elf;
 void App_t::readImage()
 	{
 	// do the work.
-	std::ifstream infile {this->infilename, ios::binary | ios::ate};
-
-	if (! infile.is_open())
 		{
-		string msg = "can't read " + this->infilename;
-		std::perror(msg.c_str());
-		std::exit(EXIT_FAILURE);
+		auto const span = this->span("read");
+		std::ifstream infile {this->infilename, ios::binary | ios::ate};
+
+		if (! infile.is_open())
+			{
+			this->fatal("can't read " + this->infilename + ": " + std::strerror(errno));
+			}
+
+		// get length
+		infile.exceptions(std::ifstream::failbit);
+		this->fSize = size_t(infile.tellg());
+		infile.seekg(0);
+
+		// get file
+		this->fileimage.resize(this->fSize);
+		infile.read((char *)&this->fileimage[0], this->fSize);
+		infile.close();
 		}
 
-	// get length
-	infile.exceptions(std::ifstream::failbit);
-	this->fSize = size_t(infile.tellg());
-	infile.seekg(0);
+	this->parseImage();
+	}
 
-	// get file
-	this->fileimage.resize(this->fSize);
-	infile.read((char *)&this->fileimage[0], this->fSize);
-	infile.close();
+/// \brief set up this->fileimage (and this->elf, for ELF files) from the
+///	file contents in this->fileimage.
+void App_t::parseImage()
+	{
+	auto const span = this->span("parse");
+
+	this->fSize = this->fileimage.size();
+
+	// anything shorter than a page zero can't be an image (and can't be
+	// probed safely).
+	if (this->fSize < sizeof(McciBootloader_CortexM0_PageZero_Wire_t))
+		this->fatal(string("file too small to be an image: ") + this->infilename);
 
 	// see if it's an elf file
 	const ElfIdentBase_t * const pElfBase = (ElfIdentBase_t *)(&this->fileimage[0]);
@@ -133,9 +155,11 @@ void App_t::readImage()
 			}
 		}
 
-	// empty the file image and set up the elf image
+	// keep the file as it is, and build the load image as a view of it.
 	this->elf.image = std::move(this->fileimage);
 	this->fileimage.clear();
+	this->elf.load.clear();
+	this->elf.vHeaders.clear();
 
 	// record the header
 	this->elf.pIdent32 = pElfIdent32;
@@ -154,7 +178,7 @@ void App_t::readImage()
 		if ((ph.getFlags() & ph.getFlagW()) != 0)
 			{
 			if (this->elf.vHeaders.size() != 0 &&
-			    this->fileimage.size() != ph.getPaddr() - this->elf.targetAddress)
+			    this->elf.load.size() != ph.getPaddr() - this->elf.targetAddress)
 			    	{
 				if (this->fVerbose)
 					{
@@ -172,60 +196,75 @@ void App_t::readImage()
 			this->elf.targetAddress = ph.getPaddr();
 			}
 
-		// is the section contiguous with the first?
-		if (this->fileimage.size() != ph.getPaddr() - this->elf.targetAddress)
+		// sections may be separated by holes (for alignment), which
+		// we fill with zeros; but they must be in order, and the holes
+		// must be small.
+		if (ph.getPaddr() < uint64_t(this->elf.targetAddress) + this->elf.load.size())
+			this->fatal("ELF sections overlap or are out of order");
+
+		auto const gap = ph.getPaddr() - this->elf.targetAddress - this->elf.load.size();
+
+		if (gap > kMaxSectionGap)
 			{
 			this->fatal("ELF sections not contiguous");
 			}
+		else if (gap != 0 && this->fVerbose)
+			{
+			std::ostringstream msg;
+			msg << "Elf: filling 0x" << std::hex << gap << " bytes before section " << std::dec << i;
+			this->verbose(msg.str());
+			}
+
+		// a section with more in the file than in memory only
+		// loads memsz bytes.
+		LoadImage_t::Segment_t segment;
+
+		segment.imageOffset = ph.getPaddr() - this->elf.targetAddress;
+		segment.fileOffset = ph.getOffset();
+		segment.memsz = ph.getMemsz();
+		segment.filesz = std::min(ph.getMemsz(), ph.getFilesz());
+
+		if (uint64_t(segment.fileOffset) + segment.filesz > this->elf.image.size())
+			this->fatal("ELF section extends past end of file");
+
+		if (! this->elf.load.add(segment))
+			this->fatal("ELF section is too large");
 
 		// save the header
 		this->elf.vHeaders.push_back(ph);
-
-		// extract the section. We do this in two steps in case
-		// the file size is shorter than the memsize.
-		std::vector<std::uint8_t> section;
-		const auto memsz = ph.getMemsz();
-		const uint32_t nCopy = std::min(memsz, ph.getFilesz());
-		section.reserve(memsz);
-		section.insert(
-			section.end(),
-			this->elf.image.begin() + ph.getOffset(),
-			this->elf.image.begin() + ph.getOffset() + nCopy
-			);
-		section.resize(memsz, 0);
-
-		// append section to the file image
-		this->fileimage.insert(
-			this->fileimage.end(),
-			section.begin(),
-			section.end()
-			);
 		}
 
-	this->fSize = this->fileimage.size();
+	if (this->elf.load.size() == 0)
+		this->fatal("ELF file has no loadable sections");
+
+	this->fSize = this->elf.load.size();
 	}
 
 void App_t::writeImage()
 	{
+	auto const span = this->span("write");
 	std::ofstream outfile;
 	std::string successMessage;
 
-	if (this->isUsingElf())
-		{
-		this->elfImagePrep();
-		this->fileimage = std::move(this->elf.image);
-		}
+	// the extra outputs are written from the same image.
+	this->writeArtifacts();
+
+	auto const &image = this->outputImage();
 
 	if (this->fDryRun)
 		this->verbose("dry run, skipping write");
+	else if (this->cachedirname != "" &&
+		 this->outputIsUnchanged(this->fPatch ? this->infilename : this->outfilename))
+		{
+		// don't touch the file, so that make won't redo things downstream.
+		this->verbose("output is unchanged, skipping write");
+		}
 	else if (this->fPatch)
 		{
 		outfile.open(this->infilename, ios::binary);
 		if (! outfile.is_open())
 			{
-			string msg = "can't write: " + this->infilename;
-			std::perror(msg.c_str());
-			std::exit(EXIT_FAILURE);
+			this->fatal("can't write: " + this->infilename + ": " + std::strerror(errno));
 			}
 		successMessage = string("successfully patched: ") + this->infilename;
 		}
@@ -234,9 +273,7 @@ void App_t::writeImage()
 		outfile.open(this->outfilename, ios::binary | ios::trunc);
 		if (! outfile.is_open())
 			{
-			string msg = "can't create: " + this->outfilename;
-			std::perror(msg.c_str());
-			std::exit(EXIT_FAILURE);
+			this->fatal("can't create: " + this->outfilename + ": " + std::strerror(errno));
 			}
 		successMessage = string("output file successfully written: ") + this->outfilename;
 		}
@@ -249,39 +286,92 @@ void App_t::writeImage()
 	if (outfile.is_open())
 		{
 		outfile.exceptions(ios::badbit | ios::failbit);
-		outfile.write((char *)&this->fileimage.at(0), this->fileimage.size());
+		outfile.write((const char *)&image.at(0), image.size());
 		outfile.close();
 		this->verbose(successMessage);
 		}
 	}
 
-/// \brief transfer data from this->fileimage back to this->elf.image
-void App_t::elfImagePrep()
+/// \brief the bytes of the output file: the ELF file, for ELF input,
+///	otherwise the flat image.
+const std::vector<uint8_t> &App_t::outputImage() const
+	{
+	return this->isUsingElf() ? this->elf.image : this->fileimage;
+	}
+
+/// \brief the size of the load image
+size_t App_t::imageSize() const
 	{
-	// walk through each of the headers, and copy the section.
-	for (auto & h : this->elf.vHeaders)
+	return this->isUsingElf() ? this->elf.load.size() : this->fileimage.size();
+	}
+
+/// \brief return a pointer to bytes [offset, offset + n) of the load
+///	image, or nullptr if they aren't stored together in the input.
+uint8_t *App_t::imagePointer(size_t offset, size_t n)
+	{
+	if (this->isUsingElf())
+		return this->elf.load.find(this->elf.image, offset, n);
+	else if (offset > this->fileimage.size() || n > this->fileimage.size() - offset)
+		return nullptr;
+	else
+		return &this->fileimage[offset];
+	}
+
+/// \brief like imagePointer(), but it's fatal if the bytes (which
+///	\p pWhat describes) aren't stored together: they are about to be
+///	patched.
+uint8_t *App_t::imageBytes(size_t offset, size_t n, const char *pWhat)
+	{
+	auto const p = this->imagePointer(offset, n);
+
+	if (p == nullptr)
 		{
-		auto const elfbase = h.getOffset();
-		auto const pbase = h.getPaddr() - this->elf.targetAddress;
-		auto const memsz = h.getMemsz();
-		auto const filesz = h.getFilesz();
-	
-		// if memsz is > filesz, look for non-zero values
-		if (memsz > filesz)
-			{
-			for (auto i = memsz; i < filesz; ++i)
-				{
-				auto j = pbase + i;
-				if (this->fileimage[j] != 0)
-					this->fatal("elf section in file too small and non-zero data written");
-				}
-			} 
-
-		// merge
-		memcpy(
-			&this->elf.image[elfbase],
-			&this->fileimage[pbase],
-			memsz
-			);
+		std::ostringstream msg;
+
+		msg << pWhat << " (0x" << std::hex << offset << ", 0x" << n
+		    << " bytes) is not in the data of a single ELF section";
+		this->fatal(msg.str());
 		}
+
+	return p;
+	}
+
+/// \brief set \p hash to the SHA-512 of the first \p n bytes of the load image.
+void App_t::hashImage(mcci_tweetnacl_sha512_t &hash, size_t n) const
+	{
+	if (this->isUsingElf())
+		this->elf.load.hash(this->elf.image, n, hash);
+	else
+		mcci_tweetnacl_hash_sha512(&hash, &this->fileimage[0], n);
+	}
+
+/*
+
+Name:	App_t::flattenImage()
+
+Function:
+	Make sure this->fileimage holds the flat load image.
+
+Definition:
+	void App_t::flattenImage();
+
+Description:
+	For binary input, this->fileimage is the image, and there's
+	nothing to do. For ELF input, the image is hashed and patched in
+	place, in the sections of this->elf.image, and the flat image is
+	only made for the outputs that need it (packages, flat artifacts,
+	the cache, and verification). Call this after the image is final:
+	the copy is made once, and isn't updated by later patches.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::flattenImage()
+	{
+	if (this->isUsingElf() && this->fileimage.size() != this->elf.load.size())
+		this->elf.load.flatten(this->elf.image, this->fileimage);
 	}
+
+/**** end of image.cpp ****/
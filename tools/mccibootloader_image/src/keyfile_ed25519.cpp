@@ -154,9 +154,43 @@ Keyfile_ed25519_t::read()
 	return true;
 	}
 
+bool
+Keyfile_ed25519_t::readPublic()
+	{
+	std::ifstream infile(this->m_filename, std::ios::in);
+
+	if (! infile.is_open())
+		return false;
+
+	// a public key file is a single line: type, base64 key blob, comment.
+	string s;
+	std::getline(infile, s);
+	std::istringstream line (s);
+
+	string keytype, body;
+	line >> keytype >> body;
+	if (keytype != kName)
+		return false;
+
+	auto m = base64decode(body);
+	std::istringstream pubm (m, std::ios::binary);
+	if (getByteString(pubm) != kName)
+		return false;
+
+	auto pubkey_string = getByteString(pubm);
+	if (pubkey_string.size() != sizeof(this->m_public.bytes))
+		return false;
+	for (unsigned i = 0; i < sizeof(this->m_public.bytes); ++i)
+		this->m_public.bytes[i] = uint8_t(pubkey_string[i]);
+
+	// whatever is left on the line is the comment
+	std::getline(line >> std::ws, this->m_comment);
+	return true;
+	}
+
 static uint32_t getInt(std::istringstream &s)
 	{
-	uint8_t buf[4];
+	uint8_t buf[4] = { 0 };
 	s.read((char *)&buf, 4);
 	return (uint32_t(buf[0]) << 24) |
 	       (uint32_t(buf[1]) << 16) |
@@ -171,7 +205,12 @@ static std::string getByteString(std::istringstream &s)
 	std::string result;
 	for (uint32_t i = 0; i < n; ++i)
 		{
-		result.push_back(s.get());
+		auto const c = s.get();
+
+		// stop at end of input; the caller will see a short string.
+		if (! s)
+			break;
+		result.push_back(c);
 		}
 	return result;
 	}
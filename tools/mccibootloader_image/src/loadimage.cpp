@@ -0,0 +1,316 @@
+/*
+
+Module:	loadimage.cpp
+
+Function:
+	McciBootloader_Elf::LoadImage_t, the scatter/gather view of the
+	load image of an ELF file.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mccibootloader_loadimage.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace McciBootloader_Elf;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief SHA-512 works on blocks of this size
+constexpr std::size_t kHashBlock = 128;
+
+///
+/// \brief SHA-512 over data that arrives in pieces of any size
+///
+/// \details mcci_tweetnacl_hashblocks_sha512() only takes whole blocks,
+///	so we hold the partial block at the end of each piece until the
+///	next one arrives. Whole blocks are hashed in place.
+///
+class HashStream_t
+	{
+public:
+	HashStream_t(mcci_tweetnacl_sha512_t &hash)
+		: m_hash(hash)
+		{
+		mcci_tweetnacl_hashblocks_sha512_init(&this->m_hash);
+		}
+
+	void put(const std::uint8_t *p, std::size_t n)
+		{
+		this->m_nTotal += n;
+
+		if (this->m_nHeld != 0)
+			{
+			auto const nCopy = std::min(n, kHashBlock - this->m_nHeld);
+
+			std::memcpy(this->m_held + this->m_nHeld, p, nCopy);
+			this->m_nHeld += nCopy;
+			p += nCopy;
+			n -= nCopy;
+
+			if (this->m_nHeld < kHashBlock)
+				return;
+
+			mcci_tweetnacl_hashblocks_sha512(&this->m_hash, this->m_held, kHashBlock);
+			this->m_nHeld = 0;
+			}
+
+		auto const nLeft = mcci_tweetnacl_hashblocks_sha512(&this->m_hash, p, n);
+
+		std::memcpy(this->m_held, p + n - nLeft, nLeft);
+		this->m_nHeld = nLeft;
+		}
+
+	void putZero(std::size_t n)
+		{
+		static const std::uint8_t zero[4096] {};
+
+		while (n != 0)
+			{
+			auto const nThis = std::min(n, sizeof(zero));
+
+			this->put(zero, nThis);
+			n -= nThis;
+			}
+		}
+
+	void finish()
+		{
+		mcci_tweetnacl_hashblocks_sha512_finish(
+			&this->m_hash,
+			this->m_held,
+			this->m_nHeld,
+			this->m_nTotal
+			);
+		}
+
+private:
+	mcci_tweetnacl_sha512_t	&m_hash;
+	std::uint8_t		m_held[kHashBlock];
+	std::size_t		m_nHeld { 0 };
+	std::size_t		m_nTotal { 0 };
+	};
+
+/// \brief call \p fn for each piece of the first \p n bytes of the load
+///	image, in order: fn(imageOffset, nBytes, fFile, fileOffset). For
+///	fill, \c fFile is false and \c fileOffset is meaningless.
+template <typename Fn>
+void forEachPiece(
+	const std::vector<LoadImage_t::Segment_t> &segments,
+	std::size_t n,
+	Fn fn
+	)
+	{
+	std::size_t pos = 0;
+
+	for (auto const &seg : segments)
+		{
+		if (pos >= n)
+			break;
+
+		// the gap before the segment
+		if (seg.imageOffset > pos)
+			{
+			auto const nGap = std::min<std::size_t>(seg.imageOffset, n) - pos;
+
+			fn(pos, nGap, false, 0);
+			pos += nGap;
+			}
+
+		// the data from the file
+		auto const nFile = std::min<std::size_t>(seg.filesz, n - pos);
+
+		if (nFile != 0)
+			{
+			fn(pos, nFile, true, std::size_t(seg.fileOffset));
+			pos += nFile;
+			}
+
+		// the .bss tail
+		auto const nTail = std::min<std::size_t>(seg.memsz - seg.filesz, n - pos);
+
+		if (nTail != 0)
+			{
+			fn(pos, nTail, false, 0);
+			pos += nTail;
+			}
+		}
+	}
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+bool LoadImage_t::add(const Segment_t &segment)
+	{
+	if (segment.imageOffset < this->m_size ||
+	    segment.filesz > segment.memsz ||
+	    std::uint64_t(segment.imageOffset) + segment.memsz > UINT32_MAX)
+		return false;
+
+	this->m_segments.push_back(segment);
+	this->m_size = segment.imageOffset + segment.memsz;
+	return true;
+	}
+
+std::size_t LoadImage_t::fillSize() const
+	{
+	std::size_t nFile = 0;
+
+	for (auto const &seg : this->m_segments)
+		nFile += seg.filesz;
+
+	return this->m_size - nFile;
+	}
+
+std::uint8_t *LoadImage_t::find(
+	std::vector<std::uint8_t> &file,
+	std::size_t offset,
+	std::size_t n
+	) const
+	{
+	for (auto const &seg : this->m_segments)
+		{
+		if (offset < seg.imageOffset)
+			break;
+
+		if (offset - seg.imageOffset < seg.filesz)
+			{
+			if (n > seg.filesz - (offset - seg.imageOffset))
+				return nullptr;
+
+			return &file[seg.fileOffset + (offset - seg.imageOffset)];
+			}
+		}
+
+	return nullptr;
+	}
+
+/*
+
+Name:	McciBootloader_Elf::LoadImage_t::hash()
+
+Function:
+	Hash a prefix of the load image, without making it contiguous.
+
+Definition:
+	void McciBootloader_Elf::LoadImage_t::hash(
+		const std::vector<std::uint8_t> &file,
+		std::size_t n,
+		mcci_tweetnacl_sha512_t &hash
+		) const;
+
+Description:
+	The segment data is hashed where it lies in \p file, and the
+	fill is hashed from a block of zeros, so the result is the same
+	as mcci_tweetnacl_hash_sha512() of the flat image, but the image
+	is never copied. \p n must not be larger than size().
+
+Returns:
+	No explicit result.
+
+*/
+
+void LoadImage_t::hash(
+	const std::vector<std::uint8_t> &file,
+	std::size_t n,
+	mcci_tweetnacl_sha512_t &hash
+	) const
+	{
+	HashStream_t stream { hash };
+
+	forEachPiece(this->m_segments, n,
+		[&](std::size_t, std::size_t nBytes, bool fFile, std::size_t fileOffset)
+		{
+		if (fFile)
+			stream.put(&file[fileOffset], nBytes);
+		else
+			stream.putZero(nBytes);
+		});
+
+	stream.finish();
+	}
+
+void LoadImage_t::flatten(
+	const std::vector<std::uint8_t> &file,
+	std::vector<std::uint8_t> &image
+	) const
+	{
+	image.assign(this->m_size, 0);
+
+	forEachPiece(this->m_segments, this->m_size,
+		[&](std::size_t imageOffset, std::size_t nBytes, bool fFile, std::size_t fileOffset)
+		{
+		if (fFile)
+			std::memcpy(&image[imageOffset], &file[fileOffset], nBytes);
+		});
+	}
+
+bool LoadImage_t::store(
+	std::vector<std::uint8_t> &file,
+	const std::vector<std::uint8_t> &image
+	) const
+	{
+	if (image.size() != this->m_size)
+		return false;
+
+	// check everything before changing anything.
+	bool fOk = true;
+
+	forEachPiece(this->m_segments, this->m_size,
+		[&](std::size_t imageOffset, std::size_t nBytes, bool fFile, std::size_t)
+		{
+		if (! fFile)
+			{
+			auto const pBegin = &image[imageOffset];
+
+			if (std::any_of(pBegin, pBegin + nBytes, [](std::uint8_t b) { return b != 0; }))
+				fOk = false;
+			}
+		});
+
+	if (! fOk)
+		return false;
+
+	forEachPiece(this->m_segments, this->m_size,
+		[&](std::size_t imageOffset, std::size_t nBytes, bool fFile, std::size_t fileOffset)
+		{
+		if (fFile)
+			std::memcpy(&file[fileOffset], &image[imageOffset], nBytes);
+		});
+
+	return true;
+	}
+
+/**** end of loadimage.cpp ****/
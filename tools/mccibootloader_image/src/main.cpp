@@ -3,7 +3,7 @@
 Module:	main.c
 
 Function:
-	main() and main app logic for mccibootloader_image.
+	Main app logic for mccibootloader_image.
 
 Copyright and License:
 	This file copyright (C) 2021 by
@@ -20,9 +20,12 @@ Author:
 */
 
 #include "mccibootloader_image.h"
+#include "mccibootloader_fragment.h"
 #include "mccibootloader_image_version.h"
+#include "mccibootloader_signer.h"
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
 
 /****************************************************************************\
 |
@@ -53,16 +56,6 @@ static std::string versionToString(
 |
 \****************************************************************************/
 
-App_t gApp;
-
-int main(
-	int argc,
-	char **argv
-	)
-	{
-	return gApp.begin(argc, argv);
-	}
-
 int App_t::begin(int argc, char **argv)
 	{
 	// make sure the authsize is right.
@@ -71,39 +64,232 @@ int App_t::begin(int argc, char **argv)
 		sizeof(mcci_tweetnacl_sha512_t) +
 		mcci_tweetnacl_sign_signature_size();
 
-	this->scanArgs(argc, argv);
+	// we don't know whether we're timing until the args are scanned.
+	auto const tStart = McciBootloader_Trace::Stamp_t::now();
+
+	// usage() and fatal() end up here, rather than exiting.
+	try	{
+		this->scanArgs(argc, argv);
+
+		if (this->fStats || this->tracefilename != "")
+			{
+			this->pTrace = std::make_shared<McciBootloader_Trace::Recorder_t>(tStart);
+			this->pTrace->add(
+				"scanArgs",
+				McciBootloader_Trace::Kind_t::kPhase,
+				this->infilename,
+				tStart,
+				McciBootloader_Trace::Stamp_t::now()
+				);
+			}
+
+		auto const status = this->run();
+
+		this->writeTrace();
+		return status;
+		}
+	catch (Exit_t &e)
+		{
+		return e.status;
+		}
+	}
+
+/*
 
+Name:	App_t::run()
+
+Function:
+	Do the work the arguments ask for.
+
+Definition:
+	int App_t::run();
+
+Description:
+	Called by begin() once the arguments have been scanned. Each mode
+	returns from here, except the daemon, which never returns.
+
+Returns:
+	The exit status.
+
+*/
+
+int App_t::run()
+	{
 	// do the pre-tests
-	this->testNaCl();
+		{
+		auto const span = this->span("selfTest");
 
-	// read the image
-	this->readImage();
+		this->testNaCl();
+		}
+
+	// the daemon never returns.
+	if (this->fDaemon)
+		this->runSigner();
+
+	// verification is a separate, read-only pass over many files.
+	if (this->fVerify)
+		return this->verify();
+
+	// so is composing SPI flash images.
+	if (this->fCompose)
+		return this->compose();
+
+	// sending an image to the bootloader needs no signer, either.
+	if (this->sendportname != "")
+		return this->sendImage();
 
-	// start processing.
+	// load the key, or connect to the signer that has it.
 	if (this->fHash)
 		{
-		this->keyfile.begin(this->keyfilename);
+		auto const span = this->span("setupSigner");
 
-		if (! this->keyfile.read())
-			this->fatal(string("can't read key file: ") + this->keyfilename);
+		this->setupSigner();
+		}
 
-		if (this->fVerbose)
-			std::cout << "Keyfile comment: " << this->keyfile.m_comment << "\n\n";
+	// a slot directory is signed, but it isn't an image.
+	if (this->fSlotDirectory)
+		return this->writeSlotDirectory();
+
+	// in batch mode, we sign many images with one request to the signer.
+	if (this->fBatch)
+		return this->signBatch();
+
+	// in watch mode, we sign the input each time it changes.
+	if (this->fWatch)
+		return this->watch();
+
+	auto const span = this->span("file", McciBootloader_Trace::Kind_t::kFile);
+
+	this->readImage();
+	this->processImage();
+	return EXIT_SUCCESS;
+	}
+
+/*
+
+Name:	App_t::writeTrace()
+
+Function:
+	Write the phase timings, if asked.
+
+Definition:
+	void App_t::writeTrace();
+
+Description:
+	With --stats, the summary is written to stdout. With --trace-file,
+	the spans are written to the file as Chrome trace-event JSON.
+
+Returns:
+	No explicit result. Failure to write the trace file is fatal.
+
+*/
+
+void App_t::writeTrace()
+	{
+	if (! this->pTrace)
+		return;
+
+	if (this->fStats)
+		{
+		this->pTrace->writeSummary(std::cout);
+		std::cout << std::flush;
+		}
+
+	if (this->tracefilename != "")
+		{
+		std::ofstream outfile { this->tracefilename, ios::trunc };
+
+		if (! outfile.is_open())
+			this->fatal("can't create: " + this->tracefilename);
+
+		this->pTrace->writeChromeTrace(outfile);
+		outfile.close();
+		if (! outfile)
+			this->fatal("can't write: " + this->tracefilename);
+
+		this->verbose("trace written: " + this->tracefilename);
 		}
+	}
 
-	if (this->fHash || this->fSign)
-		this->addHeader();
+/*
 
-	if (this->fHash || this->fSign)
-		this->addHash();
+Name:	App_t::processImage()
 
-	if (this->fSign)
-		this->addSignature();
+Function:
+	Hash and sign the input, and write the outputs.
+
+Definition:
+	void App_t::processImage();
+
+Description:
+	This is the main work of the tool, once the arguments have been
+	scanned, the key loaded, and the input read (by readImage(), or
+	by watch()).
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::processImage()
+	{
+	// if the cache has the result, use it.
+	if ((this->fHash || this->fSign) && this->cacheLookup())
+		{
+		// nothing else to do.
+		}
+	else
+		{
+		if (this->fHash || this->fSign)
+			this->addHeader();
+
+		if (this->fHash || this->fSign)
+			this->addHash();
+
+		if (this->fSign)
+			this->addSignature();
+
+		if (this->fHash || this->fSign)
+			this->cacheStore();
+		}
+
+	// write the delta package, if asked.
+	if (this->deltabasename != "")
+		{
+		auto const span = this->span("delta");
+
+		this->writeDeltaPackage();
+		}
+
+	// write the compressed package, if asked.
+	if (this->compressedoutputname != "")
+		{
+		auto const span = this->span("compress");
+
+		this->writeCompressedPackage();
+		}
+
+	// write the storage image with block hashes, if asked.
+	if (this->blockhashoutputname != "")
+		{
+		auto const span = this->span("blockHash");
+
+		this->writeBlockHashImage();
+		}
+
+	// write the fragments for multicast delivery, if asked.
+	if (this->fuotaoutputname != "")
+		{
+		auto const span = this->span("fuota");
+
+		this->writeFuotaFragments();
+		}
 
 	// write image
 	this->writeImage();
 
-	return EXIT_SUCCESS;
+	// tell make or ninja what we depend on.
+	this->writeDepfile();
 	}
 
 void App_t::verbose(const string &message)
@@ -122,6 +308,12 @@ void App_t::scanArgs(int argc, char **argv)
 	bool fOptOk = true;
 	this->fAddTime = true;
 	this->pComment = NULL;
+	this->watchDelayMs = 100;
+	this->sendBaud = 921600;
+	this->sendTimeoutMs = 30000;
+	this->log2BlockSize = McciBootloader_BlockHashHeader_Wire_t::kLog2BlockSize;
+	this->fragmentSize = 48;
+	this->fuotaRedundancy = 50;
 
 	for (;;)
 		{
@@ -191,12 +383,249 @@ void App_t::scanArgs(int argc, char **argv)
 			{
 			this->fForceBinary = fBool;
 			}
+		else if (boolArg == "--verify")
+			{
+			this->fVerify = fBool;
+			}
+		else if (boolArg == "--compose")
+			{
+			this->fCompose = fBool;
+			}
+		else if (boolArg == "--slot-directory")
+			{
+			this->fSlotDirectory = fBool;
+			}
+		else if (arg == "--public-key")
+			{
+			if (*argv == nullptr)
+				this->usage("missing public key file name");
+
+			this->publickeyfilename = *argv++;
+			}
+		else if (arg == "-j" || arg == "--jobs")
+			{
+			if (*argv == nullptr)
+				this->usage("missing job count");
+
+			char *pEnd;
+			auto const nJobs = std::strtoul(*argv, &pEnd, 10);
+			if (*pEnd != '\0' || nJobs == 0 || nJobs > 1024)
+				this->usage(string("illegal job count: ") + *argv);
+
+			this->nJobs = unsigned(nJobs);
+			++argv;
+			}
 		else if (arg == "-k" || arg == "--keyfile")
 			{
 			if (*argv == nullptr)
 				this->usage("missing keyfile name");
 
 			this->keyfilename = *argv++;
+			this->keyfilenames.push_back(this->keyfilename);
+			}
+		else if (boolArg == "--daemon")
+			{
+			this->fDaemon = fBool;
+			}
+		else if (boolArg == "--stdio")
+			{
+			this->fStdio = fBool;
+			}
+		else if (boolArg == "--batch")
+			{
+			this->fBatch = fBool;
+			}
+		else if (arg == "--signer-command")
+			{
+			if (*argv == nullptr)
+				this->usage("missing signer command");
+
+			this->signercommand = *argv++;
+			}
+		else if (boolArg == "--watch")
+			{
+			this->fWatch = fBool;
+			}
+		else if (boolArg == "--stats")
+			{
+			this->fStats = fBool;
+			}
+		else if (arg == "--trace-file")
+			{
+			if (*argv == nullptr)
+				this->usage("missing trace file name");
+
+			this->tracefilename = *argv++;
+			}
+		else if (arg == "--watch-delay")
+			{
+			if (*argv == nullptr)
+				this->usage("missing watch delay");
+
+			char *pEnd;
+			auto const delay = std::strtoul(*argv, &pEnd, 10);
+			if (*pEnd != '\0' || pEnd == *argv || delay > 60000)
+				this->usage("invalid watch delay (must be 0 to 60000 ms): " + string(*argv));
+
+			this->watchDelayMs = unsigned(delay);
+			++argv;
+			}
+		else if (arg == "--send")
+			{
+			if (*argv == nullptr)
+				this->usage("missing serial port name");
+
+			this->sendportname = *argv++;
+			}
+		else if (arg == "--baud" || arg == "--send-window" || arg == "--send-break" ||
+			 arg == "--send-timeout" || arg == "--send-corrupt")
+			{
+			if (*argv == nullptr)
+				this->usage("missing value for " + arg);
+
+			static const struct
+				{
+				const char *pName;
+				unsigned App_t::*pValue;
+				unsigned long minValue;
+				unsigned long maxValue;
+				} kSendArgs[] =
+				{
+				{ "--baud", &App_t::sendBaud, 1200, 4000000 },
+				{ "--send-window", &App_t::sendWindow, 1, 1024 },
+				{ "--send-break", &App_t::sendBreakMs, 0, 60000 },
+				{ "--send-timeout", &App_t::sendTimeoutMs, 100, 600000 },
+				{ "--send-corrupt", &App_t::sendCorruptEvery, 0, 1000000 },
+				};
+
+			char *pEnd;
+			auto const value = std::strtoul(*argv, &pEnd, 10);
+
+			for (auto const &a : kSendArgs)
+				{
+				if (arg != a.pName)
+					continue;
+
+				if (*pEnd != '\0' || pEnd == *argv || value < a.minValue || value > a.maxValue)
+					this->usage("invalid " + arg + " (must be " + std::to_string(a.minValue) + " to " + std::to_string(a.maxValue) + "): " + string(*argv));
+
+				this->*a.pValue = unsigned(value);
+				}
+			++argv;
+			}
+		else if (arg == "--cache-dir")
+			{
+			if (*argv == nullptr)
+				this->usage("missing cache directory name");
+
+			this->cachedirname = *argv++;
+			}
+		else if (arg == "--depfile")
+			{
+			if (*argv == nullptr)
+				this->usage("missing depfile name");
+
+			this->depfilename = *argv++;
+			}
+		else if (arg == "--delta-base")
+			{
+			if (*argv == nullptr)
+				this->usage("missing delta base file name");
+
+			this->deltabasename = *argv++;
+			}
+		else if (arg == "--delta-output")
+			{
+			if (*argv == nullptr)
+				this->usage("missing delta output file name");
+
+			this->deltaoutputname = *argv++;
+			}
+		else if (arg == "--compressed-output")
+			{
+			if (*argv == nullptr)
+				this->usage("missing compressed output file name");
+
+			this->compressedoutputname = *argv++;
+			}
+		else if (arg == "--block-hash-output")
+			{
+			if (*argv == nullptr)
+				this->usage("missing block hash output file name");
+
+			this->blockhashoutputname = *argv++;
+			}
+		else if (arg == "--block-size")
+			{
+			if (*argv == nullptr)
+				this->usage("missing block size");
+
+			// the bootloader's MCCI_BOOTLOADER_IMAGE_BLOCK_SIZE: a power of two, 128 to 64k.
+			char *pEnd;
+			auto const value = std::strtoul(*argv, &pEnd, 10);
+			if (*pEnd != '\0' || pEnd == *argv ||
+			    value < 128 || value > 65536 || (value & (value - 1)) != 0)
+				this->usage("invalid --block-size (must be a power of two, 128 to 65536): " + string(*argv));
+
+			this->log2BlockSize = 0;
+			while ((1ul << this->log2BlockSize) < value)
+				++this->log2BlockSize;
+			++argv;
+			}
+		else if (arg == "--fuota-output")
+			{
+			if (*argv == nullptr)
+				this->usage("missing fuota output file name");
+
+			this->fuotaoutputname = *argv++;
+			}
+		else if (arg == "--fragment-size" || arg == "--fuota-redundancy")
+			{
+			if (*argv == nullptr)
+				this->usage("missing value for " + arg);
+
+			char *pEnd;
+			auto const value = std::strtoul(*argv, &pEnd, 10);
+			bool const fSize = arg == "--fragment-size";
+			unsigned long const maxValue = fSize ? McciBootloader_Fragment::kMaxFragmentSize : 1000;
+
+			if (*pEnd != '\0' || pEnd == *argv || value > maxValue || (fSize && value == 0))
+				this->usage("invalid " + arg + " (must be " + (fSize ? "1" : "0") + " to " + std::to_string(maxValue) + "): " + string(*argv));
+
+			if (fSize)
+				this->fragmentSize = unsigned(value);
+			else
+				this->fuotaRedundancy = unsigned(value);
+			++argv;
+			}
+		else if (arg == "--output-bin" || arg == "--output-elf" ||
+			 arg == "--output-hex" || arg == "--output-srec" ||
+			 arg == "--output-slot")
+			{
+			static const std::pair<string, Artifact_t::Kind_t> kKinds[] =
+				{
+				{ "--output-bin", Artifact_t::Kind_t::kBinary },
+				{ "--output-elf", Artifact_t::Kind_t::kElf },
+				{ "--output-hex", Artifact_t::Kind_t::kHex },
+				{ "--output-srec", Artifact_t::Kind_t::kSrec },
+				{ "--output-slot", Artifact_t::Kind_t::kSlot },
+				};
+
+			if (*argv == nullptr)
+				this->usage("missing " + arg.substr(2) + " file name");
+
+			for (auto const &k : kKinds)
+				{
+				if (k.first == arg)
+					this->vArtifacts.push_back({ k.second, *argv++ });
+				}
+			}
+		else if (arg == "--socket")
+			{
+			if (*argv == nullptr)
+				this->usage("missing socket name");
+
+			this->socketname = *argv++;
 			}
 		else if (arg == "-c" || arg == "--comment")
 			{
@@ -209,7 +638,7 @@ void App_t::scanArgs(int argc, char **argv)
 			if (*argv == nullptr)
 				this->usage("missing app-version value");
 
-			this->setAppVersion(string(*argv));
+			this->setAppVersion(string(*argv++));
 			}
 		else if (arg == "--version")
 			{
@@ -224,7 +653,7 @@ void App_t::scanArgs(int argc, char **argv)
 				std::cout << "." << kLocal;
 			std::cout << "\n";
 			std::cout << kCopyright << "\n";
-			exit(EXIT_SUCCESS);
+			throw Exit_t { EXIT_SUCCESS };
 			}
 		else if (arg.substr(0, 1) == "-")
 			{
@@ -236,11 +665,91 @@ void App_t::scanArgs(int argc, char **argv)
 			}
 		}
 
+	if (this->socketname != "" && this->signercommand != "")
+		this->usage("--socket and --signer-command can't be used together");
+
+	// the daemon and --watch don't finish, so there'd be nothing to show.
+	if ((this->fStats || this->tracefilename != "") && (this->fDaemon || this->fWatch))
+		this->usage("--stats and --trace-file can't be used with --daemon or --watch");
+
+	/* the daemon takes no positional args */
+	if (this->fDaemon)
+		{
+		if ((this->socketname == "") == ! this->fStdio)
+			this->usage("--daemon needs one of --socket or --stdio");
+		if (posArgs.size() != 0)
+			this->usage("extra arguments");
+		return;
+		}
+
+	if (this->fStdio)
+		this->usage("--stdio needs --daemon");
+
 	/* check the positional args */
 	if (posArgs.size() == 0)
 		{
 		this->usage("missing input filename");
 		}
+
+	/* in verify mode, every positional arg names something to check */
+	if (this->fVerify)
+		{
+		if (this->fUpdate || this->fPatch)
+			this->usage("--verify can't be combined with --hash, --sign or --patch");
+
+		this->verifyArgs = std::move(posArgs);
+		return;
+		}
+
+	/* in compose mode, every positional arg names a manifest */
+	if (this->fCompose)
+		{
+		if (this->fUpdate || this->fPatch)
+			this->usage("--compose can't be combined with --hash, --sign or --patch");
+
+		this->composeArgs = std::move(posArgs);
+		return;
+		}
+
+	/* sending names one signed image */
+	if (this->sendportname != "")
+		{
+		if (this->fUpdate || this->fPatch)
+			this->usage("--send can't be combined with --hash, --sign or --patch");
+		if (posArgs.size() != 1)
+			this->usage("--send needs exactly one image file");
+
+		this->infilename = posArgs[0];
+		return;
+		}
+
+	/* a slot directory names its output, then the slots */
+	if (this->fSlotDirectory)
+		{
+		if (! this->fSign || this->fPatch)
+			this->usage("--slot-directory needs --sign, and can't be combined with --patch");
+		if (posArgs.size() < 2)
+			this->usage("--slot-directory needs an output file and at least one slot");
+
+		this->slotDirectoryArgs = std::move(posArgs);
+		return;
+		}
+
+	/* in batch mode, the positional args name inputs and outputs */
+	if (this->fBatch)
+		{
+		if (! this->fHash || this->fPatch)
+			this->usage("--batch needs --hash or --sign, and can't be combined with --patch");
+
+		if (this->fWatch || this->deltabasename != "" || this->compressedoutputname != "" ||
+		    this->blockhashoutputname != "" || this->fuotaoutputname != "" ||
+		    this->vArtifacts.size() != 0 || this->cachedirname != "" || this->depfilename != "")
+			this->usage("--batch only writes the signed images");
+
+		this->batchArgs = std::move(posArgs);
+		return;
+		}
+
 	this->infilename = posArgs[0];
 
 	if (posArgs.size() == 1)
@@ -259,6 +768,25 @@ void App_t::scanArgs(int argc, char **argv)
 		this->usage("extra arguments");
 		}
 
+	if ((this->deltabasename == "") != (this->deltaoutputname == ""))
+		this->usage("--delta-base and --delta-output must be used together");
+
+	if (this->deltabasename != "" && ! this->fSign)
+		this->usage("--delta-base needs --sign");
+
+	if (this->compressedoutputname != "" && ! this->fSign)
+		this->usage("--compressed-output needs --sign");
+
+	if (this->blockhashoutputname != "" && ! this->fSign)
+		this->usage("--block-hash-output needs --sign");
+
+	if (this->fuotaoutputname != "" && ! this->fSign)
+		this->usage("--fuota-output needs --sign");
+
+	// in watch mode, writing the input would wake us up again.
+	if (this->fWatch && (this->outfilename == "" || this->outfilename == this->infilename))
+		this->usage("--watch needs an output file other than the input");
+
 	if (this->fVerbose)
 		{
 		std::cout << std::boolalpha;
@@ -272,6 +800,17 @@ void App_t::scanArgs(int argc, char **argv)
 			  << "--force-binary: " << this->fForceBinary << "\n"
 			  << "       --patch: " << this->fPatch << "\n"
 		          << "     --keyfile: " << this->keyfilename << "\n"
+		          << "      --socket: " << (this->socketname == "" ? "<<none>>" : this->socketname) << "\n"
+		          << "--signer-command: " << (this->signercommand == "" ? "<<none>>" : this->signercommand) << "\n"
+		          << "   --cache-dir: " << (this->cachedirname == "" ? "<<none>>" : this->cachedirname) << "\n"
+		          << "     --depfile: " << (this->depfilename == "" ? "<<none>>" : this->depfilename) << "\n"
+		          << "       --watch: " << this->fWatch << "\n"
+		          << "  --delta-base: " << (this->deltabasename == "" ? "<<none>>" : this->deltabasename) << "\n"
+		          << "--delta-output: " << (this->deltaoutputname == "" ? "<<none>>" : this->deltaoutputname) << "\n"
+		          << "--compressed-output: " << (this->compressedoutputname == "" ? "<<none>>" : this->compressedoutputname) << "\n"
+		          << "--block-hash-output: " << (this->blockhashoutputname == "" ? "<<none>>" : this->blockhashoutputname) << "\n"
+		          << "  --block-size: " << (1u << this->log2BlockSize) << "\n"
+		          << "--fuota-output: " << (this->fuotaoutputname == "" ? "<<none>>" : this->fuotaoutputname) << "\n"
 			  << "     --comment: " << (pComment == NULL ? "<<none>>": pComment) << "\n"
 			  << " --app-version: " << (!this->fAppVersion ? "<<none>>": versionToString(this->appVersion)) << "\n"
 			  << "\n"
@@ -279,6 +818,8 @@ void App_t::scanArgs(int argc, char **argv)
 		          << "output:         "
 		          << (!this->fUpdate ? "none" : !this->fPatch ? this->outfilename : "{update}")
 			  << "\n";
+		for (auto const &artifact : this->vArtifacts)
+			std::cout << "also output:    " << artifact.filename << "\n";
 		std::cout << "\n";
 		std::cout << std::flush;
 		}
@@ -294,9 +835,27 @@ void App_t::usage(const string &message)
 		}
 	usage.append("usage: ");
 	usage.append(this->progname);
-	usage.append(" -[vsh k{keyfile} c{comment} -V{app-version}] --[version sign hash app-version {version} comment {comment} dry-run add-time force-binary verbose debug] infile [outfile]\n");
+	usage.append(" -[vsh k{keyfile} c{comment} -V{app-version}] --[version sign hash app-version {version} comment {comment} dry-run add-time force-binary verbose debug cache-dir {dir} depfile {file} delta-base {file} delta-output {file} compressed-output {file} block-hash-output {file} block-size {bytes} fuota-output {file} fragment-size {bytes} fuota-redundancy {percent} output-bin {file} output-elf {file} output-hex {file} output-srec {file} output-slot {file} socket {path} signer-command {command} public-key {pubfile} watch watch-delay {ms} stats trace-file {file}] infile [outfile]\n");
+	usage.append("   or: ");
+	usage.append(this->progname);
+	usage.append(" --batch -[vsh j{jobs} k{keyfile} c{comment} -V{app-version}] --[socket {path} signer-command {command} public-key {pubfile} jobs {n} add-time force-binary dry-run stats trace-file {file}] {infile outfile|@listfile}...\n");
+	usage.append("   or: ");
+	usage.append(this->progname);
+	usage.append(" --verify -[v j{jobs} k{keyfile}] --[public-key {pubfile} jobs {n} force-binary stats trace-file {file}] {file|dir|@listfile}...\n");
+	usage.append("   or: ");
+	usage.append(this->progname);
+	usage.append(" --compose -[v j{jobs} k{keyfile}] --[public-key {pubfile} jobs {n} force-binary dry-run stats trace-file {file}] {manifest}...\n");
+	usage.append("   or: ");
+	usage.append(this->progname);
+	usage.append(" --send {port} -[v k{keyfile}] --[public-key {pubfile} force-binary baud {rate} send-window {n} send-break {ms} send-timeout {ms} send-corrupt {n}] {infile}\n");
+	usage.append("   or: ");
+	usage.append(this->progname);
+	usage.append(" --slot-directory -s -[v k{keyfile}] --[socket {path} signer-command {command} public-key {pubfile} force-binary dry-run] {outfile} {address=slotfile}...\n");
+	usage.append("   or: ");
+	usage.append(this->progname);
+	usage.append(" --daemon {--socket {path}|--stdio} -[v j{jobs}] -k{keyfile}...\n");
 	fprintf(stderr, "%s\n", usage.c_str());
-	exit(EXIT_FAILURE);
+	throw Exit_t { EXIT_FAILURE };
 	}
 
 static std::string versionToString(McciVersion::Version_t version)
@@ -428,7 +987,10 @@ bool App_t::probeHeader(
 	)
 	{
 	// set pFileAppInfo to a pointer to the appinfo in the memory-mapped image of the file.
-	auto const pFileAppInfo = &this->fileimage.at(appInfoOffset);
+	auto const pFileAppInfo = this->imagePointer(appInfoOffset, sizeof(fileAppInfo));
+
+	if (pFileAppInfo == nullptr)
+		return false;
 
 	// copy the data to a convenient place so we can work on it.
 	memcpy(&fileAppInfo, pFileAppInfo, sizeof(fileAppInfo));
@@ -453,13 +1015,17 @@ bool App_t::probeHeader(
 
 const McciBootloader_AppInfoOffset_t vAppInfoOffsets[] =
 	{
-	{ "cm0+", 	offsetof(McciBootloader_CortexM0_PageZero_Wire_t, PageZero.AppInfo) },
-	{ "cm7(240)",	offsetof(McciBootloader_CortexM7Compact_PageZero_Wire_t, PageZero.AppInfo) },
-	{ "cm7",	offsetof(McciBootloader_CortexM7_PageZero_Wire_t, PageZero.AppInfo) },
+	{ "cm0+", 	offsetof(McciBootloader_CortexM0_PageZero_Wire_t, PageZero.AppInfo),
+			sizeof(McciBootloader_CortexM0_PageZero_Wire_t) },
+	{ "cm7(240)",	offsetof(McciBootloader_CortexM7Compact_PageZero_Wire_t, PageZero.AppInfo),
+			sizeof(McciBootloader_CortexM7Compact_PageZero_Wire_t) },
+	{ "cm7",	offsetof(McciBootloader_CortexM7_PageZero_Wire_t, PageZero.AppInfo),
+			sizeof(McciBootloader_CortexM7_PageZero_Wire_t) },
 	};
 
 void App_t::addHeader()
 	{
+	auto const span = this->span("header");
 	McciBootloader_AppInfo_Wire_t fileAppInfo;
 	const McciBootloader_AppInfoOffset_t * pEntry;
 	uint8_t *pFileAppInfo;
@@ -515,10 +1081,10 @@ void App_t::addHeader()
 
 		if (this->isUsingElf())
 			{
-			if (appInfo.imagesize.get() + appInfo.authsize.get() > this->fileimage.size())
+			if (appInfo.imagesize.get() + appInfo.authsize.get() > this->imageSize())
 				{
 				std::ostringstream msg;
-				msg << "ELF imagesize (0x" << std::hex << this->fileimage.size()
+				msg << "ELF imagesize (0x" << std::hex << this->imageSize()
 				    << ") smaller than appinfo imagesize + authinfo (0x"
 				    << std::hex << appInfo.imagesize.get() + appInfo.authsize.get()
 				    << ")";
@@ -534,6 +1100,13 @@ void App_t::addHeader()
 			{
 			this->fSize = appInfo.imagesize.get();
 			}
+
+		// the linker reserves room for the signature block.
+		if (uint64_t(appInfo.imagesize.get()) + this->authSize > this->imageSize())
+			this->fatal("image has no room for the signature block");
+
+		// for ELF input, we patch the signature block in place.
+		this->imageBytes(appInfo.imagesize.get(), this->authSize, "signature block");
 		}
 	// looks fishy: refuse to operate on the file
 	else
@@ -555,7 +1128,7 @@ void App_t::addHeader()
 	// add posix time
 	if (this->fAddTime)
 		{
-		uint32_t now = (uint32_t) time(nullptr);
+		uint64_t now = this->posixTimestamp != 0 ? this->posixTimestamp : uint32_t(time(nullptr));
 		if (this->fVerbose)
 			std::cout << "Posix time: " << now << "\n";
 		appInfo.posixTimestamp.put(now);
@@ -607,37 +1180,40 @@ void App_t::dump(
 void
 App_t::addHash()
 	{
+	auto const span = this->span("hash");
+	auto const imagesize = this->pFileAppInfo->imagesize.get();
+	auto const pSigBlock = this->imageBytes(imagesize, this->authSize, "signature block");
+
 	if (this->fVerbose)
 		{
-		this->dump("App page 0", &this->fileimage[0], &this->fileimage[256]);
+		auto const pPageZero = this->imagePointer(0, 256);
+
+		if (pPageZero != nullptr)
+			this->dump("App page 0", pPageZero, pPageZero + 256);
 		}
 
 	/* put the public key */
 	memcpy(
-		&this->fileimage[0] + this->pFileAppInfo->imagesize.get(),
+		pSigBlock,
 		this->keyfile.m_public.bytes,
 		sizeof(this->keyfile.m_public.bytes)
 		);
 
 	if (this->fVerbose)
 		{
-		auto pKey = &this->fileimage[this->pFileAppInfo->imagesize.get()];
-
 		this->dump(
-			"Public key", pKey, pKey + sizeof(this->keyfile.m_public.bytes)
+			"Public key", pSigBlock, pSigBlock + sizeof(this->keyfile.m_public.bytes)
 			);
 		}
-	size_t const hashpos = this->pFileAppInfo->imagesize.get() + sizeof(this->keyfile.m_public.bytes);
+	size_t const hashpos = imagesize + sizeof(this->keyfile.m_public.bytes);
+	auto const pHash = pSigBlock + sizeof(this->keyfile.m_public.bytes);
 
-	mcci_tweetnacl_hash_sha512(
-		&this->fileHash,
-		&this->fileimage[0],
-		hashpos
-		);
+	// for ELF input, this hashes the sections where they are.
+	this->hashImage(this->fileHash, hashpos);
 
 	/* place the hash in the image */
 	memcpy(
-		&this->fileimage[hashpos],
+		pHash,
 		&this->fileHash.bytes[0],
 		sizeof(this->fileHash.bytes)
 		);
@@ -652,8 +1228,8 @@ App_t::addHash()
 		    ;
 		this->dump(
 			msg.str(),
-			&this->fileimage.at(hashpos),
-			&this->fileimage.at(hashpos + sizeof(this->fileHash.bytes))
+			pHash,
+			pHash + sizeof(this->fileHash.bytes)
 			);
 		}
 	}
@@ -661,33 +1237,41 @@ App_t::addHash()
 void
 App_t::addSignature()
 	{
-	// here's our buffer:
-	uint8_t buffer[sizeof(this->fileHash.bytes) + mcci_tweetnacl_sign_signature_size()];
-	size_t sizeOut;
-
-	mcci_tweetnacl_sign(
-		buffer,
-		&sizeOut,
-		this->fileHash.bytes,
-		sizeof(this->fileHash.bytes),
-		&this->keyfile.m_private
-		);
+	mcci_tweetnacl_sign_signature_t signature;
+	auto const span = this->span("sign");
+
+	try	{
+		this->signer().signHashes(&this->fileHash, 1, &signature);
+		}
+	catch (std::exception &e)
+		{
+		this->fatal(e.what());
+		}
+
+	this->putSignature(signature);
+	}
 
+/// \brief place \p signature (of this->fileHash) in the signature block.
+void
+App_t::putSignature(
+	const mcci_tweetnacl_sign_signature_t &signature
+	)
+	{
 	// write the signature to the file
 	const auto signaturepos = this->pFileAppInfo->imagesize.get() + offsetof(McciBootloader_SignatureBlock_Wire_t, signature);
 
 	memcpy(
-		&this->fileimage[signaturepos],
-		buffer,
-		mcci_tweetnacl_sign_signature_size()
+		this->imageBytes(signaturepos, sizeof(signature.bytes), "signature block"),
+		signature.bytes,
+		sizeof(signature.bytes)
 		);
 
 	if (this->fVerbose)
 		{
 		this->dump(
 			"signature",
-			buffer,
-			buffer + mcci_tweetnacl_sign_signature_size()
+			signature.bytes,
+			signature.bytes + sizeof(signature.bytes)
 			);
 		}
 	}
@@ -695,8 +1279,12 @@ App_t::addSignature()
 [[noreturn]]
 void App_t::fatal(const string &message)
 	{
+	// --verify workers collect errors rather than exiting.
+	if (this->fCaptureErrors)
+		throw std::runtime_error(message);
+
 	fprintf(stderr, "?%s: %s\n", this->progname.c_str(), message.c_str());
-	exit(EXIT_FAILURE);
+	throw Exit_t { EXIT_FAILURE };
 	}
 
 /**** end of main.c ****/
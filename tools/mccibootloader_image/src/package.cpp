@@ -0,0 +1,240 @@
+/*
+
+Module:	package.cpp
+
+Function:
+	Common code for writing update packages and storage images.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_signer.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::findPackageAppInfo()
+
+Function:
+	Find the AppInfo in an image that's to be used in a package.
+
+Definition:
+	McciBootloader_AppInfo_Wire_t App_t::findPackageAppInfo(
+		App_t &app,
+		const string &name
+		);
+
+Description:
+	app.fileimage is searched for an AppInfo at the usual offsets.
+	The image must be complete: it must have a signature block of
+	the size we use. \p name is used in error messages. The callers
+	package the flat image, so for ELF input it's made here.
+
+Returns:
+	A copy of the AppInfo. If none is found, this is fatal.
+
+*/
+
+McciBootloader_AppInfo_Wire_t
+App_t::findPackageAppInfo(
+	App_t &app,
+	const string &name
+	)
+	{
+	McciBootloader_AppInfo_Wire_t appInfo;
+	uint8_t *pAppInfo;
+
+	app.flattenImage();
+
+	for (auto const &Entry : vAppInfoOffsets)
+		{
+		if (app.fileimage.size() >= Entry.appInfoOffset + sizeof(appInfo) &&
+		    app.probeHeader(Entry.appInfoOffset, appInfo, pAppInfo))
+			{
+			uint64_t const size = uint64_t(appInfo.imagesize.get()) + appInfo.authsize.get();
+
+			if (appInfo.authsize.get() != this->authSize || size > app.fileimage.size())
+				this->fatal(name + ": AppInfo sizes are not valid");
+
+			return appInfo;
+			}
+		}
+
+	this->fatal(name + ": could not find valid AppInfo structure");
+	}
+
+/*
+
+Name:	App_t::makePackage()
+
+Function:
+	Assemble and sign an update package.
+
+Definition:
+	std::vector<uint8_t> App_t::makePackage(
+		McciBootloader_PackageHeader_Wire_t &header,
+		const std::vector<uint8_t> &payload
+		);
+
+Description:
+	The payload size is filled in, and the header and payload are
+	signed with the same key as the image (or by the signing daemon,
+	if --socket was given).
+
+Returns:
+	The package: header, payload and signature block.
+
+*/
+
+std::vector<uint8_t>
+App_t::makePackage(
+	McciBootloader_PackageHeader_Wire_t &header,
+	const std::vector<uint8_t> &payload
+	)
+	{
+	std::vector<uint8_t> package;
+	auto const pHeader = (const uint8_t *)&header;
+
+	header.payloadSize.put(uint32_t(payload.size()));
+
+	package.insert(package.end(), pHeader, pHeader + sizeof(header));
+	package.insert(package.end(), payload.begin(), payload.end());
+
+	this->appendSignature(package);
+	return package;
+	}
+
+/*
+
+Name:	App_t::appendSignature()
+
+Function:
+	Sign a package or table.
+
+Definition:
+	void App_t::appendSignature(
+		std::vector<uint8_t> &data
+		);
+
+Description:
+	A signature block is appended to \p data. As for an image,
+	the hash in the signature block covers everything before it and
+	the public key. The signature is made by the same signer as that
+	of the image.
+
+Returns:
+	No explicit result.
+
+*/
+
+void
+App_t::appendSignature(
+	std::vector<uint8_t> &data
+	)
+	{
+	size_t const nSigned = data.size();
+
+	data.resize(nSigned + sizeof(McciBootloader_SignatureBlock_Wire_t));
+
+	auto const pSigBlock = &data[nSigned];
+	mcci_tweetnacl_sha512_t packageHash;
+	mcci_tweetnacl_sign_signature_t signature;
+
+	memcpy(pSigBlock, this->keyfile.m_public.bytes, sizeof(this->keyfile.m_public.bytes));
+	mcci_tweetnacl_hash_sha512(&packageHash, &data[0], nSigned + sizeof(this->keyfile.m_public.bytes));
+	memcpy(pSigBlock + offsetof(McciBootloader_SignatureBlock_Wire_t, hash), packageHash.bytes, sizeof(packageHash.bytes));
+
+	try	{
+		this->signer().signHashes(&packageHash, 1, &signature);
+		}
+	catch (std::exception &e)
+		{
+		this->fatal(e.what());
+		}
+
+	memcpy(
+		pSigBlock + offsetof(McciBootloader_SignatureBlock_Wire_t, signature),
+		signature.bytes,
+		sizeof(signature.bytes)
+		);
+	}
+
+/*
+
+Name:	App_t::writePackage()
+
+Function:
+	Write an update package or storage image to a file.
+
+Definition:
+	void App_t::writePackage(
+		const std::vector<uint8_t> &package,
+		const string &filename
+		);
+
+Description:
+	\p package is written to \p filename, unless this is a dry run.
+
+Returns:
+	No explicit result. Errors are fatal.
+
+*/
+
+void
+App_t::writePackage(
+	const std::vector<uint8_t> &package,
+	const string &filename
+	)
+	{
+	if (this->fDryRun)
+		{
+		this->verbose("dry run, skipping package write: " + filename);
+		return;
+		}
+
+	std::ofstream outfile { filename, ios::binary | ios::trunc };
+	if (! outfile.is_open())
+		this->fatal("can't create: " + filename);
+
+	outfile.write((const char *)package.data(), package.size());
+	outfile.close();
+	if (! outfile)
+		this->fatal("can't write: " + filename);
+
+	this->verbose("package successfully written: " + filename);
+	}
+
+/**** end of package.cpp ****/
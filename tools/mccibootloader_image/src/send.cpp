@@ -0,0 +1,566 @@
+/*
+
+Module:	send.cpp
+
+Function:
+	App_t::sendImage(): send a signed image to the bootloader over a
+	serial port (--send).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mccibootloader_image.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+using Header_t = McciBootloader_SerialFrameHeader_Wire_t;
+using Clock_t = std::chrono::steady_clock;
+
+/// \brief how often to send Hello until the bootloader answers
+constexpr int kHelloMs = 250;
+
+/// \brief how long to wait for an Ack before sending again from the last one
+constexpr int kAckMs = 1000;
+
+/// \brief a serial port, set up raw, with the frames received from it;
+///	errors throw std::runtime_error.
+class SendPort_t
+	{
+public:
+	SendPort_t() {}
+	~SendPort_t()
+		{
+		if (this->m_fd >= 0)
+			close(this->m_fd);
+		}
+
+	void open(const std::string &name, unsigned baud);
+	bool sendBreak(unsigned ms);
+	void sendFrame(std::uint8_t type, std::uint32_t offset, const std::uint8_t *pPayload, size_t nPayload, bool fCorrupt = false);
+	bool receiveFrame(Header_t &header, std::vector<std::uint8_t> &payload, int timeoutMs);
+
+private:
+	int	m_fd = -1;
+	std::vector<std::uint8_t> m_rx;	///< bytes received, not yet part of a frame
+	};
+
+std::uint32_t crc32(std::uint32_t crc, const std::uint8_t *pBuffer, size_t nBuffer);
+int elapsedMs(Clock_t::time_point since);
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief the names of the McciBootloaderError_t values, from mcci_bootloader.h
+const char * const kErrorNames[] =
+	{
+	"OK",
+	"BootloaderNotValid",
+	"ResetClockNotValid",
+	"NoAppImage",
+	"EraseFailed",
+	"ReadFailed",
+	"FlashWriteFailed",
+	"FlashVerifyFailed",
+	"FlashNotFound",
+	"FlashNotSupported",
+	"PackageNotValid",
+	"BlockHashMismatch",
+	"ImageNotValid",
+	"SignatureNotValid",
+	"HostTimeout",
+	};
+
+/// \brief the baud rates termios knows about
+const struct
+	{
+	unsigned	baud;
+	speed_t		speed;
+	} kBaudRates[] =
+	{
+	{ 1200, B1200 },
+	{ 2400, B2400 },
+	{ 4800, B4800 },
+	{ 9600, B9600 },
+	{ 19200, B19200 },
+	{ 38400, B38400 },
+	{ 57600, B57600 },
+	{ 115200, B115200 },
+	{ 230400, B230400 },
+#ifdef B460800
+	{ 460800, B460800 },
+#endif
+#ifdef B921600
+	{ 921600, B921600 },
+#endif
+#ifdef B1000000
+	{ 1000000, B1000000 },
+#endif
+#ifdef B2000000
+	{ 2000000, B2000000 },
+#endif
+#ifdef B4000000
+	{ 4000000, B4000000 },
+#endif
+	};
+
+std::string errorName(std::uint32_t error)
+	{
+	if (error < sizeof(kErrorNames) / sizeof(kErrorNames[0]))
+		return kErrorNames[error];
+	else
+		return "unknown error " + std::to_string(error);
+	}
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::sendImage()
+
+Function:
+	Send a signed image to the bootloader over a serial port.
+
+Definition:
+	int App_t::sendImage();
+
+Description:
+	The image is read as for --verify, and checked with the key from
+	--public-key or -k, if given; an image that fails is not sent.
+	Without a key, failures are only reported, and the image is sent
+	anyway; the bootloader will check it.
+
+	If --send-break was given, we first hold a break on the port for
+	that long, which asks the bootloader for recovery at reset. Then
+	we send Hello until the bootloader answers with Ready, and send
+	the image in Data frames, up to a window ahead of the Acks (see
+	mcci_bootloader_serial.h). After a Nak, or if no Ack comes for a
+	while, we go back and send again from the last byte acknowledged.
+	Finally, we wait for the Result.
+
+	With --send-corrupt N, every Nth Data frame is damaged the first
+	time it's sent, to test recovery from lost frames.
+
+Returns:
+	EXIT_SUCCESS if the bootloader accepted the image, EXIT_FAILURE
+	otherwise.
+
+*/
+
+int App_t::sendImage()
+	{
+	// read and check the image.
+	auto const pPublicKey = this->readCheckKey();
+	McciBootloader_VerifyResult_t result;
+	std::vector<uint8_t> image;
+
+	result.filename = this->infilename;
+	this->verifyFile(result, pPublicKey, &image);
+
+	if (image.size() == 0)
+		this->fatal(result.failures.size() != 0 ? result.failures[0] : "empty image: " + this->infilename);
+
+	for (auto const &why : result.failures)
+		std::cerr << (pPublicKey != nullptr ? "?" : "warning: ")
+			  << this->progname << ": " << this->infilename << ": " << why << "\n";
+
+	if (pPublicKey != nullptr && result.failures.size() != 0)
+		this->fatal("image failed its checks; not sent: " + this->infilename);
+
+	// send only the signed part: imagesize + authsize.
+	size_t nTotal = image.size();
+	if (result.fAppInfo)
+		{
+		size_t const nSigned = size_t(result.appInfo.imagesize.get()) + result.appInfo.authsize.get();
+
+		if (nSigned < nTotal)
+			nTotal = nSigned;
+		}
+
+	// the port throws on errors.
+	try	{
+		SendPort_t port;
+
+		port.open(this->sendportname, this->sendBaud);
+
+		if (this->sendBreakMs != 0 && ! port.sendBreak(this->sendBreakMs))
+			std::cerr << "warning: " << this->progname << ": can't send a break on "
+				  << this->sendportname << ": " << std::strerror(errno) << "\n";
+
+		// start the session.
+		Header_t header;
+		std::vector<std::uint8_t> payload;
+		McciBootloader_SerialReady_Wire_t ready;
+		auto const tStart = Clock_t::now();
+
+		for (bool fReady = false; ! fReady; )
+			{
+			if (elapsedMs(tStart) > int(this->sendTimeoutMs))
+				this->fatal("no answer from the bootloader on " + this->sendportname);
+
+			port.sendFrame(Header_t::kHello, std::uint32_t(nTotal), nullptr, 0);
+
+			auto const tHello = Clock_t::now();
+			int msLeft;
+
+			while (! fReady && (msLeft = kHelloMs - elapsedMs(tHello)) > 0)
+				{
+				if (port.receiveFrame(header, payload, msLeft) &&
+				    header.type == Header_t::kReady &&
+				    header.offset.get() == nTotal &&
+				    payload.size() == sizeof(ready))
+					{
+					std::memcpy(&ready, payload.data(), sizeof(ready));
+					fReady = true;
+					}
+				}
+			}
+
+		size_t const dataMax = ready.dataMax.get();
+		size_t window = ready.window.get();
+
+		if (dataMax == 0 || window == 0)
+			this->fatal("bootloader sent a bad Ready frame");
+
+		if (this->sendWindow != 0 && this->sendWindow < window)
+			window = this->sendWindow;
+
+		std::ostringstream s;
+		s << "bootloader ready (" << errorName(ready.reason.get()) << "): window "
+		  << ready.window.get() << " frames, using " << window << "; sending "
+		  << nTotal << " bytes";
+		this->verbose(s.str());
+
+		// send the image: go back to the last Ack after a Nak or a timeout.
+		auto const tData = Clock_t::now();
+		auto tProgress = tData;
+		size_t base = 0;
+		size_t nextSend = 0;
+		unsigned nSent = 0;
+		unsigned nResent = 0;
+		std::set<size_t> corrupted;
+		bool fResult = false;
+		std::uint32_t resultCode = 0;
+
+		while (base < nTotal && ! fResult)
+			{
+			while (nextSend < nTotal && nextSend < base + window * dataMax)
+				{
+				size_t const nData = std::min(dataMax, nTotal - nextSend);
+				bool fCorrupt = false;
+
+				++nSent;
+				if (this->sendCorruptEvery != 0 && nSent % this->sendCorruptEvery == 0)
+					fCorrupt = corrupted.insert(nextSend).second;
+
+				port.sendFrame(Header_t::kData, std::uint32_t(nextSend), image.data() + nextSend, nData, fCorrupt);
+				nextSend += nData;
+				}
+
+			if (! port.receiveFrame(header, payload, kAckMs))
+				{
+				if (elapsedMs(tProgress) > int(this->sendTimeoutMs))
+					this->fatal("bootloader stopped answering on " + this->sendportname);
+
+				nResent += unsigned((nextSend - base + dataMax - 1) / dataMax);
+				nextSend = base;
+				continue;
+				}
+
+			size_t const offset = header.offset.get();
+
+			switch (header.type)
+				{
+			case Header_t::kAck:
+				if (offset > base && offset <= nTotal)
+					{
+					base = offset;
+					tProgress = Clock_t::now();
+					if (nextSend < base)
+						nextSend = base;
+					}
+				break;
+
+			case Header_t::kNak:
+				if (offset >= base && offset < nextSend)
+					{
+					base = offset;
+					nResent += unsigned((nextSend - base + dataMax - 1) / dataMax);
+					nextSend = base;
+					}
+				break;
+
+			case Header_t::kResult:
+				fResult = true;
+				resultCode = std::uint32_t(offset);
+				break;
+
+			default:
+				break;
+				}
+			}
+
+		auto const msData = elapsedMs(tData);
+
+		// the bootloader checks the signature before it answers.
+		auto const tCheck = Clock_t::now();
+
+		while (! fResult)
+			{
+			if (elapsedMs(tCheck) > int(this->sendTimeoutMs))
+				this->fatal("no result from the bootloader on " + this->sendportname);
+
+			if (port.receiveFrame(header, payload, kAckMs) && header.type == Header_t::kResult)
+				{
+				fResult = true;
+				resultCode = header.offset.get();
+				}
+			}
+
+		std::cout << "sent " << base << " of " << nTotal << " bytes in " << msData << " ms";
+		if (msData != 0)
+			std::cout << " (" << (std::uint64_t(base) * 1000 / unsigned(msData)) << " bytes/s)";
+		std::cout << ", " << nResent << " frame(s) resent\n"
+			  << "result: " << errorName(resultCode) << " (" << resultCode << ")\n"
+			  << std::flush;
+
+		return resultCode == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	catch (std::exception &e)
+		{
+		this->fatal(e.what());
+		}
+	}
+
+namespace {
+
+/*
+|| Open the port: raw, 8 bits, no parity, no flow control. Anything the
+|| bootloader sent before we got here is discarded.
+*/
+void SendPort_t::open(const std::string &name, unsigned baud)
+	{
+	speed_t speed = 0;
+	bool fSpeed = false;
+
+	for (auto const &b : kBaudRates)
+		{
+		if (b.baud == baud)
+			{
+			speed = b.speed;
+			fSpeed = true;
+			}
+		}
+
+	if (! fSpeed)
+		throw std::runtime_error("baud rate not supported on this platform: " + std::to_string(baud));
+
+	this->m_fd = ::open(name.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (this->m_fd < 0)
+		throw std::runtime_error("can't open " + name + ": " + std::strerror(errno));
+
+	struct termios tio;
+
+	if (tcgetattr(this->m_fd, &tio) != 0)
+		throw std::runtime_error("not a serial port: " + name + ": " + std::strerror(errno));
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+
+	if (tcsetattr(this->m_fd, TCSANOW, &tio) != 0)
+		throw std::runtime_error("can't set up " + name + ": " + std::strerror(errno));
+
+	tcflush(this->m_fd, TCIOFLUSH);
+	}
+
+/* hold a break for ms; false (with errno) if the port can't */
+bool SendPort_t::sendBreak(unsigned ms)
+	{
+	if (ioctl(this->m_fd, TIOCSBRK) != 0)
+		return false;
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	return ioctl(this->m_fd, TIOCCBRK) == 0;
+	}
+
+/* send a frame; if fCorrupt, with a bad CRC */
+void SendPort_t::sendFrame(
+	std::uint8_t type,
+	std::uint32_t offset,
+	const std::uint8_t *pPayload,
+	size_t nPayload,
+	bool fCorrupt
+	)
+	{
+	Header_t header;
+
+	header.type = type;
+	header.length.put(std::uint16_t(nPayload));
+	header.offset.put(offset);
+
+	std::vector<std::uint8_t> frame(sizeof(header) + nPayload + Header_t::kCrcSize);
+	std::memcpy(frame.data(), &header, sizeof(header));
+	if (nPayload != 0)
+		std::memcpy(frame.data() + sizeof(header), pPayload, nPayload);
+
+	size_t const nCrc = sizeof(header) + nPayload;
+	uint32_le_t const crc { crc32(0, frame.data() + 1, nCrc - 1) ^ (fCorrupt ? 1u : 0u) };
+	std::memcpy(frame.data() + nCrc, &crc, sizeof(crc));
+
+	for (size_t i = 0; i < frame.size(); )
+		{
+		auto const n = ::write(this->m_fd, frame.data() + i, frame.size() - i);
+
+		if (n > 0)
+			i += size_t(n);
+		else if (n < 0 && errno == EINTR)
+			continue;
+		else if (n < 0 && errno == EAGAIN)
+			{
+			struct pollfd pfd = { this->m_fd, POLLOUT, 0 };
+			poll(&pfd, 1, kAckMs);
+			}
+		else
+			throw std::runtime_error(string("write failed: ") + std::strerror(errno));
+		}
+	}
+
+/*
+|| Receive one good frame, waiting up to timeoutMs for it; false if none
+|| came. As in the bootloader, bytes that don't start a frame with a good
+|| CRC are dropped one at a time.
+*/
+bool SendPort_t::receiveFrame(Header_t &header, std::vector<std::uint8_t> &payload, int timeoutMs)
+	{
+	auto const tStart = Clock_t::now();
+
+	for (;;)
+		{
+		// look for a frame in what we have.
+		while (this->m_rx.size() >= sizeof(header))
+			{
+			std::memcpy(&header, this->m_rx.data(), sizeof(header));
+
+			size_t const nPayload = header.length.get();
+			size_t const nFrame = sizeof(header) + nPayload + Header_t::kCrcSize;
+
+			if (header.sync == Header_t::kSync && nPayload <= Header_t::kDataMax)
+				{
+				if (this->m_rx.size() < nFrame)
+					break;
+
+				uint32_le_t crc;
+				std::memcpy(&crc, this->m_rx.data() + nFrame - sizeof(crc), sizeof(crc));
+
+				if (crc.get() == crc32(0, this->m_rx.data() + 1, nFrame - sizeof(crc) - 1))
+					{
+					payload.assign(
+						this->m_rx.begin() + sizeof(header),
+						this->m_rx.begin() + sizeof(header) + nPayload
+						);
+					this->m_rx.erase(this->m_rx.begin(), this->m_rx.begin() + nFrame);
+					return true;
+					}
+				}
+
+			this->m_rx.erase(this->m_rx.begin());
+			}
+
+		// wait for more.
+		int const msLeft = timeoutMs - elapsedMs(tStart);
+		if (msLeft <= 0)
+			return false;
+
+		struct pollfd pfd = { this->m_fd, POLLIN, 0 };
+		auto const nReady = poll(&pfd, 1, msLeft);
+
+		if (nReady < 0 && errno != EINTR)
+			throw std::runtime_error(string("poll failed: ") + std::strerror(errno));
+		if (nReady <= 0)
+			continue;
+
+		// the other end of a pty may have gone away.
+		if ((pfd.revents & POLLIN) == 0)
+			throw std::runtime_error("serial port closed");
+
+		std::uint8_t buffer[512];
+		auto const n = ::read(this->m_fd, buffer, sizeof(buffer));
+
+		if (n < 0 && errno != EINTR && errno != EAGAIN)
+			throw std::runtime_error(string("read failed: ") + std::strerror(errno));
+		if (n == 0)
+			throw std::runtime_error("serial port closed");
+		if (n > 0)
+			this->m_rx.insert(this->m_rx.end(), buffer, buffer + n);
+		}
+	}
+
+/* continue the CRC-32 (zlib, Ethernet) crc (0 to start) over a buffer */
+std::uint32_t crc32(std::uint32_t crc, const std::uint8_t *pBuffer, size_t nBuffer)
+	{
+	crc = ~crc;
+	for (size_t i = 0; i < nBuffer; ++i)
+		{
+		crc ^= pBuffer[i];
+		for (unsigned bit = 0; bit < 8; ++bit)
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+		}
+	return ~crc;
+	}
+
+int elapsedMs(Clock_t::time_point since)
+	{
+	return int(std::chrono::duration_cast<std::chrono::milliseconds>(Clock_t::now() - since).count());
+	}
+
+} // namespace
+
+/**** end of send.cpp ****/
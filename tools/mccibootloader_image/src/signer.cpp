@@ -0,0 +1,889 @@
+/*
+
+Module:	signer.cpp
+
+Function:
+	The signing daemon (--daemon), and the signer backends that talk
+	to it (--socket) or to an external signer process
+	(--signer-command).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_signer.h"
+
+#include <condition_variable>
+#include <csignal>
+#include <cerrno>
+#include <deque>
+#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace McciBootloader_Signer;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief the most requests one connection may have queued or in progress
+constexpr std::size_t kMaxPendingRequests = 64;
+
+/// \brief the most payload bytes one connection may have queued or in progress
+///
+/// \details A request that would go over the limit still goes ahead if
+///	nothing else is pending, so that a kMaxPayload request is never stuck.
+///
+constexpr std::size_t kMaxPendingBytes = 2 * std::size_t(kMaxPayload);
+
+/// \brief one client connection to the daemon
+struct Connection_t
+	{
+	explicit Connection_t(int fd) : fd(fd) {}
+	~Connection_t() { close(this->fd); }
+
+	int			fd;		///< the socket
+	std::mutex		writeLock;	///< serializes responses
+	std::mutex		pendingLock;	///< protects nPending and nPendingBytes
+	std::condition_variable	pendingDone;	///< signalled when a request is answered
+	std::size_t		nPending = 0;	///< requests queued or in progress
+	std::size_t		nPendingBytes = 0; ///< their payload bytes
+	};
+
+/// \brief one request waiting for a worker
+struct Work_t
+	{
+	std::shared_ptr<Connection_t>	pConnection;
+	RequestHeader_Wire_t		header;
+	std::vector<std::uint8_t>	payload;
+	};
+
+/// \brief the daemon's shared state
+struct Daemon_t
+	{
+	std::vector<Keyfile_ed25519_t>	keys;
+	std::mutex			queueLock;
+	std::condition_variable		queueReady;
+	std::deque<Work_t>		queue;
+
+	void reader(std::shared_ptr<Connection_t> pConnection);
+	void worker();
+	void serveStream(int inFd, int outFd, bool fVerbose) const;
+	Status_t process(const Work_t &work, std::vector<std::uint8_t> &response) const;
+	const Keyfile_ed25519_t *findKey(const std::uint8_t *pSelector) const;
+	};
+
+/// \brief a backend that speaks the daemon protocol over a pair of descriptors
+class StreamBackend_t : public Backend_t
+	{
+public:
+	StreamBackend_t(int inFd, int outFd, const std::string &name)
+		: m_inFd(inFd)
+		, m_outFd(outFd)
+		, m_name(name)
+		{}
+	~StreamBackend_t();
+
+	void start(const mcci_tweetnacl_sign_publickey_t &selector);
+
+	const mcci_tweetnacl_sign_publickey_t &publicKey() const override
+		{ return this->m_public; }
+
+	void signHashes(
+		const mcci_tweetnacl_sha512_t *pHashes,
+		std::size_t nHashes,
+		mcci_tweetnacl_sign_signature_t *pSignatures
+		) override;
+
+	std::string name() const override
+		{ return this->m_name; }
+
+protected:
+	std::vector<std::uint8_t> transact(
+		Opcode_t opcode,
+		const std::vector<std::uint8_t> &payload
+		);
+
+	int				m_inFd;
+	int				m_outFd;
+	std::string			m_name;
+	std::mutex			m_lock;		///< one request at a time
+	std::uint32_t			m_requestId { 0 };
+	mcci_tweetnacl_sign_publickey_t	m_public;
+	};
+
+/// \brief a backend that runs an external signer process
+class CommandBackend_t : public StreamBackend_t
+	{
+public:
+	CommandBackend_t(int inFd, int outFd, pid_t pid, const std::string &command)
+		: StreamBackend_t(inFd, outFd, "signer command \"" + command + "\"")
+		, m_pid(pid)
+		{}
+	~CommandBackend_t();
+
+private:
+	pid_t	m_pid;
+	};
+
+} // namespace
+
+static bool readFull(int fd, void *pBuffer, size_t nBuffer);
+static bool writeFull(int fd, const void *pBuffer, size_t nBuffer);
+static bool makeSocketAddress(const string &path, sockaddr_un &addr);
+static void setCloseOnExec(int fd);
+static void signalHandler(int sig);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/// \brief the socket path, for removal from the signal handler.
+static char sSocketPath[sizeof(sockaddr_un::sun_path)];
+
+/*
+
+Name:	App_t::runSigner()
+
+Function:
+	Run the signing daemon.
+
+Definition:
+	[[noreturn]] void App_t::runSigner();
+
+Description:
+	The keys named by -k are read once and kept in memory. We then
+	listen on the Unix-domain socket this->socketname, which is
+	created accessible only to the current user, and serve requests
+	until killed. Each connection gets a reader thread; requests are
+	handed to a pool of this->nJobs workers (default: one per CPU),
+	so that pipelined requests from one client, and requests from
+	many clients, are processed concurrently. A connection may have
+	at most kMaxPendingRequests requests, and kMaxPendingBytes of
+	payload, waiting for answers; beyond that, its reader stops
+	reading the socket until the workers catch up, so a client that
+	pipelines faster than we sign is slowed down rather than
+	buffered without limit.
+
+Returns:
+	Never returns. If the socket can't be set up, or with --stdio once
+	stdin is closed, throws Exit_t to end begin().
+
+Notes:
+	With --stdio, the daemon instead serves the one client on its
+	stdin and stdout, answering requests in order, and ends when
+	stdin is closed. This makes it an external signer process for
+	--signer-command, standing in for a hardware security module.
+	Messages go to stderr.
+
+*/
+
+[[noreturn]]
+void App_t::runSigner()
+	{
+	Daemon_t daemon;
+
+	// read all the keys.
+	if (this->keyfilenames.size() == 0)
+		this->usage("--daemon needs at least one keyfile");
+
+	for (auto const &keyfilename : this->keyfilenames)
+		{
+		Keyfile_ed25519_t key;
+
+		key.begin(keyfilename);
+		if (! key.read())
+			this->fatal(string("can't read key file: ") + keyfilename);
+
+		if (this->fVerbose)
+			(this->fStdio ? std::cerr : std::cout)
+				<< "loaded key: " << keyfilename << ": " << key.m_comment << "\n";
+		daemon.keys.push_back(key);
+		}
+
+	if (this->fStdio)
+		{
+		std::signal(SIGPIPE, SIG_IGN);
+		daemon.serveStream(STDIN_FILENO, STDOUT_FILENO, this->fVerbose);
+		throw Exit_t { EXIT_SUCCESS };
+		}
+
+	// set up the socket.
+	sockaddr_un addr;
+	if (! makeSocketAddress(this->socketname, addr))
+		this->fatal("socket path too long: " + this->socketname);
+
+	int const listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0)
+		this->fatal(string("can't create socket: ") + std::strerror(errno));
+
+	// if the socket exists but nobody is listening, it's stale.
+	if (connect(listenFd, (const sockaddr *)&addr, sizeof(addr)) == 0)
+		this->fatal("another daemon is already listening on " + this->socketname);
+	unlink(this->socketname.c_str());
+
+	// only we get to talk to the daemon.
+	auto const oldMask = umask(0077);
+	int const bindResult = bind(listenFd, (const sockaddr *)&addr, sizeof(addr));
+	umask(oldMask);
+
+	if (bindResult != 0)
+		this->fatal("can't bind " + this->socketname + ": " + std::strerror(errno));
+
+	if (listen(listenFd, SOMAXCONN) != 0)
+		this->fatal(string("can't listen: ") + std::strerror(errno));
+
+	std::strncpy(sSocketPath, this->socketname.c_str(), sizeof(sSocketPath) - 1);
+	std::signal(SIGINT, signalHandler);
+	std::signal(SIGTERM, signalHandler);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	// start the workers.
+	unsigned nJobs = this->nJobs;
+	if (nJobs == 0)
+		nJobs = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned i = 0; i < nJobs; ++i)
+		std::thread([&daemon]() { daemon.worker(); }).detach();
+
+	if (this->fVerbose)
+		std::cout << "listening on " << this->socketname
+			  << " with " << daemon.keys.size() << " key(s) and "
+			  << nJobs << " worker(s)\n" << std::flush;
+
+	// accept connections forever.
+	for (;;)
+		{
+		int const fd = accept(listenFd, nullptr, nullptr);
+
+		if (fd < 0)
+			{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			this->fatal(string("accept failed: ") + std::strerror(errno));
+			}
+
+		auto pConnection = std::make_shared<Connection_t>(fd);
+		std::thread([&daemon, pConnection]() { daemon.reader(pConnection); }).detach();
+		}
+	}
+
+/// \brief read requests from a connection and queue them for the workers.
+void Daemon_t::reader(std::shared_ptr<Connection_t> pConnection)
+	{
+	for (;;)
+		{
+		Work_t work;
+
+		if (! readFull(pConnection->fd, &work.header, sizeof(work.header)))
+			break;
+
+		auto const length = work.header.length.get();
+
+		if (work.header.magic.get() != kRequestMagic || length > kMaxPayload)
+			{
+			// we've lost sync; say why, then hang up.
+			ResponseHeader_Wire_t response;
+
+			response.requestId = work.header.requestId;
+			response.status = std::uint8_t(
+				work.header.magic.get() != kRequestMagic ? Status_t::kBadRequest : Status_t::kTooLarge
+				);
+
+			std::lock_guard<std::mutex> lock(pConnection->writeLock);
+			(void) writeFull(pConnection->fd, &response, sizeof(response));
+			break;
+			}
+
+		// wait for room before reading the payload; meanwhile the
+		// client blocks once the socket buffer fills.
+			{
+			std::unique_lock<std::mutex> lock(pConnection->pendingLock);
+			pConnection->pendingDone.wait(
+				lock,
+				[&pConnection, length]()
+					{
+					return pConnection->nPending == 0 ||
+					       (pConnection->nPending < kMaxPendingRequests &&
+						pConnection->nPendingBytes + length <= kMaxPendingBytes);
+					}
+				);
+			pConnection->nPending += 1;
+			pConnection->nPendingBytes += length;
+			}
+
+		work.payload.resize(length);
+		if (length != 0 && ! readFull(pConnection->fd, &work.payload[0], length))
+			break;
+
+		work.pConnection = pConnection;
+
+			{
+			std::lock_guard<std::mutex> lock(this->queueLock);
+			this->queue.push_back(std::move(work));
+			}
+		this->queueReady.notify_one();
+		}
+
+	// the connection closes when the last pending request is answered.
+	shutdown(pConnection->fd, SHUT_RD);
+	}
+
+/// \brief process queued requests.
+void Daemon_t::worker()
+	{
+	for (;;)
+		{
+		Work_t work;
+
+			{
+			std::unique_lock<std::mutex> lock(this->queueLock);
+			this->queueReady.wait(lock, [this]() { return this->queue.size() != 0; });
+			work = std::move(this->queue.front());
+			this->queue.pop_front();
+			}
+
+		std::vector<std::uint8_t> payload;
+		ResponseHeader_Wire_t response;
+
+		response.requestId = work.header.requestId;
+		response.status = std::uint8_t(this->process(work, payload));
+		response.length.put(std::uint32_t(payload.size()));
+
+			{
+			std::lock_guard<std::mutex> lock(work.pConnection->writeLock);
+			if (writeFull(work.pConnection->fd, &response, sizeof(response)) && payload.size() != 0)
+				(void) writeFull(work.pConnection->fd, &payload[0], payload.size());
+			}
+
+		// let the reader take another request from this connection.
+			{
+			auto &connection = *work.pConnection;
+			std::lock_guard<std::mutex> lock(connection.pendingLock);
+			connection.nPending -= 1;
+			connection.nPendingBytes -= work.payload.size();
+			}
+		work.pConnection->pendingDone.notify_one();
+		}
+	}
+
+/// \brief serve requests from \p inFd in order, until end of file.
+void Daemon_t::serveStream(int inFd, int outFd, bool fVerbose) const
+	{
+	for (;;)
+		{
+		Work_t work;
+
+		if (! readFull(inFd, &work.header, sizeof(work.header)))
+			return;
+
+		auto const length = work.header.length.get();
+		ResponseHeader_Wire_t response;
+		std::vector<std::uint8_t> payload;
+
+		response.requestId = work.header.requestId;
+
+		if (work.header.magic.get() != kRequestMagic || length > kMaxPayload)
+			{
+			// we've lost sync; say why, then stop.
+			response.status = std::uint8_t(
+				work.header.magic.get() != kRequestMagic ? Status_t::kBadRequest : Status_t::kTooLarge
+				);
+			(void) writeFull(outFd, &response, sizeof(response));
+			return;
+			}
+
+		work.payload.resize(length);
+		if (length != 0 && ! readFull(inFd, &work.payload[0], length))
+			return;
+
+		response.status = std::uint8_t(this->process(work, payload));
+		response.length.put(std::uint32_t(payload.size()));
+
+		if (fVerbose)
+			std::cerr << "request " << work.header.requestId.get()
+				  << ": opcode " << unsigned(work.header.opcode)
+				  << ", " << length << " bytes in, "
+				  << payload.size() << " bytes out, status "
+				  << unsigned(response.status) << "\n";
+
+		if (! writeFull(outFd, &response, sizeof(response)) ||
+		    (payload.size() != 0 && ! writeFull(outFd, &payload[0], payload.size())))
+			return;
+		}
+	}
+
+/// \brief carry out a request, putting the response payload in \p response.
+Status_t Daemon_t::process(const Work_t &work, std::vector<std::uint8_t> &response) const
+	{
+	auto const &payload = work.payload;
+
+	switch (Opcode_t(work.header.opcode))
+		{
+	case Opcode_t::kGetKeys:
+		for (auto const &key : this->keys)
+			response.insert(response.end(), key.m_public.bytes, key.m_public.bytes + sizeof(key.m_public.bytes));
+		return Status_t::kSuccess;
+
+	case Opcode_t::kHash:
+		{
+		mcci_tweetnacl_sha512_t hash;
+
+		mcci_tweetnacl_hash_sha512(&hash, payload.data(), payload.size());
+		response.assign(hash.bytes, hash.bytes + sizeof(hash.bytes));
+		return Status_t::kSuccess;
+		}
+
+	case Opcode_t::kSignHash:
+	case Opcode_t::kSignImage:
+		{
+		if (payload.size() < kSelectorSize)
+			return Status_t::kBadRequest;
+
+		auto const pKey = this->findKey(&payload[0]);
+		if (pKey == nullptr)
+			return Status_t::kUnknownKey;
+
+		McciBootloader_SignatureBlock_Wire_t sigBlock;
+		memcpy(sigBlock.publicKey, pKey->m_public.bytes, sizeof(sigBlock.publicKey));
+
+		if (Opcode_t(work.header.opcode) == Opcode_t::kSignHash)
+			{
+			if (payload.size() != kSelectorSize + sizeof(sigBlock.hash))
+				return Status_t::kBadRequest;
+
+			memcpy(sigBlock.hash, &payload[kSelectorSize], sizeof(sigBlock.hash));
+			}
+		else
+			{
+			// hash the image followed by the public key, as addHash()
+			// does; stream the image so we don't have to copy it.
+			auto const pImage = &payload[kSelectorSize];
+			auto const nImage = payload.size() - kSelectorSize;
+			mcci_tweetnacl_sha512_t hash;
+
+			mcci_tweetnacl_hashblocks_sha512_init(&hash);
+			auto const nLeft = mcci_tweetnacl_hashblocks_sha512(&hash, pImage, nImage);
+
+			std::uint8_t tail[2 * 128];
+			size_t nTail = nLeft;
+
+			memcpy(tail, pImage + nImage - nLeft, nLeft);
+			memcpy(tail + nTail, sigBlock.publicKey, sizeof(sigBlock.publicKey));
+			nTail += sizeof(sigBlock.publicKey);
+
+			auto const nFinal = mcci_tweetnacl_hashblocks_sha512(&hash, tail, nTail);
+			mcci_tweetnacl_hashblocks_sha512_finish(
+				&hash,
+				tail + nTail - nFinal,
+				nFinal,
+				nImage + sizeof(sigBlock.publicKey)
+				);
+			memcpy(sigBlock.hash, hash.bytes, sizeof(sigBlock.hash));
+			}
+
+		std::uint8_t signedMessage[sizeof(sigBlock.signature) + sizeof(sigBlock.hash)];
+		size_t nSigned;
+
+		if (! mcci_tweetnacl_result_is_success(mcci_tweetnacl_sign(
+				signedMessage, &nSigned,
+				sigBlock.hash, sizeof(sigBlock.hash),
+				&pKey->m_private
+				)))
+			return Status_t::kFailed;
+
+		memcpy(sigBlock.signature, signedMessage, sizeof(sigBlock.signature));
+
+		auto const pSigBlock = (const std::uint8_t *)&sigBlock;
+		if (Opcode_t(work.header.opcode) == Opcode_t::kSignHash)
+			response.assign(sigBlock.signature, sigBlock.signature + sizeof(sigBlock.signature));
+		else
+			response.assign(pSigBlock, pSigBlock + sizeof(sigBlock));
+		return Status_t::kSuccess;
+		}
+
+	case Opcode_t::kSignHashes:
+		{
+		constexpr auto kHashSize = sizeof(mcci_tweetnacl_sha512_t);
+		constexpr auto kSignatureSize = sizeof(mcci_tweetnacl_sign_signature_t);
+
+		if (payload.size() <= kSelectorSize || (payload.size() - kSelectorSize) % kHashSize != 0)
+			return Status_t::kBadRequest;
+
+		auto const pKey = this->findKey(&payload[0]);
+		if (pKey == nullptr)
+			return Status_t::kUnknownKey;
+
+		auto const nHashes = (payload.size() - kSelectorSize) / kHashSize;
+
+		response.resize(nHashes * kSignatureSize);
+		for (size_t i = 0; i < nHashes; ++i)
+			{
+			std::uint8_t signedMessage[kSignatureSize + kHashSize];
+			size_t nSigned;
+
+			if (! mcci_tweetnacl_result_is_success(mcci_tweetnacl_sign(
+					signedMessage, &nSigned,
+					&payload[kSelectorSize + i * kHashSize], kHashSize,
+					&pKey->m_private
+					)))
+				return Status_t::kFailed;
+
+			memcpy(&response[i * kSignatureSize], signedMessage, kSignatureSize);
+			}
+		return Status_t::kSuccess;
+		}
+
+	default:
+		return Status_t::kBadRequest;
+		}
+	}
+
+/// \brief find a key by public key; all-zero selects the first key.
+const Keyfile_ed25519_t *Daemon_t::findKey(const std::uint8_t *pSelector) const
+	{
+	bool fDefault = std::all_of(pSelector, pSelector + kSelectorSize, [](std::uint8_t b) { return b == 0; });
+
+	if (fDefault)
+		return &this->keys.at(0);
+
+	for (auto const &key : this->keys)
+		{
+		if (memcmp(key.m_public.bytes, pSelector, kSelectorSize) == 0)
+			return &key;
+		}
+
+	return nullptr;
+	}
+
+StreamBackend_t::~StreamBackend_t()
+	{
+	close(this->m_outFd);
+	if (this->m_inFd != this->m_outFd)
+		close(this->m_inFd);
+	}
+
+/// \brief send a request and wait for its response; throws on failure.
+std::vector<std::uint8_t> StreamBackend_t::transact(
+	Opcode_t opcode,
+	const std::vector<std::uint8_t> &payload
+	)
+	{
+	RequestHeader_Wire_t request;
+	auto const requestId = ++this->m_requestId;
+
+	request.requestId.put(requestId);
+	request.length.put(std::uint32_t(payload.size()));
+	request.opcode = std::uint8_t(opcode);
+
+	++this->m_nRequests;
+
+	if (! writeFull(this->m_outFd, &request, sizeof(request)) ||
+	    (payload.size() != 0 && ! writeFull(this->m_outFd, &payload[0], payload.size())))
+		throw std::runtime_error("can't send request to " + this->m_name + ": " + std::strerror(errno));
+
+	ResponseHeader_Wire_t response;
+
+	if (! readFull(this->m_inFd, &response, sizeof(response)))
+		throw std::runtime_error("no response from " + this->m_name);
+
+	if (response.magic.get() != kResponseMagic ||
+	    response.requestId.get() != requestId ||
+	    response.length.get() > kMaxPayload)
+		throw std::runtime_error("bad response from " + this->m_name);
+
+	std::vector<std::uint8_t> result(response.length.get());
+
+	if (result.size() != 0 && ! readFull(this->m_inFd, &result[0], result.size()))
+		throw std::runtime_error("short response from " + this->m_name);
+
+	if (response.status != std::uint8_t(Status_t::kSuccess))
+		{
+		std::ostringstream msg;
+		msg << this->m_name << " failed request: status " << unsigned(response.status);
+		throw std::runtime_error(msg.str());
+		}
+
+	return result;
+	}
+
+/// \brief get the signer's keys, and choose the one named by \p selector.
+void StreamBackend_t::start(const mcci_tweetnacl_sign_publickey_t &selector)
+	{
+	auto const keys = this->transact(Opcode_t::kGetKeys, {});
+
+	if (keys.size() == 0 || keys.size() % kSelectorSize != 0)
+		throw std::runtime_error(this->m_name + " has no keys");
+
+	bool const fDefault = std::all_of(
+		selector.bytes, selector.bytes + kSelectorSize,
+		[](std::uint8_t b) { return b == 0; }
+		);
+
+	for (size_t i = 0; i < keys.size(); i += kSelectorSize)
+		{
+		if (fDefault || memcmp(&keys[i], selector.bytes, kSelectorSize) == 0)
+			{
+			memcpy(this->m_public.bytes, &keys[i], kSelectorSize);
+			return;
+			}
+		}
+
+	throw std::runtime_error(this->m_name + " doesn't have the key given by --public-key");
+	}
+
+/*
+
+Name:	StreamBackend_t::signHashes()
+
+Function:
+	Sign hashes with the daemon or external signer.
+
+Definition:
+	void StreamBackend_t::signHashes(
+		const mcci_tweetnacl_sha512_t *pHashes,
+		std::size_t nHashes,
+		mcci_tweetnacl_sign_signature_t *pSignatures
+		) override;
+
+Description:
+	The hashes are sent in kSignHashes requests of up to
+	kMaxHashesPerRequest hashes each, so a batch of images costs one
+	round trip, not one per image. Each request names the selected
+	key explicitly, so the signer can't substitute another.
+
+Returns:
+	No explicit result. Throws std::runtime_error on failure.
+
+*/
+
+void StreamBackend_t::signHashes(
+	const mcci_tweetnacl_sha512_t *pHashes,
+	std::size_t nHashes,
+	mcci_tweetnacl_sign_signature_t *pSignatures
+	)
+	{
+	std::lock_guard<std::mutex> lock(this->m_lock);
+
+	for (size_t iFirst = 0; iFirst < nHashes; iFirst += kMaxHashesPerRequest)
+		{
+		auto const n = std::min(nHashes - iFirst, kMaxHashesPerRequest);
+		std::vector<std::uint8_t> payload;
+
+		payload.reserve(kSelectorSize + n * sizeof(pHashes[0].bytes));
+		payload.insert(payload.end(), this->m_public.bytes, this->m_public.bytes + kSelectorSize);
+		for (size_t i = 0; i < n; ++i)
+			payload.insert(payload.end(), pHashes[iFirst + i].bytes, pHashes[iFirst + i].bytes + sizeof(pHashes[0].bytes));
+
+		auto const signatures = this->transact(Opcode_t::kSignHashes, payload);
+
+		if (signatures.size() != n * sizeof(pSignatures[0].bytes))
+			throw std::runtime_error("bad response length from " + this->m_name);
+
+		for (size_t i = 0; i < n; ++i)
+			memcpy(pSignatures[iFirst + i].bytes, &signatures[i * sizeof(pSignatures[0].bytes)], sizeof(pSignatures[0].bytes));
+		}
+	}
+
+CommandBackend_t::~CommandBackend_t()
+	{
+	// closing its stdin tells the signer to exit.
+	close(this->m_outFd);
+	close(this->m_inFd);
+	this->m_outFd = this->m_inFd = -1;
+
+	int status;
+	while (waitpid(this->m_pid, &status, 0) < 0 && errno == EINTR)
+		/* try again */;
+	}
+
+std::shared_ptr<Backend_t>
+McciBootloader_Signer::makeSocketBackend(
+	const std::string &socketname,
+	const mcci_tweetnacl_sign_publickey_t &selector
+	)
+	{
+	sockaddr_un addr;
+	if (! makeSocketAddress(socketname, addr))
+		throw std::runtime_error("socket path too long: " + socketname);
+
+	int const fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		throw std::runtime_error(string("can't create socket: ") + std::strerror(errno));
+
+	setCloseOnExec(fd);
+
+	if (connect(fd, (const sockaddr *)&addr, sizeof(addr)) != 0)
+		{
+		auto const error = errno;
+
+		close(fd);
+		throw std::runtime_error("can't connect to signing daemon at " + socketname + ": " + std::strerror(error));
+		}
+
+	std::signal(SIGPIPE, SIG_IGN);
+
+	auto pBackend = std::make_shared<StreamBackend_t>(fd, fd, "signing daemon at " + socketname);
+	pBackend->start(selector);
+	return pBackend;
+	}
+
+std::shared_ptr<Backend_t>
+McciBootloader_Signer::makeCommandBackend(
+	const std::string &command,
+	const mcci_tweetnacl_sign_publickey_t &selector
+	)
+	{
+	int toChild[2];
+	int fromChild[2];
+
+	if (pipe(toChild) != 0)
+		throw std::runtime_error(string("can't create pipe: ") + std::strerror(errno));
+
+	if (pipe(fromChild) != 0)
+		{
+		auto const error = errno;
+
+		close(toChild[0]);
+		close(toChild[1]);
+		throw std::runtime_error(string("can't create pipe: ") + std::strerror(error));
+		}
+
+	// our ends mustn't leak into this or any other child.
+	setCloseOnExec(toChild[1]);
+	setCloseOnExec(fromChild[0]);
+
+	std::cout << std::flush;
+
+	pid_t const pid = fork();
+
+	if (pid == 0)
+		{
+		// the child: the pipes become stdin and stdout.
+		dup2(toChild[0], STDIN_FILENO);
+		dup2(fromChild[1], STDOUT_FILENO);
+		close(toChild[0]);
+		close(fromChild[1]);
+
+		execl("/bin/sh", "sh", "-c", command.c_str(), (char *)nullptr);
+		_exit(127);
+		}
+
+	auto const error = errno;
+
+	close(toChild[0]);
+	close(fromChild[1]);
+
+	if (pid < 0)
+		{
+		close(toChild[1]);
+		close(fromChild[0]);
+		throw std::runtime_error(string("can't start signer command: ") + std::strerror(error));
+		}
+
+	std::signal(SIGPIPE, SIG_IGN);
+
+	auto pBackend = std::make_shared<CommandBackend_t>(fromChild[0], toChild[1], pid, command);
+	pBackend->start(selector);
+	return pBackend;
+	}
+
+static bool readFull(int fd, void *pBuffer, size_t nBuffer)
+	{
+	auto p = (std::uint8_t *)pBuffer;
+
+	while (nBuffer != 0)
+		{
+		auto const n = read(fd, p, nBuffer);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+
+		p += n;
+		nBuffer -= size_t(n);
+		}
+
+	return true;
+	}
+
+static bool writeFull(int fd, const void *pBuffer, size_t nBuffer)
+	{
+	auto p = (const std::uint8_t *)pBuffer;
+
+	while (nBuffer != 0)
+		{
+		auto const n = write(fd, p, nBuffer);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+
+		p += n;
+		nBuffer -= size_t(n);
+		}
+
+	return true;
+	}
+
+static bool makeSocketAddress(const string &path, sockaddr_un &addr)
+	{
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if (path.size() == 0 || path.size() >= sizeof(addr.sun_path))
+		return false;
+
+	memcpy(addr.sun_path, path.c_str(), path.size());
+	return true;
+	}
+
+static void setCloseOnExec(int fd)
+	{
+	(void) fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+	}
+
+static void signalHandler(int sig)
+	{
+	unlink(sSocketPath);
+	_exit(128 + sig);
+	}
+
+/**** end of signer.cpp ****/
@@ -0,0 +1,190 @@
+/*
+
+Module:	signer_keyfile.cpp
+
+Function:
+	The in-process signer backend, and App_t's use of the backends.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_signer.h"
+
+#include <stdexcept>
+
+using namespace McciBootloader_Signer;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief signs with a private key held in memory
+class KeyfileBackend_t : public Backend_t
+	{
+public:
+	explicit KeyfileBackend_t(const Keyfile_ed25519_t &key)
+		: m_key(key)
+		{}
+
+	const mcci_tweetnacl_sign_publickey_t &publicKey() const override
+		{ return this->m_key.m_public; }
+
+	void signHashes(
+		const mcci_tweetnacl_sha512_t *pHashes,
+		std::size_t nHashes,
+		mcci_tweetnacl_sign_signature_t *pSignatures
+		) override;
+
+	std::string name() const override
+		{ return "key file " + this->m_key.m_filename; }
+
+private:
+	Keyfile_ed25519_t	m_key;
+	};
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+void KeyfileBackend_t::signHashes(
+	const mcci_tweetnacl_sha512_t *pHashes,
+	std::size_t nHashes,
+	mcci_tweetnacl_sign_signature_t *pSignatures
+	)
+	{
+	for (std::size_t i = 0; i < nHashes; ++i)
+		{
+		std::uint8_t buffer[sizeof(pSignatures[i].bytes) + sizeof(pHashes[i].bytes)];
+		size_t sizeOut;
+
+		if (! mcci_tweetnacl_result_is_success(mcci_tweetnacl_sign(
+				buffer,
+				&sizeOut,
+				pHashes[i].bytes,
+				sizeof(pHashes[i].bytes),
+				&this->m_key.m_private
+				)))
+			throw std::runtime_error("signing failed");
+
+		memcpy(pSignatures[i].bytes, buffer, sizeof(pSignatures[i].bytes));
+		}
+	}
+
+std::shared_ptr<Backend_t>
+McciBootloader_Signer::makeKeyfileBackend(const Keyfile_ed25519_t &key)
+	{
+	return std::make_shared<KeyfileBackend_t>(key);
+	}
+
+/*
+
+Name:	App_t::setupSigner()
+
+Function:
+	Choose the signer backend, and learn its public key.
+
+Definition:
+	void App_t::setupSigner();
+
+Description:
+	With --socket, we sign with the daemon; with --signer-command,
+	with the external signer process. In both cases --public-key, if
+	given, selects the key; otherwise the signer's first key is used.
+	Otherwise the key is read from the -k key file, and we sign
+	in-process.
+
+	Either way, this->keyfile.m_public is set to the signer's public
+	key, which addHash() places in the image ahead of the hash. Only
+	the in-process backend has the private key.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::setupSigner()
+	{
+	if (this->socketname == "" && this->signercommand == "")
+		{
+		this->keyfile.begin(this->keyfilename);
+
+		if (! this->keyfile.read())
+			this->fatal(string("can't read key file: ") + this->keyfilename);
+
+		if (this->fVerbose)
+			std::cout << "Keyfile comment: " << this->keyfile.m_comment << "\n\n";
+
+		this->pSigner = makeKeyfileBackend(this->keyfile);
+		return;
+		}
+
+	// the selector
+	mcci_tweetnacl_sign_publickey_t selector;
+
+	memset(&selector, 0, sizeof(selector));
+	if (this->publickeyfilename != "")
+		{
+		Keyfile_ed25519_t pubkey;
+
+		pubkey.begin(this->publickeyfilename);
+		if (! pubkey.readPublic() && ! pubkey.read())
+			this->fatal(string("can't read key file: ") + this->publickeyfilename);
+
+		selector = pubkey.m_public;
+		}
+
+	try	{
+		if (this->socketname != "")
+			this->pSigner = makeSocketBackend(this->socketname, selector);
+		else
+			this->pSigner = makeCommandBackend(this->signercommand, selector);
+		}
+	catch (std::exception &e)
+		{
+		this->fatal(e.what());
+		}
+
+	this->keyfile.clear();
+	this->keyfile.m_public = this->pSigner->publicKey();
+
+	this->verbose("signing with " + this->pSigner->name());
+	}
+
+/// \brief the signer; if none was set up, sign with this->keyfile.
+Backend_t &App_t::signer()
+	{
+	if (! this->pSigner)
+		this->pSigner = makeKeyfileBackend(this->keyfile);
+
+	return *this->pSigner;
+	}
+
+/**** end of signer_keyfile.cpp ****/
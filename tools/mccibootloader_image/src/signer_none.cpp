@@ -0,0 +1,75 @@
+/*
+
+Module:	signer_none.cpp
+
+Function:
+	Stubs for the signing daemon on platforms without Unix-domain sockets.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+#include "mccibootloader_signer.h"
+
+#include <stdexcept>
+
+using namespace McciBootloader_Signer;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+[[noreturn]]
+void App_t::runSigner()
+	{
+	this->fatal("--daemon is not supported on this platform");
+	}
+
+std::shared_ptr<Backend_t>
+McciBootloader_Signer::makeSocketBackend(
+	const std::string &,
+	const mcci_tweetnacl_sign_publickey_t &
+	)
+	{
+	throw std::runtime_error("--socket is not supported on this platform");
+	}
+
+std::shared_ptr<Backend_t>
+McciBootloader_Signer::makeCommandBackend(
+	const std::string &,
+	const mcci_tweetnacl_sign_publickey_t &
+	)
+	{
+	throw std::runtime_error("--signer-command is not supported on this platform");
+	}
+
+/**** end of signer_none.cpp ****/
@@ -0,0 +1,325 @@
+/*
+
+Module:	trace.cpp
+
+Function:
+	Phase timing for mccibootloader_image: the recorder, the summary
+	and the Chrome trace-event output.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	April 2021
+
+*/
+
+#include "mccibootloader_trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+
+#if defined(_WIN32)
+# define NOMINMAX
+# include <windows.h>
+#endif
+
+using namespace McciBootloader_Trace;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief the CPU time used so far by the calling thread, in ns.
+std::int64_t threadCpuNs()
+	{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+
+	if (! GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	auto const ticks = [](const FILETIME &t)
+		{
+		return (std::int64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+		};
+
+	// FILETIME ticks are 100 ns.
+	return (ticks(kernel) + ticks(user)) * 100;
+#else
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return 0;
+
+	return std::int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+	}
+
+/// \brief \p s as a JSON string, with the quotes.
+std::string jsonString(const std::string &s)
+	{
+	std::string result { "\"" };
+
+	for (auto c : s)
+		{
+		if (c == '"' || c == '\\')
+			{
+			result.push_back('\\');
+			result.push_back(c);
+			}
+		else if ((unsigned char)c < 0x20)
+			{
+			char buf[8];
+
+			std::snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+			result.append(buf);
+			}
+		else
+			result.push_back(c);
+		}
+
+	result.push_back('"');
+	return result;
+	}
+
+/// \brief nanoseconds as milliseconds, for the summary
+struct Ms_t
+	{
+	std::int64_t	ns;
+	};
+
+std::ostream &operator<<(std::ostream &os, const Ms_t &ms)
+	{
+	return os << std::fixed << std::setprecision(3) << double(ms.ns) / 1e6;
+	}
+
+/// \brief nanoseconds as microseconds, for the trace
+std::string us(std::int64_t ns)
+	{
+	char buf[32];
+
+	std::snprintf(buf, sizeof(buf), "%.3f", double(ns) / 1e3);
+	return buf;
+	}
+
+/// \brief the most files listed in the summary
+constexpr std::size_t kMaxSummaryFiles = 10;
+
+} // namespace
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+Stamp_t Stamp_t::now()
+	{
+	return { std::chrono::steady_clock::now(), threadCpuNs() };
+	}
+
+void Recorder_t::add(
+	const char *pName,
+	Kind_t kind,
+	const std::string &file,
+	const Stamp_t &start,
+	const Stamp_t &end
+	)
+	{
+	auto const ns = [](std::chrono::steady_clock::duration d)
+		{
+		return std::int64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+		};
+
+	std::lock_guard<std::mutex> lock { this->m_mutex };
+
+	auto const tid = this->m_tids.emplace(std::this_thread::get_id(), unsigned(this->m_tids.size() + 1)).first->second;
+
+	this->m_events.push_back(
+		{
+		pName,
+		kind,
+		file,
+		tid,
+		ns(start.wall - this->m_start.wall),
+		ns(end.wall - start.wall),
+		end.cpuNs - start.cpuNs
+		});
+	}
+
+/*
+
+Name:	McciBootloader_Trace::Recorder_t::writeSummary()
+
+Function:
+	Write the human-readable summary of a run.
+
+Definition:
+	void McciBootloader_Trace::Recorder_t::writeSummary(
+		std::ostream &os
+		) const;
+
+Description:
+	The phases are listed in the order they first ran, with the
+	number of times each ran and the total wall-clock and CPU time.
+	Phases run on several threads at once can add up to more
+	wall-clock time than the run took; nested phases are counted in
+	both. If any files were timed, the slowest are listed too.
+
+Returns:
+	No explicit result.
+
+*/
+
+void Recorder_t::writeSummary(std::ostream &os) const
+	{
+	std::lock_guard<std::mutex> lock { this->m_mutex };
+
+	struct Total_t
+		{
+		std::string	name;
+		unsigned	nCalls;
+		std::int64_t	wallNs;
+		std::int64_t	cpuNs;
+		};
+
+	std::vector<Total_t> phases;
+	std::vector<Total_t> files;
+
+	auto const tally = [](std::vector<Total_t> &totals, const std::string &name, const Event_t &e)
+		{
+		auto it = std::find_if(totals.begin(), totals.end(),
+				[&name](const Total_t &t) { return t.name == name; });
+
+		if (it == totals.end())
+			it = totals.insert(totals.end(), { name, 0, 0, 0 });
+
+		it->nCalls += 1;
+		it->wallNs += e.wallNs;
+		it->cpuNs += e.cpuNs;
+		};
+
+	std::int64_t endNs = 0;
+
+	for (auto const &e : this->m_events)
+		{
+		if (e.kind == Kind_t::kFile)
+			tally(files, e.file, e);
+		else
+			tally(phases, e.pName, e);
+
+		endNs = std::max(endNs, e.startNs + e.wallNs);
+		}
+
+	auto const flags = os.flags();
+
+	os << "\nphase              calls      wall ms       cpu ms\n";
+	for (auto const &t : phases)
+		{
+		os << std::left << std::setw(16) << t.name << std::right
+		   << std::setw(8) << t.nCalls
+		   << std::setw(13) << Ms_t { t.wallNs }
+		   << std::setw(13) << Ms_t { t.cpuNs }
+		   << "\n";
+		}
+
+	os << "elapsed: " << Ms_t { endNs } << " ms";
+	if (this->m_tids.size() > 1)
+		os << " on " << this->m_tids.size() << " threads";
+	os << "\n";
+
+	if (files.size() != 0)
+		{
+		std::stable_sort(files.begin(), files.end(),
+			[](const Total_t &a, const Total_t &b) { return a.wallNs > b.wallNs; });
+
+		os << "\n" << files.size() << " file(s)";
+		if (files.size() > kMaxSummaryFiles)
+			os << ", slowest " << kMaxSummaryFiles;
+		os << ":\n";
+
+		os << "     wall ms       cpu ms  file\n";
+		for (std::size_t i = 0; i < files.size() && i < kMaxSummaryFiles; ++i)
+			{
+			auto const &t = files[i];
+
+			os << std::setw(12) << Ms_t { t.wallNs }
+			   << std::setw(13) << Ms_t { t.cpuNs }
+			   << "  " << t.name
+			   << "\n";
+			}
+		}
+
+	os.flags(flags);
+	}
+
+/*
+
+Name:	McciBootloader_Trace::Recorder_t::writeChromeTrace()
+
+Function:
+	Write the spans in the Chrome trace-event format.
+
+Definition:
+	void McciBootloader_Trace::Recorder_t::writeChromeTrace(
+		std::ostream &os
+		) const;
+
+Description:
+	Each span is a complete ("X") event, with times in microseconds
+	from the start of the run; the CPU time and file name are in its
+	args. File spans are named by the file. The result can be loaded
+	into chrome://tracing or https://ui.perfetto.dev.
+
+Returns:
+	No explicit result.
+
+*/
+
+void Recorder_t::writeChromeTrace(std::ostream &os) const
+	{
+	std::lock_guard<std::mutex> lock { this->m_mutex };
+
+	os << "{\"traceEvents\":[\n";
+	os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"mccibootloader_image\"}}";
+
+	for (auto const &e : this->m_events)
+		{
+		bool const fFile = e.kind == Kind_t::kFile;
+
+		os << ",\n{\"name\":" << jsonString(fFile ? e.file : std::string(e.pName))
+		   << ",\"cat\":\"" << (fFile ? "file" : "phase") << "\""
+		   << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.tid
+		   << ",\"ts\":" << us(e.startNs)
+		   << ",\"dur\":" << us(e.wallNs)
+		   << ",\"args\":{\"cpu_us\":" << us(e.cpuNs);
+		if (e.file != "")
+			os << ",\"file\":" << jsonString(e.file);
+		os << "}}";
+		}
+
+	os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	}
+
+/**** end of trace.cpp ****/
@@ -0,0 +1,609 @@
+/*
+
+Module:	verify.cpp
+
+Function:
+	App_t::verify() and related methods: check images the way the
+	bootloader will.
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+
+#include <atomic>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+static void addInputs(
+	const string &arg,
+	std::vector<std::string> &files
+	);
+
+static bool isImageCandidate(
+	const fs::path &path
+	);
+
+static string hex32(
+	uint32_t v
+	);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::verify()
+
+Function:
+	Check a collection of images using the bootloader's rules.
+
+Definition:
+	int App_t::verify();
+
+Description:
+	Each entry in this->verifyArgs names a file, a directory (which is
+	scanned recursively for candidate images), or, if prefixed with
+	'@', a list file containing one name per line ("@-" reads the list
+	from stdin). The resulting files are checked concurrently using
+	this->nJobs worker threads. Nothing is written.
+
+	If a public key was supplied (with --public-key or -k), each image
+	must be signed with that key. Otherwise the signature is checked
+	against the key embedded in the image, which proves only that the
+	image is self-consistent.
+
+Returns:
+	EXIT_SUCCESS if every image passed, EXIT_FAILURE otherwise.
+
+*/
+
+int App_t::verify()
+	{
+	// get the key, if any.
+	auto const pPublicKey = this->readCheckKey();
+
+	// expand the arguments into a list of files
+	std::vector<std::string> files;
+
+	for (auto const &arg : this->verifyArgs)
+		{
+		try	{
+			addInputs(arg, files);
+			}
+		catch (std::exception &e)
+			{
+			this->fatal(e.what());
+			}
+		}
+
+	if (files.size() == 0)
+		this->fatal("no images found to verify");
+
+	// set up the results, one per file, in input order.
+	std::vector<McciBootloader_VerifyResult_t> results(files.size());
+	for (size_t i = 0; i < files.size(); ++i)
+		results[i].filename = files[i];
+
+	// run the workers. Each claims the next unchecked file until
+	// there are none left.
+	unsigned nJobs = this->nJobs;
+	if (nJobs == 0)
+		nJobs = std::max(1u, std::thread::hardware_concurrency());
+	if (nJobs > files.size())
+		nJobs = unsigned(files.size());
+
+	std::atomic<size_t> iNext { 0 };
+	auto const worker = [this, &iNext, &results, pPublicKey]()
+		{
+		for (size_t i; (i = iNext++) < results.size(); )
+			this->verifyFile(results[i], pPublicKey);
+		};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < nJobs; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto &t : threads)
+		t.join();
+
+	// report.
+	size_t nFailed = 0;
+	size_t nUnkeyed = 0;
+
+	for (auto const &r : results)
+		{
+		if (r.failures.size() != 0)
+			++nFailed;
+		else if (! r.fKeyChecked)
+			++nUnkeyed;
+
+		if (r.failures.size() == 0 && this->fVerbose)
+			{
+			std::cout << "ok: " << r.filename;
+			if (r.fAppInfo)
+				std::cout << " (" << hex32(r.appInfo.targetAddress.get())
+					  << ", v" << unsigned(McciVersion::getMajor(r.appInfo.version.get()))
+					  << "." << unsigned(McciVersion::getMinor(r.appInfo.version.get()))
+					  << "." << unsigned(McciVersion::getPatch(r.appInfo.version.get()))
+					  << ", \"" << r.appInfo.comment.get() << "\")"
+					  ;
+			std::cout << "\n";
+			}
+		}
+
+	std::cout << "verified " << results.size() << " image(s): "
+		  << results.size() - nFailed << " passed, "
+		  << nFailed << " failed\n";
+
+	if (pPublicKey == nullptr && nUnkeyed != 0)
+		std::cout << "warning: no public key supplied; signatures were checked against the embedded key\n";
+
+	if (nFailed != 0)
+		{
+		std::cout << "\nFailures:\n";
+		for (auto const &r : results)
+			{
+			for (auto const &why : r.failures)
+				std::cout << "  " << r.filename << ": " << why << "\n";
+			}
+		}
+
+	std::cout << std::flush;
+	return nFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+/*
+
+Name:	App_t::readCheckKey()
+
+Function:
+	Read the key that images must be signed with, if one was given.
+
+Definition:
+	const mcci_tweetnacl_sign_publickey_t *App_t::readCheckKey();
+
+Description:
+	The key is taken from --public-key if given, otherwise from -k.
+	Either may name a public or a private key file.
+
+Returns:
+	A pointer to the public key, or nullptr if no key was given, in
+	which case signatures are checked against the key embedded in
+	each image. A key file that can't be read is fatal.
+
+*/
+
+const mcci_tweetnacl_sign_publickey_t *App_t::readCheckKey()
+	{
+	if (this->publickeyfilename == "" && this->keyfilename == "")
+		return nullptr;
+
+	auto const &keyfilename = this->publickeyfilename != ""
+					? this->publickeyfilename
+					: this->keyfilename
+					;
+	this->keyfile.begin(keyfilename);
+
+	if (! this->keyfile.readPublic() && ! this->keyfile.read())
+		this->fatal(string("can't read key file: ") + keyfilename);
+
+	if (this->fVerbose)
+		std::cout << "Keyfile comment: " << this->keyfile.m_comment << "\n\n";
+
+	return &this->keyfile.m_public;
+	}
+
+/*
+
+Name:	App_t::verifyFile()
+
+Function:
+	Read and verify a single image; runs on a worker thread.
+
+Definition:
+	void App_t::verifyFile(
+		McciBootloader_VerifyResult_t &result,
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+		std::vector<uint8_t> *pImage = nullptr
+		) const;
+
+Description:
+	A private App_t is used to read the file, so that the normal ELF
+	and binary handling applies. Errors that would normally terminate
+	the program are instead recorded in result.failures.
+
+	If \p pImage isn't null, the image as read (for ELF files, the
+	loadable bytes) is moved to *pImage, whether or not it passed.
+
+Returns:
+	No explicit result.
+
+*/
+
+void App_t::verifyFile(
+	McciBootloader_VerifyResult_t &result,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	std::vector<uint8_t> *pImage
+	) const
+	{
+	App_t worker {};
+
+	worker.progname = this->progname;
+	worker.infilename = result.filename;
+	worker.fForceBinary = this->fForceBinary;
+	worker.fCaptureErrors = true;
+	worker.authSize = this->authSize;
+	worker.pTrace = this->pTrace;
+
+	auto const span = worker.span("file", McciBootloader_Trace::Kind_t::kFile);
+
+	try	{
+		worker.readImage();
+		worker.verifyImage(result, pPublicKey);
+
+		if (pImage != nullptr)
+			*pImage = std::move(worker.fileimage);
+		}
+	catch (std::exception &e)
+		{
+		result.failures.push_back(e.what());
+		}
+	}
+
+/*
+
+Name:	App_t::verifyImage()
+
+Function:
+	Apply the bootloader's checks to this->fileimage.
+
+Definition:
+	void App_t::verifyImage(
+		McciBootloader_VerifyResult_t &result,
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey
+		);
+
+Description:
+	The checks follow McciBootloader_checkStorageImage(), which calls
+	McciBootloaderPlatform_checkImageValid() with a target size of
+	imagesize + authsize, and then McciBootloader_checkCodeValid(),
+	which repeats the layout checks against the flash region the image
+	will occupy. Rather than stopping at the first failure, we report
+	every check that fails, as long as the layout is sane enough to
+	continue.
+
+Returns:
+	No explicit result; failures are appended to result.failures.
+
+*/
+
+void App_t::verifyImage(
+	McciBootloader_VerifyResult_t &result,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey
+	)
+	{
+	using MemoryMap = McciBootloader_MemoryMap_t;
+	auto &failures = result.failures;
+	auto const span = this->span("verify");
+
+	// the checks work on the image as it will be in flash.
+	this->flattenImage();
+
+	// McciBootloaderPlatform_getAppInfo()
+	const McciBootloader_AppInfoOffset_t *pEntry = nullptr;
+	uint8_t *pFileAppInfo;
+
+	for (auto const &Entry : vAppInfoOffsets)
+		{
+		if (this->probeHeader(Entry.appInfoOffset, result.appInfo, pFileAppInfo))
+			{
+			pEntry = &Entry;
+			break;
+			}
+		}
+
+	if (pEntry == nullptr)
+		{
+		failures.push_back("no valid AppInfo structure");
+		return;
+		}
+
+	result.fAppInfo = true;
+
+	auto const &appInfo = result.appInfo;
+	size_t const nPageZero = pEntry->pageZeroSize;
+	uint32_t const targetAddress = appInfo.targetAddress.get();
+	uint32_t const imagesize = appInfo.imagesize.get();
+	uint32_t const authsize = appInfo.authsize.get();
+	uint64_t const targetSize = uint64_t(imagesize) + authsize;
+
+	// McciBootloaderPlatform_checkImageValid(): stack pointer
+	auto const &appEntry = *reinterpret_cast<const CortexAppEntryContents_t *>(&this->fileimage.at(0));
+	uint32_t const stack = appEntry.stack.get();
+
+	if (stack & 3)
+		failures.push_back("stack pointer " + hex32(stack) + " is not 4-byte aligned");
+
+	if (stack < MemoryMap::kSocRamBase + 16 || MemoryMap::kSocRamTop < stack)
+		failures.push_back("stack pointer " + hex32(stack) + " is outside of SoC RAM");
+
+	// ... entry point: after page zero, and inside the image
+	uint32_t const entry = appEntry.entry.get();
+
+	if ((entry & 1) == 0)
+		failures.push_back("entry point " + hex32(entry) + " is not a Thumb address");
+
+	if ((entry & ~UINT32_C(1)) < uint64_t(targetAddress) + nPageZero ||
+	    uint64_t(targetAddress) + targetSize <= (entry & ~UINT32_C(1)))
+		failures.push_back("entry point " + hex32(entry) + " is outside of the image");
+
+	// ... and the AppInfo
+	if (authsize != this->authSize)
+		{
+		failures.push_back("AppInfo.authsize " + hex32(authsize) + " is not " + hex32(uint32_t(this->authSize)));
+		return;
+		}
+
+	// McciBootloader_checkCodeValid() is applied to the region where
+	// the image will be programmed; make sure it fits there.
+	uint64_t regionSize;
+
+	if (targetAddress == MemoryMap::kAppBase)
+		{
+		regionSize = MemoryMap::kAppSize;
+		if (targetSize > MemoryMap::kStorageImageSize)
+			failures.push_back("image size " + hex32(uint32_t(targetSize)) + " exceeds the storage slot size");
+		}
+	else if (targetAddress == MemoryMap::kBootBase)
+		{
+		regionSize = MemoryMap::kBootSize;
+		}
+	else
+		{
+		failures.push_back("AppInfo.targetAddress " + hex32(targetAddress) + " is neither the app nor the bootloader base");
+		regionSize = targetSize;
+		}
+
+	if (targetSize > regionSize)
+		failures.push_back("image size " + hex32(uint32_t(targetSize)) + " exceeds the flash region size " + hex32(uint32_t(regionSize)));
+
+	if (targetSize > this->fileimage.size())
+		{
+		failures.push_back("file is truncated: AppInfo needs " + hex32(uint32_t(targetSize)) + " bytes");
+		return;
+		}
+
+	if (pPublicKey != nullptr)
+		result.fKeyChecked = true;
+
+	// McciBootloader_checkCodeValid() and McciBootloader_checkStorageImage():
+	// the hash and the signature
+	checkSignatureBlock(&this->fileimage[0], imagesize, pPublicKey, true, failures);
+	}
+
+/*
+
+Name:	App_t::checkSignatureBlock()
+
+Function:
+	Check the hash, and optionally the signature, in an image's
+	signature block.
+
+Definition:
+	static void App_t::checkSignatureBlock(
+		const uint8_t *pImage,
+		uint32_t imagesize,
+		const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+		bool fCheckSignature,
+		std::vector<string> &failures
+		);
+
+Description:
+	pImage points to imagesize bytes of image, followed by the
+	signature block. The SHA-512 of the image and the public key is
+	compared with the hash in the block; if that fails, nothing else
+	is checked. If pPublicKey isn't null, the key in the block must
+	match it, and it's the key used to check the signature; otherwise
+	the key in the block is used. The signature is only checked if
+	fCheckSignature is true, so that images that are hashed but not
+	signed can be checked too.
+
+	This is used by --verify, and to check entries read from the
+	signing cache.
+
+Returns:
+	No explicit result; failures are appended to failures.
+
+*/
+
+void App_t::checkSignatureBlock(
+	const uint8_t *pImage,
+	uint32_t imagesize,
+	const mcci_tweetnacl_sign_publickey_t *pPublicKey,
+	bool fCheckSignature,
+	std::vector<string> &failures
+	)
+	{
+	auto const pSigBlock = reinterpret_cast<const McciBootloader_SignatureBlock_Wire_t *>(pImage + imagesize);
+	mcci_tweetnacl_sha512_t hash;
+
+	mcci_tweetnacl_hash_sha512(
+		&hash,
+		pImage,
+		imagesize + sizeof(pSigBlock->publicKey)
+		);
+
+	if (! mcci_tweetnacl_result_is_success(mcci_tweetnacl_verify_64(hash.bytes, pSigBlock->hash)))
+		{
+		failures.push_back("SHA-512 hash mismatch");
+		return;
+		}
+
+	mcci_tweetnacl_sign_publickey_t imageKey;
+	memcpy(imageKey.bytes, pSigBlock->publicKey, sizeof(imageKey.bytes));
+
+	if (pPublicKey != nullptr)
+		{
+		if (! mcci_tweetnacl_result_is_success(mcci_tweetnacl_verify_32(pPublicKey->bytes, imageKey.bytes)))
+			failures.push_back("image was signed with a different public key");
+		}
+	else
+		pPublicKey = &imageKey;
+
+	if (! fCheckSignature)
+		return;
+
+	uint8_t signedMessage[sizeof(pSigBlock->signature) + sizeof(hash.bytes)];
+	uint8_t openedMessage[sizeof(signedMessage)];
+	size_t nActual;
+
+	memcpy(signedMessage, pSigBlock->signature, sizeof(pSigBlock->signature));
+	memcpy(signedMessage + sizeof(pSigBlock->signature), hash.bytes, sizeof(hash.bytes));
+
+	auto const result_open = mcci_tweetnacl_sign_open(
+			openedMessage,
+			&nActual,
+			signedMessage,
+			sizeof(signedMessage),
+			pPublicKey
+			);
+
+	if (! mcci_tweetnacl_result_is_success(result_open) ||
+	    nActual != sizeof(hash.bytes) ||
+	    ! mcci_tweetnacl_result_is_success(mcci_tweetnacl_verify_64(hash.bytes, openedMessage)))
+		failures.push_back("ed25519 signature is not valid");
+	}
+
+/*
+
+Name:	addInputs()
+
+Function:
+	Expand one --verify argument into file names.
+
+Definition:
+	static void addInputs(
+		const string &arg,
+		std::vector<std::string> &files
+		);
+
+Description:
+	"@name" reads names (one per line; blank lines and lines starting
+	with '#' are ignored) from the named file, or from stdin if name
+	is "-". A directory is scanned recursively for candidate images,
+	in sorted order. Anything else is taken as a file name.
+
+Returns:
+	No explicit result. Throws on errors.
+
+*/
+
+static void addInputs(
+	const string &arg,
+	std::vector<std::string> &files
+	)
+	{
+	if (arg.size() > 1 && arg[0] == '@')
+		{
+		auto const listname = arg.substr(1);
+		std::ifstream listfile;
+		std::istream *pList = &std::cin;
+
+		if (listname != "-")
+			{
+			listfile.open(listname);
+			if (! listfile.is_open())
+				throw std::runtime_error("can't read list file: " + listname);
+			pList = &listfile;
+			}
+
+		for (string line; std::getline(*pList, line); )
+			{
+			if (line.size() != 0 && line.back() == '\r')
+				line.pop_back();
+			if (line.size() == 0 || line[0] == '#')
+				continue;
+
+			files.push_back(line);
+			}
+		}
+	else if (fs::is_directory(arg))
+		{
+		std::vector<std::string> dirfiles;
+
+		for (auto const &dirent : fs::recursive_directory_iterator(arg))
+			{
+			if (dirent.is_regular_file() && isImageCandidate(dirent.path()))
+				dirfiles.push_back(dirent.path().string());
+			}
+
+		std::sort(dirfiles.begin(), dirfiles.end());
+		files.insert(files.end(), dirfiles.begin(), dirfiles.end());
+		}
+	else
+		{
+		files.push_back(arg);
+		}
+	}
+
+/// \brief decide whether a file found in a directory scan should be checked
+///
+/// \details We take .bin and .elf files, plus files with no extension
+///	(which is how the linker names ELF outputs in this project).
+///
+static bool isImageCandidate(
+	const fs::path &path
+	)
+	{
+	auto const ext = path.extension().string();
+
+	return ext == ".bin" || ext == ".elf" || ext == "";
+	}
+
+static string hex32(
+	uint32_t v
+	)
+	{
+	std::ostringstream s;
+
+	s << "0x" << std::hex << std::setw(8) << std::setfill('0') << v;
+	return s.str();
+	}
+
+/**** end of verify.cpp ****/
@@ -0,0 +1,326 @@
+/*
+
+Module:	watch.cpp
+
+Function:
+	App_t::watch(): sign the input each time it changes (--watch).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+namespace {
+
+/// \brief what we've seen happen to the input since it was last signed
+struct WatchState_t
+	{
+	bool	fChanged = false;	///< the input changed
+	bool	fWriting = false;	///< it's been written, but not yet closed
+	};
+
+/// \brief if the input stays open for writing this long, sign it anyway.
+constexpr int kMaxWriteMs = 2000;
+
+/// \brief the identity and state of a file, as far as we can tell
+bool sameFile(const struct stat &a, const struct stat &b)
+	{
+	return a.st_dev == b.st_dev &&
+	       a.st_ino == b.st_ino &&
+	       a.st_size == b.st_size &&
+	       a.st_mtim.tv_sec == b.st_mtim.tv_sec &&
+	       a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+	}
+
+} // namespace
+
+static bool readEvents(int fd, int timeoutMs, const string &name, WatchState_t &state);
+static bool readStable(const string &filename, std::vector<uint8_t> &image);
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+/*
+
+Name:	App_t::watch()
+
+Function:
+	Sign the input, and then sign it again each time it changes.
+
+Definition:
+	int App_t::watch();
+
+Description:
+	The key has already been loaded, so each pass only reads, hashes,
+	signs and writes. The directory holding the input is watched with
+	inotify, so that we see the file being rewritten in place as well
+	as being replaced by rename, as linkers do.
+
+	Linkers write their output in bursts. After a change, we wait
+	until the input has been closed and no more events have come in
+	for this->watchDelayMs. Then the file is read, and checked to be
+	the same (size, mtime and inode) before and after; if it changed
+	while we read it, we wait again. So a partially written file is
+	never signed.
+
+	Each pass runs on a copy of this App_t, with errors captured; a
+	failure is reported, and we go back to waiting. Outputs that would
+	not change aren't rewritten (see outputIsUnchanged()).
+
+Returns:
+	Doesn't return; runs until interrupted, or until the watch fails.
+
+*/
+
+int App_t::watch()
+	{
+	auto const path = fs::path(this->infilename);
+	auto dirname = path.parent_path().string();
+	auto const basename = path.filename().string();
+
+	if (dirname == "")
+		dirname = ".";
+
+	int const fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0)
+		this->fatal(string("inotify_init1 failed: ") + std::strerror(errno));
+
+	if (inotify_add_watch(
+		fd,
+		dirname.c_str(),
+		IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE
+		) < 0)
+		this->fatal("can't watch " + dirname + ": " + std::strerror(errno));
+
+	std::cout << "watching " << this->infilename << " (interrupt to stop)" << std::endl;
+
+	WatchState_t state;
+	state.fChanged = true;
+
+	for (;;)
+		{
+		// wait for a change, then for things to settle down.
+		try	{
+			while (! state.fChanged)
+				readEvents(fd, -1, basename, state);
+
+			while (readEvents(
+				fd,
+				state.fWriting ? kMaxWriteMs : int(this->watchDelayMs),
+				basename,
+				state
+				))
+				/* keep reading */;
+			}
+		catch (std::exception &e)
+			{
+			this->fatal(e.what());
+			}
+
+		state = WatchState_t {};
+
+		App_t worker = *this;
+		worker.fCaptureErrors = true;
+		worker.fWatch = false;
+
+		auto const tStart = std::chrono::steady_clock::now();
+
+		try	{
+			if (! readStable(this->infilename, worker.fileimage))
+				{
+				// another event is on the way
+				this->verbose(this->infilename + ": changed while being read");
+				continue;
+				}
+
+			worker.parseImage();
+			worker.processImage();
+			}
+		catch (std::exception &e)
+			{
+			std::cout << this->infilename << ": " << e.what()
+				  << "; waiting for the next change" << std::endl;
+			continue;
+			}
+
+		auto const ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::steady_clock::now() - tStart
+					).count();
+
+		std::cout << "signed " << this->infilename << " -> " << this->outfilename
+			  << " (" << ms << " ms)" << std::endl;
+		}
+	}
+
+/*
+
+Name:	readEvents()
+
+Function:
+	Wait for and read inotify events for the input.
+
+Definition:
+	static bool readEvents(
+		int fd,
+		int timeoutMs,
+		const string &name,
+		WatchState_t &state
+		);
+
+Description:
+	Waits up to timeoutMs (forever, if negative) for events on fd,
+	and then reads them, updating state for the ones that name the
+	input.
+
+Returns:
+	true if events were read, false if the wait timed out. Throws if
+	the inotify descriptor fails.
+
+*/
+
+static bool readEvents(
+	int fd,
+	int timeoutMs,
+	const string &name,
+	WatchState_t &state
+	)
+	{
+	struct pollfd pfd = { fd, POLLIN, 0 };
+	int const nReady = poll(&pfd, 1, timeoutMs);
+
+	if (nReady < 0 && errno == EINTR)
+		return true;
+	if (nReady < 0)
+		throw std::runtime_error(string("poll failed: ") + std::strerror(errno));
+	if (nReady == 0)
+		return false;
+
+	alignas(struct inotify_event) char buffer[16 * 1024];
+	ssize_t const n = read(fd, buffer, sizeof(buffer));
+
+	if (n <= 0)
+		throw std::runtime_error(string("inotify read failed: ") + std::strerror(errno));
+
+	for (ssize_t i = 0; i < n; )
+		{
+		auto const pEvent = (const struct inotify_event *)(buffer + i);
+
+		i += sizeof(*pEvent) + pEvent->len;
+
+		if (pEvent->len == 0 || name != pEvent->name)
+			continue;
+
+		state.fChanged = true;
+
+		if (pEvent->mask & (IN_CREATE | IN_MODIFY))
+			state.fWriting = true;
+		if (pEvent->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE))
+			state.fWriting = false;
+		}
+
+	return true;
+	}
+
+/*
+
+Name:	readStable()
+
+Function:
+	Read a file, making sure it didn't change while we read it.
+
+Definition:
+	static bool readStable(
+		const string &filename,
+		std::vector<uint8_t> &image
+		);
+
+Description:
+	The file is read through one descriptor. Its size, modification
+	time and inode are compared before and after, and with those of
+	the name (in case the file was replaced while we read it).
+
+Returns:
+	true if the file was read and didn't change; false otherwise.
+	Throws if the file can't be read.
+
+*/
+
+static bool readStable(
+	const string &filename,
+	std::vector<uint8_t> &image
+	)
+	{
+	int const fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error("can't read " + filename + ": " + std::strerror(errno));
+
+	struct stat before, after, byName;
+	bool fOk = fstat(fd, &before) == 0;
+
+	if (fOk)
+		{
+		image.resize(size_t(before.st_size));
+
+		for (size_t i = 0; fOk && i < image.size(); )
+			{
+			ssize_t const n = pread(fd, &image[i], image.size() - i, off_t(i));
+
+			if (n <= 0)
+				fOk = false;
+			else
+				i += size_t(n);
+			}
+		}
+
+	fOk = fOk &&
+	      fstat(fd, &after) == 0 &&
+	      stat(filename.c_str(), &byName) == 0 &&
+	      sameFile(before, after) &&
+	      sameFile(before, byName);
+
+	close(fd);
+	return fOk;
+	}
+
+/**** end of watch.cpp ****/
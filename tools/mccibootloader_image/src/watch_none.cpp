@@ -0,0 +1,51 @@
+/*
+
+Module:	watch_none.cpp
+
+Function:
+	App_t::watch() for platforms without inotify (--watch).
+
+Copyright and License:
+	This file copyright (C) 2021 by
+
+		MCCI Corporation
+		3520 Krums Corners Road
+		Ithaca, NY  14850
+
+	See accompanying LICENSE file for copyright and license information.
+
+Author:
+	Terry Moore, MCCI Corporation	March 2021
+
+*/
+
+#include "mccibootloader_image.h"
+
+/****************************************************************************\
+|
+|	Manifest constants & typedefs.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Read-only data.
+|
+\****************************************************************************/
+
+
+
+/****************************************************************************\
+|
+|	Variables.
+|
+\****************************************************************************/
+
+int App_t::watch()
+	{
+	this->fatal("--watch is not supported on this platform");
+	}
+
+/**** end of watch_none.cpp ****/
@@ -121,6 +121,23 @@ else
   T_EXE_SUFFIX=
 endif
 
+#
+# figure out the shared library suffix
+# postcondition: T_SO_SUFFIX is .so or .dylib, or empty if we don't
+# build shared libraries for this target. T_LDFLAG_SONAME is the linker
+# flag that names the library, so that programs find it via their rpath.
+#
+ifneq ($(filter %-windows-msvc,$(CC_MULTIARCH)),)
+  T_SO_SUFFIX=
+  T_LDFLAG_SONAME=
+else ifneq ($(filter %-Darwin,$(CC_MULTIARCH)),)
+  T_SO_SUFFIX=.dylib
+  T_LDFLAG_SONAME=-install_name,@rpath/
+else
+  T_SO_SUFFIX=.so
+  T_LDFLAG_SONAME=-soname,
+endif
+
 #
 # figure out what we're doing for the archiver
 #
@@ -275,6 +275,67 @@ endef
 
 $(foreach L,$(LIBRARIES),$(eval $(call MCCI_DOLIBRARY,$(L))))
 
+##############################################################################
+#
+# Macro: MCCI_DOSHAREDLIBRARY
+#
+# Function:
+#	Generate the rules for building a shared library from static
+#	libraries.
+#
+# Usage:
+#	$(call MCCI_DOSHAREDLIBRARY,libraryname)
+#
+# Input:
+#	$1		name of library (without suffix)
+#	ARCHIVES_$1	the names of the LIBRARIES whose objects make up
+#			the shared library. Their sources must be built
+#			with -fPIC.
+#	LDADD_$1	additional libraries needed by the shared library
+#	T_SO_SUFFIX	the suffix (.so or .dylib); if empty, nothing is
+#			built.
+#
+# Notes:
+#	The shared library may have the same name as one of its archives;
+#	the archive's rules install its include files.
+#
+# Output:
+#	MCCI_CLEANFILES	updated with additional files to remove
+#	all		is updated with the library to be built.
+#
+##############################################################################
+
+define MCCI_DOSHAREDLIBRARY
+ifneq ($$(T_SO_SUFFIX),)
+MCCI_CLEANFILES += $$(T_OBJDIR)/$1$$(T_SO_SUFFIX)
+
+$$(T_OBJDIR)/$1$$(T_SO_SUFFIX): $$(foreach A,$$(ARCHIVES_$1),$$(OBJECTS_$$A))
+	@echo $1$$(T_SO_SUFFIX)
+	$${MAKEHUSH}$$(CXXLINK) $$(CXXFLAGS) -shared -Wl,$${T_LDFLAG_SONAME}$1$$(T_SO_SUFFIX) \
+		$${foreach ldflag, $$(LDFLAGS) $$(LDFLAGS_$1), -Wl,$$(ldflag)} -o $$@ $$^ \
+		$$(LDADD) $$(LDADD_$1)
+
+all $1$$(T_SO_SUFFIX):	$$(T_OBJDIR)/$1$$(T_SO_SUFFIX)
+.PHONY:		$1$$(T_SO_SUFFIX)
+
+_MCCI_INSTALLDIR_LIB_EXPAND_$1 := $${subst *,$1,$${MCCI_INSTALLDIR_LIB}}
+_install_libraries: 	_install_libraries_$1$$(T_SO_SUFFIX)
+
+.PHONY:	_install_libraries_$1$$(T_SO_SUFFIX)
+_install_libraries_$1$$(T_SO_SUFFIX):	$${T_OBJDIR}/$1$$(T_SO_SUFFIX)
+	$${MAKEHUSH}$${MCCI_INSTALLDIR_CMD} $${_MCCI_INSTALLDIR_LIB_EXPAND_$1}.
+	$${MAKEHUSH}$${MCCI_INSTALL_CMD} -m 555 $${T_OBJDIR}/$1$$(T_SO_SUFFIX) $${_MCCI_INSTALLDIR_LIB_EXPAND_$1}.
+endif
+endef
+
+##############################################################################
+#
+#	Generate the rules for each of the SHARED_LIBRARIES
+#
+##############################################################################
+
+$(foreach L,$(SHARED_LIBRARIES),$(eval $(call MCCI_DOSHAREDLIBRARY,$(L))))
+
 ##############################################################################
 #
 # Name: MCCI_DOPROGRAM